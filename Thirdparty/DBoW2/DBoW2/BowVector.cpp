@@ -31,11 +31,54 @@ BowVector::~BowVector(void)
 
 // --------------------------------------------------------------------------
 
+static bool wordLess(const std::pair<WordId, WordValue> &a, 
+  const std::pair<WordId, WordValue> &b)
+{
+  return a.first < b.first;
+}
+
+static bool wordIdLess(const std::pair<WordId, WordValue> &a, WordId id)
+{
+  return a.first < id;
+}
+
+// --------------------------------------------------------------------------
+
+BowVector::iterator BowVector::lower_bound(WordId id)
+{
+  return std::lower_bound(this->begin(), this->end(), id, wordIdLess);
+}
+
+// --------------------------------------------------------------------------
+
+BowVector::const_iterator BowVector::lower_bound(WordId id) const
+{
+  return std::lower_bound(this->begin(), this->end(), id, wordIdLess);
+}
+
+// --------------------------------------------------------------------------
+
+BowVector::iterator BowVector::find(WordId id)
+{
+  BowVector::iterator vit = this->lower_bound(id);
+  return (vit != this->end() && vit->first == id) ? vit : this->end();
+}
+
+// --------------------------------------------------------------------------
+
+BowVector::const_iterator BowVector::find(WordId id) const
+{
+  BowVector::const_iterator vit = this->lower_bound(id);
+  return (vit != this->end() && vit->first == id) ? vit : this->end();
+}
+
+// --------------------------------------------------------------------------
+
 void BowVector::addWeight(WordId id, WordValue v)
 {
   BowVector::iterator vit = this->lower_bound(id);
   
-  if(vit != this->end() && !(this->key_comp()(id, vit->first)))
+  if(vit != this->end() && vit->first == id)
   {
     vit->second += v;
   }
@@ -51,7 +94,7 @@ void BowVector::addIfNotExist(WordId id, WordValue v)
 {
   BowVector::iterator vit = this->lower_bound(id);
   
-  if(vit == this->end() || (this->key_comp()(id, vit->first)))
+  if(vit == this->end() || vit->first != id)
   {
     this->insert(vit, BowVector::value_type(id, v));
   }
@@ -59,6 +102,37 @@ void BowVector::addIfNotExist(WordId id, WordValue v)
 
 // --------------------------------------------------------------------------
 
+void BowVector::setWords(std::vector<std::pair<WordId, WordValue> > &words,
+  bool accumulate)
+{
+  this->clear();
+
+  // stable, so that repeated words are added up in the same order as 
+  // addWeight does
+  std::stable_sort(words.begin(), words.end(), wordLess);
+
+  // exact size, keyframes keep their vectors
+  size_t n = 0;
+  std::vector<std::pair<WordId, WordValue> >::const_iterator wit;
+  for(wit = words.begin(); wit != words.end(); ++wit)
+    if(wit == words.begin() || (wit-1)->first != wit->first) ++n;
+  this->reserve(n);
+
+  for(wit = words.begin(); wit != words.end(); ++wit)
+  {
+    if(!this->empty() && this->back().first == wit->first)
+    {
+      if(accumulate) this->back().second += wit->second;
+    }
+    else
+    {
+      this->push_back(*wit);
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+
 void BowVector::normalize(LNorm norm_type)
 {
   double norm = 0.0; 
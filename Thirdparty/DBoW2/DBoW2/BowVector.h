@@ -16,6 +16,7 @@
 
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/map.hpp>
+#include <boost/serialization/split_member.hpp>
 
 namespace DBoW2 {
 
@@ -55,16 +56,26 @@ enum ScoringType
   DOT_PRODUCT,
 };
 
-/// Vector of words to represent images
+/// Vector of words to represent images, stored as (word id, value) pairs
+/// sorted by word id. It is serialized as a std::map<WordId, WordValue>
 class BowVector: 
-	public std::map<WordId, WordValue>
+	public std::vector<std::pair<WordId, WordValue> >
 {
     friend class boost::serialization::access;
     template<class Archive>
-    void serialize(Archive& ar, const int version)
+    void save(Archive& ar, const int version) const
     {
-        ar & boost::serialization::base_object<std::map<WordId, WordValue> >(*this);
+        const std::map<WordId, WordValue> m(this->begin(), this->end());
+        ar & m;
     }
+    template<class Archive>
+    void load(Archive& ar, const int version)
+    {
+        std::map<WordId, WordValue> m;
+        ar & m;
+        this->assign(m.begin(), m.end());
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
 
 public:
 
@@ -78,9 +89,24 @@ public:
 	 */
 	~BowVector(void);
 	
+	/**
+	 * Returns the first word whose id is not less than the given one
+	 * @param id word id to look for
+	 */
+	iterator lower_bound(WordId id);
+	const_iterator lower_bound(WordId id) const;
+
+	/**
+	 * Returns the given word, or end() if it is not in the vector
+	 * @param id word id to look for
+	 */
+	iterator find(WordId id);
+	const_iterator find(WordId id) const;
+
 	/**
 	 * Adds a value to a word value existing in the vector, or creates a new
-	 * word with the given value
+	 * word with the given value. Inserting is linear in the vector size, use
+	 * setWords to build the whole vector
 	 * @param id word id to look for
 	 * @param v value to create the word with, or to add to existing word
 	 */
@@ -93,6 +119,16 @@ public:
 	 */
 	void addIfNotExist(WordId id, WordValue v);
 
+	/**
+	 * Replaces the content of the vector with the given words, in any order.
+	 * The result is the same as calling addWeight (if accumulate) or
+	 * addIfNotExist (otherwise) for each of them on an empty vector
+	 * @param words (word id, value) pairs, they are sorted by id in place
+	 * @param accumulate whether the values of a repeated word are added up
+	 */
+	void setWords(std::vector<std::pair<WordId, WordValue> > &words, 
+	  bool accumulate);
+
 	/**
 	 * L1-Normalizes the values in the vector 
 	 * @param norm_type norm used
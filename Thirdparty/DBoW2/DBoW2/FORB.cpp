@@ -13,9 +13,11 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <cstring>
 #include <stdint-gcc.h>
 
 #include "FORB.h"
+#include "HammingKernels.h"
 
 using namespace std;
 
@@ -100,6 +102,21 @@ int FORB::distance(const FORB::TDescriptor &a,
   return dist;
 }
 
+// --------------------------------------------------------------------------
+
+int FORB::distance(const unsigned char *a, const unsigned char *b)
+{
+  return HammingKernels::GetKernels().pair(a, b);
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::distances(const unsigned char *a, const unsigned char *b,
+  int n, int *dists)
+{
+  HammingKernels::DistancesContiguous(a, b, n, dists);
+}
+
 // --------------------------------------------------------------------------
   
 std::string FORB::toString(const FORB::TDescriptor &a)
@@ -136,6 +153,14 @@ void FORB::fromString(FORB::TDescriptor &a, const std::string &s)
 
 // --------------------------------------------------------------------------
 
+void FORB::fromBytes(FORB::TDescriptor &a, const unsigned char *p)
+{
+  a.create(1, FORB::L, CV_8U);
+  memcpy(a.ptr<unsigned char>(), p, FORB::L);
+}
+
+// --------------------------------------------------------------------------
+
 void FORB::toMat32F(const std::vector<TDescriptor> &descriptors, 
   cv::Mat &mat)
 {
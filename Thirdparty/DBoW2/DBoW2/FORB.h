@@ -46,6 +46,42 @@ public:
    */
   static int distance(const TDescriptor &a, const TDescriptor &b);
 
+  /**
+   * Calculates the distance between two descriptors stored as L bytes
+   * @param a
+   * @param b
+   * @return distance
+   */
+  static int distance(const unsigned char *a, const unsigned char *b);
+
+  /**
+   * Calculates the distances between a descriptor and n descriptors stored
+   * one after the other, L bytes each
+   * @param a
+   * @param b first of the n descriptors
+   * @param n
+   * @param dists (out) n distances
+   */
+  static void distances(const unsigned char *a, const unsigned char *b,
+    int n, int *dists);
+
+  /**
+   * Returns a pointer to the L bytes of the descriptor
+   * @param a descriptor
+   * @return pointer to the descriptor data (NULL if a is empty)
+   */
+  static inline const unsigned char* data(const TDescriptor &a)
+  {
+    return a.ptr<unsigned char>();
+  }
+
+  /**
+   * Returns a descriptor from L bytes
+   * @param a descriptor
+   * @param p descriptor data
+   */
+  static void fromBytes(TDescriptor &a, const unsigned char *p);
+
   /**
    * Returns a string version of the descriptor
    * @param a descriptor
@@ -11,6 +11,7 @@
 #include <map>
 #include <vector>
 #include <iostream>
+#include <algorithm>
 
 namespace DBoW2 {
 
@@ -22,25 +23,130 @@ FeatureVector::FeatureVector(void)
 
 // ---------------------------------------------------------------------------
 
+FeatureVector::FeatureVector(const FeatureVector &fv):
+  m_nodes(fv.m_nodes), m_features(fv.m_features)
+{
+  bindNodes();
+}
+
+// ---------------------------------------------------------------------------
+
+FeatureVector& FeatureVector::operator=(const FeatureVector &fv)
+{
+  if(this != &fv)
+  {
+    m_nodes = fv.m_nodes;
+    m_features = fv.m_features;
+    bindNodes();
+  }
+  return *this;
+}
+
+// ---------------------------------------------------------------------------
+
 FeatureVector::~FeatureVector(void)
 {
 }
 
 // ---------------------------------------------------------------------------
 
+void FeatureVector::clear()
+{
+  m_nodes.clear();
+  m_features.clear();
+}
+
+// ---------------------------------------------------------------------------
+
+static bool nodeIdLess(const FeatureVector::Node &node, NodeId id)
+{
+  return node.first < id;
+}
+
+FeatureVector::const_iterator FeatureVector::lower_bound(NodeId id) const
+{
+  return std::lower_bound(m_nodes.begin(), m_nodes.end(), id, nodeIdLess);
+}
+
+// ---------------------------------------------------------------------------
+
+FeatureVector::const_iterator FeatureVector::find(NodeId id) const
+{
+  const_iterator nit = lower_bound(id);
+  return (nit != end() && nit->first == id) ? nit : end();
+}
+
+// ---------------------------------------------------------------------------
+
 void FeatureVector::addFeature(NodeId id, unsigned int i_feature)
 {
-  FeatureVector::iterator vit = this->lower_bound(id);
-  
-  if(vit != this->end() && vit->first == id)
+  const size_t inode = lower_bound(id) - m_nodes.begin();
+
+  size_t offset = 0;
+  for(size_t i = 0; i < inode; ++i) offset += m_nodes[i].second.m_size;
+
+  if(inode == m_nodes.size() || m_nodes[inode].first != id)
+  {
+    Node node;
+    node.first = id;
+    m_nodes.insert(m_nodes.begin() + inode, node);
+  }
+
+  FeatureIndices &indices = m_nodes[inode].second;
+  m_features.insert(m_features.begin() + offset + indices.m_size, i_feature);
+  indices.m_size++;
+
+  bindNodes();
+}
+
+// ---------------------------------------------------------------------------
+
+static bool featureNodeLess(const std::pair<NodeId, unsigned int> &a,
+  const std::pair<NodeId, unsigned int> &b)
+{
+  return a.first < b.first;
+}
+
+void FeatureVector::setFeatures(
+  std::vector<std::pair<NodeId, unsigned int> > &features)
+{
+  clear();
+
+  // stable, so that the indexes of a node keep the order they were given in
+  std::stable_sort(features.begin(), features.end(), featureNodeLess);
+
+  size_t n = 0;
+  std::vector<std::pair<NodeId, unsigned int> >::const_iterator fit;
+  for(fit = features.begin(); fit != features.end(); ++fit)
+    if(fit == features.begin() || (fit-1)->first != fit->first) ++n;
+
+  m_nodes.reserve(n);
+  m_features.reserve(features.size());
+
+  for(fit = features.begin(); fit != features.end(); ++fit)
   {
-    vit->second.push_back(i_feature);
+    if(m_nodes.empty() || m_nodes.back().first != fit->first)
+    {
+      Node node;
+      node.first = fit->first;
+      m_nodes.push_back(node);
+    }
+    m_nodes.back().second.m_size++;
+    m_features.push_back(fit->second);
   }
-  else
+
+  bindNodes();
+}
+
+// ---------------------------------------------------------------------------
+
+void FeatureVector::bindNodes()
+{
+  const unsigned int *data = m_features.data();
+  for(size_t i = 0; i < m_nodes.size(); ++i)
   {
-    vit = this->insert(vit, FeatureVector::value_type(id, 
-      std::vector<unsigned int>() ));
-    vit->second.push_back(i_feature);
+    m_nodes[i].second.m_data = data;
+    data += m_nodes[i].second.m_size;
   }
 }
 
@@ -53,7 +159,7 @@ std::ostream& operator<<(std::ostream &out,
   {
     FeatureVector::const_iterator vit = v.begin();
     
-    const std::vector<unsigned int>* f = &vit->second;
+    const FeatureIndices* f = &vit->second;
 
     out << "<" << vit->first << ": [";
     if(!f->empty()) out << (*f)[0];
@@ -17,46 +17,150 @@
 
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/map.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/split_member.hpp>
 
 namespace DBoW2 {
 
-/// Vector of nodes with indexes of local features
-class FeatureVector: 
-  public std::map<NodeId, std::vector<unsigned int> >
+/// Indexes of the local features of a node, stored in its FeatureVector
+class FeatureIndices
+{
+public:
+
+  FeatureIndices(): m_data(NULL), m_size(0) {}
+
+  typedef const unsigned int* const_iterator;
+
+  const unsigned int* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  const unsigned int& operator[](size_t i) const { return m_data[i]; }
+  const_iterator begin() const { return m_data; }
+  const_iterator end() const { return m_data + m_size; }
+
+private:
+
+  friend class FeatureVector;
+
+  const unsigned int *m_data;
+  unsigned int m_size;
+};
+
+/// Vector of nodes with indexes of local features. Nodes are sorted by id
+/// and the indexes of all of them are stored in a single array.
+/// It is serialized as a std::map<NodeId, std::vector<unsigned int> >
+class FeatureVector
 {
     friend class boost::serialization::access;
     template<class Archive>
-    void serialize(Archive& ar, const int version)
+    void save(Archive& ar, const int version) const
+    {
+        std::map<NodeId, std::vector<unsigned int> > m;
+        for(const_iterator nit = begin(); nit != end(); ++nit)
+          m[nit->first].assign(nit->second.begin(), nit->second.end());
+        ar & m;
+    }
+    template<class Archive>
+    void load(Archive& ar, const int version)
     {
-        ar & boost::serialization::base_object<std::map<NodeId, std::vector<unsigned int> > >(*this);
+        std::map<NodeId, std::vector<unsigned int> > m;
+        ar & m;
+        clear();
+        std::map<NodeId, std::vector<unsigned int> >::const_iterator mit;
+        for(mit = m.begin(); mit != m.end(); ++mit)
+        {
+          Node node;
+          node.first = mit->first;
+          node.second.m_size = mit->second.size();
+          m_nodes.push_back(node);
+          m_features.insert(m_features.end(), mit->second.begin(), 
+            mit->second.end());
+        }
+        bindNodes();
     }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
 
 public:
 
+  /// Node id and the indexes of its features
+  struct Node
+  {
+    NodeId first;
+    FeatureIndices second;
+  };
+
+  typedef Node value_type;
+  typedef std::vector<Node>::const_iterator const_iterator;
+  typedef const_iterator iterator;
+
   /**
    * Constructor
    */
   FeatureVector(void);
+
+  FeatureVector(const FeatureVector &fv);
+  FeatureVector(FeatureVector &&fv) = default;
+  FeatureVector& operator=(const FeatureVector &fv);
+  FeatureVector& operator=(FeatureVector &&fv) = default;
   
   /**
    * Destructor
    */
   ~FeatureVector(void);
+
+  const_iterator begin() const { return m_nodes.begin(); }
+  const_iterator end() const { return m_nodes.end(); }
+
+  /// Number of nodes
+  size_t size() const { return m_nodes.size(); }
+  bool empty() const { return m_nodes.empty(); }
+
+  void clear();
+
+  /**
+   * Returns the first node whose id is not less than the given one
+   * @param id node id to look for
+   */
+  const_iterator lower_bound(NodeId id) const;
+
+  /**
+   * Returns the given node, or end() if it is not in the vector
+   * @param id node id to look for
+   */
+  const_iterator find(NodeId id) const;
   
   /**
    * Adds a feature to an existing node, or adds a new node with an initial
-   * feature
+   * feature. Inserting is linear in the vector size, use setFeatures to
+   * build the whole vector
    * @param id node id to add or to modify
    * @param i_feature index of feature to add to the given node
    */
   void addFeature(NodeId id, unsigned int i_feature);
 
+  /**
+   * Replaces the content of the vector with the given features, in any
+   * order. The result is the same as calling addFeature for each of them 
+   * on an empty vector
+   * @param features (node id, feature index) pairs, they are sorted by
+   *   node id in place
+   */
+  void setFeatures(std::vector<std::pair<NodeId, unsigned int> > &features);
+
   /**
    * Sends a string versions of the feature vector through the stream
    * @param out stream
    * @param v feature vector
    */
   friend std::ostream& operator<<(std::ostream &out, const FeatureVector &v);
+
+private:
+
+  /// Points the nodes to their indexes in m_features
+  void bindNodes();
+
+  std::vector<Node> m_nodes;
+  std::vector<unsigned int> m_features;
     
 };
 
@@ -0,0 +1,268 @@
+/**
+ * File: HammingKernels.h
+ * Description: Hamming distance kernels for 256-bit ORB descriptors
+ * License: see the LICENSE.txt file
+ *
+ * The kernel (scalar, POPCNT, AVX2 or AVX-512 VPOPCNTDQ) is chosen once at
+ * runtime from the features reported by the CPU, so the same binary runs on
+ * every x86 target. FORB and ORB-SLAM3's HammingDistance share this
+ * implementation and its dispatch.
+ *
+ */
+
+#ifndef __D_T_HAMMING_KERNELS__
+#define __D_T_HAMMING_KERNELS__
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <stdint.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define DBOW2_HAMMING_X86
+#include <immintrin.h>
+#endif
+
+namespace DBoW2 {
+
+namespace HammingKernels {
+
+typedef int (*PairKernel)(const uint8_t*, const uint8_t*);
+typedef void (*BatchKernelSizeT)(const uint8_t*, const uint8_t*, size_t, const size_t*, int, int*);
+typedef void (*BatchKernelUInt)(const uint8_t*, const uint8_t*, size_t, const unsigned int*, int, int*);
+
+// Bit set count operation from
+// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+inline int DistanceScalar(const uint8_t* a, const uint8_t* b)
+{
+  int dist=0;
+
+  for(int i=0; i<8; i++)
+  {
+    uint32_t va, vb;
+    memcpy(&va, a+4*i, 4);
+    memcpy(&vb, b+4*i, 4);
+
+    uint32_t v = va ^ vb;
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+  }
+
+  return dist;
+}
+
+template<typename T>
+inline void BatchScalar(const uint8_t* q, const uint8_t* base, size_t step, const T* idx, int n, int* out)
+{
+  for(int i=0; i<n; i++)
+    out[i] = DistanceScalar(q, base + step*idx[i]);
+}
+
+#ifdef DBOW2_HAMMING_X86
+
+__attribute__((target("popcnt")))
+inline int DistancePopcntInline(const uint8_t* a, const uint8_t* b)
+{
+  uint64_t a0, a1, a2, a3, b0, b1, b2, b3;
+  memcpy(&a0, a, 8); memcpy(&a1, a+8, 8); memcpy(&a2, a+16, 8); memcpy(&a3, a+24, 8);
+  memcpy(&b0, b, 8); memcpy(&b1, b+8, 8); memcpy(&b2, b+16, 8); memcpy(&b3, b+24, 8);
+
+  return (int)(_mm_popcnt_u64(a0^b0) + _mm_popcnt_u64(a1^b1) +
+         _mm_popcnt_u64(a2^b2) + _mm_popcnt_u64(a3^b3));
+}
+
+__attribute__((target("popcnt")))
+inline int DistancePopcnt(const uint8_t* a, const uint8_t* b)
+{
+  return DistancePopcntInline(a, b);
+}
+
+template<typename T>
+__attribute__((target("popcnt")))
+inline void BatchPopcnt(const uint8_t* q, const uint8_t* base, size_t step, const T* idx, int n, int* out)
+{
+  for(int i=0; i<n; i++)
+    out[i] = DistancePopcntInline(q, base + step*idx[i]);
+}
+
+// Nibble lookup popcount (W. Mula): per-byte counts with pshufb, summed with psadbw
+__attribute__((target("avx2")))
+inline __m256i PopcountBytesAVX2(const __m256i v)
+{
+  const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                      0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i lo = _mm256_and_si256(v, low_mask);
+  const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+  const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+  return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+inline int HorizontalSumAVX2(const __m256i v)
+{
+  const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  return (int)(_mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1));
+}
+
+__attribute__((target("avx2")))
+inline int DistanceAVX2(const uint8_t* a, const uint8_t* b)
+{
+  const __m256i va = _mm256_loadu_si256((const __m256i*)a);
+  const __m256i vb = _mm256_loadu_si256((const __m256i*)b);
+  return HorizontalSumAVX2(PopcountBytesAVX2(_mm256_xor_si256(va, vb)));
+}
+
+template<typename T>
+__attribute__((target("avx2")))
+inline void BatchAVX2(const uint8_t* q, const uint8_t* base, size_t step, const T* idx, int n, int* out)
+{
+  const __m256i vq = _mm256_loadu_si256((const __m256i*)q);
+  const __m256i packLow = _mm256_setr_epi32(0,2,4,6,0,2,4,6);
+
+  int i=0;
+  // Four candidates per iteration share a single horizontal reduction
+  for(; i+3<n; i+=4)
+  {
+    const __m256i s0 = PopcountBytesAVX2(_mm256_xor_si256(vq, _mm256_loadu_si256((const __m256i*)(base + step*idx[i]))));
+    const __m256i s1 = PopcountBytesAVX2(_mm256_xor_si256(vq, _mm256_loadu_si256((const __m256i*)(base + step*idx[i+1]))));
+    const __m256i s2 = PopcountBytesAVX2(_mm256_xor_si256(vq, _mm256_loadu_si256((const __m256i*)(base + step*idx[i+2]))));
+    const __m256i s3 = PopcountBytesAVX2(_mm256_xor_si256(vq, _mm256_loadu_si256((const __m256i*)(base + step*idx[i+3]))));
+
+    const __m256i s01 = _mm256_add_epi64(_mm256_unpacklo_epi64(s0, s1), _mm256_unpackhi_epi64(s0, s1));
+    const __m256i s23 = _mm256_add_epi64(_mm256_unpacklo_epi64(s2, s3), _mm256_unpackhi_epi64(s2, s3));
+    const __m256i sum = _mm256_add_epi64(_mm256_permute2x128_si256(s01, s23, 0x20),
+                       _mm256_permute2x128_si256(s01, s23, 0x31));
+
+    // Totals fit in 32 bits: keep the low half of each 64-bit lane
+    _mm_storeu_si128((__m128i*)(out+i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(sum, packLow)));
+  }
+  for(; i<n; i++)
+    out[i] = HorizontalSumAVX2(PopcountBytesAVX2(_mm256_xor_si256(vq, _mm256_loadu_si256((const __m256i*)(base + step*idx[i])))));
+}
+
+__attribute__((target("avx2,avx512f,avx512vl,avx512vpopcntdq")))
+inline int DistanceAVX512(const uint8_t* a, const uint8_t* b)
+{
+  const __m256i va = _mm256_loadu_si256((const __m256i*)a);
+  const __m256i vb = _mm256_loadu_si256((const __m256i*)b);
+  const __m256i cnt = _mm256_popcnt_epi64(_mm256_xor_si256(va, vb));
+  const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(cnt), _mm256_extracti128_si256(cnt, 1));
+  return (int)(_mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1));
+}
+
+template<typename T>
+__attribute__((target("avx2,avx512f,avx512vl,avx512vpopcntdq")))
+inline void BatchAVX512(const uint8_t* q, const uint8_t* base, size_t step, const T* idx, int n, int* out)
+{
+  const __m256i vq = _mm256_loadu_si256((const __m256i*)q);
+
+  int i=0;
+  for(; i+1<n; i+=2)
+  {
+    const __m256i c0 = _mm256_popcnt_epi64(_mm256_xor_si256(vq, _mm256_loadu_si256((const __m256i*)(base + step*idx[i]))));
+    const __m256i c1 = _mm256_popcnt_epi64(_mm256_xor_si256(vq, _mm256_loadu_si256((const __m256i*)(base + step*idx[i+1]))));
+
+    // Interleave both candidates so one reduction yields the two totals
+    const __m256i s = _mm256_add_epi64(_mm256_unpacklo_epi64(c0, c1), _mm256_unpackhi_epi64(c0, c1));
+    const __m128i t = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    out[i] = (int)_mm_cvtsi128_si64(t);
+    out[i+1] = (int)_mm_extract_epi64(t, 1);
+  }
+  if(i<n)
+    out[i] = DistanceAVX512(q, base + step*idx[i]);
+}
+
+#endif // DBOW2_HAMMING_X86
+
+struct Kernels
+{
+  PairKernel pair;
+  BatchKernelSizeT batchSizeT;
+  BatchKernelUInt batchUInt;
+  const char* name;
+
+  Kernels()
+  {
+    // Fastest kernel this CPU supports, the scalar one always is
+    if(!Select("avx512") && !Select("avx2") && !Select("popcnt"))
+      Select("scalar");
+  }
+
+  bool Select(const std::string &kernel)
+  {
+    if(kernel=="scalar")
+    {
+      pair = DistanceScalar;
+      batchSizeT = BatchScalar<size_t>;
+      batchUInt = BatchScalar<unsigned int>;
+      name = "scalar";
+      return true;
+    }
+
+#ifdef DBOW2_HAMMING_X86
+    __builtin_cpu_init();
+    if(kernel=="avx512" && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+       __builtin_cpu_supports("avx512vpopcntdq"))
+    {
+      pair = DistanceAVX512;
+      batchSizeT = BatchAVX512<size_t>;
+      batchUInt = BatchAVX512<unsigned int>;
+      name = "avx512";
+      return true;
+    }
+    else if(kernel=="avx2" && __builtin_cpu_supports("avx2"))
+    {
+      // A single pair is not worth the shuffle setup; keep POPCNT for it when available
+      pair = __builtin_cpu_supports("popcnt") ? DistancePopcnt : DistanceAVX2;
+      batchSizeT = BatchAVX2<size_t>;
+      batchUInt = BatchAVX2<unsigned int>;
+      name = "avx2";
+      return true;
+    }
+    else if(kernel=="popcnt" && __builtin_cpu_supports("popcnt"))
+    {
+      pair = DistancePopcnt;
+      batchSizeT = BatchPopcnt<size_t>;
+      batchUInt = BatchPopcnt<unsigned int>;
+      name = "popcnt";
+      return true;
+    }
+#endif
+
+    return false;
+  }
+};
+
+inline Kernels& GetKernels()
+{
+  static Kernels kernels;
+  return kernels;
+}
+
+// Distances between one query and n descriptors stored one after the other,
+// through the batched kernel with an identity index
+inline void DistancesContiguous(const uint8_t* q, const uint8_t* base, int n, int* out)
+{
+  static const int BLOCK = 64;
+  static const std::vector<unsigned int> vIdentity = []()
+  {
+    std::vector<unsigned int> v(BLOCK);
+    for(int i=0; i<BLOCK; i++)
+      v[i] = i;
+    return v;
+  }();
+
+  const Kernels& kernels = GetKernels();
+  for(int i=0; i<n; i+=BLOCK)
+    kernels.batchUInt(q, base + 32*i, 32, vIdentity.data(), std::min(BLOCK, n-i), out + i);
+}
+
+} // namespace HammingKernels
+
+} // namespace DBoW2
+
+#endif
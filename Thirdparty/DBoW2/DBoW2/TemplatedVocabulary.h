@@ -26,6 +26,13 @@
 #include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <limits>
+#include <cstring>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "FeatureVector.h"
 #include "BowVector.h"
@@ -37,6 +44,49 @@ using namespace std;
 
 namespace DBoW2 {
 
+/// Header of the binary vocabulary format. The rest of the file is the
+/// in-memory layout of the flat tree, so a mapped file is used in place.
+/// All the arrays are 8-byte aligned and indexed by node id, except
+/// children (child links of all the nodes, see child_start), descriptor
+/// (one per child link, so the children of a node are contiguous) and
+/// word_node (node id of each word).
+struct BinaryVocabularyHeader
+{
+  /// "DBOW2VOC"
+  char magic[8];
+  /// Format version
+  uint32_t version;
+  /// 0x01020304 written in the byte order of the host that saved the file
+  uint32_t endianness;
+  int32_t k;
+  int32_t L;
+  int32_t scoring;
+  int32_t weighting;
+  /// Number of nodes, including the root
+  uint32_t nodes;
+  uint32_t words;
+  /// Number of child links
+  uint32_t children;
+  /// Bytes per node descriptor
+  uint32_t descriptor_bytes;
+  /// Byte offsets of the arrays from the beginning of the file
+  uint64_t parent_offset;
+  uint64_t child_start_offset;
+  uint64_t children_offset;
+  uint64_t word_id_offset;
+  uint64_t weight_offset;
+  uint64_t descriptor_offset;
+  uint64_t word_node_offset;
+  /// Child link of each node, i.e. the position of its descriptor
+  uint64_t node_link_offset;
+  uint64_t file_size;
+  /// Optional user string, e.g. the checksum of the file it was converted from
+  char checksum[64];
+
+  static const uint32_t VERSION = 1;
+  static const uint32_t ENDIANNESS = 0x01020304;
+};
+
 /// @param TDescriptor class of descriptor
 /// @param F class of descriptor functions
 template<class TDescriptor, class F>
@@ -145,6 +195,37 @@ public:
   virtual void transform(const std::vector<TDescriptor>& features,
     BowVector &v, FeatureVector &fv, int levelsup) const;
 
+  /**
+   * Transforms the features [begin, end) into words. Only the vocabulary
+   * is read, so disjoint ranges can be transformed by several threads at
+   * once and then put together with transform(word_ids, ...)
+   * @param features
+   * @param begin first feature
+   * @param end one past the last feature
+   * @param word_ids (out) word of each feature, indexed by feature
+   * @param weights (out) weight of each word, indexed by feature
+   * @param nids (out) node of each feature levelsup levels up, indexed by
+   *   feature
+   * @param levelsup levels to go up the vocabulary tree to get the node index
+   */
+  void transform(const std::vector<TDescriptor>& features,
+    size_t begin, size_t end, WordId *word_ids, WordValue *weights,
+    NodeId *nids, int levelsup) const;
+
+  /**
+   * Builds the bow vector and the feature vector of the features whose words
+   * have been computed with transform(features, begin, end, ...). The result
+   * is the same as that of transform(features, v, fv, levelsup)
+   * @param word_ids word of each feature
+   * @param weights weight of each word
+   * @param nids node of each feature
+   * @param v (out) bow vector
+   * @param fv (out) feature vector of nodes and feature indexes
+   */
+  void transform(const std::vector<WordId> &word_ids,
+    const std::vector<WordValue> &weights, const std::vector<NodeId> &nids,
+    BowVector &v, FeatureVector &fv) const;
+
   /**
    * Transforms a single feature into a word (without weight)
    * @param feature
@@ -246,6 +327,30 @@ public:
    */
   void saveToTextFile(const std::string &filename) const;  
 
+  /**
+   * Loads the vocabulary from a binary file created by saveToBinaryFile.
+   * The file is memory-mapped and used in place, without parsing or copying
+   * the nodes. It is mapped copy-on-write, so the file is never modified.
+   * @param filename
+   * @return false if the file cannot be mapped or is not a valid vocabulary
+   */
+  bool loadFromBinaryFile(const std::string &filename);
+
+  /**
+   * Saves the vocabulary into a binary file (see BinaryVocabularyHeader)
+   * @param filename
+   * @param checksum string stored in the header (up to 63 characters)
+   * @return false if the vocabulary is empty or the file cannot be written
+   */
+  bool saveToBinaryFile(const std::string &filename,
+    const std::string &checksum = std::string()) const;
+
+  /**
+   * Returns the checksum stored in the binary file the vocabulary was loaded
+   * from, or an empty string
+   */
+  std::string getBinaryChecksum() const;
+
   /**
    * Saves the vocabulary into a file
    * @param filename
@@ -328,6 +433,44 @@ protected:
     inline bool isLeaf() const { return children.empty(); }
   };
 
+  /// Flat read-only view of the tree used by the query functions.
+  /// The arrays follow BinaryVocabularyHeader and point either to
+  /// m_flat_buffer or to a mapped binary file. The children of node n are
+  /// children[child_start[n] .. child_start[n+1]).
+  struct FlatTree
+  {
+    const BinaryVocabularyHeader *header;
+    const uint32_t *parent;
+    const uint32_t *child_start;
+    const uint32_t *children;
+    const uint32_t *word_id;
+    WordValue *weight;
+    const unsigned char *descriptors;
+    const uint32_t *word_node;
+    const uint32_t *node_link;
+
+    FlatTree(): header(NULL), parent(NULL), child_start(NULL), children(NULL),
+      word_id(NULL), weight(NULL), descriptors(NULL), word_node(NULL),
+      node_link(NULL){}
+
+    inline bool isLeaf(NodeId nid) const
+    {
+      return child_start[nid] == child_start[nid+1];
+    }
+
+    /// Descriptor of a node other than the root
+    inline const unsigned char* descriptor(NodeId nid) const
+    {
+      return descriptors + (size_t)node_link[nid] * header->descriptor_bytes;
+    }
+
+    /// Descriptors of all the children of nid, one after the other
+    inline const unsigned char* childDescriptors(NodeId nid) const
+    {
+      return descriptors + (size_t)child_start[nid] * header->descriptor_bytes;
+    }
+  };
+
 protected:
 
   /**
@@ -335,6 +478,26 @@ protected:
    */
   void createScoringObject();
 
+  /**
+   * Builds the flat tree in m_flat_buffer from m_nodes, then releases
+   * m_nodes and m_words
+   */
+  void buildFlatTree();
+
+  /**
+   * Checks that data holds a valid flat tree and sets the pointers of flat
+   * @param data beginning of the header
+   * @param size bytes available from data
+   * @param flat (out)
+   * @return false if the data is not a valid flat tree
+   */
+  static bool setFlatTree(unsigned char *data, size_t size, FlatTree &flat);
+
+  /**
+   * Releases the flat tree, unmapping the binary file if necessary
+   */
+  void releaseFlatTree();
+
   /** 
    * Returns a set of pointers to descriptores
    * @param training_features all the features
@@ -425,6 +588,17 @@ protected:
   /// Words of the vocabulary (tree leaves)
   /// this condition holds: m_words[wid]->word_id == wid
   std::vector<Node*> m_words;
+
+  /// Flat tree used by the query functions (built from m_nodes or mapped
+  /// from a binary file). m_nodes and m_words are empty once it is set
+  FlatTree m_flat;
+
+  /// Storage of the flat tree when it is built from m_nodes
+  std::vector<uint64_t> m_flat_buffer;
+
+  /// Mapped binary file, if any
+  void *m_map_addr;
+  size_t m_map_size;
   
 };
 
@@ -434,7 +608,7 @@ template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
   (int k, int L, WeightingType weighting, ScoringType scoring)
   : m_k(k), m_L(L), m_weighting(weighting), m_scoring(scoring),
-  m_scoring_object(NULL)
+  m_scoring_object(NULL), m_map_addr(NULL), m_map_size(0)
 {
   createScoringObject();
 }
@@ -443,7 +617,8 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const std::string &filename): m_scoring_object(NULL)
+  (const std::string &filename): m_scoring_object(NULL), m_map_addr(NULL),
+  m_map_size(0)
 {
   load(filename);
 }
@@ -452,7 +627,8 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const char *filename): m_scoring_object(NULL)
+  (const char *filename): m_scoring_object(NULL), m_map_addr(NULL),
+  m_map_size(0)
 {
   load(filename);
 }
@@ -516,7 +692,7 @@ void TemplatedVocabulary<TDescriptor,F>::setWeightingType(WeightingType type)
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary(
   const TemplatedVocabulary<TDescriptor, F> &voc)
-  : m_scoring_object(NULL)
+  : m_scoring_object(NULL), m_map_addr(NULL), m_map_size(0)
 {
   *this = voc;
 }
@@ -527,6 +703,7 @@ template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::~TemplatedVocabulary()
 {
   delete m_scoring_object;
+  releaseFlatTree();
 }
 
 // --------------------------------------------------------------------------
@@ -548,6 +725,20 @@ TemplatedVocabulary<TDescriptor,F>::operator=
   
   this->m_nodes = voc.m_nodes;
   this->createWords();
+
+  this->releaseFlatTree();
+  if(!this->m_nodes.empty())
+  {
+    this->buildFlatTree();
+  }
+  else if(voc.m_flat.header)
+  {
+    // voc was loaded from a binary file: copy its flat tree
+    const size_t size = voc.m_flat.header->file_size;
+    this->m_flat_buffer.resize((size + 7) / 8);
+    memcpy(&this->m_flat_buffer[0], voc.m_flat.header, size);
+    setFlatTree((unsigned char*)&this->m_flat_buffer[0], size, this->m_flat);
+  }
   
   return *this;
 }
@@ -560,6 +751,7 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 {
   m_nodes.clear();
   m_words.clear();
+  releaseFlatTree();
   
   // expected_nodes = Sum_{i=0..L} ( k^i )
 	int expected_nodes = 
@@ -583,6 +775,8 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 
   // and set the weight of each node of the tree
   setNodeWeights(training_features);
+
+  buildFlatTree();
   
 }
 
@@ -1000,6 +1194,7 @@ void TemplatedVocabulary<TDescriptor,F>::setNodeWeights
 template<class TDescriptor, class F>
 inline unsigned int TemplatedVocabulary<TDescriptor,F>::size() const
 {
+  if(m_flat.header) return m_flat.header->words;
   return m_words.size();
 }
 
@@ -1008,7 +1203,7 @@ inline unsigned int TemplatedVocabulary<TDescriptor,F>::size() const
 template<class TDescriptor, class F>
 inline bool TemplatedVocabulary<TDescriptor,F>::empty() const
 {
-  return m_words.empty();
+  return size() == 0;
 }
 
 // --------------------------------------------------------------------------
@@ -1017,6 +1212,19 @@ template<class TDescriptor, class F>
 float TemplatedVocabulary<TDescriptor,F>::getEffectiveLevels() const
 {
   long sum = 0;
+
+  if(m_flat.header)
+  {
+    const unsigned int nwords = m_flat.header->words;
+    for(unsigned int wid = 0; wid < nwords; ++wid)
+    {
+      for(NodeId nid = m_flat.word_node[wid]; nid != 0; sum++)
+        nid = m_flat.parent[nid];
+    }
+
+    return (float)((double)sum / (double)nwords);
+  }
+
   typename std::vector<Node*>::const_iterator wit;
   for(wit = m_words.begin(); wit != m_words.end(); ++wit)
   {
@@ -1033,6 +1241,13 @@ float TemplatedVocabulary<TDescriptor,F>::getEffectiveLevels() const
 template<class TDescriptor, class F>
 TDescriptor TemplatedVocabulary<TDescriptor,F>::getWord(WordId wid) const
 {
+  if(m_flat.header)
+  {
+    TDescriptor d;
+    F::fromBytes(d, m_flat.descriptor(m_flat.word_node[wid]));
+    return d;
+  }
+
   return m_words[wid]->descriptor;
 }
 
@@ -1041,6 +1256,7 @@ TDescriptor TemplatedVocabulary<TDescriptor,F>::getWord(WordId wid) const
 template<class TDescriptor, class F>
 WordValue TemplatedVocabulary<TDescriptor, F>::getWordWeight(WordId wid) const
 {
+  if(m_flat.header) return m_flat.weight[m_flat.word_node[wid]];
   return m_words[wid]->weight;
 }
 
@@ -1079,19 +1295,24 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
 
 	typename vector<TDescriptor>::const_iterator fit;
 
+  std::vector<std::pair<WordId, WordValue> > words;
+  words.reserve(features.size());
+
+  for(fit = features.begin(); fit < features.end(); ++fit)
+  {
+    WordId id;
+    WordValue w; 
+    // w is the idf value if TF_IDF, 1 if TF, idf if IDF, or 1 if BINARY
+    
+    transform(*fit, id, w);
+    
+    // not stopped
+    if(w > 0) words.push_back(std::make_pair(id, w));
+  }
+
   if(m_weighting == TF || m_weighting == TF_IDF)
   {
-    for(fit = features.begin(); fit < features.end(); ++fit)
-    {
-      WordId id;
-      WordValue w; 
-      // w is the idf value if TF_IDF, 1 if TF
-      
-      transform(*fit, id, w);
-      
-      // not stopped
-      if(w > 0) v.addWeight(id, w);
-    }
+    v.setWords(words, true);
     
     if(!v.empty() && !must)
     {
@@ -1104,18 +1325,7 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   }
   else // IDF || BINARY
   {
-    for(fit = features.begin(); fit < features.end(); ++fit)
-    {
-      WordId id;
-      WordValue w;
-      // w is idf if IDF, or 1 if BINARY
-      
-      transform(*fit, id, w);
-      
-      // not stopped
-      if(w > 0) v.addIfNotExist(id, w);
-      
-    } // if add_features
+    v.setWords(words, false);
   } // if m_weighting == ...
   
   if(must) v.normalize(norm);
@@ -1127,6 +1337,42 @@ template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::transform(
   const std::vector<TDescriptor>& features,
   BowVector &v, FeatureVector &fv, int levelsup) const
+{
+  if(empty()) // safe for subclasses
+  {
+    v.clear();
+    fv.clear();
+    return;
+  }
+
+  std::vector<WordId> word_ids(features.size());
+  std::vector<WordValue> weights(features.size());
+  std::vector<NodeId> nids(features.size());
+
+  if(!features.empty())
+    transform(features, 0, features.size(), &word_ids[0], &weights[0],
+      &nids[0], levelsup);
+
+  transform(word_ids, weights, nids, v, fv);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F> 
+void TemplatedVocabulary<TDescriptor,F>::transform(
+  const std::vector<TDescriptor>& features, size_t begin, size_t end,
+  WordId *word_ids, WordValue *weights, NodeId *nids, int levelsup) const
+{
+  for(size_t i = begin; i < end; ++i)
+    transform(features[i], word_ids[i], weights[i], &nids[i], levelsup);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F> 
+void TemplatedVocabulary<TDescriptor,F>::transform(
+  const std::vector<WordId> &word_ids, const std::vector<WordValue> &weights,
+  const std::vector<NodeId> &nids, BowVector &v, FeatureVector &fv) const
 {
   v.clear();
   fv.clear();
@@ -1140,26 +1386,30 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   LNorm norm;
   bool must = m_scoring_object->mustNormalize(norm);
   
-  typename vector<TDescriptor>::const_iterator fit;
+  const unsigned int nfeatures = word_ids.size();
+
+  std::vector<std::pair<WordId, WordValue> > words;
+  std::vector<std::pair<NodeId, unsigned int> > features;
+  words.reserve(nfeatures);
+  features.reserve(nfeatures);
+
+  for(unsigned int i_feature = 0; i_feature < nfeatures; ++i_feature)
+  {
+    // w is the idf value if TF_IDF, 1 if TF, idf if IDF, or 1 if BINARY
+    const WordValue w = weights[i_feature];
+    
+    if(w > 0) // not stopped
+    { 
+      words.push_back(std::make_pair(word_ids[i_feature], w));
+      features.push_back(std::make_pair(nids[i_feature], i_feature));
+    }
+  }
+
+  fv.setFeatures(features);
   
   if(m_weighting == TF || m_weighting == TF_IDF)
   {
-    unsigned int i_feature = 0;
-    for(fit = features.begin(); fit < features.end(); ++fit, ++i_feature)
-    {
-      WordId id;
-      NodeId nid;
-      WordValue w; 
-      // w is the idf value if TF_IDF, 1 if TF
-      
-      transform(*fit, id, w, &nid, levelsup);
-      
-      if(w > 0) // not stopped
-      { 
-        v.addWeight(id, w);
-        fv.addFeature(nid, i_feature);
-      }
-    }
+    v.setWords(words, true);
     
     if(!v.empty() && !must)
     {
@@ -1172,22 +1422,7 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   }
   else // IDF || BINARY
   {
-    unsigned int i_feature = 0;
-    for(fit = features.begin(); fit < features.end(); ++fit, ++i_feature)
-    {
-      WordId id;
-      NodeId nid;
-      WordValue w;
-      // w is idf if IDF, or 1 if BINARY
-      
-      transform(*fit, id, w, &nid, levelsup);
-      
-      if(w > 0) // not stopped
-      {
-        v.addIfNotExist(id, w);
-        fv.addFeature(nid, i_feature);
-      }
-    }
+    v.setWords(words, false);
   } // if m_weighting == ...
   
   if(must) v.normalize(norm);
@@ -1218,10 +1453,6 @@ template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::transform(const TDescriptor &feature, 
   WordId &word_id, WordValue &weight, NodeId *nid, int levelsup) const
 { 
-  // propagate the feature down the tree
-  vector<NodeId> nodes;
-  typename vector<NodeId>::const_iterator nit;
-
   // level at which the node must be stored in nid, if given
   const int nid_level = m_L - levelsup;
   if(nid_level <= 0 && nid != NULL) *nid = 0; // root
@@ -1229,6 +1460,57 @@ void TemplatedVocabulary<TDescriptor,F>::transform(const TDescriptor &feature,
   NodeId final_id = 0; // root
   int current_level = 0;
 
+  if(m_flat.header)
+  {
+    // same descent as below, on the flat tree
+    // the children of a node are scored together, since their
+    // descriptors are contiguous
+    const unsigned char *f = F::data(feature);
+    const size_t dbytes = m_flat.header->descriptor_bytes;
+    const int BLOCK = 16;
+    int d[BLOCK];
+
+    do
+    {
+      ++current_level;
+      const uint32_t cbegin = m_flat.child_start[final_id];
+      const uint32_t cend = m_flat.child_start[final_id+1];
+      const unsigned char *desc = m_flat.childDescriptors(final_id);
+
+      uint32_t best_c = cbegin;
+      int best_d = std::numeric_limits<int>::max();
+
+      for(uint32_t c = cbegin; c < cend; c += BLOCK)
+      {
+        const int n = std::min<uint32_t>(BLOCK, cend - c);
+        F::distances(f, desc + (c - cbegin) * dbytes, n, d);
+
+        for(int j = 0; j < n; ++j)
+        {
+          if(d[j] < best_d)
+          {
+            best_d = d[j];
+            best_c = c + j;
+          }
+        }
+      }
+
+      final_id = m_flat.children[best_c];
+
+      if(nid != NULL && current_level == nid_level)
+        *nid = final_id;
+
+    } while( !m_flat.isLeaf(final_id) );
+
+    word_id = m_flat.word_id[final_id];
+    weight = m_flat.weight[final_id];
+    return;
+  }
+
+  // propagate the feature down the tree
+  vector<NodeId> nodes;
+  typename vector<NodeId>::const_iterator nit;
+
   do
   {
     ++current_level;
@@ -1264,6 +1546,17 @@ template<class TDescriptor, class F>
 NodeId TemplatedVocabulary<TDescriptor,F>::getParentNode
   (WordId wid, int levelsup) const
 {
+  if(m_flat.header)
+  {
+    NodeId ret = m_flat.word_node[wid];
+    while(levelsup > 0 && ret != 0) // ret == 0 --> root
+    {
+      --levelsup;
+      ret = m_flat.parent[ret];
+    }
+    return ret;
+  }
+
   NodeId ret = m_words[wid]->id; // node id
   while(levelsup > 0 && ret != 0) // ret == 0 --> root
   {
@@ -1280,6 +1573,38 @@ void TemplatedVocabulary<TDescriptor,F>::getWordsFromNode
   (NodeId nid, std::vector<WordId> &words) const
 {
   words.clear();
+
+  if(m_flat.header)
+  {
+    if(m_flat.isLeaf(nid))
+    {
+      words.push_back(m_flat.word_id[nid]);
+      return;
+    }
+
+    words.reserve(m_k); // ^1, ^2, ...
+
+    vector<NodeId> parents;
+    parents.push_back(nid);
+
+    while(!parents.empty())
+    {
+      NodeId parentid = parents.back();
+      parents.pop_back();
+
+      for(uint32_t c = m_flat.child_start[parentid];
+        c < m_flat.child_start[parentid+1]; ++c)
+      {
+        const NodeId child_id = m_flat.children[c];
+
+        if(m_flat.isLeaf(child_id))
+          words.push_back(m_flat.word_id[child_id]);
+        else
+          parents.push_back(child_id);
+      }
+    }
+    return;
+  }
   
   if(m_nodes[nid].isLeaf())
   {
@@ -1329,6 +1654,23 @@ int TemplatedVocabulary<TDescriptor,F>::stopWords(double minWeight)
       (*wit)->weight = 0;
     }
   }
+
+  if(m_flat.header)
+  {
+    // a mapped file is private to this process, so it can be written too
+    int cf = 0;
+    for(unsigned int wid = 0; wid < m_flat.header->words; ++wid)
+    {
+      WordValue &w = m_flat.weight[m_flat.word_node[wid]];
+      if(w < minWeight)
+      {
+        ++cf;
+        w = 0;
+      }
+    }
+    if(m_words.empty()) c = cf;
+  }
+
   return c;
 }
 
@@ -1345,6 +1687,7 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
 
     m_words.clear();
     m_nodes.clear();
+    releaseFlatTree();
 
     string s;
     getline(f,s);
@@ -1379,6 +1722,9 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
     {
         string snode;
         getline(f,snode);
+        // a trailing newline would otherwise add a bogus node
+        if(snode.empty())
+            continue;
         stringstream ssnode;
         ssnode << snode;
 
@@ -1419,6 +1765,8 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
         }
     }
 
+    buildFlatTree();
+
     return true;
 
 }
@@ -1432,6 +1780,24 @@ void TemplatedVocabulary<TDescriptor,F>::saveToTextFile(const std::string &filen
     f.open(filename.c_str(),ios_base::out);
     f << m_k << " " << m_L << " " << " " << m_scoring << " " << m_weighting << endl;
 
+    if(m_nodes.empty() && m_flat.header)
+    {
+        // loaded from a binary file
+        TDescriptor d;
+        for(NodeId i=1; i<m_flat.header->nodes; i++)
+        {
+            F::fromBytes(d, m_flat.descriptor(i));
+
+            f << m_flat.parent[i] << " ";
+            if(m_flat.isLeaf(i))
+                f << 1 << " ";
+            else
+                f << 0 << " ";
+
+            f << F::toString(d) << " " << (double)m_flat.weight[i] << endl;
+        }
+    }
+
     for(size_t i=1; i<m_nodes.size();i++)
     {
         const Node& node = m_nodes[i];
@@ -1515,6 +1881,10 @@ void TemplatedVocabulary<TDescriptor,F>::save(cv::FileStorage &f,
   f << "nodes" << "[";
   vector<NodeId> parents, children;
   vector<NodeId>::const_iterator pit;
+  TDescriptor d;
+
+  // the node tree only exists while the vocabulary is being built
+  const bool flat = m_nodes.empty() && m_flat.header;
 
   parents.push_back(0); // root
 
@@ -1523,23 +1893,40 @@ void TemplatedVocabulary<TDescriptor,F>::save(cv::FileStorage &f,
     NodeId pid = parents.back();
     parents.pop_back();
 
-    const Node& parent = m_nodes[pid];
-    children = parent.children;
+    if(flat)
+      children.assign(m_flat.children + m_flat.child_start[pid],
+        m_flat.children + m_flat.child_start[pid+1]);
+    else
+      children = m_nodes[pid].children;
 
     for(pit = children.begin(); pit != children.end(); pit++)
     {
-      const Node& child = m_nodes[*pit];
+      double weight;
+      bool leaf;
+      if(flat)
+      {
+        F::fromBytes(d, m_flat.descriptor(*pit));
+        weight = m_flat.weight[*pit];
+        leaf = m_flat.isLeaf(*pit);
+      }
+      else
+      {
+        const Node& child = m_nodes[*pit];
+        d = child.descriptor;
+        weight = child.weight;
+        leaf = child.isLeaf();
+      }
 
       // save node data
       f << "{:";
-      f << "nodeId" << (int)child.id;
+      f << "nodeId" << (int)*pit;
       f << "parentId" << (int)pid;
-      f << "weight" << (double)child.weight;
-      f << "descriptor" << F::toString(child.descriptor);
+      f << "weight" << weight;
+      f << "descriptor" << F::toString(d);
       f << "}";
       
       // add to parent list
-      if(!child.isLeaf())
+      if(!leaf)
       {
         parents.push_back(*pit);
       }
@@ -1551,13 +1938,12 @@ void TemplatedVocabulary<TDescriptor,F>::save(cv::FileStorage &f,
   // words
   f << "words" << "[";
   
-  typename vector<Node*>::const_iterator wit;
-  for(wit = m_words.begin(); wit != m_words.end(); wit++)
+  const unsigned int nwords = size();
+  for(WordId id = 0; id < nwords; id++)
   {
-    WordId id = wit - m_words.begin();
     f << "{:";
     f << "wordId" << (int)id;
-    f << "nodeId" << (int)(*wit)->id;
+    f << "nodeId" << (int)(flat ? m_flat.word_node[id] : m_words[id]->id);
     f << "}";
   }
   
@@ -1575,6 +1961,7 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
 {
   m_words.clear();
   m_nodes.clear();
+  releaseFlatTree();
   
   cv::FileNode fvoc = fs[name];
   
@@ -1619,6 +2006,290 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
     m_nodes[nid].word_id = wid;
     m_words[wid] = &m_nodes[nid];
   }
+
+  buildFlatTree();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::buildFlatTree()
+{
+  releaseFlatTree();
+
+  // a vocabulary without words keeps using the (empty) tree
+  if(m_nodes.size() < 2 || m_words.empty()) return;
+
+  const uint32_t nodes = m_nodes.size();
+  const uint32_t words = m_words.size();
+  const uint32_t dbytes = F::L;
+
+  uint32_t nchildren = 0;
+  for(uint32_t i = 0; i < nodes; ++i) nchildren += m_nodes[i].children.size();
+
+  // every array starts at a multiple of 8 bytes
+  BinaryVocabularyHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, "DBOW2VOC", 8);
+  h.version = BinaryVocabularyHeader::VERSION;
+  h.endianness = BinaryVocabularyHeader::ENDIANNESS;
+  h.k = m_k;
+  h.L = m_L;
+  h.scoring = m_scoring;
+  h.weighting = m_weighting;
+  h.nodes = nodes;
+  h.words = words;
+  h.children = nchildren;
+  h.descriptor_bytes = dbytes;
+
+  uint64_t offset = (sizeof(h) + 7) & ~(uint64_t)7;
+  h.parent_offset = offset;
+  offset += ((uint64_t)nodes * 4 + 7) & ~(uint64_t)7;
+  h.child_start_offset = offset;
+  offset += ((uint64_t)(nodes + 1) * 4 + 7) & ~(uint64_t)7;
+  h.children_offset = offset;
+  offset += ((uint64_t)nchildren * 4 + 7) & ~(uint64_t)7;
+  h.word_id_offset = offset;
+  offset += ((uint64_t)nodes * 4 + 7) & ~(uint64_t)7;
+  h.weight_offset = offset;
+  offset += (uint64_t)nodes * sizeof(WordValue);
+  h.descriptor_offset = offset;
+  offset += ((uint64_t)nchildren * dbytes + 7) & ~(uint64_t)7;
+  h.word_node_offset = offset;
+  offset += ((uint64_t)words * 4 + 7) & ~(uint64_t)7;
+  h.node_link_offset = offset;
+  offset += ((uint64_t)nodes * 4 + 7) & ~(uint64_t)7;
+  h.file_size = offset;
+
+  m_flat_buffer.assign(h.file_size / 8, 0);
+  unsigned char *data = (unsigned char*)&m_flat_buffer[0];
+  memcpy(data, &h, sizeof(h));
+
+  uint32_t *parent = (uint32_t*)(data + h.parent_offset);
+  uint32_t *child_start = (uint32_t*)(data + h.child_start_offset);
+  uint32_t *children = (uint32_t*)(data + h.children_offset);
+  uint32_t *word_id = (uint32_t*)(data + h.word_id_offset);
+  WordValue *weight = (WordValue*)(data + h.weight_offset);
+  unsigned char *descriptors = data + h.descriptor_offset;
+  uint32_t *word_node = (uint32_t*)(data + h.word_node_offset);
+  uint32_t *node_link = (uint32_t*)(data + h.node_link_offset);
+
+  uint32_t c = 0;
+  for(uint32_t i = 0; i < nodes; ++i)
+  {
+    const Node &node = m_nodes[i];
+
+    parent[i] = node.parent;
+    child_start[i] = c;
+    for(size_t j = 0; j < node.children.size(); ++j, ++c)
+    {
+      const NodeId child = node.children[j];
+      children[c] = child;
+      node_link[child] = c;
+      memcpy(descriptors + (size_t)c * dbytes,
+        F::data(m_nodes[child].descriptor), dbytes);
+    }
+    word_id[i] = node.word_id;
+    weight[i] = node.weight;
+  }
+  child_start[nodes] = c;
+
+  for(uint32_t i = 0; i < words; ++i)
+    word_node[i] = m_words[i]->id;
+
+  if(!setFlatTree(data, h.file_size, m_flat))
+  {
+    // should not happen with a tree built by this class
+    releaseFlatTree();
+    return;
+  }
+
+  // every query reads the flat tree, so the node tree is not kept twice
+  m_nodes.clear();
+  m_nodes.shrink_to_fit();
+  m_words.clear();
+  m_words.shrink_to_fit();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::setFlatTree(unsigned char *data,
+  size_t size, FlatTree &flat)
+{
+  flat = FlatTree();
+
+  if(data == NULL || size < sizeof(BinaryVocabularyHeader)) return false;
+
+  const BinaryVocabularyHeader *h = (const BinaryVocabularyHeader*)data;
+
+  if(memcmp(h->magic, "DBOW2VOC", 8) != 0 ||
+    h->version != BinaryVocabularyHeader::VERSION ||
+    h->endianness != BinaryVocabularyHeader::ENDIANNESS ||
+    h->descriptor_bytes != (uint32_t)F::L ||
+    h->file_size > size ||
+    h->nodes < 2 || h->words == 0 ||
+    h->k < 1 || h->L < 1 ||
+    h->scoring < L1_NORM || h->scoring > DOT_PRODUCT ||
+    h->weighting < TF_IDF || h->weighting > BINARY ||
+    h->checksum[sizeof(h->checksum) - 1] != '\0')
+    return false;
+
+  // each array must be aligned and lie inside the file
+  const uint64_t offsets[8] = { h->parent_offset, h->child_start_offset,
+    h->children_offset, h->word_id_offset, h->weight_offset,
+    h->descriptor_offset, h->word_node_offset, h->node_link_offset };
+  const uint64_t lengths[8] = { (uint64_t)h->nodes * 4,
+    (uint64_t)(h->nodes + 1) * 4, (uint64_t)h->children * 4,
+    (uint64_t)h->nodes * 4, (uint64_t)h->nodes * sizeof(WordValue),
+    (uint64_t)h->children * h->descriptor_bytes, (uint64_t)h->words * 4,
+    (uint64_t)h->nodes * 4 };
+
+  for(int i = 0; i < 8; ++i)
+  {
+    if(offsets[i] % 8 != 0 || offsets[i] < sizeof(BinaryVocabularyHeader) ||
+      offsets[i] > h->file_size || lengths[i] > h->file_size - offsets[i])
+      return false;
+  }
+
+  FlatTree f;
+  f.header = h;
+  f.parent = (const uint32_t*)(data + h->parent_offset);
+  f.child_start = (const uint32_t*)(data + h->child_start_offset);
+  f.children = (const uint32_t*)(data + h->children_offset);
+  f.word_id = (const uint32_t*)(data + h->word_id_offset);
+  f.weight = (WordValue*)(data + h->weight_offset);
+  f.descriptors = data + h->descriptor_offset;
+  f.word_node = (const uint32_t*)(data + h->word_node_offset);
+  f.node_link = (const uint32_t*)(data + h->node_link_offset);
+
+  // the links are checked once here so that the queries can follow them
+  // without bound checks. Children always have larger ids than their
+  // parent, so every descent ends at a leaf
+  if(f.child_start[0] != 0 || f.child_start[h->nodes] != h->children ||
+    f.child_start[0] == f.child_start[1])
+    return false;
+
+  for(uint32_t i = 0; i < h->nodes; ++i)
+  {
+    if(f.child_start[i] > f.child_start[i+1]) return false;
+
+    for(uint32_t c = f.child_start[i]; c < f.child_start[i+1]; ++c)
+    {
+      if(f.children[c] <= i || f.children[c] >= h->nodes) return false;
+    }
+
+    if(i > 0 && (f.parent[i] >= i || f.node_link[i] >= h->children ||
+      f.children[f.node_link[i]] != i)) return false;
+    if(f.isLeaf(i) && f.word_id[i] >= h->words) return false;
+  }
+
+  for(uint32_t i = 0; i < h->words; ++i)
+  {
+    if(f.word_node[i] == 0 || f.word_node[i] >= h->nodes) return false;
+  }
+
+  flat = f;
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::releaseFlatTree()
+{
+  if(m_map_addr)
+  {
+    munmap(m_map_addr, m_map_size);
+    m_map_addr = NULL;
+    m_map_size = 0;
+  }
+
+  m_flat_buffer.clear();
+  m_flat = FlatTree();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromBinaryFile(
+  const std::string &filename)
+{
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0) return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BinaryVocabularyHeader))
+  {
+    close(fd);
+    return false;
+  }
+
+  const size_t size = st.st_size;
+
+  // private mapping: stopWords may change the weights in memory only
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(addr == MAP_FAILED) return false;
+
+  madvise(addr, size, MADV_WILLNEED);
+
+  FlatTree flat;
+  if(!setFlatTree((unsigned char*)addr, size, flat))
+  {
+    munmap(addr, size);
+    return false;
+  }
+
+  releaseFlatTree();
+  m_nodes.clear();
+  m_words.clear();
+
+  m_map_addr = addr;
+  m_map_size = size;
+  m_flat = flat;
+
+  m_k = flat.header->k;
+  m_L = flat.header->L;
+  m_scoring = (ScoringType)flat.header->scoring;
+  m_weighting = (WeightingType)flat.header->weighting;
+
+  createScoringObject();
+
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::saveToBinaryFile(
+  const std::string &filename, const std::string &checksum) const
+{
+  if(!m_flat.header || checksum.size() >= sizeof(m_flat.header->checksum))
+    return false;
+
+  BinaryVocabularyHeader h = *m_flat.header;
+  memset(h.checksum, 0, sizeof(h.checksum));
+  memcpy(h.checksum, checksum.c_str(), checksum.size());
+
+  std::ofstream f(filename.c_str(), std::ios::out | std::ios::binary);
+  if(!f.is_open()) return false;
+
+  f.write((const char*)&h, sizeof(h));
+  f.write((const char*)m_flat.header + sizeof(h), h.file_size - sizeof(h));
+  f.close();
+
+  return !f.fail();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+std::string TemplatedVocabulary<TDescriptor,F>::getBinaryChecksum() const
+{
+  if(!m_flat.header) return std::string();
+  return std::string(m_flat.header->checksum);
 }
 
 // --------------------------------------------------------------------------
@@ -119,6 +119,66 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
   }
 }
 
+template <int D, typename E, typename VertexXiType, typename VertexXjType>
+void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticFormForVertex(int vertexIndex)
+{
+  VertexXiType* from = static_cast<VertexXiType*>(_vertices[0]);
+  VertexXjType* to   = static_cast<VertexXjType*>(_vertices[1]);
+
+  const JacobianXiOplusType& A = jacobianOplusXi();
+  const JacobianXjOplusType& B = jacobianOplusXj();
+
+  bool fromNotFixed = !(from->fixed());
+  bool toNotFixed = !(to->fixed());
+
+  // the off-diagonal block is written by the vertex with the smaller index in the Hessian,
+  // the same one for all the edges that share the block
+  bool offDiagonal = fromNotFixed && toNotFixed &&
+    (vertexIndex == 0 ? from->hessianIndex() < to->hessianIndex() : to->hessianIndex() < from->hessianIndex());
+
+  // same expressions as constructQuadraticForm(), so both give the same values
+  const InformationType& omega = _information;
+  Matrix<double, D, 1> omega_r = - omega * _error;
+  if (this->robustKernel() == 0) {
+    Matrix<double, VertexXiType::Dimension, D> AtO = A.transpose() * omega;
+    if (offDiagonal) {
+      if (_hessianRowMajor) // we have to write to the block as transposed
+        _hessianTransposed.noalias() += B.transpose() * AtO.transpose();
+      else
+        _hessian.noalias() += AtO * B;
+    }
+    if (vertexIndex == 0 && fromNotFixed) {
+      from->b().noalias() += A.transpose() * omega_r;
+      from->A().noalias() += AtO*A;
+    }
+    if (vertexIndex == 1 && toNotFixed) {
+      to->b().noalias() += B.transpose() * omega_r;
+      to->A().noalias() += B.transpose() * omega * B;
+    }
+  } else { // robust (weighted) error according to some kernel
+    double error = this->chi2();
+    Eigen::Vector3d rho;
+    this->robustKernel()->robustify(error, rho);
+    InformationType weightedOmega = this->robustInformation(rho);
+
+    omega_r *= rho[1];
+    if (offDiagonal) {
+      if (_hessianRowMajor) // we have to write to the block as transposed
+        _hessianTransposed.noalias() += B.transpose() * weightedOmega * A;
+      else
+        _hessian.noalias() += A.transpose() * weightedOmega * B;
+    }
+    if (vertexIndex == 0 && fromNotFixed) {
+      from->b().noalias() += A.transpose() * omega_r;
+      from->A().noalias() += A.transpose() * weightedOmega * A;
+    }
+    if (vertexIndex == 1 && toNotFixed) {
+      to->b().noalias() += B.transpose() * omega_r;
+      to->A().noalias() += B.transpose() * weightedOmega * B;
+    }
+  }
+}
+
 template <int D, typename E, typename VertexXiType, typename VertexXjType>
 void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::linearizeOplus(JacobianWorkspace& jacobianWorkspace)
 {
@@ -48,6 +48,21 @@ void BaseMultiEdge<D, E>::constructQuadraticForm()
 }
 
 
+template <int D, typename E>
+void BaseMultiEdge<D, E>::constructQuadraticFormForVertex(int vertexIndex)
+{
+  if (this->robustKernel()) {
+    double error = this->chi2();
+    Eigen::Vector3d rho;
+    this->robustKernel()->robustify(error, rho);
+    Matrix<double, D, 1> omega_r = - _information * _error;
+    omega_r *= rho[1];
+    computeQuadraticFormForVertex(this->robustInformation(rho), omega_r, vertexIndex);
+  } else {
+    computeQuadraticFormForVertex(_information, - _information * _error, vertexIndex);
+  }
+}
+
 template <int D, typename E>
 void BaseMultiEdge<D, E>::linearizeOplus(JacobianWorkspace& jacobianWorkspace)
 {
@@ -220,3 +235,53 @@ void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, con
 
   }
 }
+
+template <int D, typename E>
+void BaseMultiEdge<D, E>::computeQuadraticFormForVertex(const InformationType& omega, const ErrorVector& weightedError, int vertexIndex)
+{
+  OptimizableGraph::Vertex* vk = static_cast<OptimizableGraph::Vertex*>(_vertices[vertexIndex]);
+  if (vk->fixed())
+    return;
+
+  // ii block in the hessian and b
+  {
+    const MatrixXd& A = _jacobianOplus[vertexIndex];
+    MatrixXd AtO = A.transpose() * omega;
+    int fromDim = vk->dimension();
+    assert(fromDim >= 0);
+    Eigen::Map<MatrixXd> fromMap(vk->hessianData(), fromDim, fromDim);
+    Eigen::Map<VectorXd> fromB(vk->bData(), fromDim);
+    fromMap.noalias() += AtO * A;
+    fromB.noalias() += A.transpose() * weightedError;
+  }
+
+  // off-diagonal blocks ij shared with a vertex of larger index in the Hessian
+  for (size_t i = 0; i < _vertices.size(); ++i) {
+    OptimizableGraph::Vertex* from = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
+    if (from->fixed())
+      continue;
+
+    for (size_t j = i+1; j < _vertices.size(); ++j) {
+      if ((int)i != vertexIndex && (int)j != vertexIndex)
+        continue;
+      OptimizableGraph::Vertex* to = static_cast<OptimizableGraph::Vertex*>(_vertices[j]);
+      if (to->fixed())
+        continue;
+      OptimizableGraph::Vertex* other = (int)i == vertexIndex ? to : from;
+      if (other->hessianIndex() < vk->hessianIndex())
+        continue;
+
+      const MatrixXd& A = _jacobianOplus[i];
+      const MatrixXd& B = _jacobianOplus[j];
+      MatrixXd AtO = A.transpose() * omega;
+      int idx = internal::computeUpperTriangleIndex(i, j);
+      assert(idx < (int)_hessian.size());
+      HessianHelper& hhelper = _hessian[idx];
+      if (hhelper.transposed) { // we have to write to the block as transposed
+        hhelper.matrix.noalias() += B.transpose() * AtO.transpose();
+      } else {
+        hhelper.matrix.noalias() += AtO * B;
+      }
+    }
+  }
+}
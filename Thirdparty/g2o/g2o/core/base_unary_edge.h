@@ -73,6 +73,8 @@ namespace g2o {
 
       virtual void constructQuadraticForm();
 
+      virtual void constructQuadraticFormForVertex(int vertexIndex);
+
       virtual void initialEstimate(const OptimizableGraph::VertexSet& from, OptimizableGraph::Vertex* to);
 
       virtual void mapHessianMemory(double*, int, int, bool) {assert(0 && "BaseUnaryEdge does not map memory of the Hessian");}
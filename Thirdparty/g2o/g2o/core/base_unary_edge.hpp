@@ -71,6 +71,15 @@ void BaseUnaryEdge<D, E, VertexXiType>::constructQuadraticForm()
   }
 }
 
+template <int D, typename E, typename VertexXiType>
+void BaseUnaryEdge<D, E, VertexXiType>::constructQuadraticFormForVertex(int vertexIndex)
+{
+  (void) vertexIndex;
+  assert(vertexIndex == 0 && "BaseUnaryEdge has a single vertex");
+  // all the quadratic form belongs to the only vertex
+  constructQuadraticForm();
+}
+
 template <int D, typename E, typename VertexXiType>
 void BaseUnaryEdge<D, E, VertexXiType>::linearizeOplus(JacobianWorkspace& jacobianWorkspace)
 {
@@ -147,6 +147,19 @@ namespace g2o {
 
       void deallocate();
 
+      /**
+       * linearizes the active edges and builds the system with the parallelFor() of the optimizer.
+       * Every vertex adds the terms of its edges in the order of the active edges, as the serial
+       * code does, so the system is the same for any number of threads.
+       */
+      void buildSystemParallel();
+
+      /**
+       * Schur complement of the landmarks into _Hschur and _coefficients with the parallelFor() of
+       * the optimizer. Every pose column is accumulated by one task in the order of the landmarks.
+       */
+      void computeSchurParallel();
+
       SparseBlockMatrix<PoseMatrixType>* _Hpp;
       SparseBlockMatrix<LandmarkMatrixType>* _Hll;
       SparseBlockMatrix<PoseLandmarkMatrixType>* _Hpl;
@@ -166,6 +179,15 @@ namespace g2o {
       std::vector<OpenMPMutex> _coefficientsMutex;
 #    endif
 
+      // memory reused by buildSystemParallel() and computeSchurParallel()
+      VectorXd _edgeJacobians;                          ///< Jacobians of every active edge, one after the other
+      std::vector<int> _edgeJacobianOffsets;            ///< first element of every edge in _edgeJacobians
+      std::vector<int> _vertexEdgeOffsets;              ///< first element of every vertex in _vertexEdges
+      std::vector<std::pair<int, int> > _vertexEdges;   ///< (active edge, index of the vertex in the edge)
+      VectorXd _landmarkDb;                             ///< Dinv * b of every landmark
+      std::vector<int> _poseLandmarkOffsets;            ///< first element of every pose in _poseLandmarks
+      std::vector<std::pair<int, const PoseLandmarkMatrixType*> > _poseLandmarks; ///< (landmark, Hpl block) of every pose
+
       bool _doSchur;
 
       double* _coefficients;
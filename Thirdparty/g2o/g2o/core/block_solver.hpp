@@ -375,58 +375,62 @@ bool BlockSolver<Traits>::solve(){
 
   //_DInvSchur->clear();
   memset (_coefficients, 0, _sizePoses*sizeof(double));
+  if (_optimizer->hasParallelFor() && _Hll->blockCols().size() > 100) {
+    computeSchurParallel();
+  } else {
 # ifdef G2O_OPENMP
 # pragma omp parallel for default (shared) schedule(dynamic, 10)
 # endif
-  for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_Hll->blockCols().size()); ++landmarkIndex) {
-    const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
-    assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
-
-    // calculate inverse block for the landmark
-    const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
-    assert (D && D->rows()==D->cols() && "Error in landmark matrix");
-    LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
-    Dinv = D->inverse();
-
-    LandmarkVectorType  db(D->rows());
-    for (int j=0; j<D->rows(); ++j) {
-      db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
-    }
-    db=Dinv*db;
+    for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_Hll->blockCols().size()); ++landmarkIndex) {
+      const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
+      assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+
+      // calculate inverse block for the landmark
+      const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
+      assert (D && D->rows()==D->cols() && "Error in landmark matrix");
+      LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      Dinv = D->inverse();
+
+      LandmarkVectorType  db(D->rows());
+      for (int j=0; j<D->rows(); ++j) {
+        db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
+      }
+      db=Dinv*db;
 
-    assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
-    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+      assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
+      const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
 
-    for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin();
-        it_outer != landmarkColumn.end(); ++it_outer) {
-      int i1 = it_outer->row;
+      for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin();
+          it_outer != landmarkColumn.end(); ++it_outer) {
+        int i1 = it_outer->row;
 
-      const PoseLandmarkMatrixType* Bi = it_outer->block;
-      assert(Bi);
+        const PoseLandmarkMatrixType* Bi = it_outer->block;
+        assert(Bi);
 
-      PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
-      assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
-      typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
+        PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
+        assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
+        typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
 #    ifdef G2O_OPENMP
-      ScopedOpenMPMutex mutexLock(&_coefficientsMutex[i1]);
+        ScopedOpenMPMutex mutexLock(&_coefficientsMutex[i1]);
 #    endif
-      Bb.noalias() += (*Bi)*db;
-
-      assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
-      typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
-
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
-      for (; it_inner != landmarkColumn.end(); ++it_inner) {
-        int i2 = it_inner->row;
-        const PoseLandmarkMatrixType* Bj = it_inner->block;
-        assert(Bj); 
-        while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
-          ++targetColumnIt;
-        assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
-        PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
-        assert(Hi1i2);
-        (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+        Bb.noalias() += (*Bi)*db;
+
+        assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
+        typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
+
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
+        for (; it_inner != landmarkColumn.end(); ++it_inner) {
+          int i2 = it_inner->row;
+          const PoseLandmarkMatrixType* Bj = it_inner->block;
+          assert(Bj); 
+          while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
+            ++targetColumnIt;
+          assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
+          PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
+          assert(Hi1i2);
+          (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+        }
       }
     }
   }
@@ -518,30 +522,34 @@ bool BlockSolver<Traits>::buildSystem()
 
   // resetting the terms for the pairwise constraints
   // built up the current system by storing the Hessian blocks in the edges and vertices
+  if (_optimizer->hasParallelFor() && _optimizer->activeEdges().size() > 100) {
+    buildSystemParallel();
+  } else {
 # ifndef G2O_OPENMP
-  // no threading, we do not need to copy the workspace
-  JacobianWorkspace& jacobianWorkspace = _optimizer->jacobianWorkspace();
+    // no threading, we do not need to copy the workspace
+    JacobianWorkspace& jacobianWorkspace = _optimizer->jacobianWorkspace();
 # else
-  // if running with threads need to produce copies of the workspace for each thread
-  JacobianWorkspace jacobianWorkspace = _optimizer->jacobianWorkspace();
+    // if running with threads need to produce copies of the workspace for each thread
+    JacobianWorkspace jacobianWorkspace = _optimizer->jacobianWorkspace();
 # pragma omp parallel for default (shared) firstprivate(jacobianWorkspace) if (_optimizer->activeEdges().size() > 100)
 # endif
-  for (int k = 0; k < static_cast<int>(_optimizer->activeEdges().size()); ++k) {
-    OptimizableGraph::Edge* e = _optimizer->activeEdges()[k];
-    e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
-    e->constructQuadraticForm();
+    for (int k = 0; k < static_cast<int>(_optimizer->activeEdges().size()); ++k) {
+      OptimizableGraph::Edge* e = _optimizer->activeEdges()[k];
+      e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
+      e->constructQuadraticForm();
 #  ifndef NDEBUG
-    for (size_t i = 0; i < e->vertices().size(); ++i) {
-      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
-      if (! v->fixed()) {
-        bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
-        if (hasANan) {
-          cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
-          break;
+      for (size_t i = 0; i < e->vertices().size(); ++i) {
+        const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+        if (! v->fixed()) {
+          bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
+          if (hasANan) {
+            cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
+            break;
+          }
         }
       }
-    }
 #  endif
+    }
   }
 
   // flush the current system in a sparse block matrix
@@ -560,6 +568,162 @@ bool BlockSolver<Traits>::buildSystem()
 }
 
 
+template <typename Traits>
+void BlockSolver<Traits>::buildSystemParallel()
+{
+  const SparseOptimizer::EdgeContainer& activeEdges = _optimizer->activeEdges();
+  const int numEdges = static_cast<int>(activeEdges.size());
+  const int numVertices = static_cast<int>(_optimizer->indexMapping().size());
+
+  // every edge gets its own memory for the Jacobians, so they are still there when the
+  // vertices build the system. Blocks are padded to keep them aligned for Eigen.
+  _edgeJacobianOffsets.resize(numEdges + 1);
+  _edgeJacobianOffsets[0] = 0;
+  _vertexEdgeOffsets.assign(numVertices + 1, 0);
+  for (int k = 0; k < numEdges; ++k) {
+    const OptimizableGraph::Edge* e = activeEdges[k];
+    int size = 0;
+    for (size_t i = 0; i < e->vertices().size(); ++i) {
+      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+      size += (e->dimension() * v->dimension() + 7) & ~7;
+      if (v->hessianIndex() >= 0)
+        ++_vertexEdgeOffsets[v->hessianIndex() + 1];
+    }
+    _edgeJacobianOffsets[k + 1] = _edgeJacobianOffsets[k] + size;
+  }
+  if (_edgeJacobians.size() < _edgeJacobianOffsets[numEdges])
+    _edgeJacobians.resize(_edgeJacobianOffsets[numEdges]);
+
+  // edges of every vertex, in the order of the active edges
+  for (int i = 0; i < numVertices; ++i)
+    _vertexEdgeOffsets[i + 1] += _vertexEdgeOffsets[i];
+  _vertexEdges.resize(_vertexEdgeOffsets[numVertices]);
+  std::vector<int> next(_vertexEdgeOffsets.begin(), _vertexEdgeOffsets.end() - 1);
+  for (int k = 0; k < numEdges; ++k) {
+    const OptimizableGraph::Edge* e = activeEdges[k];
+    for (size_t i = 0; i < e->vertices().size(); ++i) {
+      int hessianIndex = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i))->hessianIndex();
+      if (hessianIndex >= 0)
+        _vertexEdges[next[hessianIndex]++] = std::make_pair(k, static_cast<int>(i));
+    }
+  }
+
+  // linearize the edges
+  const int edgeChunk = 64;
+  _optimizer->parallelFor((numEdges + edgeChunk - 1) / edgeChunk, [&](int c) {
+    JacobianWorkspace jacobianWorkspace;
+    std::vector<double*> jacobianMemory;
+    const int end = std::min(numEdges, (c + 1) * edgeChunk);
+    for (int k = c * edgeChunk; k < end; ++k) {
+      OptimizableGraph::Edge* e = activeEdges[k];
+      jacobianMemory.resize(e->vertices().size());
+      double* m = _edgeJacobians.data() + _edgeJacobianOffsets[k];
+      for (size_t i = 0; i < e->vertices().size(); ++i) {
+        jacobianMemory[i] = m;
+        m += (e->dimension() * static_cast<const OptimizableGraph::Vertex*>(e->vertex(i))->dimension() + 7) & ~7;
+      }
+      jacobianWorkspace.setExternalMemory(jacobianMemory.data());
+      e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
+    }
+  });
+
+  // every vertex only writes its own blocks, there is no need to lock
+  const int vertexChunk = 16;
+  _optimizer->parallelFor((numVertices + vertexChunk - 1) / vertexChunk, [&](int c) {
+    const int end = std::min(numVertices, (c + 1) * vertexChunk);
+    for (int v = c * vertexChunk; v < end; ++v) {
+      for (int p = _vertexEdgeOffsets[v]; p < _vertexEdgeOffsets[v + 1]; ++p)
+        activeEdges[_vertexEdges[p].first]->constructQuadraticFormForVertex(_vertexEdges[p].second);
+    }
+  });
+}
+
+template <typename Traits>
+void BlockSolver<Traits>::computeSchurParallel()
+{
+  const int numLandmarks = static_cast<int>(_Hll->blockCols().size());
+  const int numPoses = static_cast<int>(_HschurTransposedCCS->blockCols().size());
+
+  // inverse block and Dinv * b of every landmark
+  if (_landmarkDb.size() < _sizeLandmarks)
+    _landmarkDb.resize(_sizeLandmarks);
+  const int landmarkChunk = 64;
+  _optimizer->parallelFor((numLandmarks + landmarkChunk - 1) / landmarkChunk, [&](int c) {
+    const int end = std::min(numLandmarks, (c + 1) * landmarkChunk);
+    for (int landmarkIndex = c * landmarkChunk; landmarkIndex < end; ++landmarkIndex) {
+      const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
+      assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+
+      const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
+      assert (D && D->rows()==D->cols() && "Error in landmark matrix");
+      LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      Dinv = D->inverse();
+
+      LandmarkVectorType  db(D->rows());
+      for (int j=0; j<D->rows(); ++j) {
+        db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
+      }
+      db=Dinv*db;
+      for (int j=0; j<D->rows(); ++j)
+        _landmarkDb[_Hll->rowBaseOfBlock(landmarkIndex) + j] = db[j];
+    }
+  });
+
+  // landmarks seen by every pose, in increasing order
+  _poseLandmarkOffsets.assign(numPoses + 1, 0);
+  for (int landmarkIndex = 0; landmarkIndex < numLandmarks; ++landmarkIndex) {
+    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+    for (size_t k = 0; k < landmarkColumn.size(); ++k)
+      ++_poseLandmarkOffsets[landmarkColumn[k].row + 1];
+  }
+  for (int i = 0; i < numPoses; ++i)
+    _poseLandmarkOffsets[i + 1] += _poseLandmarkOffsets[i];
+  _poseLandmarks.resize(_poseLandmarkOffsets[numPoses]);
+  std::vector<int> next(_poseLandmarkOffsets.begin(), _poseLandmarkOffsets.end() - 1);
+  for (int landmarkIndex = 0; landmarkIndex < numLandmarks; ++landmarkIndex) {
+    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+    for (size_t k = 0; k < landmarkColumn.size(); ++k)
+      _poseLandmarks[next[landmarkColumn[k].row]++] = std::make_pair(landmarkIndex, landmarkColumn[k].block);
+  }
+
+  // every pose i1 accumulates its column of the Schur complement and its coefficients,
+  // taking the landmarks in the same order as the serial code
+  _optimizer->parallelFor(numPoses, [&](int i1) {
+    for (int p = _poseLandmarkOffsets[i1]; p < _poseLandmarkOffsets[i1 + 1]; ++p) {
+      const int landmarkIndex = _poseLandmarks[p].first;
+      const PoseLandmarkMatrixType* Bi = _poseLandmarks[p].second;
+      assert(Bi);
+      const LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+
+      LandmarkVectorType db(Dinv.rows());
+      for (int j=0; j<Dinv.rows(); ++j)
+        db[j] = _landmarkDb[_Hll->rowBaseOfBlock(landmarkIndex) + j];
+
+      PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
+      assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
+      typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
+      Bb.noalias() += (*Bi)*db;
+
+      typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
+
+      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
+      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
+      for (; it_inner != landmarkColumn.end(); ++it_inner) {
+        int i2 = it_inner->row;
+        const PoseLandmarkMatrixType* Bj = it_inner->block;
+        assert(Bj);
+        while (targetColumnIt->row < i2)
+          ++targetColumnIt;
+        assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
+        PoseMatrixType* Hi1i2 = targetColumnIt->block;
+        assert(Hi1i2);
+        (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+      }
+    }
+  });
+}
+
 template <typename Traits>
 bool BlockSolver<Traits>::setLambda(double lambda, bool backup)
 {
@@ -35,7 +35,7 @@ using namespace std;
 namespace g2o {
 
 JacobianWorkspace::JacobianWorkspace() :
-  _maxNumVertices(-1), _maxDimension(-1)
+  _externalMemory(0), _maxNumVertices(-1), _maxDimension(-1)
 {
 }
 
@@ -76,17 +76,27 @@ namespace g2o {
        */
       void updateSize(int numVertices, int dimension);
 
+      /**
+       * use memory of the caller instead of the allocated workspace, one block per vertex
+       * of the edge. The Jacobians computed by linearizeOplus then stay valid after this
+       * workspace has been used for another edge. Pass 0 to use the allocated memory again.
+       */
+      void setExternalMemory(double* const* memory) { _externalMemory = memory; }
+
       /**
        * return the workspace for a vertex in an edge
        */
       double* workspaceForVertex(int vertexIndex)
       {
+        if (_externalMemory)
+          return _externalMemory[vertexIndex];
         assert(vertexIndex >= 0 && (size_t)vertexIndex < _workspace.size() && "Index out of bounds");
         return _workspace[vertexIndex].data();
       }
 
     protected:
       WorkspaceVector _workspace;   ///< the memory pre-allocated for computing the Jacobians
+      double* const* _externalMemory; ///< memory given by setExternalMemory(), used instead of _workspace
       int _maxNumVertices;          ///< the maximum number of vertices connected by a hyper-edge
       int _maxDimension;            ///< the maximum dimension (number of elements) for a Jacobian
   };
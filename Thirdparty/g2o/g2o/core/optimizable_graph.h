@@ -437,6 +437,16 @@ namespace g2o {
          */
         virtual void constructQuadraticForm() = 0;
 
+        /**
+         * Adds the part of the quadratic form that belongs to the vertex at position
+         * vertexIndex in the edge: its diagonal block, its part of b and the off-diagonal
+         * blocks towards the vertices with a larger hessianIndex(). Calling it for every
+         * non-fixed vertex gives the same system as constructQuadraticForm(), but
+         * different vertices can be processed in parallel without locking.
+         * The Jacobians of the last call to linearizeOplus are used.
+         */
+        virtual void constructQuadraticFormForVertex(int vertexIndex) = 0;
+
         /**
          * maps the internal matrix to some external memory location,
          * you need to provide the memory before calling constructQuadraticForm
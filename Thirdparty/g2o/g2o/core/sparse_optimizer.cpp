@@ -67,12 +67,22 @@ namespace g2o{
         (*(*it))(this);
     }
 
+    if (_parallelFor && _activeEdges.size() > 50) {
+      const int numEdges = static_cast<int>(_activeEdges.size());
+      const int chunkSize = 64;
+      parallelFor((numEdges + chunkSize - 1) / chunkSize, [&](int c) {
+        const int end = std::min(numEdges, (c + 1) * chunkSize);
+        for (int k = c * chunkSize; k < end; ++k)
+          _activeEdges[k]->computeError();
+      });
+    } else {
 #   ifdef G2O_OPENMP
 #   pragma omp parallel for default (shared) if (_activeEdges.size() > 50)
 #   endif
-    for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
-      OptimizableGraph::Edge* e = _activeEdges[k];
-      e->computeError();
+      for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
+        OptimizableGraph::Edge* e = _activeEdges[k];
+        e->computeError();
+      }
     }
 
 #  ifndef NDEBUG
@@ -87,6 +97,16 @@ namespace g2o{
 
   }
 
+  void SparseOptimizer::parallelFor(int n, const std::function<void(int)>& body) const
+  {
+    if (_parallelFor && n > 1) {
+      _parallelFor(n, body);
+    } else {
+      for (int i = 0; i < n; ++i)
+        body(i);
+    }
+  }
+
   double SparseOptimizer::activeChi2( ) const
   {
     double chi = 0.0;
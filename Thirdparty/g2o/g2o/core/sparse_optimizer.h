@@ -34,6 +34,7 @@
 #include "batch_stats.h"
 
 #include <map>
+#include <functional>
 
 namespace g2o {
 
@@ -249,6 +250,25 @@ namespace g2o {
      */
     void computeActiveErrors();
 
+    /**
+     * function that runs body(i) for every i in [0,n) and returns when all of them are done
+     */
+    typedef std::function<void(int n, const std::function<void(int)>& body)> ParallelForFunction;
+
+    /**
+     * set the function used to compute the errors, the Jacobians and the Schur complement
+     * in parallel. Without it everything runs on the calling thread. The results do not
+     * depend on the number of threads. Only set it if all the edges compute their Jacobians
+     * analytically: the numeric linearizeOplus() of the base edges modifies the vertices.
+     */
+    void setParallelFor(const ParallelForFunction& parallelFor) { _parallelFor = parallelFor;}
+    bool hasParallelFor() const { return static_cast<bool>(_parallelFor);}
+
+    /**
+     * runs body(i) for every i in [0,n), through the function given by setParallelFor() if any
+     */
+    void parallelFor(int n, const std::function<void(int)>& body) const;
+
     /**
      * Linearizes the system by computing the Jacobians for the nodes
      * and edges in the graph
@@ -306,6 +326,7 @@ namespace g2o {
 
     BatchStatisticsContainer _batchStatistics;   ///< global statistics of the optimizer, e.g., timing, num-non-zeros
     bool _computeBatchStatistics;
+    ParallelForFunction _parallelFor;
   };
 } // end namespace
 
@@ -0,0 +1,542 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef G2O_LINEAR_SOLVER_SUPERNODAL_H
+#define G2O_LINEAR_SOLVER_SUPERNODAL_H
+
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <Eigen/Sparse>
+#include <Eigen/OrderingMethods>
+
+#include "../core/linear_solver.h"
+#include "../core/batch_stats.h"
+#include "../stuff/timeutil.h"
+
+#include "../core/eigen_types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+namespace g2o {
+
+/**
+ * \brief multithreaded supernodal sparse Cholesky (multifrontal LL^T)
+ *
+ * The symbolic analysis (AMD ordering on the blocks, elimination tree,
+ * supernodes and assembly maps) is done once after init() and reused by
+ * all the following calls to solve(), as the non-zero pattern does not
+ * change between iterations. Consecutive block columns with the same
+ * structure are merged into supernodes, which are factorized as dense
+ * fronts. Independent subtrees of the supernodal elimination tree and the
+ * panels of large fronts are processed with the function given by
+ * setParallelFor(). The work is split in the same way with or without it,
+ * so the result does not depend on the number of threads.
+ */
+template <typename MatrixType>
+class LinearSolverSupernodal: public LinearSolver<MatrixType>
+{
+  public:
+    //! runs body(i) for every i in [0,n) and returns when all of them are done
+    typedef std::function<void(int n, const std::function<void(int)>& body)> ParallelForFunction;
+
+  protected:
+    struct Supernode
+    {
+      int firstBlock, lastBlock;       ///< block columns, in elimination order
+      int firstCol, numCols;           ///< scalar columns, in elimination order
+      std::vector<int> rows;           ///< scalar rows below the diagonal block, sorted
+      int parent;                      ///< supernode that receives the update matrix, -1 for roots
+      std::vector<int> children;
+      std::vector<int> parentMap;      ///< position of every entry of rows in the front of the parent
+      std::vector<int> entries;        ///< blocks of A assembled into the front
+    };
+
+    //! position of a block of A in the front of its supernode
+    struct Entry
+    {
+      int row, col;
+      bool transposed;
+    };
+
+  public:
+    LinearSolverSupernodal() :
+      LinearSolver<MatrixType>(),
+      _init(true), _writeDebug(false), _size(0)
+    {
+    }
+
+    virtual ~LinearSolverSupernodal()
+    {
+    }
+
+    virtual bool init()
+    {
+      _init = true;
+      return true;
+    }
+
+    bool solve(const SparseBlockMatrix<MatrixType>& A, double* x, double* b)
+    {
+      if (_init) // compute the symbolic decomposition once
+        computeSymbolicDecomposition(A);
+      _init = false;
+
+      double t=get_monotonic_time();
+      if (! factorize(A)) { // the matrix is not positive definite
+        if (_writeDebug) {
+          std::cerr << "Cholesky failure, writing debug.txt (Hessian loadable by Octave)" << std::endl;
+          A.writeOctave("debug.txt");
+        }
+        return false;
+      }
+
+      // Solving the system in the elimination order
+      VectorXD y(_size);
+      for (int i = 0; i < _size; ++i)
+        y(i) = b[_scalarPerm[i]];
+      VectorXD tmp;
+
+      for (size_t s = 0; s < _supernodes.size(); ++s) {
+        const Supernode& sn = _supernodes[s];
+        const MatrixXD& L = _factors[s];
+        const int m = sn.rows.size();
+        VectorXD::SegmentReturnType ys = y.segment(sn.firstCol, sn.numCols);
+        L.topRows(sn.numCols).template triangularView<Eigen::Lower>().solveInPlace(ys);
+        if (m > 0) {
+          tmp.noalias() = L.bottomRows(m) * ys;
+          for (int i = 0; i < m; ++i)
+            y(sn.rows[i]) -= tmp(i);
+        }
+      }
+
+      for (int s = static_cast<int>(_supernodes.size()) - 1; s >= 0; --s) {
+        const Supernode& sn = _supernodes[s];
+        const MatrixXD& L = _factors[s];
+        const int m = sn.rows.size();
+        VectorXD::SegmentReturnType ys = y.segment(sn.firstCol, sn.numCols);
+        if (m > 0) {
+          tmp.resize(m);
+          for (int i = 0; i < m; ++i)
+            tmp(i) = y(sn.rows[i]);
+          ys.noalias() -= L.bottomRows(m).transpose() * tmp;
+        }
+        L.topRows(sn.numCols).template triangularView<Eigen::Lower>().transpose().solveInPlace(ys);
+      }
+
+      for (int i = 0; i < _size; ++i)
+        x[_scalarPerm[i]] = y(i);
+
+      G2OBatchStatistics* globalStats = G2OBatchStatistics::globalStats();
+      if (globalStats) {
+        globalStats->timeNumericDecomposition = get_monotonic_time() - t;
+        size_t nnz = 0;
+        for (size_t s = 0; s < _factors.size(); ++s)
+          nnz += _factors[s].size();
+        globalStats->choleskyNNZ = nnz;
+      }
+
+      return true;
+    }
+
+    /**
+     * set the function used to factorize independent supernodes and the
+     * panels of large fronts in parallel. Without it everything runs on the
+     * calling thread.
+     */
+    void setParallelFor(const ParallelForFunction& parallelFor) { _parallelFor = parallelFor;}
+
+    //! write a debug dump of the system matrix if it is not SPD in solve
+    virtual bool writeDebug() const { return _writeDebug;}
+    virtual void setWriteDebug(bool b) { _writeDebug = b;}
+
+  protected:
+    //! width of the dense panels in the fronts
+    static const int PanelSize = 64;
+    //! zero blocks always allowed in a supernode, above that up to 10% of its blocks may be zero
+    static const int RelaxedBlocks = 4;
+
+    bool _init;
+    bool _writeDebug;
+    ParallelForFunction _parallelFor;
+
+    int _size;
+    std::vector<int> _scalarPerm;                 ///< original scalar index of every scalar in elimination order
+    std::vector<Supernode> _supernodes;           ///< children are numbered before their parent
+    std::vector<std::vector<int> > _levels;       ///< supernodes whose children are in previous levels
+    std::vector<Entry> _entries;                  ///< one per block of A, in the order of A.blockCols()
+    std::vector<const MatrixType*> _blocks;       ///< blocks of A in the same order as _entries
+    std::vector<MatrixXD, Eigen::aligned_allocator<MatrixXD> > _fronts;   ///< dense front of every supernode while factorizing
+    std::vector<MatrixXD, Eigen::aligned_allocator<MatrixXD> > _factors;  ///< columns of L of every supernode
+
+    void parallel(int n, const std::function<void(int)>& body) const
+    {
+      if (_parallelFor && n > 1) {
+        _parallelFor(n, body);
+      } else {
+        for (int i = 0; i < n; ++i)
+          body(i);
+      }
+    }
+
+    /**
+     * fill-in reducing ordering, elimination tree, supernodes and the maps
+     * used to assemble the fronts. Only depends on the non-zero pattern of A.
+     */
+    void computeSymbolicDecomposition(const SparseBlockMatrix<MatrixType>& A)
+    {
+      double t=get_monotonic_time();
+      const int numBlocks = A.blockCols().size();
+      _size = A.cols();
+
+      // symmetric block pattern without the diagonal
+      std::vector<std::vector<int> > adjacency(numBlocks);
+      std::vector<Eigen::Triplet<double> > triplets;
+      for (int c = 0; c < numBlocks; ++c) {
+        const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+        for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+          const int r = it->first;
+          if (r > c) // only upper triangle
+            break;
+          triplets.push_back(Eigen::Triplet<double>(r, c, 0.));
+          if (r < c) {
+            adjacency[r].push_back(c);
+            adjacency[c].push_back(r);
+          }
+        }
+      }
+
+      // AMD ordering on the blocks
+      std::vector<int> amdOrder(numBlocks);
+      {
+        typedef Eigen::SparseMatrix<double, Eigen::ColMajor> SparseMatrix;
+        SparseMatrix auxBlockMatrix(numBlocks, numBlocks);
+        auxBlockMatrix.setFromTriplets(triplets.begin(), triplets.end());
+        SparseMatrix C;
+        C = auxBlockMatrix.selfadjointView<Eigen::Upper>();
+        Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> blockP;
+        Eigen::internal::minimum_degree_ordering(C, blockP);
+        for (int i = 0; i < numBlocks; ++i)
+          amdOrder[i] = blockP.indices()(i);
+      }
+      std::vector<int> inverse(numBlocks);
+      for (int i = 0; i < numBlocks; ++i)
+        inverse[amdOrder[i]] = i;
+
+      // elimination tree of the permuted block matrix
+      std::vector<int> parent(numBlocks, -1), ancestor(numBlocks, -1);
+      for (int k = 0; k < numBlocks; ++k) {
+        const std::vector<int>& neighbors = adjacency[amdOrder[k]];
+        for (size_t n = 0; n < neighbors.size(); ++n) {
+          int i = inverse[neighbors[n]];
+          while (i != -1 && i < k) {
+            int next = ancestor[i];
+            ancestor[i] = k;
+            if (next == -1)
+              parent[i] = k;
+            i = next;
+          }
+        }
+      }
+
+      // postorder, so that every subtree is contiguous
+      std::vector<int> post(numBlocks);
+      {
+        std::vector<int> head(numBlocks, -1), next(numBlocks, -1), stack;
+        for (int k = numBlocks - 1; k >= 0; --k) {
+          if (parent[k] != -1) {
+            next[k] = head[parent[k]];
+            head[parent[k]] = k;
+          }
+        }
+        int count = 0;
+        for (int root = 0; root < numBlocks; ++root) {
+          if (parent[root] != -1)
+            continue;
+          stack.push_back(root);
+          while (! stack.empty()) {
+            int k = stack.back();
+            if (head[k] != -1) {
+              int child = head[k];
+              head[k] = next[child];
+              stack.push_back(child);
+            } else {
+              stack.pop_back();
+              post[k] = count++;
+            }
+          }
+        }
+      }
+
+      std::vector<int> order(numBlocks), parentOrder(numBlocks, -1), numChildren(numBlocks, 0);
+      for (int k = 0; k < numBlocks; ++k) {
+        order[post[k]] = amdOrder[k];
+        if (parent[k] != -1) {
+          parentOrder[post[k]] = post[parent[k]];
+          ++numChildren[post[parent[k]]];
+        }
+      }
+      for (int i = 0; i < numBlocks; ++i)
+        inverse[order[i]] = i;
+
+      std::vector<int> blockBase(numBlocks + 1, 0);
+      for (int i = 0; i < numBlocks; ++i)
+        blockBase[i + 1] = blockBase[i] + A.colsOfBlock(order[i]);
+      _scalarPerm.resize(_size);
+      for (int i = 0; i < numBlocks; ++i)
+        for (int j = blockBase[i]; j < blockBase[i + 1]; ++j)
+          _scalarPerm[j] = A.colBaseOfBlock(order[i]) + j - blockBase[i];
+
+      // block structure of every column of L below the diagonal
+      std::vector<std::vector<int> > structure(numBlocks);
+      {
+        std::vector<int> head(numBlocks, -1), next(numBlocks, -1), mark(numBlocks, -1);
+        for (int j = numBlocks - 1; j >= 0; --j) {
+          if (parentOrder[j] != -1) {
+            next[j] = head[parentOrder[j]];
+            head[parentOrder[j]] = j;
+          }
+        }
+        for (int j = 0; j < numBlocks; ++j) {
+          std::vector<int>& sj = structure[j];
+          mark[j] = j;
+          const std::vector<int>& neighbors = adjacency[order[j]];
+          for (size_t n = 0; n < neighbors.size(); ++n) {
+            int i = inverse[neighbors[n]];
+            if (i > j && mark[i] != j) {
+              mark[i] = j;
+              sj.push_back(i);
+            }
+          }
+          for (int c = head[j]; c != -1; c = next[c]) {
+            const std::vector<int>& sc = structure[c];
+            for (size_t n = 0; n < sc.size(); ++n) {
+              if (mark[sc[n]] != j) {
+                mark[sc[n]] = j;
+                sj.push_back(sc[n]);
+              }
+            }
+          }
+          std::sort(sj.begin(), sj.end());
+        }
+      }
+
+      // supernodes: chains of single children with (almost) the same
+      // structure, the columns of a supernode are stored as a dense trapezoid
+      _supernodes.clear();
+      std::vector<int> supernodeOf(numBlocks);
+      int structureBlocks = 0;
+      for (int j = 0; j < numBlocks; ++j) {
+        bool merge = false;
+        if (j > 0 && parentOrder[j - 1] == j && numChildren[j] == 1) {
+          const int numCols = j - _supernodes.back().firstBlock + 1;
+          const int trueBlocks = structureBlocks + structure[j].size();
+          const int denseBlocks = numCols * (numCols - 1) / 2 + numCols * structure[j].size();
+          const int zeroBlocks = denseBlocks - trueBlocks;
+          merge = zeroBlocks <= RelaxedBlocks || 10 * zeroBlocks <= denseBlocks;
+        }
+        if (! merge) {
+          _supernodes.push_back(Supernode());
+          _supernodes.back().firstBlock = j;
+          structureBlocks = 0;
+        }
+        _supernodes.back().lastBlock = j;
+        structureBlocks += structure[j].size();
+        supernodeOf[j] = _supernodes.size() - 1;
+      }
+
+      for (size_t s = 0; s < _supernodes.size(); ++s) {
+        Supernode& sn = _supernodes[s];
+        sn.firstCol = blockBase[sn.firstBlock];
+        sn.numCols = blockBase[sn.lastBlock + 1] - sn.firstCol;
+        const std::vector<int>& st = structure[sn.lastBlock];
+        for (size_t n = 0; n < st.size(); ++n)
+          for (int r = blockBase[st[n]]; r < blockBase[st[n] + 1]; ++r)
+            sn.rows.push_back(r);
+        sn.parent = parentOrder[sn.lastBlock] == -1 ? -1 : supernodeOf[parentOrder[sn.lastBlock]];
+        if (sn.parent != -1)
+          _supernodes[sn.parent].children.push_back(s);
+      }
+
+      // positions of the update matrices in the fronts of the parents
+      for (size_t s = 0; s < _supernodes.size(); ++s) {
+        Supernode& sn = _supernodes[s];
+        sn.parentMap.resize(sn.rows.size());
+        if (sn.parent == -1)
+          continue;
+        for (size_t i = 0; i < sn.rows.size(); ++i)
+          sn.parentMap[i] = frontIndex(_supernodes[sn.parent], sn.rows[i]);
+      }
+
+      // positions of the blocks of A in the fronts
+      _entries.clear();
+      for (auto& sn : _supernodes)
+        sn.entries.clear();
+      for (int c = 0; c < numBlocks; ++c) {
+        const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+        for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+          const int r = it->first;
+          if (r > c)
+            break;
+          const int pr = inverse[r], pc = inverse[c];
+          const int lowRow = std::max(pr, pc), lowCol = std::min(pr, pc);
+          Supernode& sn = _supernodes[supernodeOf[lowCol]];
+          Entry e;
+          e.row = frontIndex(sn, blockBase[lowRow]);
+          e.col = blockBase[lowCol] - sn.firstCol;
+          e.transposed = pr < pc;
+          sn.entries.push_back(_entries.size());
+          _entries.push_back(e);
+        }
+      }
+
+      // supernodes that can be factorized at the same time
+      std::vector<int> level(_supernodes.size(), 0);
+      _levels.clear();
+      for (size_t s = 0; s < _supernodes.size(); ++s) {
+        const Supernode& sn = _supernodes[s];
+        for (size_t c = 0; c < sn.children.size(); ++c)
+          level[s] = std::max(level[s], level[sn.children[c]] + 1);
+        if (level[s] >= static_cast<int>(_levels.size()))
+          _levels.resize(level[s] + 1);
+        _levels[level[s]].push_back(s);
+      }
+
+      _fronts.clear();
+      _fronts.resize(_supernodes.size());
+      _factors.clear();
+      _factors.resize(_supernodes.size());
+
+      G2OBatchStatistics* globalStats = G2OBatchStatistics::globalStats();
+      if (globalStats)
+        globalStats->timeSymbolicDecomposition = get_monotonic_time() - t;
+    }
+
+    //! position of the scalar row r (in elimination order) in the front of sn
+    static int frontIndex(const Supernode& sn, int r)
+    {
+      if (r >= sn.firstCol && r < sn.firstCol + sn.numCols)
+        return r - sn.firstCol;
+      std::vector<int>::const_iterator it = std::lower_bound(sn.rows.begin(), sn.rows.end(), r);
+      assert(it != sn.rows.end() && *it == r && "row not in the structure of the supernode");
+      return sn.numCols + (it - sn.rows.begin());
+    }
+
+    bool factorize(const SparseBlockMatrix<MatrixType>& A)
+    {
+      _blocks.clear();
+      for (size_t c = 0; c < A.blockCols().size(); ++c) {
+        const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+        for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+          if (it->first > static_cast<int>(c))
+            break;
+          _blocks.push_back(it->second);
+        }
+      }
+      assert(_blocks.size() == _entries.size() && "the pattern of A changed without calling init()");
+
+      std::atomic<bool> ok(true);
+      for (size_t l = 0; l < _levels.size() && ok; ++l) {
+        const std::vector<int>& level = _levels[l];
+        parallel(level.size(), [&](int i) {
+          if (! factorizeSupernode(level[i]))
+            ok = false;
+        });
+      }
+
+      for (size_t s = 0; s < _fronts.size(); ++s)
+        _fronts[s].resize(0, 0);
+      return ok;
+    }
+
+    bool factorizeSupernode(int s)
+    {
+      const Supernode& sn = _supernodes[s];
+      const int n = sn.numCols;
+      const int m = sn.rows.size();
+      MatrixXD& F = _fronts[s];
+      F.setZero(n + m, n + m);
+
+      // blocks of A, only the lower triangle of the front is used
+      for (size_t k = 0; k < sn.entries.size(); ++k) {
+        const Entry& e = _entries[sn.entries[k]];
+        const MatrixType& B = *_blocks[sn.entries[k]];
+        if (e.transposed)
+          F.block(e.row, e.col, B.cols(), B.rows()) += B.transpose();
+        else
+          F.block(e.row, e.col, B.rows(), B.cols()) += B;
+      }
+
+      // extend-add of the update matrices of the children
+      for (size_t c = 0; c < sn.children.size(); ++c) {
+        const Supernode& child = _supernodes[sn.children[c]];
+        MatrixXD& childFront = _fronts[sn.children[c]];
+        const int mc = child.rows.size();
+        const int base = child.numCols;
+        for (int j = 0; j < mc; ++j) {
+          const int fj = child.parentMap[j];
+          for (int i = j; i < mc; ++i)
+            F(child.parentMap[i], fj) += childFront(base + i, base + j);
+        }
+        childFront.resize(0, 0);
+      }
+
+      // blocked right-looking Cholesky of the first n columns, the rest of
+      // the trailing matrix becomes the update matrix for the parent
+      const int N = n + m;
+      for (int k0 = 0; k0 < n; k0 += PanelSize) {
+        const int w = std::min(PanelSize, n - k0);
+        {
+          Eigen::Ref<MatrixXD> D = F.block(k0, k0, w, w);
+          Eigen::LLT<Eigen::Ref<MatrixXD>, Eigen::Lower> llt(D);
+          if (llt.info() != Eigen::Success)
+            return false;
+        }
+        const int r0 = k0 + w;
+        const int numPanels = (N - r0 + PanelSize - 1) / PanelSize;
+        parallel(numPanels, [&](int p) {
+          const int i0 = r0 + p * PanelSize;
+          Eigen::Block<MatrixXD> B = F.block(i0, k0, std::min(PanelSize, N - i0), w);
+          F.block(k0, k0, w, w).template triangularView<Eigen::Lower>().transpose().template solveInPlace<Eigen::OnTheRight>(B);
+        });
+        parallel(numPanels, [&](int p) {
+          const int j0 = r0 + p * PanelSize;
+          const int h = std::min(PanelSize, N - j0);
+          F.block(j0, j0, N - j0, h).noalias() -= F.block(j0, k0, N - j0, w) * F.block(j0, k0, h, w).transpose();
+        });
+      }
+
+      _factors[s] = F.leftCols(n);
+      return true;
+    }
+};
+
+} // end namespace
+
+#endif
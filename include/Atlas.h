@@ -27,6 +27,8 @@
 #include "KannalaBrandt8.h"
 
 #include <set>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/export.hpp>
@@ -42,6 +44,9 @@ class KeyFrameDatabase;
 class Frame;
 class KannalaBrandt8;
 class Pinhole;
+class AtlasFile;
+class FrameTrajectory;
+class ThreadPool;
 
 //BOOST_CLASS_EXPORT_GUID(Pinhole, "Pinhole")
 //BOOST_CLASS_EXPORT_GUID(KannalaBrandt8, "KannalaBrandt8")
@@ -49,6 +54,7 @@ class Pinhole;
 class Atlas
 {
     friend class boost::serialization::access;
+    friend class AtlasFile;
 
     template<class Archive>
     void serialize(Archive &ar, const unsigned int version)
@@ -77,8 +83,25 @@ public:
     ~Atlas();
 
     void CreateNewMap();
+    // Loads pMap first if needed
     void ChangeMap(Map* pMap);
 
+    // Builds the keyframes and map points of a map that is still in the atlas file it was read from
+    // or evicted to, and replaces its place recognition entries with them. Does nothing if the map
+    // is loaded. Returns false if its data is corrupted, then the map is set bad.
+    bool LoadMap(Map* pMap);
+
+    // Keeps the keyframes and map points in memory under about nBytes by evicting the maps that
+    // have not been used for a while to files in strDirectory. 0 disables it.
+    void SetMemoryBudget(size_t nBytes, const std::string &strDirectory, ThreadPool* pThreadPool);
+    // Maps to evict for the budget to be met, least recently used first. The current map and the
+    // maps used during the last few keyframes are never evicted. The usage is only measured every
+    // few keyframes, in between nothing is returned. Called from a single thread.
+    std::vector<Map*> GetMapsToEvict();
+    // Stores the map in a file, drops its frames from pTrajectory and deletes its keyframes and map
+    // points. Place recognition keeps finding it, and LoadMap brings it back.
+    bool EvictMap(Map* pMap, FrameTrajectory* pTrajectory);
+
     unsigned long int GetLastInitKFid();
 
     void SetViewer(Viewer* pViewer);
@@ -124,6 +147,8 @@ public:
     bool isImuInitialized();
 
     // Function for garantee the correction of serialization of this object
+    // PreSave loads all the maps. After an AtlasFile::Load, PostLoad leaves the maps in the file and
+    // only adds their keyframes to the KeyFrameDatabase for place recognition.
     void PreSave();
     void PostLoad();
 
@@ -159,6 +184,29 @@ protected:
     KeyFrameDatabase* mpKeyFrameDB;
     ORBVocabulary* mpORBVocabulary;
 
+    // Maps whose keyframes and map points are in a file, each file is deleted when all its maps are loaded
+    std::map<Map*,std::shared_ptr<AtlasFile> > mmpUnloadedMaps;
+    std::mutex mMutexLoad;
+
+    // Memory budget (0 if disabled), directory of the evicted maps and KeyFrame::nNextId when each
+    // map stopped being the current one or was loaded
+    size_t mnMemoryBudget;
+    std::string mStrEvictionDir;
+    ThreadPool* mpThreadPool;
+    std::map<Map*,unsigned long> mmMapLastUse;
+    bool mbBudgetExceeded;
+
+    // Only used by GetMapsToEvict: KeyFrame::nNextId from which the usage is measured again, and the
+    // usage of the maps that are not the current one, measured again when their sizes change
+    struct MapUsage
+    {
+        unsigned long nKFs;
+        unsigned long nMPs;
+        size_t nBytes;
+    };
+    unsigned long mnNextBudgetCheck;
+    std::map<Map*,MapUsage> mmMapUsage;
+
     // Mutex
     std::mutex mMutexAtlas;
 
@@ -0,0 +1,426 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ATLASFILE_H
+#define ATLASFILE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <cstring>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3
+{
+
+class Atlas;
+class Map;
+class KeyFrame;
+class MapPoint;
+class GeometricCamera;
+class FeatureGrid;
+class KeyFrameDatabase;
+class ThreadPool;
+
+// Binary atlas file. The data that the boost serialization of the Atlas stores is kept in typed
+// contiguous arrays (sections): one record per map, keyframe and map point, the keyframe poses and
+// map point positions on their own, and pools with the variable length data (keypoints,
+// descriptors, ids, BoW vectors, grids...) that the records point into by element ranges.
+// A versioned header holds the offset and length of every section.
+// Saving lays out all the records first and then fills the pools in parallel through a shared
+// mapping of the file. Loading maps the file read-only, checks every range against its section and
+// the sizes and keypoint indices of the keyframe data against the keyframe, and builds the
+// keyframes and map points in parallel. Atlas::PreSave must be called before Save and
+// Atlas::PostLoad after Load.
+// Load only creates the maps: the file stays mapped, owned by the Atlas, and the keyframes and map
+// points of each map are built from it when the map is needed (Atlas::LoadMap). Until then only the
+// words of its keyframes are in the KeyFrameDatabase, for place recognition.
+// Store writes a single map in the same format to evict it from memory (see Atlas::EvictMap), and
+// UnloadMap deletes its objects, leaving the map as Load creates it.
+class AtlasFile
+{
+public:
+
+    // Whether filename starts with the header of this format
+    static bool IsAtlasFile(const std::string &filename);
+
+    // Writes filename.tmp and renames it over filename once it is synced
+    static bool Save(const std::string &filename, Atlas* pAtlas, const std::string &strVocabularyName,
+                     const std::string &strVocabularyChecksum, ThreadPool* pThreadPool);
+
+    // pAtlas must have been created with its default constructor
+    static bool Load(const std::string &filename, Atlas* pAtlas, std::string &strVocabularyName,
+                     std::string &strVocabularyChecksum, ThreadPool* pThreadPool);
+
+    // Writes pMap, ready for Map::PreSave, to a file that only lives as long as the returned object.
+    // Returns NULL if the file could not be created.
+    static AtlasFile* Store(const std::string &filename, Map* pMap, ThreadPool* pThreadPool);
+
+    ~AtlasFile();
+
+    // Adds the keyframes of a map still in the file to the database as stored entries
+    bool AddPlaceRecognitionSummary(Map* pMap, KeyFrameDatabase* pKFDB);
+
+    // Builds the keyframes and map points of a map in its backup vectors, ready for Map::PostLoad
+    bool LoadMap(Map* pMap);
+
+    // Deletes the keyframes and map points of a map saved in the file. Map::mMutexMapUpdate must be locked.
+    void UnloadMap(Map* pMap);
+
+protected:
+
+    static const uint32_t VERSION = 1;
+    static const uint32_t ENDIANNESS = 0x01020304;
+
+    enum eSection
+    {
+        ATLAS=0,
+        CAMERAS,
+        MAPS,
+        MAP_MEMBERS,        // indices of the keyframes and map points of each map
+        KEYFRAMES,
+        KEYFRAME_POSES,
+        KEYFRAME_IMU,
+        MAPPOINTS,
+        MAPPOINT_POSITIONS,
+        OBSERVATIONS,
+        FLOATS,
+        INTS,
+        IDS,
+        BYTES,              // matrix data (descriptors, distortion)
+        KEYPOINTS,
+        CONNECTIONS,
+        GRID_CELLS,
+        GRID_ENTRIES,
+        WORDS,
+        FEATURES,
+        IMU_MEASUREMENTS,
+        NUM_SECTIONS
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t endianness;
+        uint64_t fileSize;
+        char vocabularyName[256];
+        char vocabularyChecksum[64];
+        uint64_t elementSize[NUM_SECTIONS];
+        uint64_t sectionOffset[NUM_SECTIONS];
+        uint64_t sectionCount[NUM_SECTIONS]; // in elements
+    };
+
+    // Elements [begin, begin+count) of a section
+    struct Range
+    {
+        uint64_t begin;
+        uint64_t count;
+    };
+
+    // Sophus::SE3f storage: quaternion (x,y,z,w) and translation
+    struct SE3Record
+    {
+        float data[7];
+    };
+
+    struct MatRecord
+    {
+        int32_t rows;
+        int32_t cols;
+        int32_t type;
+        int32_t pad;
+        Range data; // BYTES
+    };
+
+    struct GridRecord
+    {
+        int32_t nCols;
+        int32_t nRows;
+        Range cells;   // GRID_CELLS
+        Range entries; // GRID_ENTRIES
+    };
+
+    struct AtlasRecord
+    {
+        uint64_t nNextMapId;
+        uint64_t nNextFrameId;
+        uint64_t nNextKeyFrameId;
+        uint64_t nNextMapPointId;
+        uint64_t nLastInitKFidMap;
+        uint32_t nNextCameraId;
+        uint32_t pad;
+    };
+
+    struct CameraRecord
+    {
+        uint32_t nId;
+        uint32_t nType;
+        float precision; // fisheye only
+        uint32_t pad;
+        Range parameters; // FLOATS
+    };
+
+    struct MapRecord
+    {
+        uint64_t nId;
+        uint64_t nInitKFid;
+        uint64_t nMaxKFid;
+        uint64_t nBackupKFinitialID;
+        uint64_t nBackupKFlowerID;
+        int32_t nBigChangeIdx;
+        uint8_t bImuInitialized;
+        uint8_t bIsInertial;
+        uint8_t bIMU_BA1;
+        uint8_t bIMU_BA2;
+        Range keyFrames;  // MAP_MEMBERS
+        Range mapPoints;  // MAP_MEMBERS
+        Range originIds;  // IDS
+    };
+
+    struct KeyFrameRecord
+    {
+        uint64_t nId;
+        uint64_t nFrameId;
+        double timeStamp;
+        int32_t nGridCols;
+        int32_t nGridRows;
+        float gridElementWidthInv;
+        float gridElementHeightInv;
+        float scale;
+        float fx, fy, invfx, invfy, cx, cy, bf, b, thDepth;
+        int32_t N;
+        int32_t nScaleLevels;
+        float scaleFactor;
+        float logScaleFactor;
+        int32_t nMinX, nMinY, nMaxX, nMaxY;
+        float K[9];
+        SE3Record Tcp;
+        SE3Record Tlr;
+        int64_t nParentId;
+        int64_t nPrevKFId;
+        int64_t nNextKFId;
+        uint32_t nOriginMapId;
+        uint32_t nCameraId;
+        uint32_t nCamera2Id;
+        int32_t NLeft;
+        int32_t NRight;
+        float halfBaseline;
+        float imuBias[6];
+        SE3Record imuTcb;
+        SE3Record imuTbc;
+        float imuCov[6];
+        float imuCovWalk[6];
+        float Vw[3];
+        float Owb[3];
+        uint8_t bFirstConnection;
+        uint8_t bNotErase;
+        uint8_t bToBeErased;
+        uint8_t bBad;
+        uint8_t bImu;
+        uint8_t bHasVelocity;
+        uint8_t bImuCalibSet;
+        uint8_t pad;
+        MatRecord distCoef;
+        MatRecord descriptors;
+        Range uRight, depth, scaleFactors, levelSigma2, invLevelSigma2; // FLOATS
+        Range keys, keysUn, keysRight;                                  // KEYPOINTS
+        Range mapPointIds, childrenIds, loopEdgeIds, mergeEdgeIds;      // IDS
+        Range leftToRightMatch, rightToLeftMatch;                       // INTS
+        Range connections;
+        Range words;
+        Range features;
+        Range imuMeasurements;
+        GridRecord grid;
+        GridRecord gridRight;
+    };
+
+    // Preintegration of the keyframe, in KEYFRAME_IMU at the index of the keyframe
+    struct PreintegratedRecord
+    {
+        float dT;
+        float C[225];
+        float Info[225];
+        float Nga[6];
+        float NgaWalk[6];
+        float b[6];
+        float dR[9];
+        float dV[3];
+        float dP[3];
+        float JRg[9];
+        float JVg[9];
+        float JVa[9];
+        float JPg[9];
+        float JPa[9];
+        float avgA[3];
+        float avgW[3];
+        float bu[6];
+        float db[6];
+    };
+
+    struct MapPointRecord
+    {
+        uint64_t nId;
+        int64_t nFirstKFid;
+        int64_t nFirstFrame;
+        uint64_t nRefKFId;
+        int64_t nReplacedId;
+        int32_t nObs;
+        uint8_t bBad;
+        uint8_t pad[3];
+        float normal[3];
+        float minDistance;
+        float maxDistance;
+        float pad2;
+        MatRecord descriptor;
+        Range observations; // OBSERVATIONS
+    };
+
+    struct PositionRecord
+    {
+        float x, y, z;
+    };
+
+    struct KeyPointRecord
+    {
+        float x, y, size, angle, response;
+        int32_t octave;
+        int32_t classId;
+    };
+
+    struct ObservationRecord
+    {
+        uint64_t nKFId;
+        int32_t leftIndex;
+        int32_t rightIndex;
+    };
+
+    struct ConnectionRecord
+    {
+        uint64_t nKFId;
+        int32_t weight;
+        int32_t pad;
+    };
+
+    struct WordRecord
+    {
+        uint32_t nWordId;
+        uint32_t pad;
+        double value;
+    };
+
+    struct FeatureRecord
+    {
+        uint32_t nNodeId;
+        uint32_t nIndex;
+    };
+
+    struct ImuMeasurementRecord
+    {
+        float a[3];
+        float w[3];
+        float t;
+    };
+
+    AtlasFile();
+
+    static const size_t ElementSize[NUM_SECTIONS];
+
+    // Saving: fills the records and reserves the ranges of every object, then writes the data
+    void Layout(const std::vector<Map*> &vpMaps, const std::vector<GeometricCamera*> &vpCameras, unsigned long nLastInitKFidMap);
+    Range Reserve(int nSection, uint64_t count);
+    MatRecord ReserveMat(const cv::Mat &mat);
+    GridRecord ReserveGrid(const FeatureGrid &grid);
+    void LayoutKeyFrame(KeyFrame* pKF, KeyFrameRecord &record);
+    void LayoutMapPoint(MapPoint* pMP, MapPointRecord &record);
+
+    // Creates and maps filename with its final size, removing it if that fails
+    bool Create(const std::string &filename, const std::string &strVocabularyName, const std::string &strVocabularyChecksum);
+    void Write(ThreadPool* pThreadPool);
+    void WriteKeyFrame(KeyFrame* pKF, const KeyFrameRecord &record, PreintegratedRecord &imu);
+    void WriteMapPoint(MapPoint* pMP, const MapPointRecord &record);
+    void WriteMat(const cv::Mat &mat, const MatRecord &record);
+    void WriteGrid(const FeatureGrid &grid, const GridRecord &record);
+    static void WriteKeyPoints(const std::vector<cv::KeyPoint> &vKeys, KeyPointRecord* pRecords);
+
+    // Loading: maps the file and checks the header and the section bounds
+    bool Open(const std::string &filename);
+    bool ReadKeyFrame(KeyFrame* pKF, const KeyFrameRecord &record, const PreintegratedRecord &imu);
+    bool ReadMapPoint(MapPoint* pMP, const MapPointRecord &record);
+    bool ReadMat(const MatRecord &record, cv::Mat &mat);
+    // Checks the grid against the keyframe: nCols x nRows cells indexing nKeys keypoints
+    bool ReadGrid(const GridRecord &record, int nCols, int nRows, size_t nKeys, FeatureGrid &grid);
+    static bool ReadKeyPoints(const KeyPointRecord* pRecords, size_t n, int nLevels, std::vector<cv::KeyPoint> &vKeys);
+
+    bool IsValid(int nSection, const Range &range) const
+    {
+        return range.begin<=mvCount[nSection] && range.count<=mvCount[nSection]-range.begin;
+    }
+
+    template<class T>
+    T* Data(int nSection) const
+    {
+        return reinterpret_cast<T*>(mpData+mvOffset[nSection]);
+    }
+
+    // Copies between a range of a section and an array of elements of the same size
+    template<class T>
+    void Put(int nSection, const Range &range, const T* pSrc)
+    {
+        if(range.count>0)
+            memcpy(mpData+mvOffset[nSection]+range.begin*ElementSize[nSection], pSrc, range.count*ElementSize[nSection]);
+    }
+
+    template<class T>
+    bool Get(int nSection, const Range &range, std::vector<T> &v) const
+    {
+        if(!IsValid(nSection,range))
+            return false;
+        v.resize(range.count);
+        if(range.count>0)
+            memcpy(v.data(), mpData+mvOffset[nSection]+range.begin*ElementSize[nSection], range.count*ElementSize[nSection]);
+        return true;
+    }
+
+    std::vector<uint64_t> mvCount;
+    std::vector<uint64_t> mvOffset;
+
+    // Objects saved or loaded, in the order of their records (NULL if not loaded yet)
+    std::vector<Map*> mvpMaps;
+    std::vector<KeyFrame*> mvpKeyFrames;
+    std::vector<MapPoint*> mvpMapPoints;
+    std::vector<GeometricCamera*> mvpCameras;
+
+    AtlasRecord mAtlasRecord;
+    std::vector<CameraRecord> mvCameraRecords;
+    std::vector<MapRecord> mvMapRecords;
+    std::vector<uint64_t> mvMapMembers;
+    std::vector<KeyFrameRecord> mvKeyFrameRecords;
+    std::vector<MapPointRecord> mvMapPointRecords;
+
+    ThreadPool* mpThreadPool;
+
+    unsigned char* mpData;
+    size_t mnSize;
+};
+
+} //namespace ORB_SLAM
+
+#endif // ATLASFILE_H
@@ -40,9 +40,13 @@
 #include "GeometricTools.h"
 
 namespace ORB_SLAM3 {
+    class ThreadPool;
+    class AtlasFile;
+
     class GeometricCamera {
 
         friend class boost::serialization::access;
+        friend class AtlasFile;
 
         template<class Archive>
         void serialize(Archive& ar, const unsigned int version)
@@ -71,7 +75,7 @@ namespace ORB_SLAM3 {
         virtual Eigen::Matrix<double,2,3> projectJac(const Eigen::Vector3d& v3D) = 0;
 
         virtual bool ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
-                                             Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated) = 0;
+                                             Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated, ThreadPool* pThreadPool) = 0;
 
         virtual cv::Mat toK() = 0;
         virtual Eigen::Matrix3f toK_() = 0;
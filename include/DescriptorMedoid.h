@@ -0,0 +1,110 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DESCRIPTORMEDOID_H
+#define DESCRIPTORMEDOID_H
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <cstddef>
+
+namespace ORB_SLAM3
+{
+
+class KeyFrame;
+
+// Descriptors observed for one MapPoint and the Hamming distances between them.
+// While there are at most MAX_CACHED descriptors the distances are kept in a packed triangular
+// matrix, updated when a single observation is added or removed (N distances), so choosing the
+// most distinctive descriptor does not recompute the N x N matrix. Points observed more often
+// drop the matrix and compute the distances when asked, as MapPoint did before, which bounds the
+// memory of the cache to under 2 KB per point.
+// The descriptors are not copied: they point into the descriptors of the keyframes, which never
+// change and outlive the observation.
+class DescriptorMedoid
+{
+public:
+
+    static const int MAX_CACHED = 32;
+
+    DescriptorMedoid();
+
+    // Adds the 32-byte descriptor of keypoint idx in pKF
+    void Add(KeyFrame* pKF, int idx, const uint8_t* pDesc);
+
+    // Removes the descriptor of keypoint idx in pKF, or all the descriptors of pKF if idx is -1
+    void Remove(KeyFrame* pKF, int idx=-1);
+
+    void Clear();
+
+    int size() const {return mvKeys.size();}
+
+    // Bytes allocated for the observations and the distance matrix
+    size_t GetMemoryUsage() const
+    {
+        return mvKeys.capacity()*sizeof(Key)+mvDistances.capacity()*sizeof(uint16_t);
+    }
+
+    // Index of the descriptor with least median distance to the rest, ignoring the keyframes
+    // in vpExcluded (sorted by pointer). Ties go to the smallest (keyframe, index) pair, that is,
+    // to the first one in observation order. Returns -1 if no descriptor is left.
+    int Medoid(const std::vector<KeyFrame*> &vpExcluded) const;
+
+    const uint8_t* Descriptor(int i) const {return mvKeys[i].pDesc;}
+
+protected:
+
+    struct Key
+    {
+        KeyFrame* pKF;
+        int idx;
+        const uint8_t* pDesc;
+    };
+
+    // Distance between descriptors i and j, only while the matrix is cached
+    uint16_t Distance(int i, int j) const
+    {
+        if(i==j)
+            return 0;
+        if(i<j)
+            std::swap(i,j);
+        return mvDistances[i*(i-1)/2+j];
+    }
+
+    // Appends the row of the last descriptor to the matrix
+    void AddRow();
+
+    // Builds the matrix again, after the number of descriptors falls back to MAX_CACHED
+    void BuildMatrix();
+
+    void RemoveAt(int i);
+
+    // Keyframe, keypoint index and descriptor of each observation
+    std::vector<Key> mvKeys;
+
+    // Strict lower triangle of the distance matrix by rows, (i,j) with i>j at i*(i-1)/2+j.
+    // Empty while there are more than MAX_CACHED descriptors.
+    std::vector<uint16_t> mvDistances;
+    bool mbCached;
+};
+
+} //namespace ORB_SLAM
+
+#endif // DESCRIPTORMEDOID_H
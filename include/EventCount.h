@@ -0,0 +1,70 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef EVENTCOUNT_H
+#define EVENTCOUNT_H
+
+#include <mutex>
+#include <condition_variable>
+
+namespace ORB_SLAM3
+{
+
+// Lets a thread sleep until another thread changes the state it is waiting on. The state keeps
+// its own flags and mutexes, writers call Notify after every change and waiters use WaitUntil.
+// Reading the epoch before checking the state means that a change made between the check and
+// the wait is never missed.
+class EventCount
+{
+public:
+
+    EventCount();
+
+    // Wakes up all the waiting threads
+    void Notify();
+
+    unsigned long Epoch();
+
+    // Blocks until Notify is called after nEpoch was read
+    void Wait(unsigned long nEpoch);
+
+    // Blocks until pred() holds. pred is evaluated without the internal lock, so it can take
+    // the locks of the state it checks.
+    template<class Predicate>
+    void WaitUntil(Predicate pred)
+    {
+        while(true)
+        {
+            const unsigned long nEpoch = Epoch();
+            if(pred())
+                return;
+            Wait(nEpoch);
+        }
+    }
+
+private:
+
+    std::mutex mMutex;
+    std::condition_variable mcv;
+    unsigned long mnEpoch;
+};
+
+} //namespace ORB_SLAM
+
+#endif // EVENTCOUNT_H
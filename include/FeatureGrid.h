@@ -0,0 +1,104 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FEATUREGRID_H
+#define FEATUREGRID_H
+
+#include <vector>
+#include <cstddef>
+
+#include <opencv2/core/core.hpp>
+
+#include <boost/serialization/serialization.hpp>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/vector.hpp>
+
+namespace ORB_SLAM3
+{
+
+// Keypoints binned in a regular image grid, stored in compressed sparse row form:
+// the entries of cell c (c = x*nRows + y) are mvEntries[mvCellStart[c] .. mvCellStart[c+1]).
+// The whole grid lives in two arrays, so copying it between Frames and KeyFrames is cheap.
+class FeatureGrid
+{
+public:
+
+    // Keypoint coordinates and octave are stored next to the index, so the
+    // radius and scale tests of an area query read contiguous memory.
+    struct Entry
+    {
+        float x;
+        float y;
+        int octave;
+        unsigned int idx;
+
+        template<class Archive>
+        void serialize(Archive& ar, const unsigned int version)
+        {
+            ar & x;
+            ar & y;
+            ar & octave;
+            ar & idx;
+        }
+    };
+
+    FeatureGrid();
+
+    // Bins vKeys[i] in cell vCells[i] (x*nRows + y) and stores i as its index.
+    // Keypoints with a negative cell are left out. Indices are kept in ascending order in each cell.
+    void Build(const int nCols, const int nRows, const std::vector<cv::KeyPoint> &vKeys, const std::vector<int> &vCells);
+
+    // Appends to vIndices the keypoints in cells [nMinCellX,nMaxCellX]x[nMinCellY,nMaxCellY] that are
+    // closer than r to (x,y) in both axes. The octave is checked as in Frame::GetFeaturesInArea.
+    void GetFeaturesInArea(const int nMinCellX, const int nMaxCellX, const int nMinCellY, const int nMaxCellY,
+                           const float &x, const float &y, const float &r, const int minLevel, const int maxLevel,
+                           std::vector<size_t> &vIndices) const;
+
+    bool empty() const {return mvEntries.empty();}
+    size_t size() const {return mvEntries.size();}
+
+    // Bytes allocated by the grid arrays
+    size_t GetMemoryUsage() const {return mvCellStart.capacity()*sizeof(unsigned int)+mvEntries.capacity()*sizeof(Entry);}
+
+    void clear();
+
+protected:
+
+    friend class boost::serialization::access;
+    friend class AtlasFile;
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        ar & mnCols;
+        ar & mnRows;
+        ar & mvCellStart;
+        ar & mvEntries;
+    }
+
+    int mnCols;
+    int mnRows;
+
+    // Offset of the first entry of each cell, plus a final sentinel (empty if the grid is not built)
+    std::vector<unsigned int> mvCellStart;
+    std::vector<Entry> mvEntries;
+};
+
+} //namespace ORB_SLAM
+
+#endif // FEATUREGRID_H
@@ -29,6 +29,7 @@
 
 #include "ImuTypes.h"
 #include "ORBVocabulary.h"
+#include "FeatureGrid.h"
 
 #include "Converter.h"
 #include "Settings.h"
@@ -48,6 +49,7 @@ class MapPoint;
 class KeyFrame;
 class ConstraintPoseImu;
 class GeometricCamera;
+class ThreadPool;
 class ORBextractor;
 
 class Frame
@@ -59,7 +61,7 @@ public:
     Frame(const Frame &frame);
 
     // Constructor for stereo cameras.
-    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib());
+    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib(), ThreadPool* pThreadPool = static_cast<ThreadPool*>(NULL));
 
     // Constructor for RGB-D cameras.
     Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib());
@@ -74,7 +76,13 @@ public:
     void ExtractORB(int flag, const cv::Mat &im, const int x0, const int x1);
 
     // Compute Bag of Words representation.
-    void ComputeBoW();
+    void ComputeBoW(ThreadPool* pThreadPool = static_cast<ThreadPool*>(NULL));
+
+    // Bag of Words of a set of descriptors (one per row), shared with KeyFrame.
+    // Chunks of features are looked up in the vocabulary in parallel when a pool is given,
+    // the vectors are then filled in feature order, so the result does not depend on the pool.
+    static void ComputeBoW(ORBVocabulary* pVoc, const cv::Mat &descriptors, DBoW2::BowVector &bowVec,
+                           DBoW2::FeatureVector &featVec, ThreadPool* pThreadPool);
 
     // Set the camera pose. (Imu pose is not modified!)
     void SetPose(const Sophus::SE3<float> &Tcw);
@@ -113,7 +121,8 @@ public:
 
     // Search a match for each keypoint in the left image to a keypoint in the right image.
     // If there is a match, depth is computed and the right coordinate associated to the left keypoint is stored.
-    void ComputeStereoMatches();
+    // Left keypoints are processed in parallel chunks when a thread pool is given.
+    void ComputeStereoMatches(ThreadPool* pThreadPool = static_cast<ThreadPool*>(NULL));
 
     // Associate a "right" coordinate to a keypoint if there is valid depth in the depthmap.
     void ComputeStereoFromRGBD(const cv::Mat &imDepth);
@@ -249,7 +258,7 @@ public:
     // Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
     static float mfGridElementWidthInv;
     static float mfGridElementHeightInv;
-    std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    FeatureGrid mGrid;
 
     IMU::Bias mPredBias;
 
@@ -316,6 +325,11 @@ private:
     // Assign keypoints to the grid for speed up feature matching (called in the constructor).
     void AssignFeaturesToGrid();
 
+    // SAD between the (2w+1)x(2w+1) window of imL centred at (uL,vL) and the windows of imR centred at
+    // (uR0+inc,vL) for inc in [-L,L]. vDists[L+inc] receives each distance (used by ComputeStereoMatches).
+    static void ComputeSlidingWindowSAD(const cv::Mat &imL, const cv::Mat &imR, const int uL, const int vL, const int uR0,
+                                        const int w, const int L, int* vDists);
+
     bool mbIsSet;
 
     bool mbImuPreintegrated;
@@ -341,9 +355,9 @@ public:
     std::vector<Eigen::Vector3f> mvStereo3Dpoints;
 
     //Grid for the right image
-    std::vector<std::size_t> mGridRight[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    FeatureGrid mGridRight;
 
-    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib());
+    Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF = static_cast<Frame*>(NULL), const IMU::Calib &ImuCalib = IMU::Calib(), ThreadPool* pThreadPool = static_cast<ThreadPool*>(NULL));
 
     //Stereo fisheye
     void ComputeStereoFishEyeMatches();
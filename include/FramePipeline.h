@@ -0,0 +1,124 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include <list>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <future>
+
+#include <opencv2/core/core.hpp>
+#include <sophus/se3.hpp>
+
+#include "Frame.h"
+#include "ImuTypes.h"
+#include "EventCount.h"
+
+namespace ORB_SLAM3
+{
+
+class System;
+
+// A frame given to System::Track*Async, from the moment it is queued until its pose is delivered
+struct QueuedFrame
+{
+    QueuedFrame(): timestamp(0), bPrepared(false), bIniExtractor(false) {}
+
+    // Rectified and resized input, owned by the queue
+    cv::Mat im;
+    cv::Mat imRight;
+    cv::Mat imDepth;
+    double timestamp;
+    std::vector<IMU::Point> vImuMeas;
+    std::string filename;
+
+    // Built by the front end
+    bool bPrepared;
+    bool bIniExtractor; // monocular only, see Tracking::UseIniExtractor
+    Frame frame;
+    cv::Mat imGray;
+
+    std::promise<Sophus::SE3f> promise;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+// Asynchronous input of System. Frames are queued and tracked in order by a tracking thread,
+// while a front end thread builds the next frame (color conversion, ORB extraction, stereo matching),
+// so the extraction of frame N+1 overlaps the tracking of frame N.
+// Mode changes and resets requested through System are applied between two frames as in the
+// synchronous calls: while one is pending the next frame is only built after the current one
+// is tracked and the request applied. Requests made while a frame is tracked (Tracking resetting
+// the active map) are applied before the next one, which is then built again.
+class FramePipeline
+{
+public:
+
+    // Push blocks while nMaxQueued frames are waiting to be built
+    FramePipeline(System* pSystem, size_t nMaxQueued);
+    // Tracks the frames still queued and stops the threads
+    ~FramePipeline();
+
+    // Takes ownership of pFrame. Frames must be pushed from a single thread.
+    std::future<Sophus::SE3f> Push(QueuedFrame* pFrame);
+
+    // Blocks until all the frames pushed have been tracked
+    void Flush();
+
+protected:
+
+    void RunTracking();
+    void RunFrontEnd();
+
+    // Builds pFrame on the front end thread while the caller tracks pTrackFrame
+    void PrepareWhileTracking(QueuedFrame* pFrame, QueuedFrame* pTrackFrame);
+
+    // Applies the mode changes and resets requested while the previous frame was tracked
+    // (Tracking asks for them from Track), and has pFrame built again if they were pending
+    void ApplyRequests(QueuedFrame* pFrame);
+
+    void Track(QueuedFrame* pFrame);
+
+    System* mpSystem;
+    size_t mnMaxQueued;
+
+    // Frames not taken yet by the tracking thread, and frames pushed but not tracked
+    std::list<QueuedFrame*> mlpQueue;
+    size_t mnPending;
+    bool mbFinishRequested;
+    std::mutex mMutexQueue;
+    EventCount mQueueChanged;
+
+    // Frame handed to the front end, reset to NULL when built
+    QueuedFrame* mpFrontEndFrame;
+    bool mbFinishFrontEnd;
+    std::mutex mMutexFrontEnd;
+    EventCount mFrontEndChanged;
+
+    std::thread* mptTracking;
+    std::thread* mptFrontEnd;
+};
+
+} //namespace ORB_SLAM
+
+#endif // FRAMEPIPELINE_H
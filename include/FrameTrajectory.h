@@ -0,0 +1,112 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FRAMETRAJECTORY_H
+#define FRAMETRAJECTORY_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <mutex>
+
+#include <sophus/se3.hpp>
+
+namespace ORB_SLAM3
+{
+
+class KeyFrame;
+class Map;
+
+// Pose of a tracked frame relative to its reference keyframe (which is optimized by BA and pose graph)
+struct FramePose
+{
+    Sophus::SE3f Tcr;
+    KeyFrame* pReferenceKF;
+    double timestamp;
+    bool bLost;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+// Poses of all the tracked frames, stored in fixed-size contiguous chunks so that appending
+// neither allocates per frame nor moves the frames already stored.
+// Frames are indexed from the first one since the last Clear. Optionally the frames older than
+// a lag can be streamed to a file while the system runs, and their chunks released afterwards.
+// Accesses from several threads must hold mMutexTrajectory.
+class FrameTrajectory
+{
+public:
+
+    FrameTrajectory();
+    ~FrameTrajectory();
+
+    void PushBack(const Sophus::SE3f &Tcr, KeyFrame* pReferenceKF, double timestamp, bool bLost);
+
+    // Frames in [Begin(),size()) are in memory, the previous ones were released after streaming them
+    size_t Begin() const {return mnFirstChunk*ChunkSize;}
+    size_t size() const {return mnEnd;}
+    bool empty() const {return mnEnd==Begin();}
+
+    FramePose& operator[](size_t i) {return mvpChunks[i/ChunkSize-mnFirstChunk][i%ChunkSize];}
+    const FramePose& operator[](size_t i) const {return mvpChunks[i/ChunkSize-mnFirstChunk][i%ChunkSize];}
+    FramePose& back() {return (*this)[mnEnd-1];}
+
+    // Drops all the frames, also those not streamed yet. An open stream keeps writing the new ones.
+    void Clear();
+
+    // Writes every frame at least nLag frames old to filename in TUM format (timestamp, twc, qwc) as
+    // soon as it is tracked, with the pose of its reference keyframe at that moment. Lost frames and
+    // frames whose keyframe is gone are skipped. If bRelease is set, the written frames are dropped
+    // from memory and are no longer available to System::SaveTrajectory*.
+    bool OpenStream(const std::string &filename, int nLag, bool bRelease);
+    // Writes the remaining frames and closes the file
+    void CloseStream();
+
+    // Writes the frames that became old enough, called by Tracking after each frame
+    void Stream();
+    // Writes all the frames, needed before their keyframes are deleted
+    void FlushStream();
+
+    // Marks as lost the frames whose reference keyframe is in pMap, or was culled and its
+    // spanning tree leads to pMap, writing them to the stream first. Needed before the keyframes
+    // of pMap are deleted.
+    void ForgetMap(Map* pMap);
+
+    std::mutex mMutexTrajectory;
+
+protected:
+
+    static const size_t ChunkSize = 4096;
+
+    void WriteStream(size_t nEnd);
+    void ReleaseChunks(size_t nEnd);
+
+    std::vector<FramePose*> mvpChunks;
+    size_t mnFirstChunk;
+    size_t mnEnd;
+
+    std::ofstream mStream;
+    size_t mnStreamed;
+    size_t mnLag;
+    bool mbRelease;
+};
+
+} //namespace ORB_SLAM
+
+#endif // FRAMETRAJECTORY_H
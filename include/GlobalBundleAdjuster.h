@@ -0,0 +1,138 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef GLOBALBUNDLEADJUSTER_H
+#define GLOBALBUNDLEADJUSTER_H
+
+#include <map>
+#include <vector>
+#include <mutex>
+
+#include "Thirdparty/g2o/g2o/core/sparse_optimizer.h"
+#include "Thirdparty/g2o/g2o/core/block_solver.h"
+#include "Thirdparty/g2o/g2o/solvers/linear_solver_supernodal.h"
+#include "Thirdparty/g2o/g2o/types/types_six_dof_expmap.h"
+
+namespace ORB_SLAM3
+{
+
+class Map;
+class KeyFrame;
+class MapPoint;
+class ThreadPool;
+
+// Global bundle adjustment graph that is kept between runs. Each run patches the graph with the
+// keyframes, points and observations added or removed since the previous one, and only the
+// variables that changed (new, with new observations, or moved more than a relinearization
+// threshold by local BA or loop correction) are optimized together with the points they observe.
+// The rest of the keyframes stay fixed at their current pose. If too much of the map changed
+// the whole graph is optimized, as in Optimizer::GlobalBundleAdjustemnt.
+class GlobalBundleAdjuster
+{
+public:
+
+    GlobalBundleAdjuster();
+    ~GlobalBundleAdjuster();
+
+    void SetThreadPool(ThreadPool* pThreadPool);
+
+    // Brings the graph up to date with pMap and optimizes the part of it that changed.
+    // The results are left in mTcwGBA/mPosGBA with mnBAGlobalForKF=nLoopKF, like the non-robust
+    // Optimizer::GlobalBundleAdjustemnt. Returns false if it was stopped through pbStopFlag.
+    // Concurrent calls are serialized.
+    bool Run(Map* pMap, int nIterations, bool* pbStopFlag, unsigned long nLoopKF);
+
+    // Drops the graph, the next run starts from scratch
+    void Clear();
+
+    // Size of the last run
+    int GetNumOptimizedKeyFrames() const {return mnOptimizedKFs;}
+    int GetNumOptimizedMapPoints() const {return mnOptimizedMPs;}
+
+protected:
+
+    struct KeyFrameVertex
+    {
+        g2o::VertexSE3Expmap* pVertex;
+        KeyFrame* pKF; // only valid during a run
+        g2o::SE3Quat Tref; // pose at the last optimization of this keyframe
+        float medianDepth; // scene median depth at the last optimization of this keyframe
+        bool bDirty;
+        bool bSeen;
+    };
+
+    struct Observation
+    {
+        unsigned long nKFId;
+        int leftIndex;
+        int rightIndex;
+        g2o::OptimizableGraph::Edge* pEdge;
+        g2o::OptimizableGraph::Edge* pEdgeRight;
+    };
+
+    struct MapPointVertex
+    {
+        g2o::VertexSBAPointXYZ* pVertex;
+        MapPoint* pMP; // only valid during a run
+        Eigen::Vector3d Pref; // position at the last optimization of this point
+        std::vector<Observation> vObservations; // sorted by keyframe id
+        bool bDirty;
+        bool bSeen;
+    };
+
+    typedef std::map<unsigned long,KeyFrameVertex,std::less<unsigned long>,
+        Eigen::aligned_allocator<std::pair<const unsigned long,KeyFrameVertex> > > KeyFrameVertexMap;
+    typedef std::map<unsigned long,MapPointVertex> MapPointVertexMap;
+
+    void UpdateKeyFrames(Map* pMap);
+    void UpdateMapPoints(Map* pMap);
+    void UpdateObservations(MapPointVertex &mpv);
+
+    void AddEdges(MapPointVertex &mpv, Observation &obs, KeyFrame* pKF);
+    void RemoveEdges(Observation &obs);
+
+    void RemoveKeyFrame(KeyFrameVertexMap::iterator it);
+    void RemoveMapPoint(MapPointVertexMap::iterator it);
+
+    // Vertex ids of keyframes and points share the same space
+    static int KeyFrameVertexId(unsigned long nId) {return 2*nId;}
+    static int MapPointVertexId(unsigned long nId) {return 2*nId+1;}
+
+    g2o::SparseOptimizer* mpOptimizer;
+    g2o::LinearSolverSupernodal<g2o::BlockSolver_6_3::PoseMatrixType>* mpLinearSolver; // owned by mpOptimizer
+    ThreadPool* mpThreadPool;
+
+    KeyFrameVertexMap mmKeyFrames;
+    MapPointVertexMap mmMapPoints;
+
+    // Map the graph was built for. Only compared, never dereferenced.
+    Map* mpMap;
+
+    int mnOptimizedKFs;
+    int mnOptimizedMPs;
+
+    std::mutex mMutexRun;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} //namespace ORB_SLAM
+
+#endif // GLOBALBUNDLEADJUSTER_H
@@ -0,0 +1,70 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef HAMMINGDISTANCE_H
+#define HAMMINGDISTANCE_H
+
+#include<vector>
+#include<string>
+#include<cstddef>
+#include<stdint.h>
+#include<opencv2/core/core.hpp>
+
+namespace ORB_SLAM3
+{
+
+// Hamming distance between 256-bit ORB descriptors (32 bytes per row).
+// The kernel (scalar, POPCNT, AVX2 or AVX-512 VPOPCNTDQ) is chosen once at runtime
+// from the features reported by the CPU, so the same binary runs on every x86 target.
+class HammingDistance
+{
+public:
+
+    // Distance between two descriptors
+    static int Compute(const uint8_t* a, const uint8_t* b);
+
+    static inline int Compute(const cv::Mat &a, const cv::Mat &b)
+    {
+        return Compute(a.ptr<uint8_t>(), b.ptr<uint8_t>());
+    }
+
+    // Distances between one query descriptor and the rows vIndices of a descriptor matrix.
+    // vDist is resized to vIndices.size() and vDist[i] is the distance to row vIndices[i].
+    static void Compute(const cv::Mat &query, const cv::Mat &descriptors,
+                        const std::vector<size_t> &vIndices, std::vector<int> &vDist);
+    static void Compute(const cv::Mat &query, const cv::Mat &descriptors,
+                        const std::vector<unsigned int> &vIndices, std::vector<int> &vDist);
+    static void Compute(const cv::Mat &query, const cv::Mat &descriptors,
+                        const unsigned int* pIndices, size_t n, std::vector<int> &vDist);
+
+    // Distances between one query descriptor and n descriptors stored one after the other.
+    // vDist must have room for n values.
+    static void Compute(const uint8_t* query, const uint8_t* descriptors, int n, int* vDist);
+
+    // Name of the kernel selected for this CPU ("scalar", "popcnt", "avx2", "avx512")
+    static const char* KernelName();
+
+    // Replaces the selected kernel by the one named, if this CPU supports it.
+    // Meant for benchmarks and checks, it must not run while distances are being computed.
+    static bool SelectKernel(const std::string &name);
+};
+
+}// namespace ORB_SLAM
+
+#endif // HAMMINGDISTANCE_H
@@ -37,6 +37,8 @@
 namespace ORB_SLAM3
 {
 
+class AtlasFile;
+
 namespace IMU
 {
 
@@ -143,6 +145,7 @@ public:
 class Preintegrated
 {
     friend class boost::serialization::access;
+    friend class ORB_SLAM3::AtlasFile;
     template<class Archive>
     void serialize(Archive & ar, const unsigned int version)
     {
@@ -169,6 +172,24 @@ class Preintegrated
     }
 
 public:
+    // Acceleration, angular velocity and integration time of one integration step
+    struct integrable
+    {
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+        {
+            ar & boost::serialization::make_array(a.data(), a.size());
+            ar & boost::serialization::make_array(w.data(), w.size());
+            ar & t;
+        }
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        integrable(){}
+        integrable(const Eigen::Vector3f &a_, const Eigen::Vector3f &w_ , const float &t_):a(a_),w(w_),t(t_){}
+        Eigen::Vector3f a, w;
+        float t;
+    };
+
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     Preintegrated(const Bias &b_, const Calib &calib);
     Preintegrated(Preintegrated* pImuPre);
@@ -177,6 +198,8 @@ public:
     void CopyFrom(Preintegrated* pImuPre);
     void Initialize(const Bias &b_);
     void IntegrateNewMeasurement(const Eigen::Vector3f &acceleration, const Eigen::Vector3f &angVel, const float &dt);
+    // Integrates n consecutive steps, as calling IntegrateNewMeasurement for each of them
+    void IntegrateNewMeasurements(const integrable* pMeasurements, const size_t n);
     void Reintegrate();
     void MergePrevious(Preintegrated* pPrev);
     void SetNewBias(const Bias &bu_);
@@ -228,25 +251,11 @@ private:
     // This is used to compute the updated values of the preintegration
     Eigen::Matrix<float,6,1> db;
 
-    struct integrable
-    {
-        template<class Archive>
-        void serialize(Archive & ar, const unsigned int version)
-        {
-            ar & boost::serialization::make_array(a.data(), a.size());
-            ar & boost::serialization::make_array(w.data(), w.size());
-            ar & t;
-        }
-
-        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-        integrable(){}
-        integrable(const Eigen::Vector3f &a_, const Eigen::Vector3f &w_ , const float &t_):a(a_),w(w_),t(t_){}
-        Eigen::Vector3f a, w;
-        float t;
-    };
-
     std::vector<integrable> mvMeasurements;
 
+    // Integrates one step with the bias already split in gyro and accelerometer parts
+    void IntegrateStep(const integrable &m, const Eigen::Vector3f &bg, const Eigen::Vector3f &ba);
+
     std::mutex mMutex;
 };
 
@@ -33,6 +33,7 @@
 #include "SerializationUtils.h"
 
 #include <mutex>
+#include <memory>
 
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/vector.hpp>
@@ -52,6 +53,7 @@ class GeometricCamera;
 class KeyFrame
 {
     friend class boost::serialization::access;
+    friend class AtlasFile;
 
     template<class Archive>
     void serialize(Archive& ar, const unsigned int version)
@@ -193,6 +195,13 @@ class KeyFrame
     }
 
 public:
+    // Keyframes sharing map points with this one and the number of points they share (weight)
+    typedef std::vector<std::pair<KeyFrame*,int> > CovisibilityList;
+
+    // Immutable list shared with the readers. Writers never modify a list that is being read,
+    // they replace it with a new one, so a view stays valid and unchanged without holding the mutex.
+    typedef std::shared_ptr<const CovisibilityList> CovisibilityView;
+
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     KeyFrame();
     KeyFrame(Frame &F, Map* pMap, KeyFrameDatabase* pKFDB);
@@ -215,7 +224,7 @@ public:
     bool isVelocitySet();
 
     // Bag of Words Representation
-    void ComputeBoW();
+    void ComputeBoW(ThreadPool* pThreadPool = static_cast<ThreadPool*>(NULL));
 
     // Covisibility graph functions
     void AddConnection(KeyFrame* pKF, const int &weight);
@@ -228,6 +237,8 @@ public:
     std::vector<KeyFrame*> GetBestCovisibilityKeyFrames(const int &N);
     std::vector<KeyFrame*> GetCovisiblesByWeight(const int &w);
     int GetWeight(KeyFrame* pKF);
+    // Covisible keyframes by decreasing weight without copying them (only a reference count is taken)
+    CovisibilityView GetCovisibilityView();
 
     // Spanning tree functions
     void AddChild(KeyFrame* pKF);
@@ -299,6 +310,8 @@ public:
     void PreSave(set<KeyFrame*>& spKF,set<MapPoint*>& spMP, set<GeometricCamera*>& spCam);
     void PostLoad(map<long unsigned int, KeyFrame*>& mpKFid, map<long unsigned int, MapPoint*>& mpMPid, map<unsigned int, GeometricCamera*>& mpCamId);
 
+    // Approximate bytes held by the keyframe (features, grids, BoW, connections and preintegration)
+    size_t GetMemoryUsage();
 
     void SetORBVocabulary(ORBVocabulary* pORBVoc);
     void SetKeyFrameDatabase(KeyFrameDatabase* pKFDB);
@@ -455,11 +468,11 @@ protected:
     ORBVocabulary* mpORBvocabulary;
 
     // Grid over the image to speed up feature matching
-    std::vector< std::vector <std::vector<size_t> > > mGrid;
+    FeatureGrid mGrid;
 
-    std::map<KeyFrame*,int> mConnectedKeyFrameWeights;
-    std::vector<KeyFrame*> mvpOrderedConnectedKeyFrames;
-    std::vector<int> mvOrderedWeights;
+    // All the connections sorted by keyframe pointer, and the covisible keyframes by decreasing weight
+    CovisibilityList mConnectedKeyFrameWeights;
+    CovisibilityView mpOrderedConnections;
     // For save relation without pointer, this is necessary for save/load function
     std::map<long unsigned int, int> mBackupConnectedKeyFrameIdWeights;
 
@@ -501,6 +514,11 @@ protected:
     std::mutex mMutexFeatures;
     std::mutex mMutexMap;
 
+    // Sorts the connections of a list by decreasing weight (and pointer)
+    static void SortByWeight(CovisibilityList &vConnections);
+
+    static CovisibilityView EmptyCovisibility();
+
 public:
     GeometricCamera* mpCamera, *mpCamera2;
 
@@ -515,7 +533,7 @@ public:
 
     const int NLeft, NRight;
 
-    std::vector< std::vector <std::vector<size_t> > > mGridRight;
+    FeatureGrid mGridRight;
 
     Sophus::SE3<float> GetRightPose();
     Sophus::SE3<float> GetRightPoseInverse();
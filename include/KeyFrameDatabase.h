@@ -23,6 +23,7 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <unordered_map>
 
 #include "KeyFrame.h"
 #include "Frame.h"
@@ -62,6 +63,10 @@ public:
 
     void add(KeyFrame* pKF);
 
+    // Keyframe of a map whose keyframes are not loaded (see Atlas::LoadMap), known only by its words.
+    // Its entries are removed with clearMap. Returns false if a word is out of the vocabulary.
+    bool addStored(Map* pMap, const DBoW2::BowVector &bowVec);
+
     void erase(KeyFrame* pKF);
 
     void clear();
@@ -73,7 +78,10 @@ public:
     // Loop and Merge Detection
     void DetectCandidates(KeyFrame* pKF, float minScore,vector<KeyFrame*>& vpLoopCand, vector<KeyFrame*>& vpMergeCand);
     void DetectBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vpLoopCand, vector<KeyFrame*> &vpMergeCand, int nMinWords);
-    void DetectNBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vpLoopCand, vector<KeyFrame*> &vpMergeCand, int nNumCandidates);
+    // If pvpStoredMergeMaps is given, it gets the maps not loaded yet that have a keyframe among the
+    // nNumCandidates best scores. Their keyframes are never returned as candidates.
+    void DetectNBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vpLoopCand, vector<KeyFrame*> &vpMergeCand, int nNumCandidates,
+                               vector<Map*>* pvpStoredMergeMaps = NULL);
 
     // Relocalization
     std::vector<KeyFrame*> DetectRelocalizationCandidates(Frame* F, Map* pMap);
@@ -84,11 +92,49 @@ public:
 
 protected:
 
+   // Entry of the inverted file: slot of the keyframe and weight of the word in it
+   struct Posting
+   {
+       unsigned int nSlot;
+       DBoW2::WordValue weight;
+   };
+
+   // Finds the keyframes sharing words with bowVec and fills mvpSharingKFs with them, in the order
+   // they appear in the inverted file, with the number of shared words and the similarity score.
+   // Stored slots go to mvpSharingStoredMaps, always with the L1 score (their BowVector is not kept).
+   // The scores are accumulated for all of them in one pass over the posting lists.
+   // mMutex must be locked.
+   void ScoreSharingKeyFrames(const DBoW2::BowVector &bowVec);
+
+   // Takes a free slot or appends a new one. mMutex must be locked.
+   unsigned int NewSlot();
+
    // Associated vocabulary
    const ORBVocabulary* mpVoc;
 
-   // Inverted file
-   std::vector<list<KeyFrame*> > mvInvertedFile;
+   // Inverted file, for each word the keyframes (in insertion order) that contain it
+   std::vector<std::vector<Posting> > mvInvertedFile;
+
+   // Keyframe in each slot (NULL if free or stored)
+   std::vector<KeyFrame*> mvpKeyFrameSlots;
+   // Map of each stored slot (NULL otherwise)
+   std::vector<Map*> mvpStoredSlotMaps;
+   std::vector<unsigned int> mvFreeSlots;
+   std::unordered_map<KeyFrame*,unsigned int> mmKeyFrameSlots;
+
+   // Per slot accumulators, zero outside ScoreSharingKeyFrames
+   std::vector<int> mvnSlotWords;
+   std::vector<double> mvSlotScores;
+   std::vector<unsigned int> mvTouchedSlots;
+
+   // Result of the last ScoreSharingKeyFrames
+   std::vector<KeyFrame*> mvpSharingKFs;
+   std::vector<int> mvnSharingWords;
+   std::vector<float> mvSharingScores;
+   // Same for the stored slots
+   std::vector<Map*> mvpSharingStoredMaps;
+   std::vector<int> mvnSharingStoredWords;
+   std::vector<float> mvSharingStoredScores;
 
    // For save relation without pointer, this is necessary for save/load function
    std::vector<list<long unsigned int> > mvBackupInvertedFileId;
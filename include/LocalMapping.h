@@ -26,6 +26,7 @@
 #include "Tracking.h"
 #include "KeyFrameDatabase.h"
 #include "Settings.h"
+#include "EventCount.h"
 
 #include <mutex>
 
@@ -37,6 +38,7 @@ class System;
 class Tracking;
 class LoopClosing;
 class Atlas;
+class ThreadPool;
 
 class LocalMapping
 {
@@ -48,6 +50,9 @@ public:
 
     void SetTracker(Tracking* pTracker);
 
+    // Pool shared with Tracking for per-keyframe parallel work (not owned)
+    void SetThreadPool(ThreadPool* pThreadPool);
+
     // Main function
     void Run();
 
@@ -62,6 +67,8 @@ public:
     void Release();
     bool isStopped();
     bool stopRequested();
+    // Blocks until Local Mapping has stopped after RequestStop, or has finished
+    void WaitUntilStopped();
     bool AcceptKeyFrames();
     void SetAcceptKeyFrames(bool flag);
     bool SetNotStop(bool flag);
@@ -132,6 +139,8 @@ public:
 protected:
 
     bool CheckNewKeyFrames();
+    // New keyframes or requests that the main loop has to handle
+    bool CheckPendingWork();
     void ProcessNewKeyFrame();
     void CreateNewMapPoints();
 
@@ -161,6 +170,8 @@ protected:
     LoopClosing* mpLoopCloser;
     Tracking* mpTracker;
 
+    ThreadPool* mpThreadPool;
+
     std::list<KeyFrame*> mlNewKeyFrames;
 
     KeyFrame* mpCurrentKeyFrame;
@@ -179,6 +190,9 @@ protected:
     bool mbAcceptKeyFrames;
     std::mutex mMutexAccept;
 
+    // Notified on every change of the queue, stop, reset and finish state
+    EventCount mStateChanged;
+
     void InitializeIMU(float priorG = 1e2, float priorA = 1e6, bool bFirst = false);
     void ScaleRefinement();
 
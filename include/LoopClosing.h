@@ -27,6 +27,7 @@
 #include "Tracking.h"
 
 #include "KeyFrameDatabase.h"
+#include "EventCount.h"
 
 #include <boost/algorithm/string.hpp>
 #include <thread>
@@ -40,6 +41,8 @@ class Tracking;
 class LocalMapping;
 class KeyFrameDatabase;
 class Map;
+class ThreadPool;
+class GlobalBundleAdjuster;
 
 
 class LoopClosing
@@ -54,10 +57,18 @@ public:
 
     LoopClosing(Atlas* pAtlas, KeyFrameDatabase* pDB, ORBVocabulary* pVoc,const bool bFixScale, const bool bActiveLC);
 
+    ~LoopClosing();
+
     void SetTracker(Tracking* pTracker);
 
     void SetLocalMapper(LocalMapping* pLocalMapper);
 
+    void SetThreadPool(ThreadPool* pThreadPool);
+
+    // Keep the global BA graph between loop closures and only optimize what changed
+    // (visual maps only, inertial maps always run the full inertial BA)
+    void SetIncrementalGBA(bool bIncremental);
+
     // Main function
     void Run();
 
@@ -119,6 +130,8 @@ public:
 protected:
 
     bool CheckNewKeyFrames();
+    // New keyframes or requests that the main loop has to handle
+    bool CheckPendingWork();
 
 
     //Methods to implement the new place recognition algorithm
@@ -144,6 +157,9 @@ protected:
 
     void CheckObservations(set<KeyFrame*> &spKFsMap1, set<KeyFrame*> &spKFsMap2);
 
+    // Evicts old maps while the Atlas is over its memory budget
+    void EnforceMemoryBudget();
+
     void ResetIfRequested();
     bool mbResetRequested;
     bool mbResetActiveMapRequested;
@@ -163,11 +179,15 @@ protected:
     ORBVocabulary* mpORBVocabulary;
 
     LocalMapping *mpLocalMapper;
+    ThreadPool* mpThreadPool;
 
     std::list<KeyFrame*> mlpLoopKeyFrameQueue;
 
     std::mutex mMutexLoopQueue;
 
+    // Notified on every change of the queue, reset and finish state
+    EventCount mStateChanged;
+
     // Loop detector parameters
     float mnCovisibilityConsistencyTh;
 
@@ -218,6 +238,7 @@ protected:
     bool mbStopGBA;
     std::mutex mMutexGBA;
     std::thread* mpThreadGBA;
+    GlobalBundleAdjuster* mpGlobalBundleAdjuster;
 
     // Fix scale in the stereo/RGB-D case
     bool mbFixScale;
@@ -52,6 +52,8 @@
 #include "MapPoint.h"
 #include "Frame.h"
 
+#include <random>
+
 #include<Eigen/Dense>
 #include<Eigen/Sparse>
 
@@ -60,10 +62,17 @@ namespace ORB_SLAM3{
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
+        MLPnPsolver();
+
         MLPnPsolver(const Frame &F, const vector<MapPoint*> &vpMapPointMatches);
 
         ~MLPnPsolver();
 
+        // Sets up the solver for a new frame and matches, resetting the RANSAC state.
+        // Buffers keep their capacity, so one solver can be reused across relocalizations.
+        // nSeed seeds the solver's own generator, so solvers can run concurrently and repeat their draws.
+        void Init(const Frame &F, const vector<MapPoint*> &vpMapPointMatches, unsigned long nSeed = 0);
+
         void SetRansacParameters(double probability = 0.99, int minInliers = 8, int maxIterations = 300, int minSet = 6, float epsilon = 0.4,
                                  float th2 = 5.991);
 
@@ -225,6 +234,9 @@ namespace ORB_SLAM3{
         // Indices for random selection [0 .. N-1]
         vector<size_t> mvAllIndices;
 
+        // Generator for the minimal sets, owned by this solver
+        std::mt19937 mRng;
+
         // RANSAC probability
         double mRansacProb;
 
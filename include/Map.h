@@ -22,6 +22,7 @@
 
 #include "MapPoint.h"
 #include "KeyFrame.h"
+#include "SpatialIndex.h"
 
 #include <set>
 #include <pangolin/pangolin.h>
@@ -41,6 +42,7 @@ class KeyFrameDatabase;
 class Map
 {
     friend class boost::serialization::access;
+    friend class AtlasFile;
 
     template<class Archive>
     void serialize(Archive &ar, const unsigned int version)
@@ -88,6 +90,22 @@ public:
     long unsigned int MapPointsInMap();
     long unsigned  KeyFramesInMap();
 
+    // Approximate bytes held by the keyframes and map points of the map
+    size_t GetMemoryUsage();
+
+    // Geometric queries over the world positions of the map points and the camera centers of the
+    // keyframes. Keyframes in radius are returned closest first.
+    std::vector<MapPoint*> GetMapPointsInRadius(const Eigen::Vector3f &x, const float r);
+    std::vector<KeyFrame*> GetKeyFramesInRadius(const Eigen::Vector3f &x, const float r);
+    std::vector<MapPoint*> GetMapPointsInFrustum(const Sophus::SE3f &Tcw, GeometricCamera* pCamera, const float minX, const float maxX,
+                                                 const float minY, const float maxY, const float maxDistance);
+    std::vector<KeyFrame*> GetKeyFramesInFrustum(const Sophus::SE3f &Tcw, GeometricCamera* pCamera, const float minX, const float maxX,
+                                                 const float minY, const float maxY, const float maxDistance);
+
+    // Keep the spatial index in step, called by MapPoint::SetWorldPos and KeyFrame::SetPose
+    void UpdateMapPointPosition(MapPoint* pMP, const Eigen::Vector3f &pos);
+    void UpdateKeyFramePosition(KeyFrame* pKF, const Eigen::Vector3f &Ow);
+
     long unsigned int GetId();
 
     long unsigned int GetInitKFid();
@@ -149,6 +167,9 @@ public:
     static const int THUMB_WIDTH = 512;
     static const int THUMB_HEIGHT = 512;
 
+    // Side of the cells of the spatial index, in map units
+    static const float SPATIAL_CELL_SIZE;
+
     static long unsigned int nNextId;
 
     // DEBUG: show KFs which are used in LBA
@@ -162,6 +183,10 @@ protected:
     std::set<MapPoint*> mspMapPoints;
     std::set<KeyFrame*> mspKeyFrames;
 
+    // Voxel hashes over the objects of mspMapPoints and mspKeyFrames
+    SpatialIndex<MapPoint> mMapPointIndex;
+    SpatialIndex<KeyFrame> mKeyFrameIndex;
+
     // Save/load, the set structure is broken in libboost 1.58 for ubuntu 16.04, a vector is serializated
     std::vector<MapPoint*> mvpBackupMapPoints;
     std::vector<KeyFrame*> mvpBackupKeyFrames;
@@ -24,11 +24,13 @@
 #include "Frame.h"
 #include "Map.h"
 #include "Converter.h"
+#include "DescriptorMedoid.h"
 
 #include "SerializationUtils.h"
 
 #include <opencv2/core/core.hpp>
 #include <mutex>
+#include <memory>
 
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/array.hpp>
@@ -45,6 +47,7 @@ class MapPoint
 {
 
     friend class boost::serialization::access;
+    friend class AtlasFile;
     template<class Archive>
     void serialize(Archive & ar, const unsigned int version)
     {
@@ -104,6 +107,14 @@ class MapPoint
 
 
 public:
+    // Keyframes observing the point with the left and right keypoint indexes (-1 if not seen by
+    // that camera), sorted by keyframe pointer as the std::map they replace.
+    typedef std::vector<std::pair<KeyFrame*,std::tuple<int,int> > > ObservationList;
+
+    // Immutable list shared with the readers. Writers never modify a list that is being read,
+    // they replace it with a new one, so a view stays valid and unchanged without holding the mutex.
+    typedef std::shared_ptr<const ObservationList> ObservationsView;
+
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     MapPoint();
 
@@ -120,6 +131,8 @@ public:
     KeyFrame* GetReferenceKeyFrame();
 
     std::map<KeyFrame*,std::tuple<int,int>> GetObservations();
+    // Current observations without copying them (only a reference count is taken)
+    ObservationsView GetObservationsView();
     int Observations();
 
     void AddObservation(KeyFrame* pKF,int idx);
@@ -160,6 +173,9 @@ public:
     void PreSave(set<KeyFrame*>& spKF,set<MapPoint*>& spMP);
     void PostLoad(map<long unsigned int, KeyFrame*>& mpKFid, map<long unsigned int, MapPoint*>& mpMPid);
 
+    // Approximate bytes held by the point (descriptors and observations)
+    size_t GetMemoryUsage();
+
 public:
     long unsigned int mnId;
     static long unsigned int nNextId;
@@ -212,8 +228,9 @@ protected:
      // Position in absolute coordinates
      Eigen::Vector3f mWorldPos;
 
-     // Keyframes observing the point and associated index in keyframe
-     std::map<KeyFrame*,std::tuple<int,int> > mObservations;
+     // Keyframes observing the point and associated index in keyframe.
+     // Owned as a mutable list, handed out to readers only as ObservationsView.
+     std::shared_ptr<ObservationList> mpObservations;
      // For save relation without pointer, this is necessary for save/load function
      std::map<long unsigned int, int> mBackupObservationsId1;
      std::map<long unsigned int, int> mBackupObservationsId2;
@@ -224,6 +241,9 @@ protected:
      // Best descriptor to fast matching
      cv::Mat mDescriptor;
 
+     // Observed descriptors and their pairwise distances, guarded by mMutexFeatures
+     DescriptorMedoid mDescriptorMedoid;
+
      // Reference KeyFrame
      KeyFrame* mpRefKF;
      long unsigned int mBackupRefKFId;
@@ -249,6 +269,12 @@ protected:
      std::mutex mMutexFeatures;
      std::mutex mMutexMap;
 
+     // List of mpObservations that can be modified in place (copied first if a reader holds it).
+     // Must be called with mMutexFeatures locked.
+     ObservationList& MutableObservations();
+
+     static std::shared_ptr<ObservationList> EmptyObservations();
+
 };
 
 } //namespace ORB_SLAM
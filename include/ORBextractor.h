@@ -27,6 +27,8 @@
 namespace ORB_SLAM3
 {
 
+class ThreadPool;
+
 class ExtractorNode
 {
 public:
@@ -80,6 +82,12 @@ public:
         return mvInvLevelSigma2;
     }
 
+    // Pyramid borders, FAST cells, oct-tree distribution and descriptors of the different
+    // levels are spread over the pool. NULL (default) extracts on the calling thread.
+    void SetThreadPool(ThreadPool* pThreadPool){
+        mpThreadPool = pThreadPool;
+    }
+
     std::vector<cv::Mat> mvImagePyramid;
 
 protected:
@@ -106,6 +114,8 @@ protected:
     std::vector<float> mvInvScaleFactor;    
     std::vector<float> mvLevelSigma2;
     std::vector<float> mvInvLevelSigma2;
+
+    ThreadPool* mpThreadPool;
 };
 
 } //namespace ORB_SLAM
@@ -0,0 +1,129 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef POSEONLYOPTIMIZER_H
+#define POSEONLYOPTIMIZER_H
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "Thirdparty/g2o/g2o/types/se3quat.h"
+
+namespace ORB_SLAM3
+{
+
+class GeometricCamera;
+
+// Levenberg-Marquardt on a single camera pose observing fixed 3D points, with the same steps
+// as g2o::OptimizationAlgorithmLevenberg on a VertexSE3Expmap with EdgeSE3ProjectXYZOnlyPose,
+// EdgeSE3ProjectXYZOnlyPoseToBody and EdgeStereoSE3ProjectXYZOnlyPose edges (Huber kernels).
+// The 6x6 system is accumulated directly, without building a graph, and the observations
+// are stored in buffers that keep their capacity between calls, so an instance reused for
+// every frame does not allocate.
+class PoseOnlyOptimizer
+{
+public:
+
+    PoseOnlyOptimizer();
+
+    // Removes all the observations, keeping the memory
+    void Clear();
+
+    void SetPose(const g2o::SE3Quat &Tcw) {mTcw = Tcw;}
+    const g2o::SE3Quat& GetPose() const {return mTcw;}
+
+    // Observations return their index. They are active (level 0) and use a Huber kernel
+    // with threshold delta until changed.
+    int AddMonocular(const Eigen::Vector3d &Xw, const Eigen::Vector2d &obs, double invSigma2,
+                     GeometricCamera* pCamera, double delta);
+    // Observation in the second camera of a rigid stereo rig, Trl maps left to right camera
+    int AddMonocularRight(const Eigen::Vector3d &Xw, const Eigen::Vector2d &obs, double invSigma2,
+                          GeometricCamera* pCamera, const g2o::SE3Quat &Trl, double delta);
+    // Rectified stereo observation (uL, v, uR)
+    int AddStereo(const Eigen::Vector3d &Xw, const Eigen::Vector3d &obs, double invSigma2,
+                  double fx, double fy, double cx, double cy, double bf, double delta);
+
+    int NumObservations() const {return mvObservations.size();}
+
+    // Only active observations take part in Optimize
+    void SetActive(int i, bool bActive) {mvObservations[i].bActive = bActive;}
+    void SetRobust(int i, bool bRobust) {mvObservations[i].bRobust = bRobust;}
+
+    // Error of observation i at the current pose. Optimize leaves the error of the active
+    // observations at the last pose it evaluated, like g2o does with the edges.
+    void ComputeError(int i);
+    double Chi2(int i) const;
+
+    // Runs up to nIterations iterations of Levenberg-Marquardt over the active observations
+    void Optimize(int nIterations);
+
+protected:
+
+    enum eObservationType
+    {
+        MONOCULAR=0,
+        MONOCULAR_RIGHT=1,
+        STEREO=2
+    };
+
+    struct Observation
+    {
+        int type;
+        bool bActive;
+        bool bRobust;
+        double invSigma2;
+        double delta;
+        Eigen::Vector3d Xw;
+        Eigen::Vector3d obs;
+        Eigen::Vector3d error;
+        GeometricCamera* pCamera;
+        int nRig; // index in mvRigs for MONOCULAR_RIGHT and STEREO
+    };
+
+    // Stereo parameters and right camera extrinsics, shared by the observations of a frame
+    struct Rig
+    {
+        Eigen::Matrix3d Rrl;
+        Eigen::Vector3d trl;
+        double fx, fy, cx, cy, bf;
+    };
+
+    void ComputeError(Observation &o, const Eigen::Matrix3d &Rcw, const Eigen::Vector3d &tcw) const;
+
+    // Robust chi2 of the active observations at mTcw, updating their errors
+    double ComputeActiveErrors();
+
+    // Gauss-Newton system of the active observations at mTcw, errors must be up to date
+    void BuildSystem(Eigen::Matrix<double,6,6> &H, Eigen::Matrix<double,6,1> &b) const;
+
+    int AddRig(const Rig &rig);
+
+    std::vector<Observation> mvObservations;
+    std::vector<Rig> mvRigs;
+
+    g2o::SE3Quat mTcw;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} //namespace ORB_SLAM
+
+#endif // POSEONLYOPTIMIZER_H
@@ -99,6 +99,7 @@ namespace ORB_SLAM3 {
         float initThFAST() {return initThFAST_;}
         float minThFAST() {return minThFAST_;}
         float scaleFactor() {return scaleFactor_;}
+        int nExtractorThreads() {return nExtractorThreads_;}
 
         float keyFrameSize() {return keyFrameSize_;}
         float keyFrameLineWidth() {return keyFrameLineWidth_;}
@@ -116,6 +117,12 @@ namespace ORB_SLAM3 {
         std::string atlasSaveFile() {return sSaveto_;}
 
         float thFarPoints() {return thFarPoints_;}
+        bool incrementalGBA() {return incrementalGBA_;}
+        std::string trajectoryStreamFile() {return trajectoryStreamFile_;}
+        int trajectoryStreamLag() {return trajectoryStreamLag_;}
+        bool trajectoryStreamRelease() {return trajectoryStreamRelease_;}
+        int memoryBudget() {return memoryBudget_;}
+        std::string memoryBudgetDir() {return memoryBudgetDir_;}
 
         cv::Mat M1l() {return M1l_;}
         cv::Mat M2l() {return M2l_;}
@@ -205,6 +212,7 @@ namespace ORB_SLAM3 {
         float scaleFactor_;
         int nLevels_;
         int initThFAST_, minThFAST_;
+        int nExtractorThreads_;
 
         /*
          * Viewer stuff
@@ -227,6 +235,12 @@ namespace ORB_SLAM3 {
          * Other stuff
          */
         float thFarPoints_;
+        bool incrementalGBA_;
+        std::string trajectoryStreamFile_;
+        int trajectoryStreamLag_;
+        bool trajectoryStreamRelease_;
+        int memoryBudget_; // MB, 0 disables the eviction of old maps
+        std::string memoryBudgetDir_;
 
     };
 };
@@ -0,0 +1,238 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Core>
+#include <sophus/se3.hpp>
+
+#include "CameraModels/GeometricCamera.h"
+
+namespace ORB_SLAM3
+{
+
+// Voxel hash over the positions of the objects of a map (world positions of the map points,
+// camera centers of the keyframes). Each cell keeps its objects next to their positions, so
+// radius and frustum queries read only the cells they overlap and never lock the objects.
+// The positions are the ones given to Insert and Move, the owner keeps them up to date.
+// All the methods can be called from several threads.
+template<class T>
+class SpatialIndex
+{
+public:
+
+    explicit SpatialIndex(const float cellSize): mfInvCellSize(1.f/cellSize) {}
+
+    // Adds pObj at pos, or moves it there if it is already in the index
+    void Insert(T* pObj, const Eigen::Vector3f &pos)
+    {
+        std::unique_lock<std::mutex> lock(mMutexIndex);
+        typename std::unordered_map<T*,Entry>::iterator it = mmEntries.find(pObj);
+        if(it==mmEntries.end())
+            AddToCell(mmEntries[pObj],pObj,pos);
+        else
+            MoveEntry(it->second,pObj,pos);
+    }
+
+    // Moves pObj to pos, objects not in the index are ignored
+    void Move(T* pObj, const Eigen::Vector3f &pos)
+    {
+        std::unique_lock<std::mutex> lock(mMutexIndex);
+        typename std::unordered_map<T*,Entry>::iterator it = mmEntries.find(pObj);
+        if(it!=mmEntries.end())
+            MoveEntry(it->second,pObj,pos);
+    }
+
+    void Erase(T* pObj)
+    {
+        std::unique_lock<std::mutex> lock(mMutexIndex);
+        typename std::unordered_map<T*,Entry>::iterator it = mmEntries.find(pObj);
+        if(it!=mmEntries.end())
+        {
+            RemoveFromCell(it->second);
+            mmEntries.erase(it);
+        }
+    }
+
+    void Clear()
+    {
+        std::unique_lock<std::mutex> lock(mMutexIndex);
+        mmEntries.clear();
+        mmCells.clear();
+    }
+
+    size_t size()
+    {
+        std::unique_lock<std::mutex> lock(mMutexIndex);
+        return mmEntries.size();
+    }
+
+    // Appends to vpObjs the objects closer than r to x
+    void GetInRadius(const Eigen::Vector3f &x, const float r, std::vector<T*> &vpObjs)
+    {
+        const float r2 = r*r;
+        ForEachCell(x,r,[&](const std::vector<Item> &vItems){
+            for(const Item &item : vItems)
+            {
+                if((item.pos-x).squaredNorm()<=r2)
+                    vpObjs.push_back(item.pObj);
+            }
+        });
+    }
+
+    // Appends to vpObjs the objects in front of the camera at Tcw, closer than maxDistance to it,
+    // that pCamera projects inside [minX,maxX]x[minY,maxY]
+    void GetInFrustum(const Sophus::SE3f &Tcw, GeometricCamera* pCamera, const float minX, const float maxX,
+                      const float minY, const float maxY, const float maxDistance, std::vector<T*> &vpObjs)
+    {
+        const Eigen::Matrix3f Rcw = Tcw.rotationMatrix();
+        const Eigen::Vector3f tcw = Tcw.translation();
+        const Eigen::Vector3f Ow = -Rcw.transpose()*tcw;
+        const float maxDistance2 = maxDistance*maxDistance;
+
+        ForEachCell(Ow,maxDistance,[&](const std::vector<Item> &vItems){
+            for(const Item &item : vItems)
+            {
+                const Eigen::Vector3f Pc = Rcw*item.pos+tcw;
+                if(Pc(2)<=0.f || Pc.squaredNorm()>maxDistance2)
+                    continue;
+
+                const Eigen::Vector2f uv = pCamera->project(Pc);
+                if(uv(0)<minX || uv(0)>maxX || uv(1)<minY || uv(1)>maxY)
+                    continue;
+
+                vpObjs.push_back(item.pObj);
+            }
+        });
+    }
+
+protected:
+
+    struct Item
+    {
+        T* pObj;
+        Eigen::Vector3f pos;
+    };
+
+    struct Entry
+    {
+        int64_t key;
+        size_t slot; // position of the object in the items of its cell
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const int64_t key) const {return (size_t)((uint64_t)key*0x9E3779B97F4A7C15ULL >> 16);}
+    };
+
+    // 21 bits per axis, enough for a million cells on each side of the origin
+    static int64_t Key(const int x, const int y, const int z)
+    {
+        return ((int64_t)(x & 0x1FFFFF) << 42) | ((int64_t)(y & 0x1FFFFF) << 21) | (int64_t)(z & 0x1FFFFF);
+    }
+
+    int Coord(const float v) const {return (int)std::floor(v*mfInvCellSize);}
+
+    int64_t Key(const Eigen::Vector3f &pos) const {return Key(Coord(pos(0)),Coord(pos(1)),Coord(pos(2)));}
+
+    void AddToCell(Entry &entry, T* pObj, const Eigen::Vector3f &pos)
+    {
+        entry.key = Key(pos);
+        std::vector<Item> &vItems = mmCells[entry.key];
+        entry.slot = vItems.size();
+        Item item;
+        item.pObj = pObj;
+        item.pos = pos;
+        vItems.push_back(item);
+    }
+
+    void RemoveFromCell(const Entry &entry)
+    {
+        typename std::unordered_map<int64_t,std::vector<Item>,KeyHash>::iterator itCell = mmCells.find(entry.key);
+        std::vector<Item> &vItems = itCell->second;
+        if(entry.slot+1<vItems.size())
+        {
+            vItems[entry.slot] = vItems.back();
+            mmEntries[vItems[entry.slot].pObj].slot = entry.slot;
+        }
+        vItems.pop_back();
+        if(vItems.empty())
+            mmCells.erase(itCell);
+    }
+
+    void MoveEntry(Entry &entry, T* pObj, const Eigen::Vector3f &pos)
+    {
+        if(Key(pos)==entry.key)
+            mmCells[entry.key][entry.slot].pos = pos;
+        else
+        {
+            RemoveFromCell(entry);
+            AddToCell(entry,pObj,pos);
+        }
+    }
+
+    // Calls f with the items of every cell that overlaps the cube of half side r around x.
+    // If the cube spans more cells than there are in use (or r is not finite), the cells in use
+    // are scanned instead.
+    template<class F>
+    void ForEachCell(const Eigen::Vector3f &x, const float r, F f)
+    {
+        std::unique_lock<std::mutex> lock(mMutexIndex);
+
+        const float nSide = 2.f*r*mfInvCellSize+2.f;
+        if(!(nSide*nSide*nSide<=(float)mmCells.size()))
+        {
+            for(typename std::unordered_map<int64_t,std::vector<Item>,KeyHash>::const_iterator it=mmCells.begin(); it!=mmCells.end(); it++)
+                f(it->second);
+            return;
+        }
+
+        const int minX = Coord(x(0)-r), maxX = Coord(x(0)+r);
+        const int minY = Coord(x(1)-r), maxY = Coord(x(1)+r);
+        const int minZ = Coord(x(2)-r), maxZ = Coord(x(2)+r);
+
+        for(int ix=minX; ix<=maxX; ix++)
+            for(int iy=minY; iy<=maxY; iy++)
+                for(int iz=minZ; iz<=maxZ; iz++)
+                {
+                    typename std::unordered_map<int64_t,std::vector<Item>,KeyHash>::const_iterator it = mmCells.find(Key(ix,iy,iz));
+                    if(it!=mmCells.end())
+                        f(it->second);
+                }
+    }
+
+    const float mfInvCellSize;
+
+    std::unordered_map<int64_t,std::vector<Item>,KeyHash> mmCells;
+    std::unordered_map<T*,Entry> mmEntries;
+
+    std::mutex mMutexIndex;
+};
+
+} //namespace ORB_SLAM
+
+#endif // SPATIALINDEX_H
@@ -26,6 +26,7 @@
 #include<stdlib.h>
 #include<string>
 #include<thread>
+#include<future>
 #include<opencv2/core/core.hpp>
 
 #include "Tracking.h"
@@ -39,6 +40,8 @@
 #include "Viewer.h"
 #include "ImuTypes.h"
 #include "Settings.h"
+#include "ThreadPool.h"
+#include "FramePipeline.h"
 
 
 namespace ORB_SLAM3
@@ -120,6 +123,19 @@ public:
     // Returns the camera pose (empty if tracking fails).
     Sophus::SE3f TrackMonocular(const cv::Mat &im, const double &timestamp, const vector<IMU::Point>& vImuMeas = vector<IMU::Point>(), string filename="");
 
+    // Asynchronous versions of TrackStereo, TrackRGBD and TrackMonocular. The images are copied
+    // (rectified or resized if needed) and queued, and the pose is delivered through the future once
+    // the frame has been tracked. Frames are tracked in the order they are given, the feature
+    // extraction of each one runs while the previous one is tracked. The calls block while too many
+    // frames are queued and must be made from a single thread. A synchronous Track* call first waits
+    // for the queued frames.
+    std::future<Sophus::SE3f> TrackStereoAsync(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timestamp, const vector<IMU::Point>& vImuMeas = vector<IMU::Point>(), string filename="");
+    std::future<Sophus::SE3f> TrackRGBDAsync(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp, const vector<IMU::Point>& vImuMeas = vector<IMU::Point>(), string filename="");
+    std::future<Sophus::SE3f> TrackMonocularAsync(const cv::Mat &im, const double &timestamp, const vector<IMU::Point>& vImuMeas = vector<IMU::Point>(), string filename="");
+
+    // Blocks until all the frames given to Track*Async have been tracked
+    void WaitForQueuedFrames();
+
 
     // This stops local mapping thread (map building) and performs only camera tracking.
     void ActivateLocalizationMode();
@@ -194,9 +210,37 @@ public:
 
 private:
 
+    friend class FramePipeline;
+
+    // Rectification or resizing of the input, the output owns its images
+    void PreprocessStereo(const cv::Mat &imLeft, const cv::Mat &imRight, cv::Mat &imLeftToFeed, cv::Mat &imRightToFeed);
+    void PreprocessRGBD(const cv::Mat &im, const cv::Mat &depthmap, cv::Mat &imToFeed, cv::Mat &imDepthToFeed);
+    void PreprocessMonocular(const cv::Mat &im, cv::Mat &imToFeed);
+
+    // Applies the pending mode change and reset requests, before a frame is built
+    bool ModeOrResetRequested();
+    void CheckModeAndReset();
+
+    void UpdateTrackingState();
+
+    std::future<Sophus::SE3f> PushQueuedFrame(QueuedFrame* pFrame);
+
+    // Front end of a queued frame, can run while another frame is tracked
+    void PrepareQueuedFrame(QueuedFrame* pFrame);
+    // Builds the frame if it was not, or rebuilds it if tracking the previous frame changed the
+    // monocular extractor it needs. Runs on the tracking thread before the next frame is built.
+    void UpdateQueuedFrame(QueuedFrame* pFrame);
+    Sophus::SE3f TrackQueuedFrame(QueuedFrame* pFrame);
+
     void SaveAtlas(int type);
     bool LoadAtlas(int type);
 
+    // Loads mpVocabulary from a text file or, if the name ends in .bin, from a binary one
+    bool LoadVocabulary(const string &strVocFile);
+
+    // Checksum of the text vocabulary stored in saved atlases
+    string GetVocabularyChecksum();
+
     string CalculateCheckSum(string filename, int type);
 
     // Input sensor
@@ -230,12 +274,19 @@ private:
     FrameDrawer* mpFrameDrawer;
     MapDrawer* mpMapDrawer;
 
+    // Worker threads created once and shared by the per-frame parallel tasks
+    // (stereo extraction, two-view initialization), instead of spawning threads on every call.
+    ThreadPool* mpThreadPool;
+
     // System threads: Local Mapping, Loop Closing, Viewer.
     // The Tracking thread "lives" in the main execution thread that creates the System object.
     std::thread* mptLocalMapping;
     std::thread* mptLoopClosing;
     std::thread* mptViewer;
 
+    // Asynchronous input, created by the first Track*Async call
+    FramePipeline* mpFramePipeline;
+
     // Reset flag
     std::mutex mMutexReset;
     bool mbReset;
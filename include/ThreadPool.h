@@ -0,0 +1,65 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace ORB_SLAM3
+{
+
+// Fixed set of worker threads created once and reused for every frame.
+class ThreadPool
+{
+public:
+
+    // nThreads workers are started here and joined in the destructor
+    ThreadPool(int nThreads);
+    ~ThreadPool();
+
+    int GetNumThreads() const {return mvWorkers.size();}
+
+    // Runs f(i) for every i in [0,n) and returns when all of them have finished.
+    // The calling thread takes part in the work, so nested calls from inside f are safe.
+    void ParallelFor(int n, const std::function<void(int)> &f);
+
+    // Same as above, but runs serially on the calling thread when pPool is NULL
+    static void ParallelFor(ThreadPool* pPool, int n, const std::function<void(int)> &f);
+
+protected:
+
+    void Run();
+
+    std::vector<std::thread> mvWorkers;
+
+    std::deque<std::function<void()> > mlTasks;
+    std::mutex mMutexTasks;
+    std::condition_variable mcvTasks;
+    bool mbFinish;
+};
+
+} //namespace ORB_SLAM
+
+#endif // THREADPOOL_H
@@ -32,10 +32,13 @@
 #include "ORBVocabulary.h"
 #include "KeyFrameDatabase.h"
 #include "ORBextractor.h"
+#include "ThreadPool.h"
 #include "MapDrawer.h"
 #include "System.h"
 #include "ImuTypes.h"
 #include "Settings.h"
+#include "FrameTrajectory.h"
+#include "EventCount.h"
 
 #include "GeometricCamera.h"
 
@@ -52,6 +55,7 @@ class LocalMapping;
 class LoopClosing;
 class System;
 class Settings;
+class MLPnPsolver;
 
 class Tracking
 {  
@@ -59,7 +63,7 @@ class Tracking
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     Tracking(System* pSys, ORBVocabulary* pVoc, FrameDrawer* pFrameDrawer, MapDrawer* pMapDrawer, Atlas* pAtlas,
-             KeyFrameDatabase* pKFDB, const string &strSettingPath, const int sensor, Settings* settings, const string &_nameSeq=std::string());
+             KeyFrameDatabase* pKFDB, const string &strSettingPath, const int sensor, Settings* settings, ThreadPool* pThreadPool, const string &_nameSeq=std::string());
 
     ~Tracking();
 
@@ -73,6 +77,18 @@ public:
     Sophus::SE3f GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, string filename);
     Sophus::SE3f GrabImageMonocular(const cv::Mat &im, const double &timestamp, string filename);
 
+    // The two halves of GrabImage*, used by the asynchronous input of System.
+    // PrepareFrame* converts the input to grayscale and builds the Frame (ORB extraction, stereo matching,
+    // undistortion). It only reads the calibration and the extractors, so it can run on another thread
+    // while the previous frame is tracked. The link to the last frame is set by TrackPreparedFrame.
+    void PrepareFrameStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp, Frame &frame, cv::Mat &imGray);
+    void PrepareFrameRGBD(const cv::Mat &imRGB, const cv::Mat &imD, const double &timestamp, Frame &frame, cv::Mat &imGray);
+    void PrepareFrameMonocular(const cv::Mat &im, const double &timestamp, bool bIniExtractor, Frame &frame, cv::Mat &imGray);
+    // Whether the next monocular frame must be extracted with the initialization extractor
+    bool UseIniExtractor();
+    // imRight is the right input image (stereo only), shown by the frame drawer
+    Sophus::SE3f TrackPreparedFrame(const Frame &frame, const cv::Mat &imGray, const cv::Mat &imRight, string filename);
+
     void GrabImuData(const IMU::Point &imuMeasurement);
 
     void SetLocalMapper(LocalMapping* pLocalMapper);
@@ -147,12 +163,9 @@ public:
     std::vector<cv::Point3f> mvIniP3D;
     Frame mInitialFrame;
 
-    // Lists used to recover the full camera trajectory at the end of the execution.
+    // Trajectory used to recover the full camera trajectory at the end of the execution.
     // Basically we store the reference keyframe for each frame and its relative transformation
-    list<Sophus::SE3f> mlRelativeFramePoses;
-    list<KeyFrame*> mlpReferences;
-    list<double> mlFrameTimes;
-    list<bool> mlbLost;
+    FrameTrajectory mTrajectory;
 
     // frames with estimated pose
     int mTrackedFr;
@@ -194,6 +207,12 @@ public:
 
 protected:
 
+    // Converts a color input image to grayscale in place
+    void ConvertToGray(cv::Mat &im);
+
+    // Tracks mCurrentFrame, built by PrepareFrame*
+    Sophus::SE3f TrackCurrentFrame(const string &filename);
+
     // Main tracking function. It is independent of the input sensor.
     void Track();
 
@@ -261,6 +280,14 @@ protected:
     ORBextractor* mpORBextractorLeft, *mpORBextractorRight;
     ORBextractor* mpIniORBextractor;
 
+    // Workers owned by System, shared by frame construction and initialization (may be NULL).
+    // The extractors also use it for intra-frame parallel extraction if nThreads>1.
+    ThreadPool* mpThreadPool;
+    void SetExtractorThreadPool(const int nThreads);
+
+    // PnP solvers reused by Relocalization, one per candidate keyframe
+    std::vector<MLPnPsolver*> mvpRelocSolvers;
+
     //BoW
     ORBVocabulary* mpORBVocabulary;
     KeyFrameDatabase* mpKeyFrameDB;
@@ -364,6 +391,7 @@ protected:
     bool mbStopRequested;
     bool mbNotStop;
     std::mutex mMutexStop;
+    EventCount mStopChanged;
 #endif
 
 public:
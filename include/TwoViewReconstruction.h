@@ -28,6 +28,8 @@
 namespace ORB_SLAM3
 {
 
+    class ThreadPool;
+
     class TwoViewReconstruction
     {
         typedef std::pair<int,int> Match;
@@ -40,7 +42,8 @@ namespace ORB_SLAM3
         // Computes in parallel a fundamental matrix and a homography
         // Selects a model and tries to recover the motion and the structure from motion
         bool Reconstruct(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
-                          Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated);
+                          Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated,
+                          ThreadPool* pThreadPool = static_cast<ThreadPool*>(NULL));
 
     private:
 
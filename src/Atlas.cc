@@ -17,6 +17,14 @@
 */
 
 #include "Atlas.h"
+
+#include <sstream>
+#include <tuple>
+#include <unistd.h>
+
+#include "AtlasFile.h"
+#include "FrameTrajectory.h"
+#include "KeyFrameDatabase.h"
 #include "Viewer.h"
 
 #include "GeometricCamera.h"
@@ -26,11 +34,12 @@
 namespace ORB_SLAM3
 {
 
-Atlas::Atlas(){
+Atlas::Atlas(): mnMemoryBudget(0), mpThreadPool(NULL), mbBudgetExceeded(false), mnNextBudgetCheck(0){
     mpCurrentMap = static_cast<Map*>(NULL);
 }
 
-Atlas::Atlas(int initKFid): mnLastInitKFidMap(initKFid), mHasViewer(false)
+Atlas::Atlas(int initKFid): mnLastInitKFidMap(initKFid), mHasViewer(false), mnMemoryBudget(0), mpThreadPool(NULL),
+    mbBudgetExceeded(false), mnNextBudgetCheck(0)
 {
     mpCurrentMap = static_cast<Map*>(NULL);
     CreateNewMap();
@@ -64,6 +73,7 @@ void Atlas::CreateNewMap()
             mnLastInitKFidMap = mpCurrentMap->GetMaxKFid()+1; //The init KF is the next of current maximum
 
         mpCurrentMap->SetStoredMap();
+        mmMapLastUse[mpCurrentMap] = KeyFrame::nNextId;
         cout << "Stored map with ID: " << mpCurrentMap->GetId() << endl;
 
         //if(mHasViewer)
@@ -78,16 +88,197 @@ void Atlas::CreateNewMap()
 
 void Atlas::ChangeMap(Map* pMap)
 {
+    LoadMap(pMap);
+
     unique_lock<mutex> lock(mMutexAtlas);
     cout << "Change to map with id: " << pMap->GetId() << endl;
     if(mpCurrentMap){
         mpCurrentMap->SetStoredMap();
+        mmMapLastUse[mpCurrentMap] = KeyFrame::nNextId;
     }
 
     mpCurrentMap = pMap;
     mpCurrentMap->SetCurrentMap();
 }
 
+bool Atlas::LoadMap(Map* pMap)
+{
+    unique_lock<mutex> lock(mMutexLoad);
+    std::map<Map*,std::shared_ptr<AtlasFile> >::iterator it = mmpUnloadedMaps.find(pMap);
+    if(it==mmpUnloadedMaps.end())
+        return true;
+
+    const bool bLoaded = it->second->LoadMap(pMap);
+
+    // The stored entries of the map are replaced by its keyframes
+    mpKeyFrameDB->clearMap(pMap);
+    mmpUnloadedMaps.erase(it);
+
+    if(bLoaded)
+    {
+        map<unsigned int,GeometricCamera*> mpCams;
+        for(GeometricCamera* pCam : mvpCameras)
+            mpCams[pCam->GetId()] = pCam;
+
+        pMap->PostLoad(mpKeyFrameDB, mpORBVocabulary, mpCams);
+
+        unique_lock<mutex> lockAtlas(mMutexAtlas);
+        mmMapLastUse[pMap] = KeyFrame::nNextId;
+    }
+    else
+    {
+        unique_lock<mutex> lockAtlas(mMutexAtlas);
+        SetMapBad(pMap);
+    }
+
+    return bLoaded;
+}
+
+void Atlas::SetMemoryBudget(size_t nBytes, const string &strDirectory, ThreadPool* pThreadPool)
+{
+    unique_lock<mutex> lock(mMutexLoad);
+    mnMemoryBudget = nBytes;
+    mStrEvictionDir = strDirectory;
+    mpThreadPool = pThreadPool;
+
+    if(mnMemoryBudget>0)
+        cout << "Memory budget of " << (mnMemoryBudget>>20) << " MB, old maps are evicted to " << mStrEvictionDir << endl;
+}
+
+vector<Map*> Atlas::GetMapsToEvict()
+{
+    vector<Map*> vpEvict;
+    if(mnMemoryBudget==0)
+        return vpEvict;
+
+    // Measuring the usage walks the objects of the current map, so it is done every few keyframes
+    const unsigned long nCheckPeriod = 10;
+    if(KeyFrame::nNextId<mnNextBudgetCheck)
+        return vpEvict;
+    mnNextBudgetCheck = KeyFrame::nNextId+nCheckPeriod;
+
+    // Keyframes since a map was last used before it can be evicted
+    const unsigned long nMinAge = 20;
+
+    vector<Map*> vpMaps;
+    Map* pCurrentMap;
+    std::map<Map*,unsigned long> mLastUse;
+    {
+        unique_lock<mutex> lock(mMutexAtlas);
+        vpMaps.assign(mspMaps.begin(),mspMaps.end());
+        pCurrentMap = mpCurrentMap;
+        mLastUse = mmMapLastUse;
+    }
+
+    set<Map*> spUnloadedMaps;
+    {
+        unique_lock<mutex> lock(mMutexLoad);
+        for(const auto &unloaded : mmpUnloadedMaps)
+            spUnloadedMaps.insert(unloaded.first);
+    }
+
+    size_t nTotal = 0;
+    vector<tuple<unsigned long,Map*,size_t> > vCandidates;
+    for(Map* pMap : vpMaps)
+    {
+        if(spUnloadedMaps.count(pMap))
+            continue;
+
+        // The other maps rarely change, their usage is kept while they keep their sizes
+        size_t nBytes;
+        if(pMap==pCurrentMap)
+            nBytes = pMap->GetMemoryUsage();
+        else
+        {
+            const unsigned long nKFs = pMap->KeyFramesInMap();
+            const unsigned long nMPs = pMap->MapPointsInMap();
+            MapUsage &usage = mmMapUsage[pMap];
+            if(usage.nBytes==0 || usage.nKFs!=nKFs || usage.nMPs!=nMPs)
+            {
+                usage.nKFs = nKFs;
+                usage.nMPs = nMPs;
+                usage.nBytes = pMap->GetMemoryUsage();
+            }
+            nBytes = usage.nBytes;
+        }
+        nTotal += nBytes;
+
+        if(pMap==pCurrentMap || pMap->IsBad() || nBytes==0)
+            continue;
+
+        const unsigned long nLastUse = mLastUse.count(pMap) ? mLastUse[pMap] : 0;
+        if(nLastUse+nMinAge>KeyFrame::nNextId)
+            continue;
+
+        vCandidates.push_back(make_tuple(nLastUse,pMap,nBytes));
+    }
+
+    if(nTotal<=mnMemoryBudget)
+    {
+        mbBudgetExceeded = false;
+        return vpEvict;
+    }
+
+    sort(vCandidates.begin(),vCandidates.end());
+    for(size_t i=0; i<vCandidates.size() && nTotal>mnMemoryBudget; i++)
+    {
+        vpEvict.push_back(get<1>(vCandidates[i]));
+        nTotal -= get<2>(vCandidates[i]);
+    }
+
+    // Reported once each time the maps in use alone go over the budget
+    if(nTotal>mnMemoryBudget && !mbBudgetExceeded)
+        cout << "Memory budget exceeded by the maps in use: " << (nTotal>>20) << " MB of keyframes and map points" << endl;
+    mbBudgetExceeded = nTotal>mnMemoryBudget;
+
+    return vpEvict;
+}
+
+bool Atlas::EvictMap(Map* pMap, FrameTrajectory* pTrajectory)
+{
+    unique_lock<mutex> lock(mMutexLoad);
+    if(mmpUnloadedMaps.count(pMap))
+        return true;
+
+    {
+        unique_lock<mutex> lockAtlas(mMutexAtlas);
+        if(pMap==mpCurrentMap || !mspMaps.count(pMap))
+            return false;
+    }
+
+    // Drawing the map waits until its objects are deleted
+    unique_lock<mutex> lockUpdate(pMap->mMutexMapUpdate);
+
+    std::set<GeometricCamera*> spCams(mvpCameras.begin(), mvpCameras.end());
+    pMap->PreSave(spCams);
+
+    stringstream ss;
+    ss << mStrEvictionDir << "/map" << pMap->GetId() << "_" << getpid() << ".osa";
+    std::shared_ptr<AtlasFile> pFile(AtlasFile::Store(ss.str(), pMap, mpThreadPool));
+    if(!pFile)
+    {
+        cerr << "Could not evict map " << pMap->GetId() << ", the memory budget is disabled" << endl;
+        mnMemoryBudget = 0;
+        return false;
+    }
+
+    // Place recognition finds the map through the words of its keyframes, as after AtlasFile::Load
+    mpKeyFrameDB->clearMap(pMap);
+    if(!pFile->AddPlaceRecognitionSummary(pMap, mpKeyFrameDB))
+        cerr << "Map " << pMap->GetId() << " cannot be found by place recognition" << endl;
+
+    if(pTrajectory)
+    {
+        unique_lock<mutex> lockTrajectory(pTrajectory->mMutexTrajectory);
+        pTrajectory->ForgetMap(pMap);
+    }
+
+    pFile->UnloadMap(pMap);
+    mmpUnloadedMaps[pMap] = pFile;
+
+    return true;
+}
+
 unsigned long int Atlas::GetLastInitKFid()
 {
     unique_lock<mutex> lock(mMutexAtlas);
@@ -301,6 +492,16 @@ bool Atlas::isImuInitialized()
 
 void Atlas::PreSave()
 {
+    // The file is written from the objects, so the maps still in the atlas file are loaded
+    vector<Map*> vpUnloadedMaps;
+    {
+        unique_lock<mutex> lock(mMutexLoad);
+        for(const auto &unloaded : mmpUnloadedMaps)
+            vpUnloadedMaps.push_back(unloaded.first);
+    }
+    for(Map* pMi : vpUnloadedMaps)
+        LoadMap(pMi);
+
     if(mpCurrentMap){
         if(!mspMaps.empty() && mnLastInitKFidMap < mpCurrentMap->GetMaxKFid())
             mnLastInitKFidMap = mpCurrentMap->GetMaxKFid()+1; //The init KF is the next of current maximum
@@ -344,12 +545,31 @@ void Atlas::PostLoad()
     unsigned long int numKF = 0, numMP = 0;
     for(Map* pMi : mvpBackupMaps)
     {
+        std::map<Map*,std::shared_ptr<AtlasFile> >::iterator it = mmpUnloadedMaps.find(pMi);
+        if(it!=mmpUnloadedMaps.end())
+        {
+            if(!it->second->AddPlaceRecognitionSummary(pMi, mpKeyFrameDB))
+            {
+                cerr << "Corrupted map " << pMi->GetId() << " in the atlas file" << endl;
+                mpKeyFrameDB->clearMap(pMi);
+                mmpUnloadedMaps.erase(it);
+                mspBadMaps.insert(pMi);
+                pMi->SetBad();
+                continue;
+            }
+            mspMaps.insert(pMi);
+            continue;
+        }
+
         mspMaps.insert(pMi);
         pMi->PostLoad(mpKeyFrameDB, mpORBVocabulary, mpCams);
         numKF += pMi->GetAllKeyFrames().size();
         numMP += pMi->GetAllMapPoints().size();
     }
     mvpBackupMaps.clear();
+
+    if(!mmpUnloadedMaps.empty())
+        cout << mmpUnloadedMaps.size() << " maps left in the atlas file until they are needed" << endl;
 }
 
 void Atlas::SetKeyFrameDababase(KeyFrameDatabase* pKFDB)
@@ -0,0 +1,1208 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "AtlasFile.h"
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Atlas.h"
+#include "KeyFrameDatabase.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+static const char AtlasFileMagic[8] = {'O','S','3','A','T','L','A','S'};
+
+const size_t AtlasFile::ElementSize[AtlasFile::NUM_SECTIONS] =
+{
+    sizeof(AtlasRecord),
+    sizeof(CameraRecord),
+    sizeof(MapRecord),
+    sizeof(uint64_t),
+    sizeof(KeyFrameRecord),
+    sizeof(SE3Record),
+    sizeof(PreintegratedRecord),
+    sizeof(MapPointRecord),
+    sizeof(PositionRecord),
+    sizeof(ObservationRecord),
+    sizeof(float),
+    sizeof(int32_t),
+    sizeof(int64_t),
+    sizeof(uint8_t),
+    sizeof(KeyPointRecord),
+    sizeof(ConnectionRecord),
+    sizeof(uint32_t),
+    sizeof(FeatureGrid::Entry),
+    sizeof(WordRecord),
+    sizeof(FeatureRecord),
+    sizeof(ImuMeasurementRecord)
+};
+
+static void BiasToArray(const IMU::Bias &b, float* p)
+{
+    p[0] = b.bax; p[1] = b.bay; p[2] = b.baz;
+    p[3] = b.bwx; p[4] = b.bwy; p[5] = b.bwz;
+}
+
+static IMU::Bias ArrayToBias(const float* p)
+{
+    return IMU::Bias(p[0],p[1],p[2],p[3],p[4],p[5]);
+}
+
+static void SE3ToArray(const Sophus::SE3f &T, float* p)
+{
+    memcpy(p,T.data(),7*sizeof(float));
+}
+
+static void ArrayToSE3(const float* p, Sophus::SE3f &T)
+{
+    memcpy(T.data(),p,7*sizeof(float));
+}
+
+AtlasFile::AtlasFile(): mvCount(NUM_SECTIONS,0), mvOffset(NUM_SECTIONS,0), mpThreadPool(NULL), mpData(NULL), mnSize(0)
+{
+}
+
+AtlasFile::~AtlasFile()
+{
+    if(mpData)
+        munmap(mpData,mnSize);
+}
+
+bool AtlasFile::IsAtlasFile(const string &filename)
+{
+    ifstream f(filename.c_str(), ios::binary);
+    char magic[sizeof(AtlasFileMagic)];
+    if(!f.read(magic,sizeof(magic)))
+        return false;
+    return memcmp(magic,AtlasFileMagic,sizeof(magic))==0;
+}
+
+bool AtlasFile::Save(const string &filename, Atlas* pAtlas, const string &strVocabularyName,
+                     const string &strVocabularyChecksum, ThreadPool* pThreadPool)
+{
+    AtlasFile file;
+    file.Layout(pAtlas->mvpBackupMaps,pAtlas->mvpCameras,pAtlas->mnLastInitKFidMap);
+
+    // The atlas is written next to the target and renamed over it once it is on disk, so a failed
+    // or interrupted save leaves the previous file untouched
+    const string strTmpFilename = filename+".tmp";
+    if(!file.Create(strTmpFilename,strVocabularyName,strVocabularyChecksum))
+        return false;
+
+    file.Write(pThreadPool);
+
+    if(msync(file.mpData,file.mnSize,MS_SYNC)!=0 || rename(strTmpFilename.c_str(),filename.c_str())!=0)
+    {
+        cerr << "Could not write the atlas file " << filename << endl;
+        unlink(strTmpFilename.c_str());
+        return false;
+    }
+
+    cout << "Atlas saved: " << file.mvpMaps.size() << " maps, " << file.mvpKeyFrames.size() << " keyframes, "
+         << file.mvpMapPoints.size() << " map points, " << file.mnSize << " bytes" << endl;
+    return true;
+}
+
+AtlasFile* AtlasFile::Store(const string &filename, Map* pMap, ThreadPool* pThreadPool)
+{
+    AtlasFile* pFile = new AtlasFile();
+    pFile->Layout(vector<Map*>(1,pMap),vector<GeometricCamera*>(),0);
+
+    if(!pFile->Create(filename,"",""))
+    {
+        delete pFile;
+        return static_cast<AtlasFile*>(NULL);
+    }
+
+    // The mapping keeps the data, the file is released with it
+    unlink(filename.c_str());
+
+    pFile->Write(pThreadPool);
+
+    // Written pages leave the process, the kernel writes them back on its own
+    madvise(pFile->mpData,pFile->mnSize,MADV_DONTNEED);
+
+    cout << "Map " << pMap->GetId() << " stored: " << pFile->mvpKeyFrames.size() << " keyframes, "
+         << pFile->mvpMapPoints.size() << " map points, " << pFile->mnSize << " bytes" << endl;
+
+    // From now on the objects are built from the file by LoadMap
+    pFile->mpThreadPool = pThreadPool;
+    pFile->mvpKeyFrames.assign(pFile->mvpKeyFrames.size(),static_cast<KeyFrame*>(NULL));
+    pFile->mvpMapPoints.assign(pFile->mvpMapPoints.size(),static_cast<MapPoint*>(NULL));
+    vector<CameraRecord>().swap(pFile->mvCameraRecords);
+    vector<MapRecord>().swap(pFile->mvMapRecords);
+    vector<uint64_t>().swap(pFile->mvMapMembers);
+    vector<KeyFrameRecord>().swap(pFile->mvKeyFrameRecords);
+    vector<MapPointRecord>().swap(pFile->mvMapPointRecords);
+
+    return pFile;
+}
+
+void AtlasFile::Write(ThreadPool* pThreadPool)
+{
+    Put(ATLAS,Range{0,1},&mAtlasRecord);
+    Put(CAMERAS,Range{0,mvCameraRecords.size()},mvCameraRecords.data());
+    Put(MAPS,Range{0,mvMapRecords.size()},mvMapRecords.data());
+    Put(MAP_MEMBERS,Range{0,mvMapMembers.size()},mvMapMembers.data());
+    Put(KEYFRAMES,Range{0,mvKeyFrameRecords.size()},mvKeyFrameRecords.data());
+    Put(MAPPOINTS,Range{0,mvMapPointRecords.size()},mvMapPointRecords.data());
+
+    for(size_t i=0; i<mvpCameras.size(); i++)
+        Put(FLOATS,mvCameraRecords[i].parameters,mvpCameras[i]->mvParameters.data());
+
+    for(size_t i=0; i<mvpMaps.size(); i++)
+        Put(IDS,mvMapRecords[i].originIds,mvpMaps[i]->mvBackupKeyFrameOriginsId.data());
+
+    // Every object writes its own ranges
+    PreintegratedRecord* pImuRecords = Data<PreintegratedRecord>(KEYFRAME_IMU);
+    ThreadPool::ParallelFor(pThreadPool, mvpKeyFrames.size(), [&](int i){
+        WriteKeyFrame(mvpKeyFrames[i],mvKeyFrameRecords[i],pImuRecords[i]);
+        SE3ToArray(mvpKeyFrames[i]->mTcw,Data<SE3Record>(KEYFRAME_POSES)[i].data);
+    });
+
+    ThreadPool::ParallelFor(pThreadPool, mvpMapPoints.size(), [&](int i){
+        WriteMapPoint(mvpMapPoints[i],mvMapPointRecords[i]);
+        const Eigen::Vector3f &pos = mvpMapPoints[i]->mWorldPos;
+        PositionRecord &position = Data<PositionRecord>(MAPPOINT_POSITIONS)[i];
+        position.x = pos(0);
+        position.y = pos(1);
+        position.z = pos(2);
+    });
+}
+
+AtlasFile::Range AtlasFile::Reserve(int nSection, uint64_t count)
+{
+    Range range;
+    range.begin = mvCount[nSection];
+    range.count = count;
+    mvCount[nSection] += count;
+    return range;
+}
+
+AtlasFile::MatRecord AtlasFile::ReserveMat(const cv::Mat &mat)
+{
+    MatRecord record;
+    memset(&record,0,sizeof(record));
+    record.rows = mat.rows;
+    record.cols = mat.cols;
+    record.type = mat.type();
+    record.data = Reserve(BYTES,mat.total()*mat.elemSize());
+    return record;
+}
+
+AtlasFile::GridRecord AtlasFile::ReserveGrid(const FeatureGrid &grid)
+{
+    GridRecord record;
+    memset(&record,0,sizeof(record));
+    record.nCols = grid.mnCols;
+    record.nRows = grid.mnRows;
+    record.cells = Reserve(GRID_CELLS,grid.mvCellStart.size());
+    record.entries = Reserve(GRID_ENTRIES,grid.mvEntries.size());
+    return record;
+}
+
+void AtlasFile::Layout(const vector<Map*> &vpMaps, const vector<GeometricCamera*> &vpCameras, unsigned long nLastInitKFidMap)
+{
+    memset(&mAtlasRecord,0,sizeof(mAtlasRecord));
+    mAtlasRecord.nNextMapId = Map::nNextId;
+    mAtlasRecord.nNextFrameId = Frame::nNextId;
+    mAtlasRecord.nNextKeyFrameId = KeyFrame::nNextId;
+    mAtlasRecord.nNextMapPointId = MapPoint::nNextId;
+    mAtlasRecord.nNextCameraId = GeometricCamera::nNextId;
+    mAtlasRecord.nLastInitKFidMap = nLastInitKFidMap;
+    Reserve(ATLAS,1);
+
+    mvpCameras = vpCameras;
+    for(GeometricCamera* pCam : mvpCameras)
+    {
+        CameraRecord record;
+        memset(&record,0,sizeof(record));
+        record.nId = pCam->mnId;
+        record.nType = pCam->mnType;
+        if(pCam->mnType==GeometricCamera::CAM_FISHEYE)
+            record.precision = static_cast<KannalaBrandt8*>(pCam)->GetPrecision();
+        record.parameters = Reserve(FLOATS,pCam->mvParameters.size());
+        mvCameraRecords.push_back(record);
+    }
+    Reserve(CAMERAS,mvCameraRecords.size());
+
+    // A keyframe or point listed by several maps is stored once
+    unordered_map<KeyFrame*,uint64_t> mKeyFrameIndex;
+    unordered_map<MapPoint*,uint64_t> mMapPointIndex;
+
+    for(Map* pMap : vpMaps)
+    {
+        if(!pMap)
+            continue;
+
+        MapRecord record;
+        memset(&record,0,sizeof(record));
+        record.nId = pMap->mnId;
+        record.nInitKFid = pMap->mnInitKFid;
+        record.nMaxKFid = pMap->mnMaxKFid;
+        record.nBackupKFinitialID = pMap->mnBackupKFinitialID;
+        record.nBackupKFlowerID = pMap->mnBackupKFlowerID;
+        record.nBigChangeIdx = pMap->mnBigChangeIdx;
+        record.bImuInitialized = pMap->mbImuInitialized;
+        record.bIsInertial = pMap->mbIsInertial;
+        record.bIMU_BA1 = pMap->mbIMU_BA1;
+        record.bIMU_BA2 = pMap->mbIMU_BA2;
+
+        record.keyFrames.begin = mvMapMembers.size();
+        for(KeyFrame* pKF : pMap->mvpBackupKeyFrames)
+        {
+            auto it = mKeyFrameIndex.insert(make_pair(pKF,(uint64_t)mvpKeyFrames.size()));
+            if(it.second)
+                mvpKeyFrames.push_back(pKF);
+            mvMapMembers.push_back(it.first->second);
+        }
+        record.keyFrames.count = mvMapMembers.size()-record.keyFrames.begin;
+
+        record.mapPoints.begin = mvMapMembers.size();
+        for(MapPoint* pMP : pMap->mvpBackupMapPoints)
+        {
+            auto it = mMapPointIndex.insert(make_pair(pMP,(uint64_t)mvpMapPoints.size()));
+            if(it.second)
+                mvpMapPoints.push_back(pMP);
+            mvMapMembers.push_back(it.first->second);
+        }
+        record.mapPoints.count = mvMapMembers.size()-record.mapPoints.begin;
+
+        record.originIds = Reserve(IDS,pMap->mvBackupKeyFrameOriginsId.size());
+
+        mvpMaps.push_back(pMap);
+        mvMapRecords.push_back(record);
+    }
+    Reserve(MAPS,mvMapRecords.size());
+    Reserve(MAP_MEMBERS,mvMapMembers.size());
+
+    mvKeyFrameRecords.resize(mvpKeyFrames.size());
+    for(size_t i=0; i<mvpKeyFrames.size(); i++)
+        LayoutKeyFrame(mvpKeyFrames[i],mvKeyFrameRecords[i]);
+    Reserve(KEYFRAMES,mvpKeyFrames.size());
+    Reserve(KEYFRAME_POSES,mvpKeyFrames.size());
+    Reserve(KEYFRAME_IMU,mvpKeyFrames.size());
+
+    mvMapPointRecords.resize(mvpMapPoints.size());
+    for(size_t i=0; i<mvpMapPoints.size(); i++)
+        LayoutMapPoint(mvpMapPoints[i],mvMapPointRecords[i]);
+    Reserve(MAPPOINTS,mvpMapPoints.size());
+    Reserve(MAPPOINT_POSITIONS,mvpMapPoints.size());
+}
+
+void AtlasFile::LayoutKeyFrame(KeyFrame* pKF, KeyFrameRecord &r)
+{
+    memset(&r,0,sizeof(r));
+
+    r.nId = pKF->mnId;
+    r.nFrameId = pKF->mnFrameId;
+    r.timeStamp = pKF->mTimeStamp;
+    r.nGridCols = pKF->mnGridCols;
+    r.nGridRows = pKF->mnGridRows;
+    r.gridElementWidthInv = pKF->mfGridElementWidthInv;
+    r.gridElementHeightInv = pKF->mfGridElementHeightInv;
+    r.scale = pKF->mfScale;
+    r.fx = pKF->fx;
+    r.fy = pKF->fy;
+    r.invfx = pKF->invfx;
+    r.invfy = pKF->invfy;
+    r.cx = pKF->cx;
+    r.cy = pKF->cy;
+    r.bf = pKF->mbf;
+    r.b = pKF->mb;
+    r.thDepth = pKF->mThDepth;
+    r.N = pKF->N;
+    r.nScaleLevels = pKF->mnScaleLevels;
+    r.scaleFactor = pKF->mfScaleFactor;
+    r.logScaleFactor = pKF->mfLogScaleFactor;
+    r.nMinX = pKF->mnMinX;
+    r.nMinY = pKF->mnMinY;
+    r.nMaxX = pKF->mnMaxX;
+    r.nMaxY = pKF->mnMaxY;
+    memcpy(r.K,pKF->mK_.data(),sizeof(r.K));
+    SE3ToArray(pKF->mTcp,r.Tcp.data);
+    SE3ToArray(pKF->mTlr,r.Tlr.data);
+    r.nParentId = pKF->mBackupParentId;
+    r.nPrevKFId = pKF->mBackupPrevKFId;
+    r.nNextKFId = pKF->mBackupNextKFId;
+    r.nOriginMapId = pKF->mnOriginMapId;
+    r.nCameraId = pKF->mnBackupIdCamera;
+    r.nCamera2Id = pKF->mnBackupIdCamera2;
+    r.NLeft = pKF->NLeft;
+    r.NRight = pKF->NRight;
+    r.halfBaseline = pKF->mHalfBaseline;
+    BiasToArray(pKF->mImuBias,r.imuBias);
+    SE3ToArray(pKF->mImuCalib.mTcb,r.imuTcb.data);
+    SE3ToArray(pKF->mImuCalib.mTbc,r.imuTbc.data);
+    memcpy(r.imuCov,pKF->mImuCalib.Cov.diagonal().data(),sizeof(r.imuCov));
+    memcpy(r.imuCovWalk,pKF->mImuCalib.CovWalk.diagonal().data(),sizeof(r.imuCovWalk));
+    memcpy(r.Vw,pKF->mVw.data(),sizeof(r.Vw));
+    memcpy(r.Owb,pKF->mOwb.data(),sizeof(r.Owb));
+    r.bFirstConnection = pKF->mbFirstConnection;
+    r.bNotErase = pKF->mbNotErase;
+    r.bToBeErased = pKF->mbToBeErased;
+    r.bBad = pKF->mbBad;
+    r.bImu = pKF->bImu;
+    r.bHasVelocity = pKF->mbHasVelocity;
+    r.bImuCalibSet = pKF->mImuCalib.mbIsSet;
+
+    r.distCoef = ReserveMat(pKF->mDistCoef);
+    r.descriptors = ReserveMat(pKF->mDescriptors);
+
+    r.uRight = Reserve(FLOATS,pKF->mvuRight.size());
+    r.depth = Reserve(FLOATS,pKF->mvDepth.size());
+    r.scaleFactors = Reserve(FLOATS,pKF->mvScaleFactors.size());
+    r.levelSigma2 = Reserve(FLOATS,pKF->mvLevelSigma2.size());
+    r.invLevelSigma2 = Reserve(FLOATS,pKF->mvInvLevelSigma2.size());
+
+    r.keys = Reserve(KEYPOINTS,pKF->mvKeys.size());
+    r.keysUn = Reserve(KEYPOINTS,pKF->mvKeysUn.size());
+    r.keysRight = Reserve(KEYPOINTS,pKF->mvKeysRight.size());
+
+    r.mapPointIds = Reserve(IDS,pKF->mvBackupMapPointsId.size());
+    r.childrenIds = Reserve(IDS,pKF->mvBackupChildrensId.size());
+    r.loopEdgeIds = Reserve(IDS,pKF->mvBackupLoopEdgesId.size());
+    r.mergeEdgeIds = Reserve(IDS,pKF->mvBackupMergeEdgesId.size());
+
+    r.leftToRightMatch = Reserve(INTS,pKF->mvLeftToRightMatch.size());
+    r.rightToLeftMatch = Reserve(INTS,pKF->mvRightToLeftMatch.size());
+
+    r.connections = Reserve(CONNECTIONS,pKF->mBackupConnectedKeyFrameIdWeights.size());
+    r.words = Reserve(WORDS,pKF->mBowVec.size());
+
+    size_t nFeatures = 0;
+    for(DBoW2::FeatureVector::const_iterator it=pKF->mFeatVec.begin(); it!=pKF->mFeatVec.end(); ++it)
+        nFeatures += it->second.size();
+    r.features = Reserve(FEATURES,nFeatures);
+
+    r.imuMeasurements = Reserve(IMU_MEASUREMENTS,pKF->mBackupImuPreintegrated.mvMeasurements.size());
+
+    r.grid = ReserveGrid(pKF->mGrid);
+    r.gridRight = ReserveGrid(pKF->mGridRight);
+}
+
+void AtlasFile::LayoutMapPoint(MapPoint* pMP, MapPointRecord &r)
+{
+    memset(&r,0,sizeof(r));
+
+    r.nId = pMP->mnId;
+    r.nFirstKFid = pMP->mnFirstKFid;
+    r.nFirstFrame = pMP->mnFirstFrame;
+    r.nRefKFId = pMP->mBackupRefKFId;
+    r.nReplacedId = pMP->mBackupReplacedId;
+    r.nObs = pMP->nObs;
+    r.bBad = pMP->mbBad;
+    memcpy(r.normal,pMP->mNormalVector.data(),sizeof(r.normal));
+    r.minDistance = pMP->mfMinDistance;
+    r.maxDistance = pMP->mfMaxDistance;
+    r.descriptor = ReserveMat(pMP->mDescriptor);
+    r.observations = Reserve(OBSERVATIONS,pMP->mBackupObservationsId1.size());
+}
+
+bool AtlasFile::Create(const string &filename, const string &strVocabularyName, const string &strVocabularyChecksum)
+{
+    Header h;
+    memset(&h,0,sizeof(h));
+    if(strVocabularyName.size()>=sizeof(h.vocabularyName) || strVocabularyChecksum.size()>=sizeof(h.vocabularyChecksum))
+    {
+        cerr << "Vocabulary name or checksum too long for the atlas file" << endl;
+        return false;
+    }
+
+    memcpy(h.magic,AtlasFileMagic,sizeof(h.magic));
+    h.version = VERSION;
+    h.endianness = ENDIANNESS;
+    memcpy(h.vocabularyName,strVocabularyName.c_str(),strVocabularyName.size());
+    memcpy(h.vocabularyChecksum,strVocabularyChecksum.c_str(),strVocabularyChecksum.size());
+
+    // Sections are 8 byte aligned, so their elements can be read in place
+    uint64_t offset = (sizeof(Header)+7) & ~(uint64_t)7;
+    for(int i=0; i<NUM_SECTIONS; i++)
+    {
+        mvOffset[i] = offset;
+        h.elementSize[i] = ElementSize[i];
+        h.sectionOffset[i] = offset;
+        h.sectionCount[i] = mvCount[i];
+        offset = (offset+mvCount[i]*ElementSize[i]+7) & ~(uint64_t)7;
+    }
+    h.fileSize = offset;
+
+    std::remove(filename.c_str());
+    const int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd<0)
+    {
+        cerr << "Could not create the atlas file " << filename << endl;
+        return false;
+    }
+
+    // Reserving the blocks makes a full disk fail here instead of when the pages are written back
+    if(ftruncate(fd,h.fileSize)!=0 || posix_fallocate(fd,0,h.fileSize)!=0)
+    {
+        close(fd);
+        unlink(filename.c_str());
+        cerr << "Could not allocate " << h.fileSize << " bytes for the atlas file " << filename << endl;
+        return false;
+    }
+
+    void* addr = mmap(NULL, h.fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr==MAP_FAILED)
+    {
+        unlink(filename.c_str());
+        cerr << "Could not map the atlas file " << filename << endl;
+        return false;
+    }
+
+    mpData = static_cast<unsigned char*>(addr);
+    mnSize = h.fileSize;
+    memcpy(mpData,&h,sizeof(h));
+
+    return true;
+}
+
+void AtlasFile::WriteMat(const cv::Mat &mat, const MatRecord &record)
+{
+    if(mat.isContinuous())
+    {
+        Put(BYTES,record.data,mat.data);
+        return;
+    }
+
+    const size_t rowSize = mat.cols*mat.elemSize();
+    unsigned char* pDst = Data<unsigned char>(BYTES)+record.data.begin;
+    for(int i=0; i<mat.rows; i++)
+        memcpy(pDst+i*rowSize,mat.ptr(i),rowSize);
+}
+
+void AtlasFile::WriteGrid(const FeatureGrid &grid, const GridRecord &record)
+{
+    Put(GRID_CELLS,record.cells,grid.mvCellStart.data());
+    Put(GRID_ENTRIES,record.entries,grid.mvEntries.data());
+}
+
+void AtlasFile::WriteKeyPoints(const vector<cv::KeyPoint> &vKeys, KeyPointRecord* pRecords)
+{
+    for(size_t i=0; i<vKeys.size(); i++)
+    {
+        const cv::KeyPoint &kp = vKeys[i];
+        KeyPointRecord &r = pRecords[i];
+        r.x = kp.pt.x;
+        r.y = kp.pt.y;
+        r.size = kp.size;
+        r.angle = kp.angle;
+        r.response = kp.response;
+        r.octave = kp.octave;
+        r.classId = kp.class_id;
+    }
+}
+
+void AtlasFile::WriteKeyFrame(KeyFrame* pKF, const KeyFrameRecord &r, PreintegratedRecord &imu)
+{
+    WriteMat(pKF->mDistCoef,r.distCoef);
+    WriteMat(pKF->mDescriptors,r.descriptors);
+
+    Put(FLOATS,r.uRight,pKF->mvuRight.data());
+    Put(FLOATS,r.depth,pKF->mvDepth.data());
+    Put(FLOATS,r.scaleFactors,pKF->mvScaleFactors.data());
+    Put(FLOATS,r.levelSigma2,pKF->mvLevelSigma2.data());
+    Put(FLOATS,r.invLevelSigma2,pKF->mvInvLevelSigma2.data());
+
+    WriteKeyPoints(pKF->mvKeys,Data<KeyPointRecord>(KEYPOINTS)+r.keys.begin);
+    WriteKeyPoints(pKF->mvKeysUn,Data<KeyPointRecord>(KEYPOINTS)+r.keysUn.begin);
+    WriteKeyPoints(pKF->mvKeysRight,Data<KeyPointRecord>(KEYPOINTS)+r.keysRight.begin);
+
+    Put(IDS,r.mapPointIds,pKF->mvBackupMapPointsId.data());
+    Put(IDS,r.childrenIds,pKF->mvBackupChildrensId.data());
+    Put(IDS,r.loopEdgeIds,pKF->mvBackupLoopEdgesId.data());
+    Put(IDS,r.mergeEdgeIds,pKF->mvBackupMergeEdgesId.data());
+
+    Put(INTS,r.leftToRightMatch,pKF->mvLeftToRightMatch.data());
+    Put(INTS,r.rightToLeftMatch,pKF->mvRightToLeftMatch.data());
+
+    ConnectionRecord* pConnection = Data<ConnectionRecord>(CONNECTIONS)+r.connections.begin;
+    for(map<long unsigned int,int>::const_iterator it=pKF->mBackupConnectedKeyFrameIdWeights.begin(); it!=pKF->mBackupConnectedKeyFrameIdWeights.end(); ++it, ++pConnection)
+    {
+        pConnection->nKFId = it->first;
+        pConnection->weight = it->second;
+        pConnection->pad = 0;
+    }
+
+    WordRecord* pWord = Data<WordRecord>(WORDS)+r.words.begin;
+    for(DBoW2::BowVector::const_iterator it=pKF->mBowVec.begin(); it!=pKF->mBowVec.end(); ++it, ++pWord)
+    {
+        pWord->nWordId = it->first;
+        pWord->pad = 0;
+        pWord->value = it->second;
+    }
+
+    FeatureRecord* pFeature = Data<FeatureRecord>(FEATURES)+r.features.begin;
+    for(DBoW2::FeatureVector::const_iterator it=pKF->mFeatVec.begin(); it!=pKF->mFeatVec.end(); ++it)
+    {
+        for(DBoW2::FeatureIndices::const_iterator fit=it->second.begin(); fit!=it->second.end(); ++fit, ++pFeature)
+        {
+            pFeature->nNodeId = it->first;
+            pFeature->nIndex = *fit;
+        }
+    }
+
+    WriteGrid(pKF->mGrid,r.grid);
+    WriteGrid(pKF->mGridRight,r.gridRight);
+
+    const IMU::Preintegrated &pre = pKF->mBackupImuPreintegrated;
+    imu.dT = pre.dT;
+    memcpy(imu.C,pre.C.data(),sizeof(imu.C));
+    memcpy(imu.Info,pre.Info.data(),sizeof(imu.Info));
+    memcpy(imu.Nga,pre.Nga.diagonal().data(),sizeof(imu.Nga));
+    memcpy(imu.NgaWalk,pre.NgaWalk.diagonal().data(),sizeof(imu.NgaWalk));
+    BiasToArray(pre.b,imu.b);
+    memcpy(imu.dR,pre.dR.data(),sizeof(imu.dR));
+    memcpy(imu.dV,pre.dV.data(),sizeof(imu.dV));
+    memcpy(imu.dP,pre.dP.data(),sizeof(imu.dP));
+    memcpy(imu.JRg,pre.JRg.data(),sizeof(imu.JRg));
+    memcpy(imu.JVg,pre.JVg.data(),sizeof(imu.JVg));
+    memcpy(imu.JVa,pre.JVa.data(),sizeof(imu.JVa));
+    memcpy(imu.JPg,pre.JPg.data(),sizeof(imu.JPg));
+    memcpy(imu.JPa,pre.JPa.data(),sizeof(imu.JPa));
+    memcpy(imu.avgA,pre.avgA.data(),sizeof(imu.avgA));
+    memcpy(imu.avgW,pre.avgW.data(),sizeof(imu.avgW));
+    BiasToArray(pre.bu,imu.bu);
+    memcpy(imu.db,pre.db.data(),sizeof(imu.db));
+
+    ImuMeasurementRecord* pMeasurement = Data<ImuMeasurementRecord>(IMU_MEASUREMENTS)+r.imuMeasurements.begin;
+    for(size_t i=0; i<pre.mvMeasurements.size(); i++, ++pMeasurement)
+    {
+        const IMU::Preintegrated::integrable &m = pre.mvMeasurements[i];
+        memcpy(pMeasurement->a,m.a.data(),sizeof(pMeasurement->a));
+        memcpy(pMeasurement->w,m.w.data(),sizeof(pMeasurement->w));
+        pMeasurement->t = m.t;
+    }
+}
+
+void AtlasFile::WriteMapPoint(MapPoint* pMP, const MapPointRecord &r)
+{
+    WriteMat(pMP->mDescriptor,r.descriptor);
+
+    ObservationRecord* pObservation = Data<ObservationRecord>(OBSERVATIONS)+r.observations.begin;
+    for(map<long unsigned int,int>::const_iterator it=pMP->mBackupObservationsId1.begin(); it!=pMP->mBackupObservationsId1.end(); ++it, ++pObservation)
+    {
+        map<long unsigned int,int>::const_iterator it2 = pMP->mBackupObservationsId2.find(it->first);
+        pObservation->nKFId = it->first;
+        pObservation->leftIndex = it->second;
+        pObservation->rightIndex = it2!=pMP->mBackupObservationsId2.end() ? it2->second : -1;
+    }
+}
+
+bool AtlasFile::Load(const string &filename, Atlas* pAtlas, string &strVocabularyName,
+                     string &strVocabularyChecksum, ThreadPool* pThreadPool)
+{
+    AtlasFile* pFile = new AtlasFile();
+    AtlasFile &file = *pFile;
+    if(!file.Open(filename))
+    {
+        delete pFile;
+        return false;
+    }
+
+    const Header* h = reinterpret_cast<const Header*>(file.mpData);
+    strVocabularyName = h->vocabularyName;
+    strVocabularyChecksum = h->vocabularyChecksum;
+
+    const uint64_t nKFs = file.mvCount[KEYFRAMES];
+    const uint64_t nMPs = file.mvCount[MAPPOINTS];
+    bool bOk = file.mvCount[ATLAS]==1 && file.mvCount[KEYFRAME_POSES]==nKFs && file.mvCount[KEYFRAME_IMU]==nKFs &&
+               file.mvCount[MAPPOINT_POSITIONS]==nMPs;
+
+    vector<GeometricCamera*> vpCameras;
+    const CameraRecord* pCameraRecords = file.Data<CameraRecord>(CAMERAS);
+    for(uint64_t i=0; i<file.mvCount[CAMERAS] && bOk; i++)
+    {
+        const CameraRecord &r = pCameraRecords[i];
+        vector<float> vParameters;
+        bOk = file.Get(FLOATS,r.parameters,vParameters);
+        if(!bOk)
+            break;
+
+        GeometricCamera* pCam;
+        if(r.nType==GeometricCamera::CAM_PINHOLE && vParameters.size()==4)
+            pCam = new Pinhole(vParameters);
+        else if(r.nType==GeometricCamera::CAM_FISHEYE && vParameters.size()==8)
+            pCam = new KannalaBrandt8(vParameters,r.precision);
+        else
+        {
+            bOk = false;
+            break;
+        }
+        pCam->mnId = r.nId;
+        vpCameras.push_back(pCam);
+    }
+
+    // Only the maps are created here, their keyframes and map points stay in the file until LoadMap
+    vector<Map*> vpMaps;
+    const MapRecord* pMapRecords = file.Data<MapRecord>(MAPS);
+    const uint64_t* pMembers = file.Data<uint64_t>(MAP_MEMBERS);
+    for(uint64_t i=0; i<file.mvCount[MAPS] && bOk; i++)
+    {
+        const MapRecord &r = pMapRecords[i];
+        if(!file.IsValid(MAP_MEMBERS,r.keyFrames) || !file.IsValid(MAP_MEMBERS,r.mapPoints))
+        {
+            bOk = false;
+            break;
+        }
+
+        for(uint64_t j=r.keyFrames.begin; j<r.keyFrames.begin+r.keyFrames.count && bOk; j++)
+            bOk = pMembers[j]<nKFs;
+        for(uint64_t j=r.mapPoints.begin; j<r.mapPoints.begin+r.mapPoints.count && bOk; j++)
+            bOk = pMembers[j]<nMPs;
+
+        Map* pMap = new Map();
+        vpMaps.push_back(pMap);
+
+        pMap->mnId = r.nId;
+        pMap->mnInitKFid = r.nInitKFid;
+        pMap->mnMaxKFid = r.nMaxKFid;
+        pMap->mnBackupKFinitialID = r.nBackupKFinitialID;
+        pMap->mnBackupKFlowerID = r.nBackupKFlowerID;
+        pMap->mnBigChangeIdx = r.nBigChangeIdx;
+        pMap->mbImuInitialized = r.bImuInitialized;
+        pMap->mbIsInertial = r.bIsInertial;
+        pMap->mbIMU_BA1 = r.bIMU_BA1;
+        pMap->mbIMU_BA2 = r.bIMU_BA2;
+        bOk = bOk && file.Get(IDS,r.originIds,pMap->mvBackupKeyFrameOriginsId);
+    }
+
+    if(!bOk)
+    {
+        cerr << "Corrupted atlas file " << filename << endl;
+        for(Map* pMap : vpMaps)
+            delete pMap;
+        for(GeometricCamera* pCam : vpCameras)
+        {
+            if(pCam->GetType()==GeometricCamera::CAM_FISHEYE)
+                delete static_cast<KannalaBrandt8*>(pCam);
+            else
+                delete static_cast<Pinhole*>(pCam);
+        }
+        delete pFile;
+        return false;
+    }
+
+    file.mpThreadPool = pThreadPool;
+    file.mvpMaps = vpMaps;
+    file.mvpKeyFrames.assign(nKFs,static_cast<KeyFrame*>(NULL));
+    file.mvpMapPoints.assign(nMPs,static_cast<MapPoint*>(NULL));
+
+    pAtlas->mvpBackupMaps = vpMaps;
+    pAtlas->mvpCameras = vpCameras;
+    pAtlas->mnLastInitKFidMap = file.Data<AtlasRecord>(ATLAS)->nLastInitKFidMap;
+    // The file is deleted with the last of its maps to be loaded
+    std::shared_ptr<AtlasFile> pShared(pFile);
+    for(Map* pMap : vpMaps)
+        pAtlas->mmpUnloadedMaps[pMap] = pShared;
+
+    // After creating the objects, whose constructors take new ids
+    const AtlasRecord &atlasRecord = file.Data<AtlasRecord>(ATLAS)[0];
+    Map::nNextId = atlasRecord.nNextMapId;
+    Frame::nNextId = atlasRecord.nNextFrameId;
+    KeyFrame::nNextId = atlasRecord.nNextKeyFrameId;
+    MapPoint::nNextId = atlasRecord.nNextMapPointId;
+    GeometricCamera::nNextId = atlasRecord.nNextCameraId;
+
+    cout << "Atlas opened: " << vpMaps.size() << " maps, " << nKFs << " keyframes, " << nMPs << " map points" << endl;
+    return true;
+}
+
+bool AtlasFile::AddPlaceRecognitionSummary(Map* pMap, KeyFrameDatabase* pKFDB)
+{
+    const size_t nMap = find(mvpMaps.begin(),mvpMaps.end(),pMap)-mvpMaps.begin();
+    if(nMap==mvpMaps.size())
+        return false;
+
+    const MapRecord &r = Data<MapRecord>(MAPS)[nMap];
+    const uint64_t* pMembers = Data<uint64_t>(MAP_MEMBERS);
+    const KeyFrameRecord* pKFRecords = Data<KeyFrameRecord>(KEYFRAMES);
+    const WordRecord* pWords = Data<WordRecord>(WORDS);
+
+    vector<pair<DBoW2::WordId,DBoW2::WordValue> > vWords;
+    DBoW2::BowVector bowVec;
+    for(uint64_t j=r.keyFrames.begin; j<r.keyFrames.begin+r.keyFrames.count; j++)
+    {
+        const KeyFrameRecord &kf = pKFRecords[pMembers[j]];
+        if(kf.bBad)
+            continue;
+        if(!IsValid(WORDS,kf.words))
+            return false;
+
+        vWords.resize(kf.words.count);
+        for(uint64_t i=0; i<kf.words.count; i++)
+            vWords[i] = make_pair(pWords[kf.words.begin+i].nWordId,pWords[kf.words.begin+i].value);
+        bowVec.setWords(vWords,false);
+
+        if(!pKFDB->addStored(pMap,bowVec))
+            return false;
+    }
+
+    return true;
+}
+
+bool AtlasFile::LoadMap(Map* pMap)
+{
+    const size_t nMap = find(mvpMaps.begin(),mvpMaps.end(),pMap)-mvpMaps.begin();
+    if(nMap==mvpMaps.size())
+        return false;
+
+    const MapRecord &r = Data<MapRecord>(MAPS)[nMap];
+    const uint64_t* pMembers = Data<uint64_t>(MAP_MEMBERS);
+
+    // A keyframe or point listed by several maps is built once
+    vector<uint64_t> vnNewKFs, vnNewMPs;
+    for(uint64_t j=r.keyFrames.begin; j<r.keyFrames.begin+r.keyFrames.count; j++)
+    {
+        if(!mvpKeyFrames[pMembers[j]])
+        {
+            mvpKeyFrames[pMembers[j]] = new KeyFrame();
+            vnNewKFs.push_back(pMembers[j]);
+        }
+    }
+    for(uint64_t j=r.mapPoints.begin; j<r.mapPoints.begin+r.mapPoints.count; j++)
+    {
+        if(!mvpMapPoints[pMembers[j]])
+        {
+            mvpMapPoints[pMembers[j]] = new MapPoint();
+            vnNewMPs.push_back(pMembers[j]);
+        }
+    }
+
+    vector<char> vbKFOk(vnNewKFs.size(),0), vbMPOk(vnNewMPs.size(),0);
+
+    const KeyFrameRecord* pKFRecords = Data<KeyFrameRecord>(KEYFRAMES);
+    const SE3Record* pPoses = Data<SE3Record>(KEYFRAME_POSES);
+    const PreintegratedRecord* pImuRecords = Data<PreintegratedRecord>(KEYFRAME_IMU);
+    ThreadPool::ParallelFor(mpThreadPool, vnNewKFs.size(), [&](int i){
+        const uint64_t k = vnNewKFs[i];
+        vbKFOk[i] = ReadKeyFrame(mvpKeyFrames[k],pKFRecords[k],pImuRecords[k]);
+        ArrayToSE3(pPoses[k].data,mvpKeyFrames[k]->mTcw);
+    });
+
+    const MapPointRecord* pMPRecords = Data<MapPointRecord>(MAPPOINTS);
+    const PositionRecord* pPositions = Data<PositionRecord>(MAPPOINT_POSITIONS);
+    ThreadPool::ParallelFor(mpThreadPool, vnNewMPs.size(), [&](int i){
+        const uint64_t k = vnNewMPs[i];
+        vbMPOk[i] = ReadMapPoint(mvpMapPoints[k],pMPRecords[k]);
+        mvpMapPoints[k]->mWorldPos << pPositions[k].x, pPositions[k].y, pPositions[k].z;
+    });
+
+    bool bOk = true;
+    for(size_t i=0; i<vbKFOk.size() && bOk; i++)
+        bOk = vbKFOk[i];
+    for(size_t i=0; i<vbMPOk.size() && bOk; i++)
+        bOk = vbMPOk[i];
+
+    // The observations index the keypoints of their keyframes. Those of keyframes not in the map are
+    // dropped by MapPoint::PostLoad.
+    if(bOk)
+    {
+        map<unsigned long,int> mnKeyFrameN;
+        for(uint64_t j=r.keyFrames.begin; j<r.keyFrames.begin+r.keyFrames.count; j++)
+            mnKeyFrameN[mvpKeyFrames[pMembers[j]]->mnId] = mvpKeyFrames[pMembers[j]]->N;
+
+        for(size_t i=0; i<vnNewMPs.size() && bOk; i++)
+        {
+            MapPoint* pMP = mvpMapPoints[vnNewMPs[i]];
+            for(map<long unsigned int,int>::const_iterator it=pMP->mBackupObservationsId1.begin(); it!=pMP->mBackupObservationsId1.end() && bOk; it++)
+            {
+                map<unsigned long,int>::const_iterator itN = mnKeyFrameN.find(it->first);
+                if(itN==mnKeyFrameN.end())
+                    continue;
+                const int rightIndex = pMP->mBackupObservationsId2[it->first];
+                bOk = it->second>=-1 && it->second<itN->second && rightIndex>=-1 && rightIndex<itN->second;
+            }
+        }
+    }
+
+    if(!bOk)
+    {
+        cerr << "Corrupted map " << pMap->GetId() << " in the atlas file" << endl;
+        for(uint64_t k : vnNewKFs)
+        {
+            delete mvpKeyFrames[k];
+            mvpKeyFrames[k] = static_cast<KeyFrame*>(NULL);
+        }
+        for(uint64_t k : vnNewMPs)
+        {
+            delete mvpMapPoints[k];
+            mvpMapPoints[k] = static_cast<MapPoint*>(NULL);
+        }
+        return false;
+    }
+
+    pMap->mvpBackupKeyFrames.clear();
+    pMap->mvpBackupMapPoints.clear();
+    for(uint64_t j=r.keyFrames.begin; j<r.keyFrames.begin+r.keyFrames.count; j++)
+        pMap->mvpBackupKeyFrames.push_back(mvpKeyFrames[pMembers[j]]);
+    for(uint64_t j=r.mapPoints.begin; j<r.mapPoints.begin+r.mapPoints.count; j++)
+        pMap->mvpBackupMapPoints.push_back(mvpMapPoints[pMembers[j]]);
+
+    cout << "Map " << pMap->GetId() << " loaded: " << r.keyFrames.count << " keyframes, " << r.mapPoints.count << " map points" << endl;
+    return true;
+}
+
+void AtlasFile::UnloadMap(Map* pMap)
+{
+    // The map is left as Load creates it
+    set<KeyFrame*> spKeyFrames;
+    set<MapPoint*> spMapPoints;
+    {
+        unique_lock<mutex> lock(pMap->mMutexMap);
+        spKeyFrames.swap(pMap->mspKeyFrames);
+        spMapPoints.swap(pMap->mspMapPoints);
+        pMap->mMapPointIndex.Clear();
+        pMap->mKeyFrameIndex.Clear();
+        pMap->mvpKeyFrameOrigins.clear();
+        pMap->mvpReferenceMapPoints.clear();
+        pMap->mvpBackupKeyFrames.clear();
+        pMap->mvpBackupMapPoints.clear();
+        pMap->mpKFinitial = static_cast<KeyFrame*>(NULL);
+        pMap->mpKFlowerID = static_cast<KeyFrame*>(NULL);
+        pMap->mpFirstRegionKF = static_cast<KeyFrame*>(NULL);
+    }
+
+    for(KeyFrame* pKF : spKeyFrames)
+    {
+        if(pKF->mpImuPreintegrated!=&pKF->mBackupImuPreintegrated)
+            delete pKF->mpImuPreintegrated;
+        delete pKF;
+    }
+    for(MapPoint* pMP : spMapPoints)
+        delete pMP;
+}
+
+bool AtlasFile::Open(const string &filename)
+{
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if(fd<0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd,&st)!=0 || st.st_size<(off_t)sizeof(Header))
+    {
+        close(fd);
+        return false;
+    }
+
+    const size_t size = st.st_size;
+    void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(addr==MAP_FAILED)
+        return false;
+
+    // The keyframes are read in parallel from all over the file
+    madvise(addr, size, MADV_WILLNEED);
+
+    mpData = static_cast<unsigned char*>(addr);
+    mnSize = size;
+
+    const Header* h = static_cast<const Header*>(addr);
+    if(memcmp(h->magic,AtlasFileMagic,sizeof(h->magic))!=0 || h->endianness!=ENDIANNESS ||
+       h->fileSize!=size || h->vocabularyName[sizeof(h->vocabularyName)-1]!='\0' ||
+       h->vocabularyChecksum[sizeof(h->vocabularyChecksum)-1]!='\0')
+    {
+        cerr << "Not a valid atlas file " << filename << endl;
+        return false;
+    }
+
+    if(h->version!=VERSION)
+    {
+        cerr << "Atlas file version " << h->version << " is not supported (expected " << VERSION << ")" << endl;
+        return false;
+    }
+
+    for(int i=0; i<NUM_SECTIONS; i++)
+    {
+        if(h->elementSize[i]!=ElementSize[i] || h->sectionOffset[i]%8!=0 || h->sectionOffset[i]<sizeof(Header) ||
+           h->sectionOffset[i]>size || h->sectionCount[i]>(size-h->sectionOffset[i])/ElementSize[i])
+        {
+            cerr << "Corrupted atlas file " << filename << endl;
+            return false;
+        }
+        mvOffset[i] = h->sectionOffset[i];
+        mvCount[i] = h->sectionCount[i];
+    }
+
+    return true;
+}
+
+bool AtlasFile::ReadMat(const MatRecord &r, cv::Mat &mat)
+{
+    if(r.rows<0 || r.cols<0 || CV_MAT_TYPE(r.type)!=r.type ||
+       (uint64_t)r.rows*r.cols*CV_ELEM_SIZE(r.type)!=r.data.count || !IsValid(BYTES,r.data))
+        return false;
+
+    mat.create(r.rows,r.cols,r.type);
+    if(r.data.count>0)
+        memcpy(mat.data,Data<unsigned char>(BYTES)+r.data.begin,r.data.count);
+    return true;
+}
+
+bool AtlasFile::ReadGrid(const GridRecord &r, int nCols, int nRows, size_t nKeys, FeatureGrid &grid)
+{
+    grid.mnCols = r.nCols;
+    grid.mnRows = r.nRows;
+    if(!Get(GRID_CELLS,r.cells,grid.mvCellStart) || !Get(GRID_ENTRIES,r.entries,grid.mvEntries))
+        return false;
+
+    // The queries follow the cell offsets without checks
+    if(grid.mvCellStart.empty())
+        return grid.mvEntries.empty();
+
+    if(r.nCols!=nCols || r.nRows!=nRows || r.nCols<0 || r.nRows<0 || grid.mvCellStart.size()!=(uint64_t)r.nCols*r.nRows+1 ||
+       grid.mvCellStart.front()!=0 || grid.mvCellStart.back()!=grid.mvEntries.size())
+        return false;
+
+    for(size_t i=1; i<grid.mvCellStart.size(); i++)
+        if(grid.mvCellStart[i]<grid.mvCellStart[i-1])
+            return false;
+
+    // The entries index the keypoints of the grid
+    for(size_t i=0; i<grid.mvEntries.size(); i++)
+        if(grid.mvEntries[i].idx>=nKeys)
+            return false;
+
+    return true;
+}
+
+bool AtlasFile::ReadKeyPoints(const KeyPointRecord* pRecords, size_t n, int nLevels, vector<cv::KeyPoint> &vKeys)
+{
+    vKeys.resize(n);
+    for(size_t i=0; i<n; i++)
+    {
+        const KeyPointRecord &r = pRecords[i];
+        // The octave indexes the scale factors
+        if(r.octave<0 || r.octave>=nLevels)
+            return false;
+        vKeys[i] = cv::KeyPoint(r.x,r.y,r.size,r.angle,r.response,r.octave,r.classId);
+    }
+    return true;
+}
+
+bool AtlasFile::ReadKeyFrame(KeyFrame* pKF, const KeyFrameRecord &r, const PreintegratedRecord &imu)
+{
+    pKF->mnId = r.nId;
+    const_cast<long unsigned int&>(pKF->mnFrameId) = r.nFrameId;
+    const_cast<double&>(pKF->mTimeStamp) = r.timeStamp;
+    const_cast<int&>(pKF->mnGridCols) = r.nGridCols;
+    const_cast<int&>(pKF->mnGridRows) = r.nGridRows;
+    const_cast<float&>(pKF->mfGridElementWidthInv) = r.gridElementWidthInv;
+    const_cast<float&>(pKF->mfGridElementHeightInv) = r.gridElementHeightInv;
+    pKF->mfScale = r.scale;
+    const_cast<float&>(pKF->fx) = r.fx;
+    const_cast<float&>(pKF->fy) = r.fy;
+    const_cast<float&>(pKF->invfx) = r.invfx;
+    const_cast<float&>(pKF->invfy) = r.invfy;
+    const_cast<float&>(pKF->cx) = r.cx;
+    const_cast<float&>(pKF->cy) = r.cy;
+    const_cast<float&>(pKF->mbf) = r.bf;
+    const_cast<float&>(pKF->mb) = r.b;
+    const_cast<float&>(pKF->mThDepth) = r.thDepth;
+    const_cast<int&>(pKF->N) = r.N;
+    const_cast<int&>(pKF->mnScaleLevels) = r.nScaleLevels;
+    const_cast<float&>(pKF->mfScaleFactor) = r.scaleFactor;
+    const_cast<float&>(pKF->mfLogScaleFactor) = r.logScaleFactor;
+    const_cast<int&>(pKF->mnMinX) = r.nMinX;
+    const_cast<int&>(pKF->mnMinY) = r.nMinY;
+    const_cast<int&>(pKF->mnMaxX) = r.nMaxX;
+    const_cast<int&>(pKF->mnMaxY) = r.nMaxY;
+    memcpy(pKF->mK_.data(),r.K,sizeof(r.K));
+    ArrayToSE3(r.Tcp.data,pKF->mTcp);
+    ArrayToSE3(r.Tlr.data,pKF->mTlr);
+    pKF->mBackupParentId = r.nParentId;
+    pKF->mBackupPrevKFId = r.nPrevKFId;
+    pKF->mBackupNextKFId = r.nNextKFId;
+    pKF->mnOriginMapId = r.nOriginMapId;
+    pKF->mnBackupIdCamera = r.nCameraId;
+    pKF->mnBackupIdCamera2 = r.nCamera2Id;
+    const_cast<int&>(pKF->NLeft) = r.NLeft;
+    const_cast<int&>(pKF->NRight) = r.NRight;
+    pKF->mHalfBaseline = r.halfBaseline;
+    pKF->mImuBias = ArrayToBias(r.imuBias);
+    ArrayToSE3(r.imuTcb.data,pKF->mImuCalib.mTcb);
+    ArrayToSE3(r.imuTbc.data,pKF->mImuCalib.mTbc);
+    memcpy(pKF->mImuCalib.Cov.diagonal().data(),r.imuCov,sizeof(r.imuCov));
+    memcpy(pKF->mImuCalib.CovWalk.diagonal().data(),r.imuCovWalk,sizeof(r.imuCovWalk));
+    pKF->mImuCalib.mbIsSet = r.bImuCalibSet;
+    memcpy(pKF->mVw.data(),r.Vw,sizeof(r.Vw));
+    memcpy(pKF->mOwb.data(),r.Owb,sizeof(r.Owb));
+    pKF->mbFirstConnection = r.bFirstConnection;
+    pKF->mbNotErase = r.bNotErase;
+    pKF->mbToBeErased = r.bToBeErased;
+    pKF->mbBad = r.bBad;
+    pKF->bImu = r.bImu;
+    pKF->mbHasVelocity = r.bHasVelocity;
+
+    if(!ReadMat(r.distCoef,pKF->mDistCoef) || !ReadMat(r.descriptors,const_cast<cv::Mat&>(pKF->mDescriptors)))
+        return false;
+
+    if(!Get(FLOATS,r.uRight,const_cast<vector<float>&>(pKF->mvuRight)) ||
+       !Get(FLOATS,r.depth,const_cast<vector<float>&>(pKF->mvDepth)) ||
+       !Get(FLOATS,r.scaleFactors,const_cast<vector<float>&>(pKF->mvScaleFactors)) ||
+       !Get(FLOATS,r.levelSigma2,const_cast<vector<float>&>(pKF->mvLevelSigma2)) ||
+       !Get(FLOATS,r.invLevelSigma2,const_cast<vector<float>&>(pKF->mvInvLevelSigma2)))
+        return false;
+
+    // The per keypoint data is indexed with the keypoint indices of the matcher, the grids, the
+    // feature vector and the observations, none of which are checked at run time. Without a
+    // second camera all the N keypoints are in the left one.
+    if(r.N<0 || r.nScaleLevels<=0)
+        return false;
+    const bool bTwoCameras = r.NLeft!=-1;
+    if(bTwoCameras && (r.NLeft<0 || r.NRight<0 || r.NLeft+r.NRight!=r.N))
+        return false;
+    const uint64_t nLeft = bTwoCameras ? r.NLeft : r.N;
+    const uint64_t nRight = bTwoCameras ? r.NRight : 0;
+
+    if(pKF->mDescriptors.rows!=r.N || r.keys.count!=nLeft || r.keysUn.count!=nLeft || r.keysRight.count!=nRight ||
+       pKF->mvuRight.size()!=nLeft || pKF->mvDepth.size()!=nLeft ||
+       pKF->mvScaleFactors.size()!=(size_t)r.nScaleLevels || pKF->mvLevelSigma2.size()!=(size_t)r.nScaleLevels ||
+       pKF->mvInvLevelSigma2.size()!=(size_t)r.nScaleLevels)
+        return false;
+
+    if(!IsValid(KEYPOINTS,r.keys) || !IsValid(KEYPOINTS,r.keysUn) || !IsValid(KEYPOINTS,r.keysRight))
+        return false;
+    const KeyPointRecord* pKeyPoints = Data<KeyPointRecord>(KEYPOINTS);
+    if(!ReadKeyPoints(pKeyPoints+r.keys.begin,r.keys.count,r.nScaleLevels,const_cast<vector<cv::KeyPoint>&>(pKF->mvKeys)) ||
+       !ReadKeyPoints(pKeyPoints+r.keysUn.begin,r.keysUn.count,r.nScaleLevels,const_cast<vector<cv::KeyPoint>&>(pKF->mvKeysUn)) ||
+       !ReadKeyPoints(pKeyPoints+r.keysRight.begin,r.keysRight.count,r.nScaleLevels,const_cast<vector<cv::KeyPoint>&>(pKF->mvKeysRight)))
+        return false;
+
+    // PostLoad reads one map point id per keypoint
+    if(r.mapPointIds.count!=(uint64_t)r.N)
+        return false;
+
+    if(!Get(IDS,r.mapPointIds,pKF->mvBackupMapPointsId) ||
+       !Get(IDS,r.childrenIds,pKF->mvBackupChildrensId) ||
+       !Get(IDS,r.loopEdgeIds,pKF->mvBackupLoopEdgesId) ||
+       !Get(IDS,r.mergeEdgeIds,pKF->mvBackupMergeEdgesId))
+        return false;
+
+    if(!Get(INTS,r.leftToRightMatch,pKF->mvLeftToRightMatch) || !Get(INTS,r.rightToLeftMatch,pKF->mvRightToLeftMatch))
+        return false;
+
+    if(!IsValid(CONNECTIONS,r.connections) || !IsValid(WORDS,r.words) || !IsValid(FEATURES,r.features) ||
+       !IsValid(IMU_MEASUREMENTS,r.imuMeasurements))
+        return false;
+
+    pKF->mBackupConnectedKeyFrameIdWeights.clear();
+    const ConnectionRecord* pConnections = Data<ConnectionRecord>(CONNECTIONS)+r.connections.begin;
+    for(uint64_t i=0; i<r.connections.count; i++)
+        pKF->mBackupConnectedKeyFrameIdWeights[pConnections[i].nKFId] = pConnections[i].weight;
+
+    vector<pair<DBoW2::WordId,DBoW2::WordValue> > vWords(r.words.count);
+    const WordRecord* pWords = Data<WordRecord>(WORDS)+r.words.begin;
+    for(uint64_t i=0; i<r.words.count; i++)
+        vWords[i] = make_pair(pWords[i].nWordId,pWords[i].value);
+    pKF->mBowVec.setWords(vWords,false);
+
+    vector<pair<DBoW2::NodeId,unsigned int> > vFeatures(r.features.count);
+    const FeatureRecord* pFeatures = Data<FeatureRecord>(FEATURES)+r.features.begin;
+    for(uint64_t i=0; i<r.features.count; i++)
+    {
+        if(pFeatures[i].nIndex>=(uint64_t)r.N)
+            return false;
+        vFeatures[i] = make_pair(pFeatures[i].nNodeId,pFeatures[i].nIndex);
+    }
+    pKF->mFeatVec.setFeatures(vFeatures);
+
+    if(!ReadGrid(r.grid,r.nGridCols,r.nGridRows,nLeft,pKF->mGrid) ||
+       !ReadGrid(r.gridRight,r.nGridCols,r.nGridRows,nRight,pKF->mGridRight))
+        return false;
+
+    IMU::Preintegrated &pre = pKF->mBackupImuPreintegrated;
+    pre.dT = imu.dT;
+    memcpy(pre.C.data(),imu.C,sizeof(imu.C));
+    memcpy(pre.Info.data(),imu.Info,sizeof(imu.Info));
+    memcpy(pre.Nga.diagonal().data(),imu.Nga,sizeof(imu.Nga));
+    memcpy(pre.NgaWalk.diagonal().data(),imu.NgaWalk,sizeof(imu.NgaWalk));
+    pre.b = ArrayToBias(imu.b);
+    memcpy(pre.dR.data(),imu.dR,sizeof(imu.dR));
+    memcpy(pre.dV.data(),imu.dV,sizeof(imu.dV));
+    memcpy(pre.dP.data(),imu.dP,sizeof(imu.dP));
+    memcpy(pre.JRg.data(),imu.JRg,sizeof(imu.JRg));
+    memcpy(pre.JVg.data(),imu.JVg,sizeof(imu.JVg));
+    memcpy(pre.JVa.data(),imu.JVa,sizeof(imu.JVa));
+    memcpy(pre.JPg.data(),imu.JPg,sizeof(imu.JPg));
+    memcpy(pre.JPa.data(),imu.JPa,sizeof(imu.JPa));
+    memcpy(pre.avgA.data(),imu.avgA,sizeof(imu.avgA));
+    memcpy(pre.avgW.data(),imu.avgW,sizeof(imu.avgW));
+    pre.bu = ArrayToBias(imu.bu);
+    memcpy(pre.db.data(),imu.db,sizeof(imu.db));
+
+    const ImuMeasurementRecord* pMeasurements = Data<ImuMeasurementRecord>(IMU_MEASUREMENTS)+r.imuMeasurements.begin;
+    pre.mvMeasurements.clear();
+    pre.mvMeasurements.reserve(r.imuMeasurements.count);
+    for(uint64_t i=0; i<r.imuMeasurements.count; i++)
+    {
+        const ImuMeasurementRecord &m = pMeasurements[i];
+        pre.mvMeasurements.push_back(IMU::Preintegrated::integrable(Eigen::Vector3f(m.a[0],m.a[1],m.a[2]),
+                                                                    Eigen::Vector3f(m.w[0],m.w[1],m.w[2]),m.t));
+    }
+
+    return true;
+}
+
+bool AtlasFile::ReadMapPoint(MapPoint* pMP, const MapPointRecord &r)
+{
+    pMP->mnId = r.nId;
+    pMP->mnFirstKFid = r.nFirstKFid;
+    pMP->mnFirstFrame = r.nFirstFrame;
+    pMP->mBackupRefKFId = r.nRefKFId;
+    pMP->mBackupReplacedId = r.nReplacedId;
+    pMP->nObs = r.nObs;
+    pMP->mbBad = r.bBad;
+    pMP->mNormalVector << r.normal[0], r.normal[1], r.normal[2];
+    pMP->mfMinDistance = r.minDistance;
+    pMP->mfMaxDistance = r.maxDistance;
+
+    if(!ReadMat(r.descriptor,pMP->mDescriptor) || !IsValid(OBSERVATIONS,r.observations))
+        return false;
+
+    pMP->mBackupObservationsId1.clear();
+    pMP->mBackupObservationsId2.clear();
+    const ObservationRecord* pObservations = Data<ObservationRecord>(OBSERVATIONS)+r.observations.begin;
+    for(uint64_t i=0; i<r.observations.count; i++)
+    {
+        pMP->mBackupObservationsId1[pObservations[i].nKFId] = pObservations[i].leftIndex;
+        pMP->mBackupObservationsId2[pObservations[i].nKFId] = pObservations[i].rightIndex;
+    }
+
+    return true;
+}
+
+} //namespace ORB_SLAM
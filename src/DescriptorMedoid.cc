@@ -0,0 +1,192 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "DescriptorMedoid.h"
+#include "HammingDistance.h"
+
+#include <algorithm>
+#include <cstring>
+#include <climits>
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+DescriptorMedoid::DescriptorMedoid(): mbCached(true)
+{
+}
+
+void DescriptorMedoid::AddRow()
+{
+    const int N = mvKeys.size()-1;
+
+    // Distances of the last descriptor to the previous ones
+    static thread_local vector<uint8_t> vDescriptors;
+    static thread_local vector<int> vDist;
+    vDescriptors.resize(32*N);
+    vDist.resize(N);
+    for(int j=0; j<N; j++)
+        memcpy(&vDescriptors[32*j], mvKeys[j].pDesc, 32);
+    HammingDistance::Compute(mvKeys[N].pDesc, vDescriptors.data(), N, vDist.data());
+
+    for(int j=0; j<N; j++)
+        mvDistances.push_back(vDist[j]);
+}
+
+void DescriptorMedoid::BuildMatrix()
+{
+    const int N = mvKeys.size();
+    mvDistances.clear();
+    mvDistances.reserve(N*(N-1)/2);
+
+    vector<Key> vKeys;
+    vKeys.swap(mvKeys);
+    for(int i=0; i<N; i++)
+    {
+        mvKeys.push_back(vKeys[i]);
+        AddRow();
+    }
+    mbCached = true;
+}
+
+void DescriptorMedoid::Add(KeyFrame* pKF, int idx, const uint8_t* pDesc)
+{
+    Key key;
+    key.pKF = pKF;
+    key.idx = idx;
+    key.pDesc = pDesc;
+    mvKeys.push_back(key);
+
+    if(!mbCached)
+        return;
+
+    if((int)mvKeys.size()>MAX_CACHED)
+    {
+        vector<uint16_t>().swap(mvDistances);
+        mbCached = false;
+        return;
+    }
+
+    AddRow();
+}
+
+void DescriptorMedoid::RemoveAt(int i)
+{
+    // The last descriptor takes the place of the removed one
+    const int last = mvKeys.size()-1;
+    if(i!=last)
+    {
+        mvKeys[i] = mvKeys[last];
+
+        if(mbCached)
+        {
+            for(int j=0; j<last; j++)
+            {
+                if(j!=i)
+                    mvDistances[max(i,j)*(max(i,j)-1)/2+min(i,j)] = Distance(last,j);
+            }
+        }
+    }
+
+    mvKeys.pop_back();
+    if(mbCached)
+        mvDistances.resize(last*(last-1)/2);
+}
+
+void DescriptorMedoid::Remove(KeyFrame* pKF, int idx)
+{
+    for(int i=mvKeys.size()-1; i>=0; i--)
+    {
+        if(mvKeys[i].pKF==pKF && (idx==-1 || mvKeys[i].idx==idx))
+            RemoveAt(i);
+    }
+
+    if(!mbCached && (int)mvKeys.size()<=MAX_CACHED)
+        BuildMatrix();
+}
+
+void DescriptorMedoid::Clear()
+{
+    vector<Key>().swap(mvKeys);
+    vector<uint16_t>().swap(mvDistances);
+    mbCached = true;
+}
+
+int DescriptorMedoid::Medoid(const vector<KeyFrame*> &vpExcluded) const
+{
+    const int N = mvKeys.size();
+
+    static thread_local vector<int> vValid;
+    vValid.clear();
+    for(int i=0; i<N; i++)
+        if(!binary_search(vpExcluded.begin(), vpExcluded.end(), mvKeys[i].pKF))
+            vValid.push_back(i);
+
+    const int M = vValid.size();
+    if(M==0)
+        return -1;
+
+    // Without the matrix the valid descriptors are gathered to compute each row at once
+    static thread_local vector<uint8_t> vDescriptors;
+    static thread_local vector<int> vDist;
+    if(!mbCached)
+    {
+        vDescriptors.resize(32*M);
+        vDist.resize(M);
+        for(int b=0; b<M; b++)
+            memcpy(&vDescriptors[32*b], mvKeys[vValid[b]].pDesc, 32);
+    }
+
+    // Median of each row over the valid columns
+    static thread_local vector<uint16_t> vRow;
+    vRow.resize(M);
+    const int nMedian = (M-1)/2;
+
+    int BestMedian = INT_MAX;
+    int BestIdx = -1;
+    for(int a=0; a<M; a++)
+    {
+        const int i = vValid[a];
+        if(mbCached)
+        {
+            for(int b=0; b<M; b++)
+                vRow[b] = Distance(i,vValid[b]);
+        }
+        else
+        {
+            HammingDistance::Compute(mvKeys[i].pDesc, vDescriptors.data(), M, vDist.data());
+            for(int b=0; b<M; b++)
+                vRow[b] = vDist[b];
+        }
+
+        nth_element(vRow.begin(), vRow.begin()+nMedian, vRow.end());
+        const int median = vRow[nMedian];
+
+        if(median<BestMedian || (median==BestMedian && make_pair(mvKeys[i].pKF,mvKeys[i].idx)<make_pair(mvKeys[BestIdx].pKF,mvKeys[BestIdx].idx)))
+        {
+            BestMedian = median;
+            BestIdx = i;
+        }
+    }
+
+    return BestIdx;
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,110 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "FeatureGrid.h"
+
+#include <cmath>
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+FeatureGrid::FeatureGrid(): mnCols(0), mnRows(0)
+{
+}
+
+void FeatureGrid::Build(const int nCols, const int nRows, const vector<cv::KeyPoint> &vKeys, const vector<int> &vCells)
+{
+    mnCols = nCols;
+    mnRows = nRows;
+
+    const int nCells = nCols*nRows;
+
+    // Counting sort of the keypoints by cell, which keeps them in index order inside each cell
+    mvCellStart.assign(nCells+1,0);
+    for(size_t i=0; i<vCells.size(); i++)
+        if(vCells[i]>=0)
+            mvCellStart[vCells[i]+1]++;
+
+    for(int c=0; c<nCells; c++)
+        mvCellStart[c+1] += mvCellStart[c];
+
+    mvEntries.resize(mvCellStart[nCells]);
+
+    vector<unsigned int> vNext(mvCellStart.begin(),mvCellStart.end()-1);
+    for(size_t i=0; i<vCells.size(); i++)
+    {
+        if(vCells[i]<0)
+            continue;
+
+        Entry &e = mvEntries[vNext[vCells[i]]++];
+        e.x = vKeys[i].pt.x;
+        e.y = vKeys[i].pt.y;
+        e.octave = vKeys[i].octave;
+        e.idx = i;
+    }
+}
+
+void FeatureGrid::GetFeaturesInArea(const int nMinCellX, const int nMaxCellX, const int nMinCellY, const int nMaxCellY,
+                                    const float &x, const float &y, const float &r, const int minLevel, const int maxLevel,
+                                    vector<size_t> &vIndices) const
+{
+    if(mvEntries.empty())
+        return;
+
+    const bool bCheckLevels = (minLevel>0) || (maxLevel>=0);
+
+    for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
+    {
+        // Cells of one column are contiguous, so the rows [nMinCellY,nMaxCellY] are a single range
+        const unsigned int begin = mvCellStart[ix*mnRows+nMinCellY];
+        const unsigned int end = mvCellStart[ix*mnRows+nMaxCellY+1];
+
+        for(unsigned int j=begin; j<end; j++)
+        {
+            const Entry &e = mvEntries[j];
+
+            if(bCheckLevels)
+            {
+                if(e.octave<minLevel)
+                    continue;
+                if(maxLevel>=0)
+                    if(e.octave>maxLevel)
+                        continue;
+            }
+
+            const float distx = e.x-x;
+            const float disty = e.y-y;
+
+            if(fabs(distx)<r && fabs(disty)<r)
+                vIndices.push_back(e.idx);
+        }
+    }
+}
+
+void FeatureGrid::clear()
+{
+    mnCols = 0;
+    mnRows = 0;
+    mvCellStart.clear();
+    mvEntries.clear();
+}
+
+} //namespace ORB_SLAM
@@ -25,11 +25,16 @@
 #include "Converter.h"
 #include "ORBmatcher.h"
 #include "GeometricCamera.h"
+#include "ThreadPool.h"
+#include "HammingDistance.h"
 
-#include <thread>
 #include <include/CameraModels/Pinhole.h>
 #include <include/CameraModels/KannalaBrandt8.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace ORB_SLAM3
 {
 
@@ -72,13 +77,9 @@ Frame::Frame(const Frame &frame)
      mTlr(frame.mTlr), mRlr(frame.mRlr), mtlr(frame.mtlr), mTrl(frame.mTrl),
      mTcw(frame.mTcw), mbHasPose(false), mbHasVelocity(false)
 {
-    for(int i=0;i<FRAME_GRID_COLS;i++)
-        for(int j=0; j<FRAME_GRID_ROWS; j++){
-            mGrid[i][j]=frame.mGrid[i][j];
-            if(frame.Nleft > 0){
-                mGridRight[i][j] = frame.mGridRight[i][j];
-            }
-        }
+    mGrid = frame.mGrid;
+    if(frame.Nleft > 0)
+        mGridRight = frame.mGridRight;
 
     if(frame.mbHasPose)
         SetPose(frame.GetPose());
@@ -98,7 +99,7 @@ Frame::Frame(const Frame &frame)
 }
 
 
-Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, Frame* pPrevF, const IMU::Calib &ImuCalib)
+Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, Frame* pPrevF, const IMU::Calib &ImuCalib, ThreadPool* pThreadPool)
     :mpcpi(NULL), mpORBvocabulary(voc),mpORBextractorLeft(extractorLeft),mpORBextractorRight(extractorRight), mTimeStamp(timeStamp), mK(K.clone()), mK_(Converter::toMatrix3f(K)), mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth),
      mImuCalib(ImuCalib), mpImuPreintegrated(NULL), mpPrevFrame(pPrevF),mpImuPreintegratedFrame(NULL), mpReferenceKF(static_cast<KeyFrame*>(NULL)), mbIsSet(false), mbImuPreintegrated(false),
      mpCamera(pCamera) ,mpCamera2(nullptr), mbHasPose(false), mbHasVelocity(false)
@@ -119,10 +120,11 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft,0,0);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight,0,0);
-    threadLeft.join();
-    threadRight.join();
+    // Left and right images are processed concurrently on the shared thread pool
+    ThreadPool::ParallelFor(pThreadPool, 2, [&](int i)
+    {
+        ExtractORB(i, i==0 ? imLeft : imRight, 0, 0);
+    });
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndExtORB = std::chrono::steady_clock::now();
 
@@ -138,7 +140,7 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_StartStereoMatches = std::chrono::steady_clock::now();
 #endif
-    ComputeStereoMatches();
+    ComputeStereoMatches(pThreadPool);
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndStereoMatches = std::chrono::steady_clock::now();
 
@@ -384,34 +386,32 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extra
 
 void Frame::AssignFeaturesToGrid()
 {
-    // Fill matrix with points
-    const int nCells = FRAME_GRID_COLS*FRAME_GRID_ROWS;
-
-    int nReserve = 0.5f*N/(nCells);
-
-    for(unsigned int i=0; i<FRAME_GRID_COLS;i++)
-        for (unsigned int j=0; j<FRAME_GRID_ROWS;j++){
-            mGrid[i][j].reserve(nReserve);
-            if(Nleft != -1){
-                mGridRight[i][j].reserve(nReserve);
-            }
-        }
+    // Cell of each keypoint, -1 if it falls out of the grid
+    const vector<cv::KeyPoint> &vKeysLeft = (Nleft == -1) ? mvKeysUn : mvKeys;
+    const int nLeft = (Nleft == -1) ? N : Nleft;
+    vector<int> vCells(nLeft,-1);
 
+    for(int i=0;i<nLeft;i++)
+    {
+        int nGridPosX, nGridPosY;
+        if(PosInGrid(vKeysLeft[i],nGridPosX,nGridPosY))
+            vCells[i] = nGridPosX*FRAME_GRID_ROWS+nGridPosY;
+    }
 
+    mGrid.Build(FRAME_GRID_COLS,FRAME_GRID_ROWS,vKeysLeft,vCells);
 
-    for(int i=0;i<N;i++)
+    if(Nleft != -1)
     {
-        const cv::KeyPoint &kp = (Nleft == -1) ? mvKeysUn[i]
-                                                 : (i < Nleft) ? mvKeys[i]
-                                                                 : mvKeysRight[i - Nleft];
+        vCells.assign(N-Nleft,-1);
 
-        int nGridPosX, nGridPosY;
-        if(PosInGrid(kp,nGridPosX,nGridPosY)){
-            if(Nleft == -1 || i < Nleft)
-                mGrid[nGridPosX][nGridPosY].push_back(i);
-            else
-                mGridRight[nGridPosX][nGridPosY].push_back(i - Nleft);
+        for(int i=0;i<N-Nleft;i++)
+        {
+            int nGridPosX, nGridPosY;
+            if(PosInGrid(mvKeysRight[i],nGridPosX,nGridPosY))
+                vCells[i] = nGridPosX*FRAME_GRID_ROWS+nGridPosY;
         }
+
+        mGridRight.Build(FRAME_GRID_COLS,FRAME_GRID_ROWS,mvKeysRight,vCells);
     }
 }
 
@@ -686,38 +686,8 @@ vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const f
         return vIndices;
     }
 
-    const bool bCheckLevels = (minLevel>0) || (maxLevel>=0);
-
-    for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
-    {
-        for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
-        {
-            const vector<size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-            if(vCell.empty())
-                continue;
-
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
-            {
-                const cv::KeyPoint &kpUn = (Nleft == -1) ? mvKeysUn[vCell[j]]
-                                                         : (!bRight) ? mvKeys[vCell[j]]
-                                                                     : mvKeysRight[vCell[j]];
-                if(bCheckLevels)
-                {
-                    if(kpUn.octave<minLevel)
-                        continue;
-                    if(maxLevel>=0)
-                        if(kpUn.octave>maxLevel)
-                            continue;
-                }
-
-                const float distx = kpUn.pt.x-x;
-                const float disty = kpUn.pt.y-y;
-
-                if(fabs(distx)<factorX && fabs(disty)<factorY)
-                    vIndices.push_back(vCell[j]);
-            }
-        }
-    }
+    const FeatureGrid &grid = (!bRight) ? mGrid : mGridRight;
+    grid.GetFeaturesInArea(nMinCellX,nMaxCellX,nMinCellY,nMaxCellY,x,y,r,minLevel,maxLevel,vIndices);
 
     return vIndices;
 }
@@ -735,13 +705,36 @@ bool Frame::PosInGrid(const cv::KeyPoint &kp, int &posX, int &posY)
 }
 
 
-void Frame::ComputeBoW()
+void Frame::ComputeBoW(ThreadPool* pThreadPool)
 {
     if(mBowVec.empty())
+        ComputeBoW(mpORBvocabulary,mDescriptors,mBowVec,mFeatVec,pThreadPool);
+}
+
+void Frame::ComputeBoW(ORBVocabulary* pVoc, const cv::Mat &descriptors, DBoW2::BowVector &bowVec,
+                       DBoW2::FeatureVector &featVec, ThreadPool* pThreadPool)
+{
+    const vector<cv::Mat> vDesc = Converter::toDescriptorVector(descriptors);
+    const int nDesc = vDesc.size();
+
+    // Feature vector associate features with nodes in the 4th level (from leaves up)
+    // We assume the vocabulary tree has 6 levels, change the 4 otherwise
+    const int levelsup = 4;
+
+    vector<DBoW2::WordId> vWordIds(nDesc);
+    vector<DBoW2::WordValue> vWeights(nDesc);
+    vector<DBoW2::NodeId> vNodeIds(nDesc);
+
+    const int chunk = 64;
+    const int nChunks = (nDesc+chunk-1)/chunk;
+    ThreadPool::ParallelFor(pThreadPool, nChunks, [&](int c)
     {
-        vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
-        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4);
-    }
+        const size_t begin = c*chunk;
+        const size_t end = min(begin+chunk,(size_t)nDesc);
+        pVoc->transform(vDesc,begin,end,&vWordIds[0],&vWeights[0],&vNodeIds[0],levelsup);
+    });
+
+    pVoc->transform(vWordIds,vWeights,vNodeIds,bowVec,featVec);
 }
 
 void Frame::UndistortKeyPoints()
@@ -808,7 +801,7 @@ void Frame::ComputeImageBounds(const cv::Mat &imLeft)
     }
 }
 
-void Frame::ComputeStereoMatches()
+void Frame::ComputeStereoMatches(ThreadPool* pThreadPool)
 {
     mvuRight = vector<float>(N,-1.0f);
     mvDepth = vector<float>(N,-1.0f);
@@ -842,127 +835,144 @@ void Frame::ComputeStereoMatches()
     const float minD = 0;
     const float maxD = mbf/minZ;
 
-    // For each left keypoint search a match in the right image
-    vector<pair<int, int> > vDistIdx;
-    vDistIdx.reserve(N);
+    // Correlation distance of each matched left keypoint, -1 if not matched
+    vector<int> vMatchDist(N,-1);
 
-    for(int iL=0; iL<N; iL++)
-    {
-        const cv::KeyPoint &kpL = mvKeys[iL];
-        const int &levelL = kpL.octave;
-        const float &vL = kpL.pt.y;
-        const float &uL = kpL.pt.x;
-
-        const vector<size_t> &vCandidates = vRowIndices[vL];
+    // For each left keypoint search a match in the right image.
+    // Keypoints are independent, so they are processed in chunks on the thread pool.
+    const int nChunkSize = 64;
+    const int nChunks = (N+nChunkSize-1)/nChunkSize;
 
-        if(vCandidates.empty())
-            continue;
+    ThreadPool::ParallelFor(pThreadPool, nChunks, [&](int chunk)
+    {
+        // sliding window search parameters
+        const int w = 5;
+        const int L = 5;
+        int vDists[2*L+1];
 
-        const float minU = uL-maxD;
-        const float maxU = uL-minD;
+        const int iniL = chunk*nChunkSize;
+        const int endL = min(iniL+nChunkSize,N);
 
-        if(maxU<0)
-            continue;
+        for(int iL=iniL; iL<endL; iL++)
+        {
+            const cv::KeyPoint &kpL = mvKeys[iL];
+            const int &levelL = kpL.octave;
+            const float &vL = kpL.pt.y;
+            const float &uL = kpL.pt.x;
 
-        int bestDist = ORBmatcher::TH_HIGH;
-        size_t bestIdxR = 0;
+            const vector<size_t> &vCandidates = vRowIndices[vL];
 
-        const cv::Mat &dL = mDescriptors.row(iL);
+            if(vCandidates.empty())
+                continue;
 
-        // Compare descriptor to right keypoints
-        for(size_t iC=0; iC<vCandidates.size(); iC++)
-        {
-            const size_t iR = vCandidates[iC];
-            const cv::KeyPoint &kpR = mvKeysRight[iR];
+            const float minU = uL-maxD;
+            const float maxU = uL-minD;
 
-            if(kpR.octave<levelL-1 || kpR.octave>levelL+1)
+            if(maxU<0)
                 continue;
 
-            const float &uR = kpR.pt.x;
+            int bestDist = ORBmatcher::TH_HIGH;
+            size_t bestIdxR = 0;
+
+            const uint8_t* dL = mDescriptors.ptr<uint8_t>(iL);
 
-            if(uR>=minU && uR<=maxU)
+            // Compare descriptor to right keypoints
+            for(size_t iC=0; iC<vCandidates.size(); iC++)
             {
-                const cv::Mat &dR = mDescriptorsRight.row(iR);
-                const int dist = ORBmatcher::DescriptorDistance(dL,dR);
+                const size_t iR = vCandidates[iC];
+                const cv::KeyPoint &kpR = mvKeysRight[iR];
+
+                if(kpR.octave<levelL-1 || kpR.octave>levelL+1)
+                    continue;
 
-                if(dist<bestDist)
+                const float &uR = kpR.pt.x;
+
+                if(uR>=minU && uR<=maxU)
                 {
-                    bestDist = dist;
-                    bestIdxR = iR;
+                    const int dist = HammingDistance::Compute(dL,mDescriptorsRight.ptr<uint8_t>(iR));
+
+                    if(dist<bestDist)
+                    {
+                        bestDist = dist;
+                        bestIdxR = iR;
+                    }
                 }
             }
-        }
 
-        // Subpixel match by correlation
-        if(bestDist<thOrbDist)
-        {
-            // coordinates in image pyramid at keypoint scale
-            const float uR0 = mvKeysRight[bestIdxR].pt.x;
-            const float scaleFactor = mvInvScaleFactors[kpL.octave];
-            const float scaleduL = round(kpL.pt.x*scaleFactor);
-            const float scaledvL = round(kpL.pt.y*scaleFactor);
-            const float scaleduR0 = round(uR0*scaleFactor);
-
-            // sliding window search
-            const int w = 5;
-            cv::Mat IL = mpORBextractorLeft->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduL-w,scaleduL+w+1);
-
-            int bestDist = INT_MAX;
-            int bestincR = 0;
-            const int L = 5;
-            vector<float> vDists;
-            vDists.resize(2*L+1);
-
-            const float iniu = scaleduR0+L-w;
-            const float endu = scaleduR0+L+w+1;
-            if(iniu<0 || endu >= mpORBextractorRight->mvImagePyramid[kpL.octave].cols)
-                continue;
-
-            for(int incR=-L; incR<=+L; incR++)
+            // Subpixel match by correlation
+            if(bestDist<thOrbDist)
             {
-                cv::Mat IR = mpORBextractorRight->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduR0+incR-w,scaleduR0+incR+w+1);
+                // coordinates in image pyramid at keypoint scale
+                const float uR0 = mvKeysRight[bestIdxR].pt.x;
+                const float scaleFactor = mvInvScaleFactors[kpL.octave];
+                const float scaleduL = round(kpL.pt.x*scaleFactor);
+                const float scaledvL = round(kpL.pt.y*scaleFactor);
+                const float scaleduR0 = round(uR0*scaleFactor);
+
+                const cv::Mat &imL = mpORBextractorLeft->mvImagePyramid[kpL.octave];
+                const cv::Mat &imR = mpORBextractorRight->mvImagePyramid[kpL.octave];
+
+                const float iniu = scaleduR0-L-w;
+                const float endu = scaleduR0+L+w+1;
+                if(iniu<0 || endu >= imR.cols)
+                    continue;
+
+                ComputeSlidingWindowSAD(imL,imR,scaleduL,scaledvL,scaleduR0,w,L,vDists);
 
-                float dist = cv::norm(IL,IR,cv::NORM_L1);
-                if(dist<bestDist)
+                int bestDist = INT_MAX;
+                int bestincR = 0;
+
+                for(int incR=-L; incR<=+L; incR++)
                 {
-                    bestDist =  dist;
-                    bestincR = incR;
+                    if(vDists[L+incR]<bestDist)
+                    {
+                        bestDist = vDists[L+incR];
+                        bestincR = incR;
+                    }
                 }
 
-                vDists[L+incR] = dist;
-            }
-
-            if(bestincR==-L || bestincR==L)
-                continue;
+                if(bestincR==-L || bestincR==L)
+                    continue;
 
-            // Sub-pixel match (Parabola fitting)
-            const float dist1 = vDists[L+bestincR-1];
-            const float dist2 = vDists[L+bestincR];
-            const float dist3 = vDists[L+bestincR+1];
+                // Sub-pixel match (Parabola fitting)
+                const float dist1 = vDists[L+bestincR-1];
+                const float dist2 = vDists[L+bestincR];
+                const float dist3 = vDists[L+bestincR+1];
 
-            const float deltaR = (dist1-dist3)/(2.0f*(dist1+dist3-2.0f*dist2));
+                const float deltaR = (dist1-dist3)/(2.0f*(dist1+dist3-2.0f*dist2));
 
-            if(deltaR<-1 || deltaR>1)
-                continue;
+                if(deltaR<-1 || deltaR>1)
+                    continue;
 
-            // Re-scaled coordinate
-            float bestuR = mvScaleFactors[kpL.octave]*((float)scaleduR0+(float)bestincR+deltaR);
+                // Re-scaled coordinate
+                float bestuR = mvScaleFactors[kpL.octave]*((float)scaleduR0+(float)bestincR+deltaR);
 
-            float disparity = (uL-bestuR);
+                float disparity = (uL-bestuR);
 
-            if(disparity>=minD && disparity<maxD)
-            {
-                if(disparity<=0)
+                if(disparity>=minD && disparity<maxD)
                 {
-                    disparity=0.01;
-                    bestuR = uL-0.01;
+                    if(disparity<=0)
+                    {
+                        disparity=0.01;
+                        bestuR = uL-0.01;
+                    }
+                    mvDepth[iL]=mbf/disparity;
+                    mvuRight[iL] = bestuR;
+                    vMatchDist[iL] = bestDist;
                 }
-                mvDepth[iL]=mbf/disparity;
-                mvuRight[iL] = bestuR;
-                vDistIdx.push_back(pair<int,int>(bestDist,iL));
             }
         }
-    }
+    });
+
+    vector<pair<int, int> > vDistIdx;
+    vDistIdx.reserve(N);
+
+    for(int iL=0; iL<N; iL++)
+        if(vMatchDist[iL]>=0)
+            vDistIdx.push_back(pair<int,int>(vMatchDist[iL],iL));
+
+    if(vDistIdx.empty())
+        return;
 
     sort(vDistIdx.begin(),vDistIdx.end());
     const float median = vDistIdx[vDistIdx.size()/2].first;
@@ -980,6 +990,54 @@ void Frame::ComputeStereoMatches()
     }
 }
 
+void Frame::ComputeSlidingWindowSAD(const cv::Mat &imL, const cv::Mat &imR, const int uL, const int vL, const int uR0,
+                                    const int w, const int L, int* vDists)
+{
+    const int W = 2*w+1;
+    const uchar* pL = imL.ptr<uchar>(vL-w) + (uL-w);
+    const uchar* pR = imR.ptr<uchar>(vL-w) + (uR0-L-w);
+    const size_t stepL = imL.step[0];
+    const size_t stepR = imR.step[0];
+
+#ifdef __SSE2__
+    // Every row of the window is read with one 16-byte load, masked to the W valid pixels.
+    // The loads may go past the window, so use them only when they stay inside the image buffer.
+    if(W<=16 && pL+(W-1)*stepL+16<=imL.datalimit && pR+(W-1)*stepR+2*L+16<=imR.datalimit)
+    {
+        const __m128i mask = _mm_cmplt_epi8(_mm_setr_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15), _mm_set1_epi8(W));
+
+        __m128i vRowsL[16];
+        for(int r=0; r<W; r++)
+            vRowsL[r] = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pL+r*stepL)), mask);
+
+        for(int inc=0; inc<=2*L; inc++)
+        {
+            __m128i acc = _mm_setzero_si128();
+            for(int r=0; r<W; r++)
+            {
+                const __m128i rowR = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pR+r*stepR+inc)), mask);
+                acc = _mm_add_epi64(acc, _mm_sad_epu8(vRowsL[r], rowR));
+            }
+            vDists[inc] = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+        }
+        return;
+    }
+#endif
+
+    for(int inc=0; inc<=2*L; inc++)
+    {
+        int dist = 0;
+        for(int r=0; r<W; r++)
+        {
+            const uchar* rowL = pL+r*stepL;
+            const uchar* rowR = pR+r*stepR+inc;
+            for(int c=0; c<W; c++)
+                dist += abs((int)rowL[c]-(int)rowR[c]);
+        }
+        vDists[inc] = dist;
+    }
+}
+
 
 void Frame::ComputeStereoFromRGBD(const cv::Mat &imDepth)
 {
@@ -1031,7 +1089,7 @@ void Frame::setIntegrated()
     mbImuPreintegrated = true;
 }
 
-Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF, const IMU::Calib &ImuCalib)
+Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera* pCamera, GeometricCamera* pCamera2, Sophus::SE3f& Tlr,Frame* pPrevF, const IMU::Calib &ImuCalib, ThreadPool* pThreadPool)
         :mpcpi(NULL), mpORBvocabulary(voc),mpORBextractorLeft(extractorLeft),mpORBextractorRight(extractorRight), mTimeStamp(timeStamp), mK(K.clone()), mK_(Converter::toMatrix3f(K)),  mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth),
          mImuCalib(ImuCalib), mpImuPreintegrated(NULL), mpPrevFrame(pPrevF),mpImuPreintegratedFrame(NULL), mpReferenceKF(static_cast<KeyFrame*>(NULL)), mbImuPreintegrated(false), mpCamera(pCamera), mpCamera2(pCamera2),
          mbHasPose(false), mbHasVelocity(false)
@@ -1056,10 +1114,12 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft,static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera)->mvLappingArea[1]);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight,static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[0],static_cast<KannalaBrandt8*>(mpCamera2)->mvLappingArea[1]);
-    threadLeft.join();
-    threadRight.join();
+    // Left and right images are processed concurrently on the shared thread pool
+    ThreadPool::ParallelFor(pThreadPool, 2, [&](int i)
+    {
+        KannalaBrandt8* pKB = static_cast<KannalaBrandt8*>(i==0 ? mpCamera : mpCamera2);
+        ExtractORB(i, i==0 ? imLeft : imRight, pKB->mvLappingArea[0], pKB->mvLappingArea[1]);
+    });
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndExtORB = std::chrono::steady_clock::now();
 
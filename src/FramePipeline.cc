@@ -0,0 +1,212 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "FramePipeline.h"
+
+#include "System.h"
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+FramePipeline::FramePipeline(System* pSystem, size_t nMaxQueued):
+    mpSystem(pSystem), mnMaxQueued(max(nMaxQueued,(size_t)1)), mnPending(0), mbFinishRequested(false),
+    mpFrontEndFrame(NULL), mbFinishFrontEnd(false)
+{
+    mptFrontEnd = new thread(&FramePipeline::RunFrontEnd,this);
+    mptTracking = new thread(&FramePipeline::RunTracking,this);
+}
+
+FramePipeline::~FramePipeline()
+{
+    {
+        unique_lock<mutex> lock(mMutexQueue);
+        mbFinishRequested = true;
+    }
+    mQueueChanged.Notify();
+    mptTracking->join();
+
+    {
+        unique_lock<mutex> lock(mMutexFrontEnd);
+        mbFinishFrontEnd = true;
+    }
+    mFrontEndChanged.Notify();
+    mptFrontEnd->join();
+
+    delete mptTracking;
+    delete mptFrontEnd;
+}
+
+future<Sophus::SE3f> FramePipeline::Push(QueuedFrame* pFrame)
+{
+    future<Sophus::SE3f> pose = pFrame->promise.get_future();
+
+    mQueueChanged.WaitUntil([&]{
+        unique_lock<mutex> lock(mMutexQueue);
+        return mlpQueue.size()<mnMaxQueued;
+    });
+
+    {
+        unique_lock<mutex> lock(mMutexQueue);
+        mlpQueue.push_back(pFrame);
+        mnPending++;
+    }
+    mQueueChanged.Notify();
+
+    return pose;
+}
+
+void FramePipeline::Flush()
+{
+    mQueueChanged.WaitUntil([&]{
+        unique_lock<mutex> lock(mMutexQueue);
+        return mnPending==0;
+    });
+}
+
+void FramePipeline::RunTracking()
+{
+    // Frame already built, waiting to be tracked
+    QueuedFrame* pPrepared = NULL;
+
+    while(true)
+    {
+        // With a frame ready, do not wait for the next one to be pushed
+        mQueueChanged.WaitUntil([&]{
+            unique_lock<mutex> lock(mMutexQueue);
+            return pPrepared || !mlpQueue.empty() || mbFinishRequested;
+        });
+
+        QueuedFrame* pNext = NULL;
+        {
+            unique_lock<mutex> lock(mMutexQueue);
+            if(!mlpQueue.empty())
+            {
+                pNext = mlpQueue.front();
+                mlpQueue.pop_front();
+            }
+            else if(!pPrepared)
+                break;
+        }
+
+        if(pNext)
+        {
+            mQueueChanged.Notify();
+
+            if(pPrepared && !mpSystem->ModeOrResetRequested())
+                PrepareWhileTracking(pNext,pPrepared);
+            else
+            {
+                if(pPrepared)
+                {
+                    ApplyRequests(pPrepared);
+                    Track(pPrepared);
+                }
+                mpSystem->CheckModeAndReset();
+                mpSystem->UpdateQueuedFrame(pNext);
+            }
+        }
+        else
+        {
+            ApplyRequests(pPrepared);
+            Track(pPrepared);
+        }
+
+        pPrepared = pNext;
+    }
+}
+
+void FramePipeline::PrepareWhileTracking(QueuedFrame* pFrame, QueuedFrame* pTrackFrame)
+{
+    // pTrackFrame must be final before pFrame takes the next frame id
+    mpSystem->UpdateQueuedFrame(pTrackFrame);
+
+    // Guess that tracking keeps the monocular extractor, UpdateQueuedFrame fixes it otherwise
+    pFrame->bIniExtractor = pTrackFrame->bIniExtractor;
+
+    {
+        unique_lock<mutex> lock(mMutexFrontEnd);
+        mpFrontEndFrame = pFrame;
+    }
+    mFrontEndChanged.Notify();
+
+    Track(pTrackFrame);
+
+    mFrontEndChanged.WaitUntil([&]{
+        unique_lock<mutex> lock(mMutexFrontEnd);
+        return mpFrontEndFrame==NULL;
+    });
+}
+
+void FramePipeline::ApplyRequests(QueuedFrame* pFrame)
+{
+    if(!mpSystem->ModeOrResetRequested())
+        return;
+
+    const long unsigned int nNextId = Frame::nNextId;
+    mpSystem->CheckModeAndReset();
+
+    // pFrame was built while the previous frame was tracked, before the request. It is built
+    // again, taking its own id back unless the reset restarted the ids.
+    if(pFrame->bPrepared)
+    {
+        if(Frame::nNextId==nNextId)
+            Frame::nNextId = pFrame->frame.mnId;
+        pFrame->bPrepared = false;
+    }
+}
+
+void FramePipeline::Track(QueuedFrame* pFrame)
+{
+    pFrame->promise.set_value(mpSystem->TrackQueuedFrame(pFrame));
+    delete pFrame;
+
+    {
+        unique_lock<mutex> lock(mMutexQueue);
+        mnPending--;
+    }
+    mQueueChanged.Notify();
+}
+
+void FramePipeline::RunFrontEnd()
+{
+    while(true)
+    {
+        QueuedFrame* pFrame = NULL;
+        mFrontEndChanged.WaitUntil([&]{
+            unique_lock<mutex> lock(mMutexFrontEnd);
+            pFrame = mpFrontEndFrame;
+            return pFrame || mbFinishFrontEnd;
+        });
+
+        if(!pFrame)
+            break;
+
+        mpSystem->PrepareQueuedFrame(pFrame);
+
+        {
+            unique_lock<mutex> lock(mMutexFrontEnd);
+            mpFrontEndFrame = NULL;
+        }
+        mFrontEndChanged.Notify();
+    }
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,194 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "FrameTrajectory.h"
+
+#include <iostream>
+#include <iomanip>
+
+#include "KeyFrame.h"
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+FrameTrajectory::FrameTrajectory(): mnFirstChunk(0), mnEnd(0), mnStreamed(0), mnLag(1), mbRelease(false)
+{
+}
+
+FrameTrajectory::~FrameTrajectory()
+{
+    CloseStream();
+    for(size_t i=0; i<mvpChunks.size(); i++)
+        delete[] mvpChunks[i];
+}
+
+void FrameTrajectory::PushBack(const Sophus::SE3f &Tcr, KeyFrame* pReferenceKF, double timestamp, bool bLost)
+{
+    if(mnEnd%ChunkSize==0)
+        mvpChunks.push_back(new FramePose[ChunkSize]);
+
+    FramePose &pose = mvpChunks.back()[mnEnd%ChunkSize];
+    pose.Tcr = Tcr;
+    pose.pReferenceKF = pReferenceKF;
+    pose.timestamp = timestamp;
+    pose.bLost = bLost;
+    mnEnd++;
+}
+
+void FrameTrajectory::Clear()
+{
+    for(size_t i=0; i<mvpChunks.size(); i++)
+        delete[] mvpChunks[i];
+    mvpChunks.clear();
+    mnFirstChunk = 0;
+    mnEnd = 0;
+    mnStreamed = 0;
+}
+
+bool FrameTrajectory::OpenStream(const string &filename, int nLag, bool bRelease)
+{
+    CloseStream();
+
+    mStream.open(filename.c_str());
+    if(!mStream.is_open())
+    {
+        cerr << "Could not open trajectory stream " << filename << endl;
+        return false;
+    }
+    mStream << fixed;
+
+    // The last frame is always kept, tracking needs it when the next one is lost
+    mnLag = max(nLag,1);
+    mbRelease = bRelease;
+    mnStreamed = mnEnd;
+
+    cout << "Streaming trajectory to " << filename << " with a lag of " << mnLag << " frames" << endl;
+    return true;
+}
+
+void FrameTrajectory::CloseStream()
+{
+    if(mStream.is_open())
+    {
+        WriteStream(mnEnd);
+        mStream.close();
+    }
+}
+
+void FrameTrajectory::FlushStream()
+{
+    if(mStream.is_open())
+        WriteStream(mnEnd);
+}
+
+void FrameTrajectory::ForgetMap(Map* pMap)
+{
+    vector<size_t> vnFrames;
+    for(size_t i=Begin(); i<mnEnd; i++)
+    {
+        KeyFrame* pKF = (*this)[i].pReferenceKF;
+        while(pKF && pKF->isBad() && pKF->GetMap()!=pMap)
+            pKF = pKF->GetParent();
+
+        if(pKF && pKF->GetMap()==pMap)
+            vnFrames.push_back(i);
+    }
+
+    if(vnFrames.empty())
+        return;
+
+    if(mStream.is_open())
+        WriteStream(vnFrames.back()+1);
+
+    for(size_t i : vnFrames)
+    {
+        FramePose &pose = (*this)[i];
+        pose.pReferenceKF = static_cast<KeyFrame*>(NULL);
+        pose.bLost = true;
+    }
+}
+
+void FrameTrajectory::Stream()
+{
+    if(!mStream.is_open() || mnEnd<mnLag)
+        return;
+
+    WriteStream(mnEnd-mnLag);
+
+    if(mbRelease)
+        ReleaseChunks(mnStreamed);
+}
+
+void FrameTrajectory::WriteStream(size_t nEnd)
+{
+    if(mnStreamed>=nEnd)
+        return;
+
+    for(size_t i=mnStreamed; i<nEnd; i++)
+    {
+        const FramePose &pose = (*this)[i];
+        if(pose.bLost || !pose.pReferenceKF)
+            continue;
+
+        KeyFrame* pKF = pose.pReferenceKF;
+
+        Sophus::SE3f Trw;
+
+        // If the reference keyframe was culled, traverse the spanning tree to get a suitable keyframe.
+        while(pKF && pKF->isBad())
+        {
+            Trw = Trw * pKF->mTcp;
+            pKF = pKF->GetParent();
+        }
+
+        if(!pKF)
+            continue;
+
+        Trw = Trw * pKF->GetPose();
+
+        Sophus::SE3f Twc = (pose.Tcr * Trw).inverse();
+        Eigen::Vector3f twc = Twc.translation();
+        Eigen::Quaternionf q = Twc.unit_quaternion();
+
+        mStream << setprecision(6) << pose.timestamp << " " <<  setprecision(9) << twc(0) << " " << twc(1) << " " << twc(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << "\n";
+    }
+    mStream.flush();
+
+    mnStreamed = nEnd;
+}
+
+void FrameTrajectory::ReleaseChunks(size_t nEnd)
+{
+    size_t nChunks = 0;
+    while(nChunks+1<mvpChunks.size() && (mnFirstChunk+nChunks+1)*ChunkSize<=nEnd)
+    {
+        delete[] mvpChunks[nChunks];
+        nChunks++;
+    }
+
+    if(nChunks>0)
+    {
+        mvpChunks.erase(mvpChunks.begin(),mvpChunks.begin()+nChunks);
+        mnFirstChunk += nChunks;
+    }
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,502 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "GlobalBundleAdjuster.h"
+
+#include "Map.h"
+#include "KeyFrame.h"
+#include "MapPoint.h"
+#include "ThreadPool.h"
+#include "OptimizableTypes.h"
+
+#include "Thirdparty/g2o/g2o/core/optimization_algorithm_levenberg.h"
+#include "Thirdparty/g2o/g2o/core/robust_kernel_impl.h"
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+// A variable is relinearized when it moved more than this since it was last optimized: radians
+// for keyframe rotations, and relative to the scene depth for keyframe and point positions.
+// It is about half a pixel for a 500 pixel focal length.
+static const double thRelinearize = 1e-3;
+
+// Above this fraction of changed keyframes the whole graph is optimized
+static const double thFullOptimization = 0.5;
+
+GlobalBundleAdjuster::GlobalBundleAdjuster(): mpThreadPool(NULL), mpMap(NULL), mnOptimizedKFs(0), mnOptimizedMPs(0)
+{
+    mpLinearSolver = new g2o::LinearSolverSupernodal<g2o::BlockSolver_6_3::PoseMatrixType>();
+    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(mpLinearSolver);
+    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+
+    mpOptimizer = new g2o::SparseOptimizer();
+    mpOptimizer->setAlgorithm(solver);
+    mpOptimizer->setVerbose(false);
+}
+
+GlobalBundleAdjuster::~GlobalBundleAdjuster()
+{
+    delete mpOptimizer;
+}
+
+void GlobalBundleAdjuster::SetThreadPool(ThreadPool* pThreadPool)
+{
+    unique_lock<mutex> lock(mMutexRun);
+    mpThreadPool = pThreadPool;
+
+    // Errors, Jacobians, the Schur complement and the factorization run on the pool
+    g2o::SparseOptimizer::ParallelForFunction parallelFor;
+    if(pThreadPool)
+        parallelFor = [pThreadPool](int n, const std::function<void(int)> &f){pThreadPool->ParallelFor(n,f);};
+    mpOptimizer->setParallelFor(parallelFor);
+    mpLinearSolver->setParallelFor(parallelFor);
+}
+
+void GlobalBundleAdjuster::Clear()
+{
+    unique_lock<mutex> lock(mMutexRun);
+    mpOptimizer->clear();
+    mmKeyFrames.clear();
+    mmMapPoints.clear();
+    mpMap = NULL;
+}
+
+bool GlobalBundleAdjuster::Run(Map* pMap, int nIterations, bool* pbStopFlag, unsigned long nLoopKF)
+{
+    unique_lock<mutex> lock(mMutexRun);
+
+    if(pMap!=mpMap)
+    {
+        mpOptimizer->clear();
+        mmKeyFrames.clear();
+        mmMapPoints.clear();
+        mpMap = pMap;
+    }
+
+    UpdateKeyFrames(pMap);
+    UpdateMapPoints(pMap);
+
+    // Variables to relinearize: changed keyframes and points, and all the points seen by a
+    // changed keyframe. Keyframes that only observe those points are kept fixed.
+    const unsigned long nInitKFId = pMap->GetInitKFid();
+    int nDirtyKFs = 0;
+    for(KeyFrameVertexMap::iterator it=mmKeyFrames.begin(); it!=mmKeyFrames.end(); it++)
+    {
+        if(it->second.bDirty && it->first!=nInitKFId)
+            nDirtyKFs++;
+    }
+    const bool bFull = nDirtyKFs > thFullOptimization*mmKeyFrames.size();
+
+    for(KeyFrameVertexMap::iterator it=mmKeyFrames.begin(); it!=mmKeyFrames.end(); it++)
+    {
+        KeyFrameVertex &kfv = it->second;
+        kfv.pVertex->setFixed(it->first==nInitKFId || !(bFull || kfv.bDirty));
+    }
+
+    g2o::HyperGraph::EdgeSet sEdges;
+    vector<MapPointVertex*> vpActiveMPs;
+    mnOptimizedKFs = 0;
+    mnOptimizedMPs = 0;
+    for(MapPointVertexMap::iterator it=mmMapPoints.begin(); it!=mmMapPoints.end(); it++)
+    {
+        MapPointVertex &mpv = it->second;
+        bool bActive = bFull || mpv.bDirty;
+        for(size_t i=0; i<mpv.vObservations.size() && !bActive; i++)
+            bActive = !mmKeyFrames[mpv.vObservations[i].nKFId].pVertex->fixed();
+        if(!bActive)
+            continue;
+
+        vpActiveMPs.push_back(&mpv);
+        for(size_t i=0; i<mpv.vObservations.size(); i++)
+        {
+            if(mpv.vObservations[i].pEdge)
+                sEdges.insert(mpv.vObservations[i].pEdge);
+            if(mpv.vObservations[i].pEdgeRight)
+                sEdges.insert(mpv.vObservations[i].pEdgeRight);
+        }
+    }
+
+    if(!sEdges.empty())
+    {
+        mpOptimizer->setForceStopFlag(pbStopFlag);
+        mpOptimizer->initializeOptimization(sEdges);
+        mpOptimizer->optimize(nIterations);
+        mpOptimizer->setForceStopFlag(NULL);
+
+        if(pbStopFlag && *pbStopFlag)
+            return false;
+    }
+
+    // The optimized variables are now linearized at their new estimate
+    for(KeyFrameVertexMap::iterator it=mmKeyFrames.begin(); it!=mmKeyFrames.end(); it++)
+    {
+        KeyFrameVertex &kfv = it->second;
+        if(kfv.pVertex->fixed())
+            continue;
+        kfv.Tref = kfv.pVertex->estimate();
+        kfv.medianDepth = kfv.pKF->ComputeSceneMedianDepth(2);
+        kfv.bDirty = false;
+        mnOptimizedKFs++;
+    }
+    for(size_t i=0; i<vpActiveMPs.size(); i++)
+    {
+        vpActiveMPs[i]->Pref = vpActiveMPs[i]->pVertex->estimate();
+        vpActiveMPs[i]->bDirty = false;
+    }
+    mnOptimizedMPs = vpActiveMPs.size();
+
+    // Recover optimized data. Keyframes and points not optimized keep the pose they had.
+    for(KeyFrameVertexMap::iterator it=mmKeyFrames.begin(); it!=mmKeyFrames.end(); it++)
+    {
+        KeyFrame* pKF = it->second.pKF;
+        const g2o::SE3Quat SE3quat = it->second.pVertex->estimate();
+        pKF->mTcwGBA = Sophus::SE3d(SE3quat.rotation(),SE3quat.translation()).cast<float>();
+        pKF->mnBAGlobalForKF = nLoopKF;
+    }
+
+    for(MapPointVertexMap::iterator it=mmMapPoints.begin(); it!=mmMapPoints.end(); it++)
+    {
+        MapPoint* pMP = it->second.pMP;
+        pMP->mPosGBA = it->second.pVertex->estimate().cast<float>();
+        pMP->mnBAGlobalForKF = nLoopKF;
+    }
+
+    return true;
+}
+
+void GlobalBundleAdjuster::UpdateKeyFrames(Map* pMap)
+{
+    for(KeyFrameVertexMap::iterator it=mmKeyFrames.begin(); it!=mmKeyFrames.end(); it++)
+        it->second.bSeen = false;
+
+    const vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
+    for(size_t i=0; i<vpKFs.size(); i++)
+    {
+        KeyFrame* pKF = vpKFs[i];
+        if(pKF->isBad())
+            continue;
+
+        Sophus::SE3<float> Tcw = pKF->GetPose();
+        const g2o::SE3Quat T(Tcw.unit_quaternion().cast<double>(),Tcw.translation().cast<double>());
+
+        KeyFrameVertexMap::iterator it = mmKeyFrames.find(pKF->mnId);
+        if(it==mmKeyFrames.end())
+        {
+            KeyFrameVertex kfv;
+            kfv.pVertex = new g2o::VertexSE3Expmap();
+            kfv.pVertex->setId(KeyFrameVertexId(pKF->mnId));
+            mpOptimizer->addVertex(kfv.pVertex);
+            kfv.Tref = T;
+            kfv.medianDepth = -1;
+            kfv.bDirty = true;
+            it = mmKeyFrames.insert(make_pair(pKF->mnId,kfv)).first;
+        }
+        else if(!it->second.bDirty)
+        {
+            const g2o::SE3Quat &Tref = it->second.Tref;
+            const double dRot = Tref.rotation().angularDistance(T.rotation());
+            const double dCenter = (Tref.inverse().translation()-T.inverse().translation()).norm();
+            if(dRot>thRelinearize)
+                it->second.bDirty = true;
+            else if(dCenter>0)
+            {
+                // Depth cached at the last optimization, the scale of the map barely changes in between
+                const float depth = it->second.medianDepth;
+                it->second.bDirty = depth<=0 || dCenter>thRelinearize*depth;
+            }
+        }
+
+        it->second.pVertex->setEstimate(T);
+        it->second.pKF = pKF;
+        it->second.bSeen = true;
+    }
+
+    for(KeyFrameVertexMap::iterator it=mmKeyFrames.begin(); it!=mmKeyFrames.end();)
+    {
+        if(it->second.bSeen)
+            it++;
+        else
+            RemoveKeyFrame(it++);
+    }
+}
+
+void GlobalBundleAdjuster::UpdateMapPoints(Map* pMap)
+{
+    for(MapPointVertexMap::iterator it=mmMapPoints.begin(); it!=mmMapPoints.end(); it++)
+        it->second.bSeen = false;
+
+    const vector<MapPoint*> vpMPs = pMap->GetAllMapPoints();
+    for(size_t i=0; i<vpMPs.size(); i++)
+    {
+        MapPoint* pMP = vpMPs[i];
+        if(pMP->isBad())
+            continue;
+
+        const Eigen::Vector3d P = pMP->GetWorldPos().cast<double>();
+
+        MapPointVertexMap::iterator it = mmMapPoints.find(pMP->mnId);
+        if(it==mmMapPoints.end())
+        {
+            MapPointVertex mpv;
+            mpv.pVertex = new g2o::VertexSBAPointXYZ();
+            mpv.pVertex->setId(MapPointVertexId(pMP->mnId));
+            mpv.pVertex->setMarginalized(true);
+            mpOptimizer->addVertex(mpv.pVertex);
+            mpv.Pref = P;
+            mpv.bDirty = true;
+            it = mmMapPoints.insert(make_pair(pMP->mnId,mpv)).first;
+        }
+        else if(!it->second.bDirty)
+        {
+            KeyFrame* pRefKF = pMP->GetReferenceKeyFrame();
+            const double depth = (P-pRefKF->GetCameraCenter().cast<double>()).norm();
+            it->second.bDirty = (P-it->second.Pref).norm() > thRelinearize*depth;
+        }
+
+        it->second.pVertex->setEstimate(P);
+        it->second.pMP = pMP;
+        it->second.bSeen = true;
+
+        UpdateObservations(it->second);
+    }
+
+    // Points without observations are left out, as in the full bundle adjustment
+    for(MapPointVertexMap::iterator it=mmMapPoints.begin(); it!=mmMapPoints.end();)
+    {
+        if(it->second.bSeen && !it->second.vObservations.empty())
+            it++;
+        else
+            RemoveMapPoint(it++);
+    }
+}
+
+void GlobalBundleAdjuster::UpdateObservations(MapPointVertex &mpv)
+{
+    const MapPoint::ObservationsView observations = mpv.pMP->GetObservationsView();
+
+    vector<pair<unsigned long,size_t> > vCurrent;
+    vCurrent.reserve(observations->size());
+    for(size_t i=0; i<observations->size(); i++)
+    {
+        KeyFrame* pKF = (*observations)[i].first;
+        if(pKF->isBad() || !mmKeyFrames.count(pKF->mnId))
+            continue;
+        vCurrent.push_back(make_pair(pKF->mnId,i));
+    }
+    sort(vCurrent.begin(),vCurrent.end());
+
+    // Merge the current observations with the ones in the graph, both sorted by keyframe id
+    vector<Observation> vObservations;
+    vObservations.reserve(vCurrent.size());
+    size_t j=0;
+    for(size_t i=0; i<vCurrent.size(); i++)
+    {
+        KeyFrame* pKF = (*observations)[vCurrent[i].second].first;
+        const tuple<int,int> &indexes = (*observations)[vCurrent[i].second].second;
+
+        while(j<mpv.vObservations.size() && mpv.vObservations[j].nKFId<vCurrent[i].first)
+        {
+            RemoveEdges(mpv.vObservations[j]);
+            mmKeyFrames[mpv.vObservations[j].nKFId].bDirty = true;
+            mpv.bDirty = true;
+            j++;
+        }
+
+        if(j<mpv.vObservations.size() && mpv.vObservations[j].nKFId==vCurrent[i].first &&
+           mpv.vObservations[j].leftIndex==get<0>(indexes) && mpv.vObservations[j].rightIndex==get<1>(indexes))
+        {
+            vObservations.push_back(mpv.vObservations[j]);
+            j++;
+            continue;
+        }
+
+        if(j<mpv.vObservations.size() && mpv.vObservations[j].nKFId==vCurrent[i].first)
+        {
+            RemoveEdges(mpv.vObservations[j]);
+            j++;
+        }
+
+        Observation obs;
+        obs.nKFId = pKF->mnId;
+        obs.leftIndex = get<0>(indexes);
+        obs.rightIndex = get<1>(indexes);
+        AddEdges(mpv, obs, pKF);
+        if(obs.pEdge || obs.pEdgeRight)
+            vObservations.push_back(obs);
+
+        mmKeyFrames[pKF->mnId].bDirty = true;
+        mpv.bDirty = true;
+    }
+
+    for(; j<mpv.vObservations.size(); j++)
+    {
+        RemoveEdges(mpv.vObservations[j]);
+        mmKeyFrames[mpv.vObservations[j].nKFId].bDirty = true;
+        mpv.bDirty = true;
+    }
+
+    mpv.vObservations.swap(vObservations);
+}
+
+void GlobalBundleAdjuster::AddEdges(MapPointVertex &mpv, Observation &obs, KeyFrame* pKF)
+{
+    obs.pEdge = NULL;
+    obs.pEdgeRight = NULL;
+
+    g2o::OptimizableGraph::Vertex* vPoint = mpv.pVertex;
+    g2o::OptimizableGraph::Vertex* vSE3 = mmKeyFrames[pKF->mnId].pVertex;
+
+    const int leftIndex = obs.leftIndex;
+
+    if(leftIndex != -1 && pKF->mvuRight[leftIndex]<0)
+    {
+        const cv::KeyPoint &kpUn = pKF->mvKeysUn[leftIndex];
+
+        Eigen::Matrix<double,2,1> measurement;
+        measurement << kpUn.pt.x, kpUn.pt.y;
+
+        ORB_SLAM3::EdgeSE3ProjectXYZ* e = new ORB_SLAM3::EdgeSE3ProjectXYZ();
+
+        e->setVertex(0, vPoint);
+        e->setVertex(1, vSE3);
+        e->setMeasurement(measurement);
+        const float &invSigma2 = pKF->mvInvLevelSigma2[kpUn.octave];
+        e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
+
+        e->pCamera = pKF->mpCamera;
+
+        mpOptimizer->addEdge(e);
+        obs.pEdge = e;
+    }
+    else if(leftIndex != -1 && pKF->mvuRight[leftIndex] >= 0) //Stereo observation
+    {
+        const cv::KeyPoint &kpUn = pKF->mvKeysUn[leftIndex];
+
+        Eigen::Matrix<double,3,1> measurement;
+        const float kp_ur = pKF->mvuRight[leftIndex];
+        measurement << kpUn.pt.x, kpUn.pt.y, kp_ur;
+
+        g2o::EdgeStereoSE3ProjectXYZ* e = new g2o::EdgeStereoSE3ProjectXYZ();
+
+        e->setVertex(0, vPoint);
+        e->setVertex(1, vSE3);
+        e->setMeasurement(measurement);
+        const float &invSigma2 = pKF->mvInvLevelSigma2[kpUn.octave];
+        e->setInformation(Eigen::Matrix3d::Identity()*invSigma2);
+
+        e->fx = pKF->fx;
+        e->fy = pKF->fy;
+        e->cx = pKF->cx;
+        e->cy = pKF->cy;
+        e->bf = pKF->mbf;
+
+        mpOptimizer->addEdge(e);
+        obs.pEdge = e;
+    }
+
+    if(pKF->mpCamera2)
+    {
+        int rightIndex = obs.rightIndex;
+
+        if(rightIndex != -1 && rightIndex < (int)pKF->mvKeysRight.size())
+        {
+            rightIndex -= pKF->NLeft;
+
+            Eigen::Matrix<double,2,1> measurement;
+            const cv::KeyPoint &kp = pKF->mvKeysRight[rightIndex];
+            measurement << kp.pt.x, kp.pt.y;
+
+            ORB_SLAM3::EdgeSE3ProjectXYZToBody *e = new ORB_SLAM3::EdgeSE3ProjectXYZToBody();
+
+            e->setVertex(0, vPoint);
+            e->setVertex(1, vSE3);
+            e->setMeasurement(measurement);
+            const float &invSigma2 = pKF->mvInvLevelSigma2[kp.octave];
+            e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
+
+            g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
+            e->setRobustKernel(rk);
+            rk->setDelta(sqrt(5.99));
+
+            Sophus::SE3f Trl = pKF->GetRelativePoseTrl();
+            e->mTrl = g2o::SE3Quat(Trl.unit_quaternion().cast<double>(), Trl.translation().cast<double>());
+
+            e->pCamera = pKF->mpCamera2;
+
+            mpOptimizer->addEdge(e);
+            obs.pEdgeRight = e;
+        }
+    }
+}
+
+void GlobalBundleAdjuster::RemoveEdges(Observation &obs)
+{
+    if(obs.pEdge)
+        mpOptimizer->removeEdge(obs.pEdge);
+    if(obs.pEdgeRight)
+        mpOptimizer->removeEdge(obs.pEdgeRight);
+    obs.pEdge = NULL;
+    obs.pEdgeRight = NULL;
+}
+
+void GlobalBundleAdjuster::RemoveKeyFrame(KeyFrameVertexMap::iterator it)
+{
+    // The points lose the observations of this keyframe, removeVertex deletes the edges
+    const unsigned long nKFId = it->first;
+    const g2o::HyperGraph::EdgeSet &sEdges = it->second.pVertex->edges();
+    for(g2o::HyperGraph::EdgeSet::const_iterator eit=sEdges.begin(); eit!=sEdges.end(); eit++)
+    {
+        const int nVertexId = (*eit)->vertex(0)->id();
+        MapPointVertexMap::iterator mit = mmMapPoints.find(nVertexId/2);
+        if(mit==mmMapPoints.end())
+            continue;
+
+        vector<Observation> &vObservations = mit->second.vObservations;
+        for(size_t i=0; i<vObservations.size(); i++)
+        {
+            if(vObservations[i].nKFId==nKFId)
+            {
+                vObservations.erase(vObservations.begin()+i);
+                break;
+            }
+        }
+        mit->second.bDirty = true;
+    }
+
+    mpOptimizer->removeVertex(it->second.pVertex);
+    mmKeyFrames.erase(it);
+}
+
+void GlobalBundleAdjuster::RemoveMapPoint(MapPointVertexMap::iterator it)
+{
+    vector<Observation> &vObservations = it->second.vObservations;
+    for(size_t i=0; i<vObservations.size(); i++)
+    {
+        KeyFrameVertexMap::iterator kit = mmKeyFrames.find(vObservations[i].nKFId);
+        if(kit!=mmKeyFrames.end())
+            kit->second.bDirty = true;
+    }
+
+    mpOptimizer->removeVertex(it->second.pVertex);
+    mmMapPoints.erase(it);
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,80 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "HammingDistance.h"
+
+#include "Thirdparty/DBoW2/DBoW2/HammingKernels.h"
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+// The kernels and their runtime dispatch live in DBoW2, which uses them for the vocabulary
+using DBoW2::HammingKernels::GetKernels;
+
+int HammingDistance::Compute(const uint8_t* a, const uint8_t* b)
+{
+    return GetKernels().pair(a, b);
+}
+
+void HammingDistance::Compute(const cv::Mat &query, const cv::Mat &descriptors,
+                              const vector<size_t> &vIndices, vector<int> &vDist)
+{
+    vDist.resize(vIndices.size());
+    if(vIndices.empty())
+        return;
+
+    GetKernels().batchSizeT(query.ptr<uint8_t>(), descriptors.ptr<uint8_t>(), descriptors.step[0],
+                            vIndices.data(), (int)vIndices.size(), vDist.data());
+}
+
+void HammingDistance::Compute(const cv::Mat &query, const cv::Mat &descriptors,
+                              const vector<unsigned int> &vIndices, vector<int> &vDist)
+{
+    Compute(query, descriptors, vIndices.data(), vIndices.size(), vDist);
+}
+
+void HammingDistance::Compute(const cv::Mat &query, const cv::Mat &descriptors,
+                              const unsigned int* pIndices, size_t n, vector<int> &vDist)
+{
+    vDist.resize(n);
+    if(n==0)
+        return;
+
+    GetKernels().batchUInt(query.ptr<uint8_t>(), descriptors.ptr<uint8_t>(), descriptors.step[0],
+                           pIndices, (int)n, vDist.data());
+}
+
+void HammingDistance::Compute(const uint8_t* query, const uint8_t* descriptors, int n, int* vDist)
+{
+    DBoW2::HammingKernels::DistancesContiguous(query, descriptors, n, vDist);
+}
+
+const char* HammingDistance::KernelName()
+{
+    return GetKernels().name;
+}
+
+bool HammingDistance::SelectKernel(const string &name)
+{
+    return GetKernels().Select(name);
+}
+
+} //namespace ORB_SLAM
@@ -168,67 +168,131 @@ void Preintegrated::Initialize(const Bias &b_)
 void Preintegrated::Reintegrate()
 {
     std::unique_lock<std::mutex> lock(mMutex);
-    const std::vector<integrable> aux = mvMeasurements;
+    std::vector<integrable> aux;
+    aux.swap(mvMeasurements);
     Initialize(bu);
-    for(size_t i=0;i<aux.size();i++)
-        IntegrateNewMeasurement(aux[i].a,aux[i].w,aux[i].t);
+    IntegrateNewMeasurements(aux.data(),aux.size());
 }
 
 void Preintegrated::IntegrateNewMeasurement(const Eigen::Vector3f &acceleration, const Eigen::Vector3f &angVel, const float &dt)
 {
     mvMeasurements.push_back(integrable(acceleration,angVel,dt));
 
+    Eigen::Vector3f bg, ba;
+    bg << b.bwx, b.bwy, b.bwz;
+    ba << b.bax, b.bay, b.baz;
+    IntegrateStep(mvMeasurements.back(),bg,ba);
+}
+
+void Preintegrated::IntegrateNewMeasurements(const integrable* pMeasurements, const size_t n)
+{
+    mvMeasurements.insert(mvMeasurements.end(),pMeasurements,pMeasurements+n);
+
+    Eigen::Vector3f bg, ba;
+    bg << b.bwx, b.bwy, b.bwz;
+    ba << b.bax, b.bay, b.baz;
+    for(size_t i=0;i<n;i++)
+        IntegrateStep(pMeasurements[i],bg,ba);
+}
+
+void Preintegrated::IntegrateStep(const integrable &m, const Eigen::Vector3f &bg, const Eigen::Vector3f &ba)
+{
     // Position is updated firstly, as it depends on previously computed velocity and rotation.
     // Velocity is updated secondly, as it depends on previously computed rotation.
     // Rotation is the last to be updated.
 
-    //Matrices to compute covariance
-    Eigen::Matrix<float,9,9> A;
-    A.setIdentity();
-    Eigen::Matrix<float,9,6> B;
-    B.setZero();
+    const float dt = m.t;
+    const float dt2 = dt*dt;
 
-    Eigen::Vector3f acc, accW;
-    acc << acceleration(0)-b.bax, acceleration(1)-b.bay, acceleration(2)-b.baz;
-    accW << angVel(0)-b.bwx, angVel(1)-b.bwy, angVel(2)-b.bwz;
+    const Eigen::Vector3f acc = m.a-ba;
+    const Eigen::Vector3f accW = m.w-bg;
+    const Eigen::Vector3f dRacc = dR*acc;
 
-    avgA = (dT*avgA + dR*acc*dt)/(dT+dt);
+    avgA = (dT*avgA + dRacc*dt)/(dT+dt);
     avgW = (dT*avgW + accW*dt)/(dT+dt);
 
     // Update delta position dP and velocity dV (rely on no-updated delta rotation)
-    dP = dP + dV*dt + 0.5f*dR*acc*dt*dt;
-    dV = dV + dR*acc*dt;
-
-    // Compute velocity and position parts of matrices A and B (rely on non-updated delta rotation)
-    Eigen::Matrix<float,3,3> Wacc = Sophus::SO3f::hat(acc);
+    dP += dV*dt + 0.5f*dRacc*dt2;
+    dV += dRacc*dt;
+
+    // Update position and velocity jacobians wrt bias correction (rely on non-updated delta rotation)
+    const Eigen::Matrix3f dRWacc = dR*Sophus::SO3f::hat(acc);
+    const Eigen::Matrix3f dRWaccJRg = dRWacc*JRg;
+    JPa += JVa*dt - 0.5f*dt2*dR;
+    JPg += JVg*dt - 0.5f*dt2*dRWaccJRg;
+    JVa -= dt*dR;
+    JVg -= dt*dRWaccJRg;
+
+    // Delta rotation of this step and its right jacobian, as IntegratedRotation
+    const Eigen::Vector3f v = accW*dt;
+    const float d2 = v.squaredNorm();
+    const float d = sqrt(d2);
+    const Eigen::Matrix3f W = Sophus::SO3f::hat(v);
+    Eigen::Matrix3f deltaR, rightJ;
+    if(d<eps)
+    {
+        deltaR = Eigen::Matrix3f::Identity() + W;
+        rightJ = Eigen::Matrix3f::Identity();
+    }
+    else
+    {
+        const Eigen::Matrix3f W2 = W*W;
+        const float s = sin(d);
+        const float c = cos(d);
+        deltaR = Eigen::Matrix3f::Identity() + W*s/d + W2*(1.0f-c)/d2;
+        rightJ = Eigen::Matrix3f::Identity() - W*(1.0f-c)/d2 + W2*(d-s)/(d2*d);
+    }
 
-    A.block<3,3>(3,0) = -dR*dt*Wacc;
-    A.block<3,3>(6,0) = -0.5f*dR*dt*dt*Wacc;
-    A.block<3,3>(6,3) = Eigen::DiagonalMatrix<float,3>(dt, dt, dt);
-    B.block<3,3>(3,3) = dR*dt;
-    B.block<3,3>(6,3) = 0.5f*dR*dt*dt;
+    // Update covariance C = A*C*A' + B*Nga*B'. With 3x3 blocks in (rotation, velocity, position) order
+    //  A = [dRi'  0  0; A1 I 0; A2 dt*I I],  B = [rightJ*dt 0; 0 dR*dt; 0 0.5*dR*dt^2]
+    // so it is computed by blocks, only the upper triangle
+    const Eigen::Matrix3f A1 = -dt*dRWacc;
+    const Eigen::Matrix3f A2 = 0.5f*dt*A1;
+    const Eigen::Matrix3f deltaRt = deltaR.transpose();
 
+    Eigen::Matrix<float,9,9> AC;
+    for(int j=0;j<9;j+=3)
+    {
+        const Eigen::Matrix3f C0j = C.block<3,3>(0,j);
+        const Eigen::Matrix3f C1j = C.block<3,3>(3,j);
+        AC.block<3,3>(0,j) = deltaRt*C0j;
+        AC.block<3,3>(3,j) = A1*C0j + C1j;
+        AC.block<3,3>(6,j) = A2*C0j + dt*C1j + C.block<3,3>(6,j);
+    }
 
-    // Update position and velocity jacobians wrt bias correction
-    JPa = JPa + JVa*dt -0.5f*dR*dt*dt;
-    JPg = JPg + JVg*dt -0.5f*dR*dt*dt*Wacc*JRg;
-    JVa = JVa - dR*dt;
-    JVg = JVg - dR*dt*Wacc*JRg;
+    const Eigen::Matrix3f A1t = A1.transpose();
+    const Eigen::Matrix3f A2t = A2.transpose();
+    for(int i=0;i<9;i+=3)
+    {
+        const Eigen::Matrix3f ACi0 = AC.block<3,3>(i,0);
+        const Eigen::Matrix3f ACi1 = AC.block<3,3>(i,3);
+        if(i==0)
+            C.block<3,3>(0,0) = ACi0*deltaR;
+        if(i<=3)
+            C.block<3,3>(i,3) = ACi0*A1t + ACi1;
+        C.block<3,3>(i,6) = ACi0*A2t + dt*ACi1 + AC.block<3,3>(i,6);
+    }
 
-    // Update delta rotation
-    IntegratedRotation dRi(angVel,b,dt);
-    dR = NormalizeRotation(dR*dRi.deltaR);
+    const Eigen::Matrix3f Ng = Nga.diagonal().head<3>().asDiagonal();
+    const Eigen::Matrix3f Na = dR*Nga.diagonal().tail<3>().asDiagonal()*dR.transpose();
+    C.block<3,3>(0,0) += (dt2*rightJ)*Ng*rightJ.transpose();
+    C.block<3,3>(3,3) += dt2*Na;
+    C.block<3,3>(3,6) += (0.5f*dt2*dt)*Na;
+    C.block<3,3>(6,6) += (0.25f*dt2*dt2)*Na;
 
-    // Compute rotation parts of matrices A and B
-    A.block<3,3>(0,0) = dRi.deltaR.transpose();
-    B.block<3,3>(0,0) = dRi.rightJ*dt;
+    C.block<3,3>(3,0) = C.block<3,3>(0,3).transpose();
+    C.block<3,3>(6,0) = C.block<3,3>(0,6).transpose();
+    C.block<3,3>(6,3) = C.block<3,3>(3,6).transpose();
 
-    // Update covariance
-    C.block<9,9>(0,0) = A * C.block<9,9>(0,0) * A.transpose() + B*Nga*B.transpose();
-    C.block<6,6>(9,9) += NgaWalk;
+    C.diagonal().tail<6>() += NgaWalk.diagonal();
 
     // Update rotation jacobian wrt bias correction
-    JRg = dRi.deltaR.transpose()*JRg - dRi.rightJ*dt;
+    JRg = deltaRt*JRg - rightJ*dt;
+
+    // Update delta rotation. The product of two rotations is orthonormal up to rounding,
+    // one Newton step of the polar decomposition gives the same rotation as NormalizeRotation
+    const Eigen::Matrix3f R = dR*deltaR;
+    dR = 0.5f*R*(3.0f*Eigen::Matrix3f::Identity() - R.transpose()*R);
 
     // Total integrated time
     dT += dt;
@@ -249,14 +313,13 @@ void Preintegrated::MergePrevious(Preintegrated* pPrev)
     bav.bay = bu.bay;
     bav.baz = bu.baz;
 
-    const std::vector<integrable > aux1 = pPrev->mvMeasurements;
-    const std::vector<integrable> aux2 = mvMeasurements;
+    std::vector<integrable> aux2;
+    aux2.swap(mvMeasurements);
 
     Initialize(bav);
-    for(size_t i=0;i<aux1.size();i++)
-        IntegrateNewMeasurement(aux1[i].a,aux1[i].w,aux1[i].t);
-    for(size_t i=0;i<aux2.size();i++)
-        IntegrateNewMeasurement(aux2[i].a,aux2[i].w,aux2[i].t);
+    mvMeasurements.reserve(pPrev->mvMeasurements.size()+aux2.size());
+    IntegrateNewMeasurements(pPrev->mvMeasurements.data(),pPrev->mvMeasurements.size());
+    IntegrateNewMeasurements(aux2.data(),aux2.size());
 
 }
 
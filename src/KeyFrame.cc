@@ -20,6 +20,8 @@
 #include "Converter.h"
 #include "ImuTypes.h"
 #include<mutex>
+#include<algorithm>
+#include<limits>
 
 namespace ORB_SLAM3
 {
@@ -37,9 +39,9 @@ KeyFrame::KeyFrame():
         mfLogScaleFactor(0), mvScaleFactors(0), mvLevelSigma2(0), mvInvLevelSigma2(0), mnMinX(0), mnMinY(0), mnMaxX(0),
         mnMaxY(0), mPrevKF(static_cast<KeyFrame*>(NULL)), mNextKF(static_cast<KeyFrame*>(NULL)), mbFirstConnection(true), mpParent(NULL), mbNotErase(false),
         mbToBeErased(false), mbBad(false), mHalfBaseline(0), mbCurrentPlaceRecognition(false), mnMergeCorrectedForKF(0),
-        NLeft(0),NRight(0), mnNumberOfOpt(0), mbHasVelocity(false)
+        NLeft(0),NRight(0), mnNumberOfOpt(0), mbHasVelocity(false), mpMap(static_cast<Map*>(NULL))
 {
-
+    mpOrderedConnections = EmptyCovisibility();
 }
 
 KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
@@ -63,19 +65,11 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
 {
     mnId=nNextId++;
 
-    mGrid.resize(mnGridCols);
-    if(F.Nleft != -1)  mGridRight.resize(mnGridCols);
-    for(int i=0; i<mnGridCols;i++)
-    {
-        mGrid[i].resize(mnGridRows);
-        if(F.Nleft != -1) mGridRight[i].resize(mnGridRows);
-        for(int j=0; j<mnGridRows; j++){
-            mGrid[i][j] = F.mGrid[i][j];
-            if(F.Nleft != -1){
-                mGridRight[i][j] = F.mGridRight[i][j];
-            }
-        }
-    }
+    mpOrderedConnections = EmptyCovisibility();
+
+    mGrid = F.mGrid;
+    if(F.Nleft != -1)
+        mGridRight = F.mGridRight;
 
 
 
@@ -95,15 +89,10 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
     mnOriginMapId = pMap->GetId();
 }
 
-void KeyFrame::ComputeBoW()
+void KeyFrame::ComputeBoW(ThreadPool* pThreadPool)
 {
     if(mBowVec.empty() || mFeatVec.empty())
-    {
-        vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
-        // Feature vector associate features with nodes in the 4th level (from leaves up)
-        // We assume the vocabulary tree has 6 levels, change the 4 otherwise
-        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4);
-    }
+        Frame::ComputeBoW(mpORBvocabulary,mDescriptors,mBowVec,mFeatVec,pThreadPool);
 }
 
 void KeyFrame::SetPose(const Sophus::SE3f &Tcw)
@@ -119,6 +108,11 @@ void KeyFrame::SetPose(const Sophus::SE3f &Tcw)
     {
         mOwb = mRwc * mImuCalib.mTcb.translation() + mTwc.translation();
     }
+
+    // Moved while holding the pose, so the index ends with the last one set
+    Map* pMap = GetMap();
+    if(pMap)
+        pMap->UpdateKeyFramePosition(this,mTwc.translation());
 }
 
 void KeyFrame::SetVelocity(const Eigen::Vector3f &Vw)
@@ -186,14 +180,29 @@ bool KeyFrame::isVelocitySet()
     return mbHasVelocity;
 }
 
+KeyFrame::CovisibilityView KeyFrame::EmptyCovisibility()
+{
+    static const CovisibilityView pEmpty = make_shared<const CovisibilityList>();
+    return pEmpty;
+}
+
+void KeyFrame::SortByWeight(CovisibilityList &vConnections)
+{
+    sort(vConnections.begin(),vConnections.end(),[](const pair<KeyFrame*,int> &a, const pair<KeyFrame*,int> &b){
+        return a.second>b.second || (a.second==b.second && a.first>b.first);
+    });
+}
+
 void KeyFrame::AddConnection(KeyFrame *pKF, const int &weight)
 {
     {
         unique_lock<mutex> lock(mMutexConnections);
-        if(!mConnectedKeyFrameWeights.count(pKF))
-            mConnectedKeyFrameWeights[pKF]=weight;
-        else if(mConnectedKeyFrameWeights[pKF]!=weight)
-            mConnectedKeyFrameWeights[pKF]=weight;
+        CovisibilityList::iterator it = lower_bound(mConnectedKeyFrameWeights.begin(),mConnectedKeyFrameWeights.end(),
+                                                    make_pair(pKF,std::numeric_limits<int>::min()));
+        if(it==mConnectedKeyFrameWeights.end() || it->first!=pKF)
+            mConnectedKeyFrameWeights.insert(it,make_pair(pKF,weight));
+        else if(it->second!=weight)
+            it->second=weight;
         else
             return;
     }
@@ -204,79 +213,69 @@ void KeyFrame::AddConnection(KeyFrame *pKF, const int &weight)
 void KeyFrame::UpdateBestCovisibles()
 {
     unique_lock<mutex> lock(mMutexConnections);
-    vector<pair<int,KeyFrame*> > vPairs;
-    vPairs.reserve(mConnectedKeyFrameWeights.size());
-    for(map<KeyFrame*,int>::iterator mit=mConnectedKeyFrameWeights.begin(), mend=mConnectedKeyFrameWeights.end(); mit!=mend; mit++)
-       vPairs.push_back(make_pair(mit->second,mit->first));
-
-    sort(vPairs.begin(),vPairs.end());
-    list<KeyFrame*> lKFs;
-    list<int> lWs;
-    for(size_t i=0, iend=vPairs.size(); i<iend;i++)
+    shared_ptr<CovisibilityList> pOrdered = make_shared<CovisibilityList>();
+    pOrdered->reserve(mConnectedKeyFrameWeights.size());
+    for(const pair<KeyFrame*,int> &connection : mConnectedKeyFrameWeights)
     {
-        if(!vPairs[i].second->isBad())
-        {
-            lKFs.push_front(vPairs[i].second);
-            lWs.push_front(vPairs[i].first);
-        }
+        if(!connection.first->isBad())
+            pOrdered->push_back(connection);
     }
 
-    mvpOrderedConnectedKeyFrames = vector<KeyFrame*>(lKFs.begin(),lKFs.end());
-    mvOrderedWeights = vector<int>(lWs.begin(), lWs.end());
+    SortByWeight(*pOrdered);
+    mpOrderedConnections = pOrdered;
 }
 
 set<KeyFrame*> KeyFrame::GetConnectedKeyFrames()
 {
     unique_lock<mutex> lock(mMutexConnections);
     set<KeyFrame*> s;
-    for(map<KeyFrame*,int>::iterator mit=mConnectedKeyFrameWeights.begin();mit!=mConnectedKeyFrameWeights.end();mit++)
-        s.insert(mit->first);
+    for(const pair<KeyFrame*,int> &connection : mConnectedKeyFrameWeights)
+        s.insert(s.end(),connection.first);
     return s;
 }
 
-vector<KeyFrame*> KeyFrame::GetVectorCovisibleKeyFrames()
+KeyFrame::CovisibilityView KeyFrame::GetCovisibilityView()
 {
     unique_lock<mutex> lock(mMutexConnections);
-    return mvpOrderedConnectedKeyFrames;
+    return mpOrderedConnections;
 }
 
-vector<KeyFrame*> KeyFrame::GetBestCovisibilityKeyFrames(const int &N)
+vector<KeyFrame*> KeyFrame::GetVectorCovisibleKeyFrames()
 {
-    unique_lock<mutex> lock(mMutexConnections);
-    if((int)mvpOrderedConnectedKeyFrames.size()<N)
-        return mvpOrderedConnectedKeyFrames;
-    else
-        return vector<KeyFrame*>(mvpOrderedConnectedKeyFrames.begin(),mvpOrderedConnectedKeyFrames.begin()+N);
+    return GetBestCovisibilityKeyFrames(std::numeric_limits<int>::max());
+}
 
+vector<KeyFrame*> KeyFrame::GetBestCovisibilityKeyFrames(const int &N)
+{
+    const CovisibilityView pOrdered = GetCovisibilityView();
+    const size_t n = min(pOrdered->size(),(size_t)max(N,0));
+    vector<KeyFrame*> vpKFs(n);
+    for(size_t i=0; i<n; i++)
+        vpKFs[i] = (*pOrdered)[i].first;
+    return vpKFs;
 }
 
 vector<KeyFrame*> KeyFrame::GetCovisiblesByWeight(const int &w)
 {
-    unique_lock<mutex> lock(mMutexConnections);
-
-    if(mvpOrderedConnectedKeyFrames.empty())
-    {
-        return vector<KeyFrame*>();
-    }
+    // Keyframes with a weight of at least w
+    const CovisibilityView pOrdered = GetCovisibilityView();
+    const size_t n = partition_point(pOrdered->begin(),pOrdered->end(),[w](const pair<KeyFrame*,int> &connection){
+        return connection.second>=w;
+    })-pOrdered->begin();
 
-    vector<int>::iterator it = upper_bound(mvOrderedWeights.begin(),mvOrderedWeights.end(),w,KeyFrame::weightComp);
-
-    if(it==mvOrderedWeights.end() && mvOrderedWeights.back() < w)
-    {
-        return vector<KeyFrame*>();
-    }
-    else
-    {
-        int n = it-mvOrderedWeights.begin();
-        return vector<KeyFrame*>(mvpOrderedConnectedKeyFrames.begin(), mvpOrderedConnectedKeyFrames.begin()+n);
-    }
+    vector<KeyFrame*> vpKFs(n);
+    for(size_t i=0; i<n; i++)
+        vpKFs[i] = (*pOrdered)[i].first;
+    return vpKFs;
 }
 
 int KeyFrame::GetWeight(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexConnections);
-    if(mConnectedKeyFrameWeights.count(pKF))
-        return mConnectedKeyFrameWeights[pKF];
+    CovisibilityList::const_iterator it = lower_bound(mConnectedKeyFrameWeights.begin(),mConnectedKeyFrameWeights.end(),
+                                                      make_pair(pKF,std::numeric_limits<int>::min()));
+    if(it!=mConnectedKeyFrameWeights.end() && it->first==pKF)
+        return it->second;
     else
         return 0;
 }
@@ -378,8 +377,6 @@ MapPoint* KeyFrame::GetMapPoint(const size_t &idx)
 
 void KeyFrame::UpdateConnections(bool upParent)
 {
-    map<KeyFrame*,int> KFcounter;
-
     vector<MapPoint*> vpMP;
 
     {
@@ -388,7 +385,8 @@ void KeyFrame::UpdateConnections(bool upParent)
     }
 
     //For all map points in keyframe check in which other keyframes are they seen
-    //Increase counter for those keyframes
+    //Each observation is a vote for its keyframe, the votes are counted after sorting them
+    vector<KeyFrame*> vpVotes;
     for(vector<MapPoint*>::iterator vit=vpMP.begin(), vend=vpMP.end(); vit!=vend; vit++)
     {
         MapPoint* pMP = *vit;
@@ -399,19 +397,34 @@ void KeyFrame::UpdateConnections(bool upParent)
         if(pMP->isBad())
             continue;
 
-        map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
+        const MapPoint::ObservationsView observations = pMP->GetObservationsView();
 
-        for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
-            if(mit->first->mnId==mnId || mit->first->isBad() || mit->first->GetMap() != mpMap)
-                continue;
-            KFcounter[mit->first]++;
-
+            if(mit->first!=this)
+                vpVotes.push_back(mit->first);
         }
     }
 
+    sort(vpVotes.begin(),vpVotes.end());
+
+    // Counter for each keyframe, sorted by pointer. Bad keyframes and those in other maps are
+    // checked once per keyframe instead of once per observation.
+    CovisibilityList vCounter;
+    for(size_t i=0; i<vpVotes.size();)
+    {
+        size_t j = i+1;
+        while(j<vpVotes.size() && vpVotes[j]==vpVotes[i])
+            j++;
+
+        KeyFrame* pKFi = vpVotes[i];
+        if(!pKFi->isBad() && pKFi->GetMap()==mpMap)
+            vCounter.push_back(make_pair(pKFi,(int)(j-i)));
+        i = j;
+    }
+
     // This should not happen
-    if(KFcounter.empty())
+    if(vCounter.empty())
         return;
 
     //If the counter is greater than threshold add connection
@@ -420,52 +433,38 @@ void KeyFrame::UpdateConnections(bool upParent)
     KeyFrame* pKFmax=NULL;
     int th = 15;
 
-    vector<pair<int,KeyFrame*> > vPairs;
-    vPairs.reserve(KFcounter.size());
-    if(!upParent)
-        cout << "UPDATE_CONN: current KF " << mnId << endl;
-    for(map<KeyFrame*,int>::iterator mit=KFcounter.begin(), mend=KFcounter.end(); mit!=mend; mit++)
+    shared_ptr<CovisibilityList> pOrdered = make_shared<CovisibilityList>();
+    for(const pair<KeyFrame*,int> &counter : vCounter)
     {
-        if(!upParent)
-            cout << "  UPDATE_CONN: KF " << mit->first->mnId << " ; num matches: " << mit->second << endl;
-        if(mit->second>nmax)
+        if(counter.second>nmax)
         {
-            nmax=mit->second;
-            pKFmax=mit->first;
+            nmax=counter.second;
+            pKFmax=counter.first;
         }
-        if(mit->second>=th)
+        if(counter.second>=th)
         {
-            vPairs.push_back(make_pair(mit->second,mit->first));
-            (mit->first)->AddConnection(this,mit->second);
+            pOrdered->push_back(counter);
+            counter.first->AddConnection(this,counter.second);
         }
     }
 
-    if(vPairs.empty())
+    if(pOrdered->empty())
     {
-        vPairs.push_back(make_pair(nmax,pKFmax));
+        pOrdered->push_back(make_pair(pKFmax,nmax));
         pKFmax->AddConnection(this,nmax);
     }
 
-    sort(vPairs.begin(),vPairs.end());
-    list<KeyFrame*> lKFs;
-    list<int> lWs;
-    for(size_t i=0; i<vPairs.size();i++)
-    {
-        lKFs.push_front(vPairs[i].second);
-        lWs.push_front(vPairs[i].first);
-    }
+    SortByWeight(*pOrdered);
 
     {
         unique_lock<mutex> lockCon(mMutexConnections);
 
-        mConnectedKeyFrameWeights = KFcounter;
-        mvpOrderedConnectedKeyFrames = vector<KeyFrame*>(lKFs.begin(),lKFs.end());
-        mvOrderedWeights = vector<int>(lWs.begin(), lWs.end());
-
+        mConnectedKeyFrameWeights.swap(vCounter);
+        mpOrderedConnections = pOrdered;
 
         if(mbFirstConnection && mnId!=mpMap->GetInitKFid())
         {
-            mpParent = mvpOrderedConnectedKeyFrames.front();
+            mpParent = pOrdered->front().first;
             mpParent->AddChild(this);
             mbFirstConnection = false;
         }
@@ -585,9 +584,14 @@ void KeyFrame::SetBadFlag()
         }
     }
 
-    for(map<KeyFrame*,int>::iterator mit = mConnectedKeyFrameWeights.begin(), mend=mConnectedKeyFrameWeights.end(); mit!=mend; mit++)
+    CovisibilityList vConnections;
+    {
+        unique_lock<mutex> lock(mMutexConnections);
+        vConnections = mConnectedKeyFrameWeights;
+    }
+    for(const pair<KeyFrame*,int> &connection : vConnections)
     {
-        mit->first->EraseConnection(this);
+        connection.first->EraseConnection(this);
     }
 
     for(size_t i=0; i<mvpMapPoints.size(); i++)
@@ -603,7 +607,7 @@ void KeyFrame::SetBadFlag()
         unique_lock<mutex> lock1(mMutexFeatures);
 
         mConnectedKeyFrameWeights.clear();
-        mvpOrderedConnectedKeyFrames.clear();
+        mpOrderedConnections = EmptyCovisibility();
 
         // Update Spanning Tree
         set<KeyFrame*> sParentCandidates;
@@ -689,9 +693,11 @@ void KeyFrame::EraseConnection(KeyFrame* pKF)
     bool bUpdate = false;
     {
         unique_lock<mutex> lock(mMutexConnections);
-        if(mConnectedKeyFrameWeights.count(pKF))
+        CovisibilityList::iterator it = lower_bound(mConnectedKeyFrameWeights.begin(),mConnectedKeyFrameWeights.end(),
+                                                    make_pair(pKF,std::numeric_limits<int>::min()));
+        if(it!=mConnectedKeyFrameWeights.end() && it->first==pKF)
         {
-            mConnectedKeyFrameWeights.erase(pKF);
+            mConnectedKeyFrameWeights.erase(it);
             bUpdate=true;
         }
     }
@@ -725,24 +731,8 @@ vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const
     if(nMaxCellY<0)
         return vIndices;
 
-    for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
-    {
-        for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
-        {
-            const vector<size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
-            {
-                const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[vCell[j]]
-                                                         : (!bRight) ? mvKeys[vCell[j]]
-                                                                     : mvKeysRight[vCell[j]];
-                const float distx = kpUn.pt.x-x;
-                const float disty = kpUn.pt.y-y;
-
-                if(fabs(distx)<r && fabs(disty)<r)
-                    vIndices.push_back(vCell[j]);
-            }
-        }
-    }
+    const FeatureGrid &grid = (!bRight) ? mGrid : mGridRight;
+    grid.GetFeaturesInArea(nMinCellX,nMaxCellX,nMinCellY,nMaxCellY,x,y,r,-1,-1,vIndices);
 
     return vIndices;
 }
@@ -844,6 +834,35 @@ void KeyFrame::UpdateMap(Map* pMap)
     mpMap = pMap;
 }
 
+size_t KeyFrame::GetMemoryUsage()
+{
+    // The feature data never changes after the keyframe is created
+    size_t nBytes = sizeof(KeyFrame);
+    nBytes += (mvKeys.capacity()+mvKeysUn.capacity()+mvKeysRight.capacity())*sizeof(cv::KeyPoint);
+    nBytes += (mvuRight.capacity()+mvDepth.capacity())*sizeof(float);
+    nBytes += (mvLeftToRightMatch.capacity()+mvRightToLeftMatch.capacity())*sizeof(int);
+    nBytes += mDescriptors.total()*mDescriptors.elemSize();
+    nBytes += mGrid.GetMemoryUsage()+mGridRight.GetMemoryUsage();
+    nBytes += mBowVec.capacity()*sizeof(DBoW2::BowVector::value_type);
+    nBytes += mFeatVec.size()*sizeof(DBoW2::FeatureVector::value_type)+N*sizeof(unsigned int);
+    if(mpImuPreintegrated && mpImuPreintegrated!=&mBackupImuPreintegrated)
+        nBytes += sizeof(IMU::Preintegrated);
+
+    {
+        unique_lock<mutex> lock(mMutexFeatures);
+        nBytes += mvpMapPoints.capacity()*sizeof(MapPoint*);
+    }
+
+    {
+        unique_lock<mutex> lock(mMutexConnections);
+        nBytes += (mConnectedKeyFrameWeights.capacity()+mpOrderedConnections->capacity())*sizeof(std::pair<KeyFrame*,int>);
+        // Tree nodes take about four pointers besides the element
+        nBytes += (mspChildrens.size()+mspLoopEdges.size()+mspMergeEdges.size())*(sizeof(KeyFrame*)+4*sizeof(void*));
+    }
+
+    return nBytes;
+}
+
 void KeyFrame::PreSave(set<KeyFrame*>& spKF,set<MapPoint*>& spMP, set<GeometricCamera*>& spCam)
 {
     // Save the id of each MapPoint in this KF, there can be null pointer in the vector
@@ -859,7 +878,7 @@ void KeyFrame::PreSave(set<KeyFrame*>& spKF,set<MapPoint*>& spMP, set<GeometricC
     }
     // Save the id of each connected KF with it weight
     mBackupConnectedKeyFrameIdWeights.clear();
-    for(std::map<KeyFrame*,int>::const_iterator it = mConnectedKeyFrameWeights.begin(), end = mConnectedKeyFrameWeights.end(); it != end; ++it)
+    for(CovisibilityList::const_iterator it = mConnectedKeyFrameWeights.begin(), end = mConnectedKeyFrameWeights.end(); it != end; ++it)
     {
         if(spKF.find(it->first) != spKF.end())
             mBackupConnectedKeyFrameIdWeights[it->first->mnId] = it->second;
@@ -945,8 +964,9 @@ void KeyFrame::PostLoad(map<long unsigned int, KeyFrame*>& mpKFid, map<long unsi
         it != end; ++it)
     {
         KeyFrame* pKFi = mpKFid[it->first];
-        mConnectedKeyFrameWeights[pKFi] = it->second;
+        mConnectedKeyFrameWeights.push_back(make_pair(pKFi,it->second));
     }
+    sort(mConnectedKeyFrameWeights.begin(),mConnectedKeyFrameWeights.end());
 
     // Restore parent KeyFrame
     if(mBackupParentId>=0)
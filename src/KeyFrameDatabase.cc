@@ -23,6 +23,9 @@
 #include "Thirdparty/DBoW2/DBoW2/BowVector.h"
 
 #include<mutex>
+#include<cmath>
+#include<algorithm>
+#include<functional>
 
 using namespace std;
 
@@ -40,95 +43,221 @@ void KeyFrameDatabase::add(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutex);
 
+    if(mmKeyFrameSlots.count(pKF))
+        return;
+
+    const unsigned int nSlot = NewSlot();
+    mvpKeyFrameSlots[nSlot] = pKF;
+    mmKeyFrameSlots[pKF] = nSlot;
+
     for(DBoW2::BowVector::const_iterator vit= pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit!=vend; vit++)
-        mvInvertedFile[vit->first].push_back(pKF);
+    {
+        Posting posting;
+        posting.nSlot = nSlot;
+        posting.weight = vit->second;
+        mvInvertedFile[vit->first].push_back(posting);
+    }
+}
+
+bool KeyFrameDatabase::addStored(Map* pMap, const DBoW2::BowVector &bowVec)
+{
+    unique_lock<mutex> lock(mMutex);
+
+    if(!bowVec.empty() && bowVec.back().first>=mvInvertedFile.size())
+        return false;
+
+    const unsigned int nSlot = NewSlot();
+    mvpStoredSlotMaps[nSlot] = pMap;
+
+    for(DBoW2::BowVector::const_iterator vit= bowVec.begin(), vend=bowVec.end(); vit!=vend; vit++)
+    {
+        Posting posting;
+        posting.nSlot = nSlot;
+        posting.weight = vit->second;
+        mvInvertedFile[vit->first].push_back(posting);
+    }
+
+    return true;
+}
+
+unsigned int KeyFrameDatabase::NewSlot()
+{
+    if(!mvFreeSlots.empty())
+    {
+        const unsigned int nSlot = mvFreeSlots.back();
+        mvFreeSlots.pop_back();
+        return nSlot;
+    }
+
+    mvpKeyFrameSlots.push_back(static_cast<KeyFrame*>(NULL));
+    mvpStoredSlotMaps.push_back(static_cast<Map*>(NULL));
+    mvnSlotWords.push_back(0);
+    mvSlotScores.push_back(0.0);
+    return mvpKeyFrameSlots.size()-1;
 }
 
 void KeyFrameDatabase::erase(KeyFrame* pKF)
 {
     unique_lock<mutex> lock(mMutex);
 
+    std::unordered_map<KeyFrame*,unsigned int>::iterator mit = mmKeyFrameSlots.find(pKF);
+    if(mit==mmKeyFrameSlots.end())
+        return;
+    const unsigned int nSlot = mit->second;
+
     // Erase elements in the Inverse File for the entry
     for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit!=vend; vit++)
     {
-        // List of keyframes that share the word
-        list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+        // Keyframes that share the word
+        vector<Posting> &vPostings = mvInvertedFile[vit->first];
 
-        for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+        for(vector<Posting>::iterator pit=vPostings.begin(), pend=vPostings.end(); pit!=pend; pit++)
         {
-            if(pKF==*lit)
+            if(pit->nSlot==nSlot)
             {
-                lKFs.erase(lit);
+                vPostings.erase(pit);
                 break;
             }
         }
     }
+
+    mvpKeyFrameSlots[nSlot] = static_cast<KeyFrame*>(NULL);
+    mvFreeSlots.push_back(nSlot);
+    mmKeyFrameSlots.erase(mit);
 }
 
 void KeyFrameDatabase::clear()
 {
     mvInvertedFile.clear();
     mvInvertedFile.resize(mpVoc->size());
+    mvpKeyFrameSlots.clear();
+    mvpStoredSlotMaps.clear();
+    mvFreeSlots.clear();
+    mmKeyFrameSlots.clear();
+    mvnSlotWords.clear();
+    mvSlotScores.clear();
 }
 
 void KeyFrameDatabase::clearMap(Map* pMap)
 {
     unique_lock<mutex> lock(mMutex);
 
+    // Free the slots of the keyframes in the map
+    vector<bool> vbErased(mvpKeyFrameSlots.size(),false);
+    for(size_t i=0; i<mvpKeyFrameSlots.size(); i++)
+    {
+        KeyFrame* pKFi = mvpKeyFrameSlots[i];
+        if(pKFi && pMap == pKFi->GetMap())
+        {
+            // Dont delete the KF because the class Map clean all the KF when it is destroyed
+            vbErased[i] = true;
+            mvpKeyFrameSlots[i] = static_cast<KeyFrame*>(NULL);
+            mvFreeSlots.push_back(i);
+            mmKeyFrameSlots.erase(pKFi);
+        }
+        else if(mvpStoredSlotMaps[i] == pMap)
+        {
+            vbErased[i] = true;
+            mvpStoredSlotMaps[i] = static_cast<Map*>(NULL);
+            mvFreeSlots.push_back(i);
+        }
+    }
+
     // Erase elements in the Inverse File for the entry
-    for(std::vector<list<KeyFrame*> >::iterator vit=mvInvertedFile.begin(), vend=mvInvertedFile.end(); vit!=vend; vit++)
+    for(std::vector<vector<Posting> >::iterator vit=mvInvertedFile.begin(), vend=mvInvertedFile.end(); vit!=vend; vit++)
     {
-        // List of keyframes that share the word
-        list<KeyFrame*> &lKFs =  *vit;
+        // Keyframes that share the word
+        vector<Posting> &vPostings = *vit;
 
-        for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend;)
+        size_t j=0;
+        for(size_t i=0; i<vPostings.size(); i++)
         {
-            KeyFrame* pKFi = *lit;
-            if(pMap == pKFi->GetMap())
-            {
-                lit = lKFs.erase(lit);
-                // Dont delete the KF because the class Map clean all the KF when it is destroyed
-            }
+            if(!vbErased[vPostings[i].nSlot])
+                vPostings[j++] = vPostings[i];
+        }
+        vPostings.resize(j);
+    }
+}
+
+void KeyFrameDatabase::ScoreSharingKeyFrames(const DBoW2::BowVector &bowVec)
+{
+    mvTouchedSlots.clear();
+
+    // Accumulate the L1 score term by term in the same word order as DBoW2::L1Scoring
+    for(DBoW2::BowVector::const_iterator vit=bowVec.begin(), vend=bowVec.end(); vit != vend; vit++)
+    {
+        const DBoW2::WordValue vi = vit->second;
+        const vector<Posting> &vPostings = mvInvertedFile[vit->first];
+
+        for(size_t i=0, iend=vPostings.size(); i<iend; i++)
+        {
+            const unsigned int nSlot = vPostings[i].nSlot;
+            const DBoW2::WordValue wi = vPostings[i].weight;
+
+            if(mvnSlotWords[nSlot]==0)
+                mvTouchedSlots.push_back(nSlot);
+            mvnSlotWords[nSlot]++;
+            mvSlotScores[nSlot] += fabs(vi - wi) - fabs(vi) - fabs(wi);
+        }
+    }
+
+    const bool bL1 = mpVoc->getScoringType()==DBoW2::L1_NORM;
+
+    mvpSharingKFs.clear();
+    mvnSharingWords.clear();
+    mvSharingScores.clear();
+    mvpSharingStoredMaps.clear();
+    mvnSharingStoredWords.clear();
+    mvSharingStoredScores.clear();
+    for(size_t i=0, iend=mvTouchedSlots.size(); i<iend; i++)
+    {
+        const unsigned int nSlot = mvTouchedSlots[i];
+        KeyFrame* pKFi = mvpKeyFrameSlots[nSlot];
+        if(pKFi)
+        {
+            mvpSharingKFs.push_back(pKFi);
+            mvnSharingWords.push_back(mvnSlotWords[nSlot]);
+            if(bL1)
+                mvSharingScores.push_back(-mvSlotScores[nSlot]/2.0);
             else
-            {
-                ++lit;
-            }
+                mvSharingScores.push_back(mpVoc->score(bowVec,pKFi->mBowVec));
         }
+        else
+        {
+            mvpSharingStoredMaps.push_back(mvpStoredSlotMaps[nSlot]);
+            mvnSharingStoredWords.push_back(mvnSlotWords[nSlot]);
+            mvSharingStoredScores.push_back(-mvSlotScores[nSlot]/2.0);
+        }
+
+        mvnSlotWords[nSlot] = 0;
+        mvSlotScores[nSlot] = 0.0;
     }
 }
 
 vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float minScore)
 {
     set<KeyFrame*> spConnectedKeyFrames = pKF->GetConnectedKeyFrames();
-    list<KeyFrame*> lKFsSharingWords;
+    vector<KeyFrame*> lKFsSharingWords;
 
     // Search all keyframes that share a word with current keyframes
     // Discard keyframes connected to the query keyframe
     {
         unique_lock<mutex> lock(mMutex);
 
-        for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
-        {
-            list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+        ScoreSharingKeyFrames(pKF->mBowVec);
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+        for(size_t i=0, iend=mvpSharingKFs.size(); i<iend; i++)
+        {
+            KeyFrame* pKFi=mvpSharingKFs[i];
+            if(pKFi->GetMap()==pKF->GetMap()) // For consider a loop candidate it a candidate it must be in the same map
             {
-                KeyFrame* pKFi=*lit;
-                if(pKFi->GetMap()==pKF->GetMap()) // For consider a loop candidate it a candidate it must be in the same map
+                if(!spConnectedKeyFrames.count(pKFi))
                 {
-                    if(pKFi->mnLoopQuery!=pKF->mnId)
-                    {
-                        pKFi->mnLoopWords=0;
-                        if(!spConnectedKeyFrames.count(pKFi))
-                        {
-                            pKFi->mnLoopQuery=pKF->mnId;
-                            lKFsSharingWords.push_back(pKFi);
-                        }
-                    }
-                    pKFi->mnLoopWords++;
+                    pKFi->mnLoopQuery=pKF->mnId;
+                    pKFi->mnLoopWords=mvnSharingWords[i];
+                    pKFi->mLoopScore=mvSharingScores[i];
+                    lKFsSharingWords.push_back(pKFi);
                 }
-
-
             }
         }
     }
@@ -140,7 +269,7 @@ vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float mi
 
     // Only compare against those keyframes that share enough words
     int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(vector<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
     {
         if((*lit)->mnLoopWords>maxCommonWords)
             maxCommonWords=(*lit)->mnLoopWords;
@@ -151,7 +280,7 @@ vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float mi
     int nscores=0;
 
     // Compute similarity score. Retain the matches whose score is higher than minScore
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(vector<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
 
@@ -159,9 +288,7 @@ vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float mi
         {
             nscores++;
 
-            float si = mpVoc->score(pKF->mBowVec,pKFi->mBowVec);
-
-            pKFi->mLoopScore = si;
+            float si = pKFi->mLoopScore;
             if(si>=minScore)
                 lScoreAndMatch.push_back(make_pair(si,pKFi));
         }
@@ -228,46 +355,34 @@ vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float mi
 void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<KeyFrame*>& vpLoopCand, vector<KeyFrame*>& vpMergeCand)
 {
     set<KeyFrame*> spConnectedKeyFrames = pKF->GetConnectedKeyFrames();
-    list<KeyFrame*> lKFsSharingWordsLoop,lKFsSharingWordsMerge;
+    vector<KeyFrame*> lKFsSharingWordsLoop,lKFsSharingWordsMerge;
 
     // Search all keyframes that share a word with current keyframes
     // Discard keyframes connected to the query keyframe
     {
         unique_lock<mutex> lock(mMutex);
 
-        for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
+        ScoreSharingKeyFrames(pKF->mBowVec);
+
+        for(size_t i=0, iend=mvpSharingKFs.size(); i<iend; i++)
         {
-            list<KeyFrame*> &lKFs = mvInvertedFile[vit->first];
+            KeyFrame* pKFi=mvpSharingKFs[i];
+            if(spConnectedKeyFrames.count(pKFi))
+                continue;
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+            if(pKFi->GetMap()==pKF->GetMap()) // For consider a loop candidate it a candidate it must be in the same map
             {
-                KeyFrame* pKFi=*lit;
-                if(pKFi->GetMap()==pKF->GetMap()) // For consider a loop candidate it a candidate it must be in the same map
-                {
-                    if(pKFi->mnLoopQuery!=pKF->mnId)
-                    {
-                        pKFi->mnLoopWords=0;
-                        if(!spConnectedKeyFrames.count(pKFi))
-                        {
-                            pKFi->mnLoopQuery=pKF->mnId;
-                            lKFsSharingWordsLoop.push_back(pKFi);
-                        }
-                    }
-                    pKFi->mnLoopWords++;
-                }
-                else if(!pKFi->GetMap()->IsBad())
-                {
-                    if(pKFi->mnMergeQuery!=pKF->mnId)
-                    {
-                        pKFi->mnMergeWords=0;
-                        if(!spConnectedKeyFrames.count(pKFi))
-                        {
-                            pKFi->mnMergeQuery=pKF->mnId;
-                            lKFsSharingWordsMerge.push_back(pKFi);
-                        }
-                    }
-                    pKFi->mnMergeWords++;
-                }
+                pKFi->mnLoopQuery=pKF->mnId;
+                pKFi->mnLoopWords=mvnSharingWords[i];
+                pKFi->mLoopScore=mvSharingScores[i];
+                lKFsSharingWordsLoop.push_back(pKFi);
+            }
+            else if(!pKFi->GetMap()->IsBad())
+            {
+                pKFi->mnMergeQuery=pKF->mnId;
+                pKFi->mnMergeWords=mvnSharingWords[i];
+                pKFi->mMergeScore=mvSharingScores[i];
+                lKFsSharingWordsMerge.push_back(pKFi);
             }
         }
     }
@@ -281,7 +396,7 @@ void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<Key
 
         // Only compare against those keyframes that share enough words
         int maxCommonWords=0;
-        for(list<KeyFrame*>::iterator lit=lKFsSharingWordsLoop.begin(), lend= lKFsSharingWordsLoop.end(); lit!=lend; lit++)
+        for(vector<KeyFrame*>::iterator lit=lKFsSharingWordsLoop.begin(), lend= lKFsSharingWordsLoop.end(); lit!=lend; lit++)
         {
             if((*lit)->mnLoopWords>maxCommonWords)
                 maxCommonWords=(*lit)->mnLoopWords;
@@ -292,7 +407,7 @@ void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<Key
         int nscores=0;
 
         // Compute similarity score. Retain the matches whose score is higher than minScore
-        for(list<KeyFrame*>::iterator lit=lKFsSharingWordsLoop.begin(), lend= lKFsSharingWordsLoop.end(); lit!=lend; lit++)
+        for(vector<KeyFrame*>::iterator lit=lKFsSharingWordsLoop.begin(), lend= lKFsSharingWordsLoop.end(); lit!=lend; lit++)
         {
             KeyFrame* pKFi = *lit;
 
@@ -300,9 +415,7 @@ void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<Key
             {
                 nscores++;
 
-                float si = mpVoc->score(pKF->mBowVec,pKFi->mBowVec);
-
-                pKFi->mLoopScore = si;
+                float si = pKFi->mLoopScore;
                 if(si>=minScore)
                     lScoreAndMatch.push_back(make_pair(si,pKFi));
             }
@@ -369,7 +482,7 @@ void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<Key
 
         // Only compare against those keyframes that share enough words
         int maxCommonWords=0;
-        for(list<KeyFrame*>::iterator lit=lKFsSharingWordsMerge.begin(), lend=lKFsSharingWordsMerge.end(); lit!=lend; lit++)
+        for(vector<KeyFrame*>::iterator lit=lKFsSharingWordsMerge.begin(), lend=lKFsSharingWordsMerge.end(); lit!=lend; lit++)
         {
             if((*lit)->mnMergeWords>maxCommonWords)
                 maxCommonWords=(*lit)->mnMergeWords;
@@ -380,7 +493,7 @@ void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<Key
         int nscores=0;
 
         // Compute similarity score. Retain the matches whose score is higher than minScore
-        for(list<KeyFrame*>::iterator lit=lKFsSharingWordsMerge.begin(), lend=lKFsSharingWordsMerge.end(); lit!=lend; lit++)
+        for(vector<KeyFrame*>::iterator lit=lKFsSharingWordsMerge.begin(), lend=lKFsSharingWordsMerge.end(); lit!=lend; lit++)
         {
             KeyFrame* pKFi = *lit;
 
@@ -388,9 +501,7 @@ void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<Key
             {
                 nscores++;
 
-                float si = mpVoc->score(pKF->mBowVec,pKFi->mBowVec);
-
-                pKFi->mMergeScore = si;
+                float si = pKFi->mMergeScore;
                 if(si>=minScore)
                     lScoreAndMatch.push_back(make_pair(si,pKFi));
             }
@@ -451,23 +562,16 @@ void KeyFrameDatabase::DetectCandidates(KeyFrame* pKF, float minScore,vector<Key
 
     }
 
-    for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
-    {
-        list<KeyFrame*> &lKFs = mvInvertedFile[vit->first];
-
-        for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-        {
-            KeyFrame* pKFi=*lit;
-            pKFi->mnLoopQuery=-1;
-            pKFi->mnMergeQuery=-1;
-        }
-    }
+    for(vector<KeyFrame*>::iterator lit=lKFsSharingWordsLoop.begin(), lend=lKFsSharingWordsLoop.end(); lit!=lend; lit++)
+        (*lit)->mnLoopQuery=-1;
+    for(vector<KeyFrame*>::iterator lit=lKFsSharingWordsMerge.begin(), lend=lKFsSharingWordsMerge.end(); lit!=lend; lit++)
+        (*lit)->mnMergeQuery=-1;
 
 }
 
 void KeyFrameDatabase::DetectBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vpLoopCand, vector<KeyFrame*> &vpMergeCand, int nMinWords)
 {
-    list<KeyFrame*> lKFsSharingWords;
+    vector<KeyFrame*> lKFsSharingWords;
     set<KeyFrame*> spConnectedKF;
 
     // Search all keyframes that share a word with current frame
@@ -476,26 +580,19 @@ void KeyFrameDatabase::DetectBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vp
 
         spConnectedKF = pKF->GetConnectedKeyFrames();
 
-        for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
-        {
-            list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+        ScoreSharingKeyFrames(pKF->mBowVec);
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+        for(size_t i=0, iend=mvpSharingKFs.size(); i<iend; i++)
+        {
+            KeyFrame* pKFi=mvpSharingKFs[i];
+            if(spConnectedKF.find(pKFi) != spConnectedKF.end())
             {
-                KeyFrame* pKFi=*lit;
-                if(spConnectedKF.find(pKFi) != spConnectedKF.end())
-                {
-                    continue;
-                }
-                if(pKFi->mnPlaceRecognitionQuery!=pKF->mnId)
-                {
-                    pKFi->mnPlaceRecognitionWords=0;
-                    pKFi->mnPlaceRecognitionQuery=pKF->mnId;
-                    lKFsSharingWords.push_back(pKFi);
-                }
-               pKFi->mnPlaceRecognitionWords++;
-
+                continue;
             }
+            pKFi->mnPlaceRecognitionQuery=pKF->mnId;
+            pKFi->mnPlaceRecognitionWords=mvnSharingWords[i];
+            pKFi->mPlaceRecognitionScore=mvSharingScores[i];
+            lKFsSharingWords.push_back(pKFi);
         }
     }
     if(lKFsSharingWords.empty())
@@ -503,7 +600,7 @@ void KeyFrameDatabase::DetectBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vp
 
     // Only compare against those keyframes that share enough words
     int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(vector<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
     {
         if((*lit)->mnPlaceRecognitionWords>maxCommonWords)
             maxCommonWords=(*lit)->mnPlaceRecognitionWords;
@@ -521,15 +618,14 @@ void KeyFrameDatabase::DetectBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vp
     int nscores=0;
 
     // Compute similarity score.
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(vector<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
 
         if(pKFi->mnPlaceRecognitionWords>minCommonWords)
         {
             nscores++;
-            float si = mpVoc->score(pKF->mBowVec,pKFi->mBowVec);
-            pKFi->mPlaceRecognitionScore=si;
+            float si = pKFi->mPlaceRecognitionScore;
             lScoreAndMatch.push_back(make_pair(si,pKFi));
         }
     }
@@ -601,10 +697,14 @@ bool compFirst(const pair<float, KeyFrame*> & a, const pair<float, KeyFrame*> &
 }
 
 
-void KeyFrameDatabase::DetectNBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vpLoopCand, vector<KeyFrame*> &vpMergeCand, int nNumCandidates)
+void KeyFrameDatabase::DetectNBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &vpLoopCand, vector<KeyFrame*> &vpMergeCand, int nNumCandidates,
+                                             vector<Map*>* pvpStoredMergeMaps)
 {
-    list<KeyFrame*> lKFsSharingWords;
+    vector<KeyFrame*> lKFsSharingWords;
     set<KeyFrame*> spConnectedKF;
+    vector<Map*> vpStoredMaps;
+    vector<int> vnStoredWords;
+    vector<float> vStoredScores;
 
     // Search all keyframes that share a word with current frame
     {
@@ -612,55 +712,84 @@ void KeyFrameDatabase::DetectNBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &v
 
         spConnectedKF = pKF->GetConnectedKeyFrames();
 
-        for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
-        {
-            list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+        ScoreSharingKeyFrames(pKF->mBowVec);
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+        for(size_t i=0, iend=mvpSharingKFs.size(); i<iend; i++)
+        {
+            KeyFrame* pKFi=mvpSharingKFs[i];
+            if(!spConnectedKF.count(pKFi))
             {
-                KeyFrame* pKFi=*lit;
-
-                if(pKFi->mnPlaceRecognitionQuery!=pKF->mnId)
-                {
-                    pKFi->mnPlaceRecognitionWords=0;
-                    if(!spConnectedKF.count(pKFi))
-                    {
-
-                        pKFi->mnPlaceRecognitionQuery=pKF->mnId;
-                        lKFsSharingWords.push_back(pKFi);
-                    }
-                }
-                pKFi->mnPlaceRecognitionWords++;
+                pKFi->mnPlaceRecognitionQuery=pKF->mnId;
+                pKFi->mnPlaceRecognitionWords=mvnSharingWords[i];
+                pKFi->mPlaceRecognitionScore=mvSharingScores[i];
+                lKFsSharingWords.push_back(pKFi);
             }
         }
+
+        if(pvpStoredMergeMaps)
+        {
+            vpStoredMaps = mvpSharingStoredMaps;
+            vnStoredWords = mvnSharingStoredWords;
+            vStoredScores = mvSharingStoredScores;
+        }
     }
-    if(lKFsSharingWords.empty())
+    if(lKFsSharingWords.empty() && vpStoredMaps.empty())
         return;
 
     // Only compare against those keyframes that share enough words
     int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(vector<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
     {
         if((*lit)->mnPlaceRecognitionWords>maxCommonWords)
             maxCommonWords=(*lit)->mnPlaceRecognitionWords;
     }
+    for(size_t i=0; i<vnStoredWords.size(); i++)
+        maxCommonWords = max(maxCommonWords,vnStoredWords[i]);
 
     int minCommonWords = maxCommonWords*0.8f;
 
+    // Stored maps with a keyframe among the best scores are reported to be loaded. Without their
+    // covisibility the scores are not accumulated, the query is repeated once they are loaded.
+    if(!vpStoredMaps.empty())
+    {
+        vector<float> vScores;
+        for(vector<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+        {
+            if((*lit)->mnPlaceRecognitionWords>minCommonWords)
+                vScores.push_back((*lit)->mPlaceRecognitionScore);
+        }
+        for(size_t i=0; i<vpStoredMaps.size(); i++)
+        {
+            if(vnStoredWords[i]>minCommonWords)
+                vScores.push_back(vStoredScores[i]);
+        }
+
+        const size_t nBest = min(vScores.size(),(size_t)max(nNumCandidates,1));
+        nth_element(vScores.begin(),vScores.begin()+nBest-1,vScores.end(),greater<float>());
+        const float minBestScore = vScores[nBest-1];
+
+        for(size_t i=0; i<vpStoredMaps.size(); i++)
+        {
+            Map* pMapi = vpStoredMaps[i];
+            if(vnStoredWords[i]>minCommonWords && vStoredScores[i]>=minBestScore && !pMapi->IsBad() &&
+               find(pvpStoredMergeMaps->begin(),pvpStoredMergeMaps->end(),pMapi)==pvpStoredMergeMaps->end())
+                pvpStoredMergeMaps->push_back(pMapi);
+        }
+    }
+
     list<pair<float,KeyFrame*> > lScoreAndMatch;
 
     int nscores=0;
 
     // Compute similarity score.
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(vector<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
 
         if(pKFi->mnPlaceRecognitionWords>minCommonWords)
         {
             nscores++;
-            float si = mpVoc->score(pKF->mBowVec,pKFi->mBowVec);
-            pKFi->mPlaceRecognitionScore=si;
+            float si = pKFi->mPlaceRecognitionScore;
             lScoreAndMatch.push_back(make_pair(si,pKFi));
         }
     }
@@ -732,57 +861,53 @@ void KeyFrameDatabase::DetectNBestCandidates(KeyFrame *pKF, vector<KeyFrame*> &v
 
 vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F, Map* pMap)
 {
-    list<KeyFrame*> lKFsSharingWords;
+    list<pair<float,KeyFrame*> > lScoreAndMatch;
+    float bestAccScore = 0;
 
     // Search all keyframes that share a word with current frame
     {
         unique_lock<mutex> lock(mMutex);
 
-        for(DBoW2::BowVector::const_iterator vit=F->mBowVec.begin(), vend=F->mBowVec.end(); vit != vend; vit++)
-        {
-            list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+        ScoreSharingKeyFrames(F->mBowVec);
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-            {
-                KeyFrame* pKFi=*lit;
-                if(pKFi->mnRelocQuery!=F->mnId)
-                {
-                    pKFi->mnRelocWords=0;
-                    pKFi->mnRelocQuery=F->mnId;
-                    lKFsSharingWords.push_back(pKFi);
-                }
-                pKFi->mnRelocWords++;
-            }
+        int maxCommonWords=0;
+        for(size_t i=0, iend=mvpSharingKFs.size(); i<iend; i++)
+        {
+            KeyFrame* pKFi=mvpSharingKFs[i];
+            pKFi->mnRelocQuery=F->mnId;
+            pKFi->mnRelocWords=mvnSharingWords[i];
+            pKFi->mRelocScore=mvSharingScores[i];
+            if(mvnSharingWords[i]>maxCommonWords)
+                maxCommonWords=mvnSharingWords[i];
         }
-    }
-    if(lKFsSharingWords.empty())
-        return vector<KeyFrame*>();
-
-    // Only compare against those keyframes that share enough words
-    int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-    {
-        if((*lit)->mnRelocWords>maxCommonWords)
-            maxCommonWords=(*lit)->mnRelocWords;
-    }
-
-    int minCommonWords = maxCommonWords*0.8f;
 
-    list<pair<float,KeyFrame*> > lScoreAndMatch;
+        // Only compare against those keyframes that share enough words
+        int minCommonWords = maxCommonWords*0.8f;
 
-    int nscores=0;
+        // Only keyframes of pMap can be candidates, the rest are not kept beyond the lock (other maps
+        // can be evicted meanwhile). Their accumulated scores still set the score to retain, so they
+        // are accumulated here.
+        for(size_t i=0, iend=mvpSharingKFs.size(); i<iend; i++)
+        {
+            KeyFrame* pKFi=mvpSharingKFs[i];
+            if(pKFi->mnRelocWords<=minCommonWords)
+                continue;
 
-    // Compute similarity score.
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-    {
-        KeyFrame* pKFi = *lit;
+            if(pKFi->GetMap()==pMap)
+            {
+                lScoreAndMatch.push_back(make_pair(pKFi->mRelocScore,pKFi));
+                continue;
+            }
 
-        if(pKFi->mnRelocWords>minCommonWords)
-        {
-            nscores++;
-            float si = mpVoc->score(F->mBowVec,pKFi->mBowVec);
-            pKFi->mRelocScore=si;
-            lScoreAndMatch.push_back(make_pair(si,pKFi));
+            float accScore = pKFi->mRelocScore;
+            const vector<KeyFrame*> vpNeighs = pKFi->GetBestCovisibilityKeyFrames(10);
+            for(KeyFrame* pKF2 : vpNeighs)
+            {
+                if(pKF2->mnRelocQuery==F->mnId)
+                    accScore+=pKF2->mRelocScore;
+            }
+            if(accScore>bestAccScore)
+                bestAccScore=accScore;
         }
     }
 
@@ -790,7 +915,6 @@ vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F, Map
         return vector<KeyFrame*>();
 
     list<pair<float,KeyFrame*> > lAccScoreAndMatch;
-    float bestAccScore = 0;
 
     // Lets now accumulate score by covisibility
     for(list<pair<float,KeyFrame*> >::iterator it=lScoreAndMatch.begin(), itend=lScoreAndMatch.end(); it!=itend; it++)
@@ -850,8 +974,7 @@ void KeyFrameDatabase::SetORBVocabulary(ORBVocabulary* pORBVoc)
     ptr = (ORBVocabulary**)( &mpVoc );
     *ptr = pORBVoc;
 
-    mvInvertedFile.clear();
-    mvInvertedFile.resize(mpVoc->size());
+    clear();
 }
 
 } //namespace ORB_SLAM
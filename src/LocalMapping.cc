@@ -37,6 +37,8 @@ LocalMapping::LocalMapping(System* pSys, Atlas *pAtlas, const float bMonocular,
 {
     mnMatchesInliers = 0;
 
+    mpThreadPool = NULL;
+
     mbBadImu = false;
 
     mTinit = 0.f;
@@ -61,6 +63,11 @@ void LocalMapping::SetTracker(Tracking *pTracker)
     mpTracker=pTracker;
 }
 
+void LocalMapping::SetThreadPool(ThreadPool *pThreadPool)
+{
+    mpThreadPool=pThreadPool;
+}
+
 void LocalMapping::Run()
 {
     mbFinished = false;
@@ -146,12 +153,12 @@ void LocalMapping::Run()
                         }
 
                         bool bLarge = ((mpTracker->GetMatchesInliers()>75)&&mbMonocular)||((mpTracker->GetMatchesInliers()>100)&&!mbMonocular);
-                        Optimizer::LocalInertialBA(mpCurrentKeyFrame, &mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA, bLarge, !mpCurrentKeyFrame->GetMap()->GetIniertialBA2());
+                        Optimizer::LocalInertialBA(mpCurrentKeyFrame, &mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA, bLarge, !mpCurrentKeyFrame->GetMap()->GetIniertialBA2(), mpThreadPool);
                         b_doneLBA = true;
                     }
                     else
                     {
-                        Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA);
+                        Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA,mpThreadPool);
                         b_doneLBA = true;
                     }
 
@@ -259,10 +266,7 @@ void LocalMapping::Run()
         else if(Stop() && !mbBadImu)
         {
             // Safe area to stop
-            while(isStopped() && !CheckFinish())
-            {
-                usleep(3000);
-            }
+            mStateChanged.WaitUntil([&]{return !isStopped() || CheckFinish();});
             if(CheckFinish())
                 break;
         }
@@ -275,7 +279,8 @@ void LocalMapping::Run()
         if(CheckFinish())
             break;
 
-        usleep(3000);
+        // Sleep until a keyframe or a request arrives
+        mStateChanged.WaitUntil([&]{return CheckPendingWork();});
     }
 
     SetFinish();
@@ -283,9 +288,12 @@ void LocalMapping::Run()
 
 void LocalMapping::InsertKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexNewKFs);
-    mlNewKeyFrames.push_back(pKF);
-    mbAbortBA=true;
+    {
+        unique_lock<mutex> lock(mMutexNewKFs);
+        mlNewKeyFrames.push_back(pKF);
+        mbAbortBA=true;
+    }
+    mStateChanged.Notify();
 }
 
 
@@ -295,6 +303,26 @@ bool LocalMapping::CheckNewKeyFrames()
     return(!mlNewKeyFrames.empty());
 }
 
+bool LocalMapping::CheckPendingWork()
+{
+    if(CheckNewKeyFrames() && !mbBadImu)
+        return true;
+
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        if(mbStopRequested && !mbNotStop)
+            return true;
+    }
+
+    {
+        unique_lock<mutex> lock(mMutexReset);
+        if(mbResetRequested || mbResetRequestedActiveMap)
+            return true;
+    }
+
+    return CheckFinish();
+}
+
 void LocalMapping::ProcessNewKeyFrame()
 {
     {
@@ -304,7 +332,7 @@ void LocalMapping::ProcessNewKeyFrame()
     }
 
     // Compute Bags of Words structures
-    mpCurrentKeyFrame->ComputeBoW();
+    mpCurrentKeyFrame->ComputeBoW(mpThreadPool);
 
     // Associate MapPoints to the new keyframe and update normal and descriptor
     const vector<MapPoint*> vpMapPointMatches = mpCurrentKeyFrame->GetMapPointMatches();
@@ -824,23 +852,28 @@ void LocalMapping::SearchInNeighbors()
 
 void LocalMapping::RequestStop()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    mbStopRequested = true;
-    unique_lock<mutex> lock2(mMutexNewKFs);
-    mbAbortBA = true;
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        mbStopRequested = true;
+        unique_lock<mutex> lock2(mMutexNewKFs);
+        mbAbortBA = true;
+    }
+    mStateChanged.Notify();
 }
 
 bool LocalMapping::Stop()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    if(mbStopRequested && !mbNotStop)
     {
+        unique_lock<mutex> lock(mMutexStop);
+        if(!mbStopRequested || mbNotStop)
+            return false;
+
         mbStopped = true;
         cout << "Local Mapping STOP" << endl;
-        return true;
     }
+    mStateChanged.Notify();
 
-    return false;
+    return true;
 }
 
 bool LocalMapping::isStopped()
@@ -855,17 +888,26 @@ bool LocalMapping::stopRequested()
     return mbStopRequested;
 }
 
+void LocalMapping::WaitUntilStopped()
+{
+    // SetFinish also marks the thread as stopped
+    mStateChanged.WaitUntil([&]{return isStopped();});
+}
+
 void LocalMapping::Release()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    unique_lock<mutex> lock2(mMutexFinish);
-    if(mbFinished)
-        return;
-    mbStopped = false;
-    mbStopRequested = false;
-    for(list<KeyFrame*>::iterator lit = mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
-        delete *lit;
-    mlNewKeyFrames.clear();
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        unique_lock<mutex> lock2(mMutexFinish);
+        if(mbFinished)
+            return;
+        mbStopped = false;
+        mbStopRequested = false;
+        for(list<KeyFrame*>::iterator lit = mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
+            delete *lit;
+        mlNewKeyFrames.clear();
+    }
+    mStateChanged.Notify();
 
     cout << "Local Mapping RELEASE" << endl;
 }
@@ -884,12 +926,15 @@ void LocalMapping::SetAcceptKeyFrames(bool flag)
 
 bool LocalMapping::SetNotStop(bool flag)
 {
-    unique_lock<mutex> lock(mMutexStop);
+    {
+        unique_lock<mutex> lock(mMutexStop);
 
-    if(flag && mbStopped)
-        return false;
+        if(flag && mbStopped)
+            return false;
 
-    mbNotStop = flag;
+        mbNotStop = flag;
+    }
+    mStateChanged.Notify();
 
     return true;
 }
@@ -968,9 +1013,9 @@ void LocalMapping::KeyFrameCulling()
                         const int &scaleLevel = (pKF -> NLeft == -1) ? pKF->mvKeysUn[i].octave
                                                                      : (i < pKF -> NLeft) ? pKF -> mvKeys[i].octave
                                                                                           : pKF -> mvKeysRight[i].octave;
-                        const map<KeyFrame*, tuple<int,int>> observations = pMP->GetObservations();
+                        const MapPoint::ObservationsView observations = pMP->GetObservationsView();
                         int nObs=0;
-                        for(map<KeyFrame*, tuple<int,int>>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+                        for(MapPoint::ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
                         {
                             KeyFrame* pKFi = mit->first;
                             if(pKFi==pKF)
@@ -1060,17 +1105,14 @@ void LocalMapping::RequestReset()
         cout << "LM: Map reset recieved" << endl;
         mbResetRequested = true;
     }
+    mStateChanged.Notify();
     cout << "LM: Map reset, waiting..." << endl;
 
-    while(1)
+    mStateChanged.WaitUntil([&]
     {
-        {
-            unique_lock<mutex> lock2(mMutexReset);
-            if(!mbResetRequested)
-                break;
-        }
-        usleep(3000);
-    }
+        unique_lock<mutex> lock2(mMutexReset);
+        return !mbResetRequested;
+    });
     cout << "LM: Map reset, Done!!!" << endl;
 }
 
@@ -1082,17 +1124,14 @@ void LocalMapping::RequestResetActiveMap(Map* pMap)
         mbResetRequestedActiveMap = true;
         mpMapToReset = pMap;
     }
+    mStateChanged.Notify();
     cout << "LM: Active map reset, waiting..." << endl;
 
-    while(1)
+    mStateChanged.WaitUntil([&]
     {
-        {
-            unique_lock<mutex> lock2(mMutexReset);
-            if(!mbResetRequestedActiveMap)
-                break;
-        }
-        usleep(3000);
-    }
+        unique_lock<mutex> lock2(mMutexReset);
+        return !mbResetRequestedActiveMap;
+    });
     cout << "LM: Active map reset, Done!!!" << endl;
 }
 
@@ -1140,14 +1179,20 @@ void LocalMapping::ResetIfRequested()
         }
     }
     if(executed_reset)
+    {
+        mStateChanged.Notify();
         cout << "LM: Reset free the mutex" << endl;
+    }
 
 }
 
 void LocalMapping::RequestFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinishRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinishRequested = true;
+    }
+    mStateChanged.Notify();
 }
 
 bool LocalMapping::CheckFinish()
@@ -1158,10 +1203,13 @@ bool LocalMapping::CheckFinish()
 
 void LocalMapping::SetFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;    
-    unique_lock<mutex> lock2(mMutexStop);
-    mbStopped = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinished = true;
+        unique_lock<mutex> lock2(mMutexStop);
+        mbStopped = true;
+    }
+    mStateChanged.Notify();
 }
 
 bool LocalMapping::isFinished()
@@ -1304,9 +1352,9 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA)
     if (bFIBA)
     {
         if (priorA!=0.f)
-            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, true, priorG, priorA);
+            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, true, priorG, priorA, NULL, NULL, mpThreadPool);
         else
-            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, false);
+            Optimizer::FullInertialBA(mpAtlas->GetCurrentMap(), 100, false, mpCurrentKeyFrame->mnId, NULL, false, 1e2, 1e6, NULL, NULL, mpThreadPool);
     }
 
     std::chrono::steady_clock::time_point t5 = std::chrono::steady_clock::now();
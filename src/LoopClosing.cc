@@ -24,6 +24,7 @@
 #include "Optimizer.h"
 #include "ORBmatcher.h"
 #include "G2oTypes.h"
+#include "GlobalBundleAdjuster.h"
 
 #include<mutex>
 #include<thread>
@@ -40,6 +41,8 @@ LoopClosing::LoopClosing(Atlas *pAtlas, KeyFrameDatabase *pDB, ORBVocabulary *pV
 {
     mnCovisibilityConsistencyTh = 3;
     mpLastCurrentKF = static_cast<KeyFrame*>(NULL);
+    mpThreadPool = NULL;
+    mpGlobalBundleAdjuster = NULL;
 
 #ifdef REGISTER_TIMES
 
@@ -76,6 +79,11 @@ LoopClosing::LoopClosing(Atlas *pAtlas, KeyFrameDatabase *pDB, ORBVocabulary *pV
     mnCorrectionGBA = 0;
 }
 
+LoopClosing::~LoopClosing()
+{
+    delete mpGlobalBundleAdjuster;
+}
+
 void LoopClosing::SetTracker(Tracking *pTracker)
 {
     mpTracker=pTracker;
@@ -86,6 +94,27 @@ void LoopClosing::SetLocalMapper(LocalMapping *pLocalMapper)
     mpLocalMapper=pLocalMapper;
 }
 
+void LoopClosing::SetThreadPool(ThreadPool *pThreadPool)
+{
+    mpThreadPool=pThreadPool;
+    if(mpGlobalBundleAdjuster)
+        mpGlobalBundleAdjuster->SetThreadPool(pThreadPool);
+}
+
+void LoopClosing::SetIncrementalGBA(bool bIncremental)
+{
+    if(bIncremental && !mpGlobalBundleAdjuster)
+    {
+        mpGlobalBundleAdjuster = new GlobalBundleAdjuster();
+        mpGlobalBundleAdjuster->SetThreadPool(mpThreadPool);
+    }
+    else if(!bIncremental && mpGlobalBundleAdjuster)
+    {
+        delete mpGlobalBundleAdjuster;
+        mpGlobalBundleAdjuster = NULL;
+    }
+}
+
 
 void LoopClosing::Run()
 {
@@ -294,6 +323,10 @@ void LoopClosing::Run()
 
             }
             mpLastCurrentKF = mpCurrentKF;
+
+            // Not while a merge with another map is being confirmed
+            if(mnMergeNumCoincidences==0 && !mbMergeDetected)
+                EnforceMemoryBudget();
         }
 
         ResetIfRequested();
@@ -302,7 +335,8 @@ void LoopClosing::Run()
             break;
         }
 
-        usleep(5000);
+        // Sleep until a keyframe or a request arrives
+        mStateChanged.WaitUntil([&]{return CheckPendingWork();});
     }
 
     SetFinish();
@@ -310,9 +344,13 @@ void LoopClosing::Run()
 
 void LoopClosing::InsertKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexLoopQueue);
-    if(pKF->mnId!=0)
+    {
+        unique_lock<mutex> lock(mMutexLoopQueue);
+        if(pKF->mnId==0)
+            return;
         mlpLoopKeyFrameQueue.push_back(pKF);
+    }
+    mStateChanged.Notify();
 }
 
 bool LoopClosing::CheckNewKeyFrames()
@@ -321,6 +359,20 @@ bool LoopClosing::CheckNewKeyFrames()
     return(!mlpLoopKeyFrameQueue.empty());
 }
 
+bool LoopClosing::CheckPendingWork()
+{
+    if(CheckNewKeyFrames())
+        return true;
+
+    {
+        unique_lock<mutex> lock(mMutexReset);
+        if(mbResetRequested || mbResetActiveMapRequested)
+            return true;
+    }
+
+    return CheckFinish();
+}
+
 bool LoopClosing::NewDetectCommonRegions()
 {
     // To deactivate placerecognition. No loopclosing nor merging will be performed
@@ -488,7 +540,23 @@ bool LoopClosing::NewDetectCommonRegions()
 #ifdef REGISTER_TIMES
         std::chrono::steady_clock::time_point time_StartQuery = std::chrono::steady_clock::now();
 #endif
-        mpKeyFrameDB->DetectNBestCandidates(mpCurrentKF, vpLoopBowCand, vpMergeBowCand,3);
+        vector<Map*> vpStoredMergeMaps;
+        mpKeyFrameDB->DetectNBestCandidates(mpCurrentKF, vpLoopBowCand, vpMergeBowCand,3,
+                                            bMergeDetectedInKF ? static_cast<vector<Map*>*>(NULL) : &vpStoredMergeMaps);
+
+        // Maps still in the atlas file are loaded when they have a merge candidate, and searched again
+        if(!vpStoredMergeMaps.empty())
+        {
+            for(Map* pMap : vpStoredMergeMaps)
+            {
+                Verbose::PrintMess("Loading map " + to_string(pMap->GetId()) + " with a merge candidate", Verbose::VERBOSITY_NORMAL);
+                mpAtlas->LoadMap(pMap);
+            }
+
+            vpLoopBowCand.clear();
+            vpMergeBowCand.clear();
+            mpKeyFrameDB->DetectNBestCandidates(mpCurrentKF, vpLoopBowCand, vpMergeBowCand,3);
+        }
 #ifdef REGISTER_TIMES
         std::chrono::steady_clock::time_point time_EndQuery = std::chrono::steady_clock::now();
 
@@ -993,10 +1061,7 @@ void LoopClosing::CorrectLoop()
     }
 
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
 
     // Ensure current keyframe is updated
     //cout << "Start updating connections" << endl;
@@ -1175,12 +1240,14 @@ void LoopClosing::CorrectLoop()
     //cout << "Optimize essential graph" << endl;
     if(pLoopMap->IsInertial() && pLoopMap->isImuInitialized())
     {
-        Optimizer::OptimizeEssentialGraph4DoF(pLoopMap, mpLoopMatchedKF, mpCurrentKF, NonCorrectedSim3, CorrectedSim3, LoopConnections);
+        Optimizer::OptimizeEssentialGraph4DoF(pLoopMap, mpLoopMatchedKF, mpCurrentKF, NonCorrectedSim3, CorrectedSim3, LoopConnections,
+                                              mpThreadPool, Optimizer::LINEAR_SOLVER_SUPERNODAL);
     }
     else
     {
         //cout << "Loop -> Scale correction: " << mg2oLoopScw.scale() << endl;
-        Optimizer::OptimizeEssentialGraph(pLoopMap, mpLoopMatchedKF, mpCurrentKF, NonCorrectedSim3, CorrectedSim3, LoopConnections, bFixedScale);
+        Optimizer::OptimizeEssentialGraph(pLoopMap, mpLoopMatchedKF, mpCurrentKF, NonCorrectedSim3, CorrectedSim3, LoopConnections, bFixedScale,
+                                            mpThreadPool, Optimizer::LINEAR_SOLVER_SUPERNODAL);
     }
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndOpt = std::chrono::steady_clock::now();
@@ -1247,10 +1314,7 @@ void LoopClosing::MergeLocal()
     //cout << "Request Stop Local Mapping" << endl;
     mpLocalMapper->RequestStop();
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
     //cout << "Local Map stopped" << endl;
 
     mpLocalMapper->EmptyQueue();
@@ -1388,6 +1452,22 @@ void LoopClosing::MergeLocal()
         nNumTries++;
     }
 
+    // On weakly connected maps the covisibility may not fill the window, it is completed with
+    // the keyframes of the merge map closest to the matched one
+    if(spMergeConnectedKFs.size() < numTemporalKFs)
+    {
+        const float radius = mpMergeMatchedKF->ComputeSceneMedianDepth(2);
+        if(radius>0)
+        {
+            const vector<KeyFrame*> vpNearKFs = pMergeMap->GetKeyFramesInRadius(mpMergeMatchedKF->GetCameraCenter(), radius);
+            for(size_t i=0; i<vpNearKFs.size() && spMergeConnectedKFs.size() < numTemporalKFs; i++)
+            {
+                if(!vpNearKFs[i]->isBad())
+                    spMergeConnectedKFs.insert(vpNearKFs[i]);
+            }
+        }
+    }
+
     set<MapPoint*> spMapPointMerge;
     for(KeyFrame* pKFi : spMergeConnectedKFs)
     {
@@ -1706,10 +1786,7 @@ void LoopClosing::MergeLocal()
 
         mpLocalMapper->RequestStop();
         // Wait until Local Mapping has effectively stopped
-        while(!mpLocalMapper->isStopped())
-        {
-            usleep(1000);
-        }
+        mpLocalMapper->WaitUntilStopped();
 
         // Optimize graph (and update the loop position for each element form the begining to the end)
         if(mpTracker->mSensor != System::MONOCULAR)
@@ -1820,10 +1897,7 @@ void LoopClosing::MergeLocal2()
     //cout << "Request Stop Local Mapping" << endl;
     mpLocalMapper->RequestStop();
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
     //cout << "Local Map stopped" << endl;
 
     Map* pCurrentMap = mpCurrentKF->GetMap();
@@ -2203,16 +2277,13 @@ void LoopClosing::RequestReset()
         unique_lock<mutex> lock(mMutexReset);
         mbResetRequested = true;
     }
+    mStateChanged.Notify();
 
-    while(1)
+    mStateChanged.WaitUntil([&]
     {
-        {
         unique_lock<mutex> lock2(mMutexReset);
-        if(!mbResetRequested)
-            break;
-        }
-        usleep(5000);
-    }
+        return !mbResetRequested;
+    });
 }
 
 void LoopClosing::RequestResetActiveMap(Map *pMap)
@@ -2222,15 +2293,23 @@ void LoopClosing::RequestResetActiveMap(Map *pMap)
         mbResetActiveMapRequested = true;
         mpMapToReset = pMap;
     }
+    mStateChanged.Notify();
 
-    while(1)
+    mStateChanged.WaitUntil([&]
     {
-        {
-            unique_lock<mutex> lock2(mMutexReset);
-            if(!mbResetActiveMapRequested)
-                break;
-        }
-        usleep(3000);
+        unique_lock<mutex> lock2(mMutexReset);
+        return !mbResetActiveMapRequested;
+    });
+}
+
+void LoopClosing::EnforceMemoryBudget()
+{
+    vector<Map*> vpMaps = mpAtlas->GetMapsToEvict();
+    for(Map* pMap : vpMaps)
+    {
+        Verbose::PrintMess("Evicting map " + to_string(pMap->GetId()) + " to meet the memory budget", Verbose::VERBOSITY_NORMAL);
+        if(!mpAtlas->EvictMap(pMap, &mpTracker->mTrajectory))
+            break;
     }
 }
 
@@ -2263,6 +2342,11 @@ void LoopClosing::ResetIfRequested()
         mbResetActiveMapRequested=false;
 
     }
+    else
+        return;
+
+    lock.unlock();
+    mStateChanged.Notify();
 }
 
 void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoopKF)
@@ -2280,10 +2364,16 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
 
     const bool bImuInit = pActiveMap->isImuInitialized();
 
-    if(!bImuInit)
-        Optimizer::GlobalBundleAdjustemnt(pActiveMap,10,&mbStopGBA,nLoopKF,false);
+    if(!bImuInit && mpGlobalBundleAdjuster)
+    {
+        mpGlobalBundleAdjuster->Run(pActiveMap,10,&mbStopGBA,nLoopKF);
+        Verbose::PrintMess("Incremental GBA: " + to_string(mpGlobalBundleAdjuster->GetNumOptimizedKeyFrames()) + " KFs and " +
+                           to_string(mpGlobalBundleAdjuster->GetNumOptimizedMapPoints()) + " MPs optimized", Verbose::VERBOSITY_DEBUG);
+    }
+    else if(!bImuInit)
+        Optimizer::GlobalBundleAdjustemnt(pActiveMap,10,&mbStopGBA,nLoopKF,false,mpThreadPool,Optimizer::LINEAR_SOLVER_SUPERNODAL);
     else
-        Optimizer::FullInertialBA(pActiveMap,7,false,nLoopKF,&mbStopGBA);
+        Optimizer::FullInertialBA(pActiveMap,7,false,nLoopKF,&mbStopGBA,false,1e2,1e6,NULL,NULL,mpThreadPool,Optimizer::LINEAR_SOLVER_SUPERNODAL);
 
 #ifdef REGISTER_TIMES
     std::chrono::steady_clock::time_point time_EndGBA = std::chrono::steady_clock::now();
@@ -2319,11 +2409,7 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
 
             mpLocalMapper->RequestStop();
             // Wait until Local Mapping has effectively stopped
-
-            while(!mpLocalMapper->isStopped() && !mpLocalMapper->isFinished())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
 
             // Get Map Mutex
             unique_lock<mutex> lock(pActiveMap->mMutexMapUpdate);
@@ -2512,9 +2598,12 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
 
 void LoopClosing::RequestFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    // cout << "LC: Finish requested" << endl;
-    mbFinishRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        // cout << "LC: Finish requested" << endl;
+        mbFinishRequested = true;
+    }
+    mStateChanged.Notify();
 }
 
 bool LoopClosing::CheckFinish()
@@ -2525,8 +2614,11 @@ bool LoopClosing::CheckFinish()
 
 void LoopClosing::SetFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinished = true;
+    }
+    mStateChanged.Notify();
 }
 
 bool LoopClosing::isFinished()
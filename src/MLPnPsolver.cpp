@@ -52,9 +52,32 @@
 
 
 namespace ORB_SLAM3 {
+    MLPnPsolver::MLPnPsolver():
+            mnInliersi(0), mnIterations(0), mnBestInliers(0), N(0), mpCamera(NULL){
+    }
+
     MLPnPsolver::MLPnPsolver(const Frame &F, const vector<MapPoint *> &vpMapPointMatches):
             mnInliersi(0), mnIterations(0), mnBestInliers(0), N(0), mpCamera(F.mpCamera){
+        Init(F, vpMapPointMatches);
+    }
+
+    void MLPnPsolver::Init(const Frame &F, const vector<MapPoint *> &vpMapPointMatches, unsigned long nSeed){
+        mRng.seed((std::mt19937::result_type)nSeed);
+        mnInliersi = 0;
+        mnIterations = 0;
+        mnBestInliers = 0;
+        mvbBestInliers.clear();
+        N = 0;
+        mpCamera = F.mpCamera;
+
         mvpMapPointMatches = vpMapPointMatches;
+        mvBearingVecs.clear();
+        mvP2D.clear();
+        mvSigma2.clear();
+        mvP3Dw.clear();
+        mvKeyPointIndices.clear();
+        mvAllIndices.clear();
+
         mvBearingVecs.reserve(F.mvpMapPoints.size());
         mvP2D.reserve(F.mvpMapPoints.size());
         mvSigma2.reserve(F.mvpMapPoints.size());
@@ -127,7 +150,8 @@ namespace ORB_SLAM3 {
 	        // Get min set of points
 	        for(short i = 0; i < mRansacMinSet; ++i)
 	        {
-	            int randi = DUtils::Random::RandomInt(0, vAvailableIndices.size()-1);
+	            std::uniform_int_distribution<int> randomIndex(0, vAvailableIndices.size()-1);
+	            int randi = randomIndex(mRng);
 
 	            int idx = vAvailableIndices[randi];
 
@@ -25,9 +25,11 @@ namespace ORB_SLAM3
 {
 
 long unsigned int Map::nNextId=0;
+const float Map::SPATIAL_CELL_SIZE=1.f;
 
 Map::Map():mnMaxKFid(0),mnBigChangeIdx(0), mbImuInitialized(false), mnMapChange(0), mpFirstRegionKF(static_cast<KeyFrame*>(NULL)),
-mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false)
+mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false),
+mMapPointIndex(SPATIAL_CELL_SIZE), mKeyFrameIndex(SPATIAL_CELL_SIZE)
 {
     mnId=nNextId++;
     mThumbnail = static_cast<GLubyte*>(NULL);
@@ -35,7 +37,8 @@ mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNo
 
 Map::Map(int initKFid):mnInitKFid(initKFid), mnMaxKFid(initKFid),/*mnLastLoopKFid(initKFid),*/ mnBigChangeIdx(0), mIsInUse(false),
                        mHasTumbnail(false), mbBad(false), mbImuInitialized(false), mpFirstRegionKF(static_cast<KeyFrame*>(NULL)),
-                       mnMapChange(0), mbFail(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false)
+                       mnMapChange(0), mbFail(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false),
+                       mMapPointIndex(SPATIAL_CELL_SIZE), mKeyFrameIndex(SPATIAL_CELL_SIZE)
 {
     mnId=nNextId++;
     mThumbnail = static_cast<GLubyte*>(NULL);
@@ -59,6 +62,8 @@ Map::~Map()
 
 void Map::AddKeyFrame(KeyFrame *pKF)
 {
+    mKeyFrameIndex.Insert(pKF,pKF->GetCameraCenter());
+
     unique_lock<mutex> lock(mMutexMap);
     if(mspKeyFrames.empty()){
         cout << "First KF:" << pKF->mnId << "; Map init KF:" << mnInitKFid << endl;
@@ -79,6 +84,8 @@ void Map::AddKeyFrame(KeyFrame *pKF)
 
 void Map::AddMapPoint(MapPoint *pMP)
 {
+    mMapPointIndex.Insert(pMP,pMP->GetWorldPos());
+
     unique_lock<mutex> lock(mMutexMap);
     mspMapPoints.insert(pMP);
 }
@@ -97,6 +104,8 @@ bool Map::isImuInitialized()
 
 void Map::EraseMapPoint(MapPoint *pMP)
 {
+    mMapPointIndex.Erase(pMP);
+
     unique_lock<mutex> lock(mMutexMap);
     mspMapPoints.erase(pMP);
 
@@ -106,6 +115,8 @@ void Map::EraseMapPoint(MapPoint *pMP)
 
 void Map::EraseKeyFrame(KeyFrame *pKF)
 {
+    mKeyFrameIndex.Erase(pKF);
+
     unique_lock<mutex> lock(mMutexMap);
     mspKeyFrames.erase(pKF);
     if(mspKeyFrames.size()>0)
@@ -168,6 +179,66 @@ long unsigned int Map::KeyFramesInMap()
     return mspKeyFrames.size();
 }
 
+size_t Map::GetMemoryUsage()
+{
+    // The sets are copied so that the map is not locked while the objects lock their own mutexes
+    size_t nBytes = 0;
+    for(KeyFrame* pKF : GetAllKeyFrames())
+        nBytes += pKF->GetMemoryUsage();
+    for(MapPoint* pMP : GetAllMapPoints())
+        nBytes += pMP->GetMemoryUsage();
+    return nBytes;
+}
+
+vector<MapPoint*> Map::GetMapPointsInRadius(const Eigen::Vector3f &x, const float r)
+{
+    vector<MapPoint*> vpMPs;
+    mMapPointIndex.GetInRadius(x,r,vpMPs);
+    return vpMPs;
+}
+
+vector<KeyFrame*> Map::GetKeyFramesInRadius(const Eigen::Vector3f &x, const float r)
+{
+    vector<KeyFrame*> vpKFs;
+    mKeyFrameIndex.GetInRadius(x,r,vpKFs);
+
+    vector<pair<float,KeyFrame*> > vDistKFs;
+    vDistKFs.reserve(vpKFs.size());
+    for(KeyFrame* pKF : vpKFs)
+        vDistKFs.push_back(make_pair((pKF->GetCameraCenter()-x).squaredNorm(),pKF));
+    sort(vDistKFs.begin(),vDistKFs.end());
+
+    for(size_t i=0; i<vDistKFs.size(); i++)
+        vpKFs[i] = vDistKFs[i].second;
+    return vpKFs;
+}
+
+vector<MapPoint*> Map::GetMapPointsInFrustum(const Sophus::SE3f &Tcw, GeometricCamera* pCamera, const float minX, const float maxX,
+                                             const float minY, const float maxY, const float maxDistance)
+{
+    vector<MapPoint*> vpMPs;
+    mMapPointIndex.GetInFrustum(Tcw,pCamera,minX,maxX,minY,maxY,maxDistance,vpMPs);
+    return vpMPs;
+}
+
+vector<KeyFrame*> Map::GetKeyFramesInFrustum(const Sophus::SE3f &Tcw, GeometricCamera* pCamera, const float minX, const float maxX,
+                                             const float minY, const float maxY, const float maxDistance)
+{
+    vector<KeyFrame*> vpKFs;
+    mKeyFrameIndex.GetInFrustum(Tcw,pCamera,minX,maxX,minY,maxY,maxDistance,vpKFs);
+    return vpKFs;
+}
+
+void Map::UpdateMapPointPosition(MapPoint* pMP, const Eigen::Vector3f &pos)
+{
+    mMapPointIndex.Move(pMP,pos);
+}
+
+void Map::UpdateKeyFramePosition(KeyFrame* pKF, const Eigen::Vector3f &Ow)
+{
+    mKeyFrameIndex.Move(pKF,Ow);
+}
+
 vector<MapPoint*> Map::GetReferenceMapPoints()
 {
     unique_lock<mutex> lock(mMutexMap);
@@ -225,6 +296,8 @@ void Map::clear()
 
     mspMapPoints.clear();
     mspKeyFrames.clear();
+    mMapPointIndex.Clear();
+    mKeyFrameIndex.Clear();
     mnMaxKFid = mnInitKFid;
     mbImuInitialized = false;
     mvpReferenceMapPoints.clear();
@@ -426,11 +499,13 @@ void Map::PreSave(std::set<GeometricCamera*> &spCams)
 
 void Map::PostLoad(KeyFrameDatabase* pKFDB, ORBVocabulary* pORBVoc/*, map<long unsigned int, KeyFrame*>& mpKeyFrameId*/, map<unsigned int, GeometricCamera*> &mpCams)
 {
-    std::copy(mvpBackupMapPoints.begin(), mvpBackupMapPoints.end(), std::inserter(mspMapPoints, mspMapPoints.begin()));
-    std::copy(mvpBackupKeyFrames.begin(), mvpBackupKeyFrames.end(), std::inserter(mspKeyFrames, mspKeyFrames.begin()));
+    // The map can be loaded while other threads draw or query it (see Atlas::LoadMap),
+    // so its sets are filled once the objects are ready
+    std::set<MapPoint*> spMapPoints(mvpBackupMapPoints.begin(), mvpBackupMapPoints.end());
+    std::set<KeyFrame*> spKeyFrames(mvpBackupKeyFrames.begin(), mvpBackupKeyFrames.end());
 
     map<long unsigned int,MapPoint*> mpMapPointId;
-    for(MapPoint* pMPi : mspMapPoints)
+    for(MapPoint* pMPi : spMapPoints)
     {
         if(!pMPi || pMPi->isBad())
             continue;
@@ -440,7 +515,7 @@ void Map::PostLoad(KeyFrameDatabase* pKFDB, ORBVocabulary* pORBVoc/*, map<long u
     }
 
     map<long unsigned int, KeyFrame*> mpKeyFrameId;
-    for(KeyFrame* pKFi : mspKeyFrames)
+    for(KeyFrame* pKFi : spKeyFrames)
     {
         if(!pKFi || pKFi->isBad())
             continue;
@@ -452,7 +527,7 @@ void Map::PostLoad(KeyFrameDatabase* pKFDB, ORBVocabulary* pORBVoc/*, map<long u
     }
 
     // References reconstruction between different instances
-    for(MapPoint* pMPi : mspMapPoints)
+    for(MapPoint* pMPi : spMapPoints)
     {
         if(!pMPi || pMPi->isBad())
             continue;
@@ -460,7 +535,7 @@ void Map::PostLoad(KeyFrameDatabase* pKFDB, ORBVocabulary* pORBVoc/*, map<long u
         pMPi->PostLoad(mpKeyFrameId, mpMapPointId);
     }
 
-    for(KeyFrame* pKFi : mspKeyFrames)
+    for(KeyFrame* pKFi : spKeyFrames)
     {
         if(!pKFi || pKFi->isBad())
             continue;
@@ -488,6 +563,21 @@ void Map::PostLoad(KeyFrameDatabase* pKFDB, ORBVocabulary* pORBVoc/*, map<long u
     }
 
     mvpBackupMapPoints.clear();
+
+    for(MapPoint* pMPi : spMapPoints)
+    {
+        if(pMPi)
+            mMapPointIndex.Insert(pMPi,pMPi->GetWorldPos());
+    }
+    for(KeyFrame* pKFi : spKeyFrames)
+    {
+        if(pKFi)
+            mKeyFrameIndex.Insert(pKFi,pKFi->GetCameraCenter());
+    }
+
+    unique_lock<mutex> lock(mMutexMap);
+    mspMapPoints.insert(spMapPoints.begin(), spMapPoints.end());
+    mspKeyFrames.insert(spKeyFrames.begin(), spKeyFrames.end());
 }
 
 
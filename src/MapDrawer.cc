@@ -342,6 +342,8 @@ void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph, const b
             if(pMap == pActiveMap)
                 continue;
 
+            // Its keyframes are not deleted while drawn (see Atlas::EvictMap)
+            unique_lock<mutex> lock(pMap->mMutexMapUpdate);
             vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
 
             for(size_t i=0; i<vpKFs.size(); i++)
@@ -27,13 +27,48 @@ namespace ORB_SLAM3
 long unsigned int MapPoint::nNextId=0;
 mutex MapPoint::mGlobalMutex;
 
+namespace
+{
+
+bool CompareObservation(const MapPoint::ObservationList::value_type &obs, KeyFrame* pKF)
+{
+    return obs.first < pKF;
+}
+
+// Observation of pKF in a sorted list, or end() if there is none
+MapPoint::ObservationList::const_iterator FindObservation(const MapPoint::ObservationList &obs, KeyFrame* pKF)
+{
+    MapPoint::ObservationList::const_iterator it = lower_bound(obs.begin(), obs.end(), pKF, CompareObservation);
+    if(it != obs.end() && it->first == pKF)
+        return it;
+    return obs.end();
+}
+
+} // namespace
+
+std::shared_ptr<MapPoint::ObservationList> MapPoint::EmptyObservations()
+{
+    static const std::shared_ptr<ObservationList> pEmpty = make_shared<ObservationList>();
+    return pEmpty;
+}
+
+MapPoint::ObservationList& MapPoint::MutableObservations()
+{
+    // Views are only taken with mMutexFeatures locked, so a count of one means no reader holds it.
+    // The shared empty list always has more than one owner.
+    if(mpObservations.use_count() > 1)
+        mpObservations = make_shared<ObservationList>(*mpObservations);
+    return *mpObservations;
+}
+
 MapPoint::MapPoint():
     mnFirstKFid(0), mnFirstFrame(0), nObs(0), mnTrackReferenceForFrame(0),
     mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
     mnCorrectedReference(0), mnBAGlobalForKF(0), mnVisible(1), mnFound(1), mbBad(false),
-    mpReplaced(static_cast<MapPoint*>(NULL))
+    mpReplaced(static_cast<MapPoint*>(NULL)), mpMap(static_cast<Map*>(NULL))
 {
     mpReplaced = static_cast<MapPoint*>(NULL);
+    mpObservations = EmptyObservations();
 }
 
 MapPoint::MapPoint(const Eigen::Vector3f &Pos, KeyFrame *pRefKF, Map* pMap):
@@ -43,6 +78,8 @@ MapPoint::MapPoint(const Eigen::Vector3f &Pos, KeyFrame *pRefKF, Map* pMap):
     mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0), mpMap(pMap),
     mnOriginMapId(pMap->GetId())
 {
+    mpObservations = EmptyObservations();
+
     SetWorldPos(Pos);
 
     mNormalVector.setZero();
@@ -62,6 +99,8 @@ MapPoint::MapPoint(const double invDepth, cv::Point2f uv_init, KeyFrame* pRefKF,
     mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0), mpMap(pMap),
     mnOriginMapId(pMap->GetId())
 {
+    mpObservations = EmptyObservations();
+
     mInvDepth=invDepth;
     mInitU=(double)uv_init.x;
     mInitV=(double)uv_init.y;
@@ -81,6 +120,8 @@ MapPoint::MapPoint(const Eigen::Vector3f &Pos, Map* pMap, Frame* pFrame, const i
     mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(static_cast<KeyFrame*>(NULL)), mnVisible(1),
     mnFound(1), mbBad(false), mpReplaced(NULL), mpMap(pMap), mnOriginMapId(pMap->GetId())
 {
+    mpObservations = EmptyObservations();
+
     SetWorldPos(Pos);
 
     Eigen::Vector3f Ow;
@@ -119,6 +160,11 @@ void MapPoint::SetWorldPos(const Eigen::Vector3f &Pos) {
     unique_lock<mutex> lock2(mGlobalMutex);
     unique_lock<mutex> lock(mMutexPos);
     mWorldPos = Pos;
+
+    // Moved while holding the position, so the index ends with the last one set
+    Map* pMap = GetMap();
+    if(pMap)
+        pMap->UpdateMapPointPosition(this,Pos);
 }
 
 Eigen::Vector3f MapPoint::GetWorldPos() {
@@ -141,23 +187,20 @@ KeyFrame* MapPoint::GetReferenceKeyFrame()
 void MapPoint::AddObservation(KeyFrame* pKF, int idx)
 {
     unique_lock<mutex> lock(mMutexFeatures);
-    tuple<int,int> indexes;
+    ObservationList &obs = MutableObservations();
 
-    if(mObservations.count(pKF)){
-        indexes = mObservations[pKF];
-    }
-    else{
-        indexes = tuple<int,int>(-1,-1);
+    ObservationList::iterator it = lower_bound(obs.begin(), obs.end(), pKF, CompareObservation);
+    if(it == obs.end() || it->first != pKF){
+        it = obs.insert(it, make_pair(pKF, tuple<int,int>(-1,-1)));
     }
 
-    if(pKF -> NLeft != -1 && idx >= pKF -> NLeft){
-        get<1>(indexes) = idx;
-    }
-    else{
-        get<0>(indexes) = idx;
-    }
+    tuple<int,int> &indexes = it->second;
+    int &side = (pKF -> NLeft != -1 && idx >= pKF -> NLeft) ? get<1>(indexes) : get<0>(indexes);
 
-    mObservations[pKF]=indexes;
+    if(side != -1)
+        mDescriptorMedoid.Remove(pKF, side);
+    side = idx;
+    mDescriptorMedoid.Add(pKF, idx, pKF->mDescriptors.ptr<uint8_t>(idx));
 
     if(!pKF->mpCamera2 && pKF->mvuRight[idx]>=0)
         nObs+=2;
@@ -170,9 +213,10 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
     bool bBad=false;
     {
         unique_lock<mutex> lock(mMutexFeatures);
-        if(mObservations.count(pKF))
+        ObservationList::const_iterator itObs = FindObservation(*mpObservations, pKF);
+        if(itObs != mpObservations->end())
         {
-            tuple<int,int> indexes = mObservations[pKF];
+            tuple<int,int> indexes = itObs->second;
             int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
 
             if(leftIndex != -1){
@@ -185,10 +229,13 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
                 nObs--;
             }
 
-            mObservations.erase(pKF);
+            const size_t nPos = itObs - mpObservations->begin();
+            ObservationList &obs = MutableObservations();
+            obs.erase(obs.begin() + nPos);
+            mDescriptorMedoid.Remove(pKF);
 
             if(mpRefKF==pKF)
-                mpRefKF=mObservations.begin()->first;
+                mpRefKF=obs.begin()->first;
 
             // If only 2 observations or less, discard point
             if(nObs<=2)
@@ -202,9 +249,15 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
 
 
 std::map<KeyFrame*, std::tuple<int,int>>  MapPoint::GetObservations()
+{
+    ObservationsView obs = GetObservationsView();
+    return std::map<KeyFrame*, std::tuple<int,int>>(obs->begin(), obs->end());
+}
+
+MapPoint::ObservationsView MapPoint::GetObservationsView()
 {
     unique_lock<mutex> lock(mMutexFeatures);
-    return mObservations;
+    return mpObservations;
 }
 
 int MapPoint::Observations()
@@ -215,15 +268,16 @@ int MapPoint::Observations()
 
 void MapPoint::SetBadFlag()
 {
-    map<KeyFrame*, tuple<int,int>> obs;
+    ObservationsView obs;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
         mbBad=true;
-        obs = mObservations;
-        mObservations.clear();
+        obs = mpObservations;
+        mpObservations = EmptyObservations();
+        mDescriptorMedoid.Clear();
     }
-    for(map<KeyFrame*, tuple<int,int>>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    for(ObservationList::const_iterator mit=obs->begin(), mend=obs->end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
         int leftIndex = get<0>(mit -> second), rightIndex = get<1>(mit -> second);
@@ -251,19 +305,20 @@ void MapPoint::Replace(MapPoint* pMP)
         return;
 
     int nvisible, nfound;
-    map<KeyFrame*,tuple<int,int>> obs;
+    ObservationsView obs;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
-        obs=mObservations;
-        mObservations.clear();
+        obs=mpObservations;
+        mpObservations = EmptyObservations();
+        mDescriptorMedoid.Clear();
         mbBad=true;
         nvisible = mnVisible;
         nfound = mnFound;
         mpReplaced = pMP;
     }
 
-    for(map<KeyFrame*,tuple<int,int>>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    for(ObservationList::const_iterator mit=obs->begin(), mend=obs->end(); mit!=mend; mit++)
     {
         // Replace measurement in keyframe
         KeyFrame* pKF = mit->first;
@@ -328,77 +383,37 @@ float MapPoint::GetFoundRatio()
 
 void MapPoint::ComputeDistinctiveDescriptors()
 {
-    // Retrieve all observed descriptors
-    vector<cv::Mat> vDescriptors;
-
-    map<KeyFrame*,tuple<int,int>> observations;
+    // The distances between all observed descriptors are kept up to date by
+    // AddObservation/EraseObservation, here only the medoid is selected
+    ObservationsView observations;
 
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         if(mbBad)
             return;
-        observations=mObservations;
+        observations=mpObservations;
     }
 
-    if(observations.empty())
+    if(observations->empty())
         return;
 
-    vDescriptors.reserve(observations.size());
-
-    for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+    // Keyframe flags are checked without holding mMutexFeatures (KeyFrame::SetBadFlag locks them in the opposite order)
+    vector<KeyFrame*> vpBadKFs;
+    for(ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
     {
-        KeyFrame* pKF = mit->first;
-
-        if(!pKF->isBad()){
-            tuple<int,int> indexes = mit -> second;
-            int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
-
-            if(leftIndex != -1){
-                vDescriptors.push_back(pKF->mDescriptors.row(leftIndex));
-            }
-            if(rightIndex != -1){
-                vDescriptors.push_back(pKF->mDescriptors.row(rightIndex));
-            }
-        }
-    }
-
-    if(vDescriptors.empty())
-        return;
-
-    // Compute distances between them
-    const size_t N = vDescriptors.size();
-
-    float Distances[N][N];
-    for(size_t i=0;i<N;i++)
-    {
-        Distances[i][i]=0;
-        for(size_t j=i+1;j<N;j++)
-        {
-            int distij = ORBmatcher::DescriptorDistance(vDescriptors[i],vDescriptors[j]);
-            Distances[i][j]=distij;
-            Distances[j][i]=distij;
-        }
+        if(mit->first->isBad())
+            vpBadKFs.push_back(mit->first);
     }
 
-    // Take the descriptor with least median distance to the rest
-    int BestMedian = INT_MAX;
-    int BestIdx = 0;
-    for(size_t i=0;i<N;i++)
     {
-        vector<int> vDists(Distances[i],Distances[i]+N);
-        sort(vDists.begin(),vDists.end());
-        int median = vDists[0.5*(N-1)];
+        unique_lock<mutex> lock(mMutexFeatures);
 
-        if(median<BestMedian)
-        {
-            BestMedian = median;
-            BestIdx = i;
-        }
-    }
+        // Take the descriptor with least median distance to the rest
+        const int BestIdx = mDescriptorMedoid.Medoid(vpBadKFs);
+        if(BestIdx<0)
+            return;
 
-    {
-        unique_lock<mutex> lock(mMutexFeatures);
-        mDescriptor = vDescriptors[BestIdx].clone();
+        mDescriptor = cv::Mat(1,32,CV_8U,const_cast<uint8_t*>(mDescriptorMedoid.Descriptor(BestIdx))).clone();
     }
 }
 
@@ -411,8 +426,9 @@ cv::Mat MapPoint::GetDescriptor()
 tuple<int,int> MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexFeatures);
-    if(mObservations.count(pKF))
-        return mObservations[pKF];
+    ObservationList::const_iterator it = FindObservation(*mpObservations, pKF);
+    if(it != mpObservations->end())
+        return it->second;
     else
         return tuple<int,int>(-1,-1);
 }
@@ -420,12 +436,12 @@ tuple<int,int> MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
 bool MapPoint::IsInKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexFeatures);
-    return (mObservations.count(pKF));
+    return FindObservation(*mpObservations, pKF) != mpObservations->end();
 }
 
 void MapPoint::UpdateNormalAndDepth()
 {
-    map<KeyFrame*,tuple<int,int>> observations;
+    ObservationsView observations;
     KeyFrame* pRefKF;
     Eigen::Vector3f Pos;
     {
@@ -433,18 +449,18 @@ void MapPoint::UpdateNormalAndDepth()
         unique_lock<mutex> lock2(mMutexPos);
         if(mbBad)
             return;
-        observations = mObservations;
+        observations = mpObservations;
         pRefKF = mpRefKF;
         Pos = mWorldPos;
     }
 
-    if(observations.empty())
+    if(observations->empty())
         return;
 
     Eigen::Vector3f normal;
     normal.setZero();
     int n=0;
-    for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+    for(ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
 
@@ -468,7 +484,8 @@ void MapPoint::UpdateNormalAndDepth()
     Eigen::Vector3f PC = Pos - pRefKF->GetCameraCenter();
     const float dist = PC.norm();
 
-    tuple<int ,int> indexes = observations[pRefKF];
+    ObservationList::const_iterator itRef = FindObservation(*observations, pRefKF);
+    tuple<int ,int> indexes = itRef != observations->end() ? itRef->second : tuple<int,int>(0,0);
     int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
     int level;
     if(pRefKF -> NLeft == -1){
@@ -548,7 +565,8 @@ int MapPoint::PredictScale(const float &currentDist, Frame* pF)
 void MapPoint::PrintObservations()
 {
     cout << "MP_OBS: MP " << mnId << endl;
-    for(map<KeyFrame*,tuple<int,int>>::iterator mit=mObservations.begin(), mend=mObservations.end(); mit!=mend; mit++)
+    ObservationsView observations = GetObservationsView();
+    for(ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
     {
         KeyFrame* pKFi = mit->first;
         tuple<int,int> indexes = mit->second;
@@ -569,6 +587,17 @@ void MapPoint::UpdateMap(Map* pMap)
     mpMap = pMap;
 }
 
+size_t MapPoint::GetMemoryUsage()
+{
+    unique_lock<mutex> lock(mMutexFeatures);
+    size_t nBytes = sizeof(MapPoint);
+    nBytes += mDescriptor.total()*mDescriptor.elemSize();
+    nBytes += mDescriptorMedoid.GetMemoryUsage();
+    if(mpObservations)
+        nBytes += sizeof(ObservationList)+mpObservations->capacity()*sizeof(ObservationList::value_type);
+    return nBytes;
+}
+
 void MapPoint::PreSave(set<KeyFrame*>& spKF,set<MapPoint*>& spMP)
 {
     mBackupReplacedId = -1;
@@ -578,7 +607,9 @@ void MapPoint::PreSave(set<KeyFrame*>& spKF,set<MapPoint*>& spMP)
     mBackupObservationsId1.clear();
     mBackupObservationsId2.clear();
     // Save the id and position in each KF who view it
-    for(std::map<KeyFrame*,std::tuple<int,int> >::const_iterator it = mObservations.begin(), end = mObservations.end(); it != end; ++it)
+    // (the view stays valid while EraseObservation replaces the list)
+    ObservationsView observations = GetObservationsView();
+    for(ObservationList::const_iterator it = observations->begin(), end = observations->end(); it != end; ++it)
     {
         KeyFrame* pKFi = it->first;
         if(spKF.find(pKFi) != spKF.end())
@@ -614,7 +645,8 @@ void MapPoint::PostLoad(map<long unsigned int, KeyFrame*>& mpKFid, map<long unsi
             mpReplaced = it->second;
     }
 
-    mObservations.clear();
+    std::shared_ptr<ObservationList> pObs = make_shared<ObservationList>();
+    pObs->reserve(mBackupObservationsId1.size());
 
     for(map<long unsigned int, int>::const_iterator it = mBackupObservationsId1.begin(), end = mBackupObservationsId1.end(); it != end; ++it)
     {
@@ -623,10 +655,24 @@ void MapPoint::PostLoad(map<long unsigned int, KeyFrame*>& mpKFid, map<long unsi
         std::tuple<int, int> indexes = tuple<int,int>(it->second,it2->second);
         if(pKFi)
         {
-           mObservations[pKFi] = indexes;
+           pObs->push_back(make_pair(pKFi, indexes));
         }
     }
 
+    // Sorted by keyframe pointer, as the loaded ids are sorted by id
+    sort(pObs->begin(), pObs->end(), [](const ObservationList::value_type &a, const ObservationList::value_type &b){return a.first < b.first;});
+    mpObservations = pObs;
+
+    mDescriptorMedoid.Clear();
+    for(ObservationList::const_iterator it = pObs->begin(), end = pObs->end(); it != end; ++it)
+    {
+        int leftIndex = get<0>(it->second), rightIndex = get<1>(it->second);
+        if(leftIndex != -1)
+            mDescriptorMedoid.Add(it->first, leftIndex, it->first->mDescriptors.ptr<uint8_t>(leftIndex));
+        if(rightIndex != -1)
+            mDescriptorMedoid.Add(it->first, rightIndex, it->first->mDescriptors.ptr<uint8_t>(rightIndex));
+    }
+
     mBackupObservationsId1.clear();
     mBackupObservationsId2.clear();
 }
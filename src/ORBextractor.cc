@@ -60,6 +60,7 @@
 #include <iostream>
 
 #include "ORBextractor.h"
+#include "ThreadPool.h"
 
 
 using namespace cv;
@@ -409,7 +410,7 @@ namespace ORB_SLAM3
     ORBextractor::ORBextractor(int _nfeatures, float _scaleFactor, int _nlevels,
                                int _iniThFAST, int _minThFAST):
             nfeatures(_nfeatures), scaleFactor(_scaleFactor), nlevels(_nlevels),
-            iniThFAST(_iniThFAST), minThFAST(_minThFAST)
+            iniThFAST(_iniThFAST), minThFAST(_minThFAST), mpThreadPool(NULL)
     {
         mvScaleFactor.resize(nlevels);
         mvLevelSigma2.resize(nlevels);
@@ -784,92 +785,103 @@ namespace ORB_SLAM3
 
         const float W = 35;
 
+        // Cell grid of each level
+        vector<int> vMinBorderX(nlevels), vMaxBorderX(nlevels), vMaxBorderY(nlevels);
+        vector<int> vCols(nlevels), vCellW(nlevels), vCellH(nlevels);
+
+        // FAST is run per row of cells, rows of all levels being independent tasks
+        vector<pair<int,int> > vRowTasks;
+        vector<int> vFirstRowTask(nlevels+1);
+
         for (int level = 0; level < nlevels; ++level)
         {
-            const int minBorderX = EDGE_THRESHOLD-3;
-            const int minBorderY = minBorderX;
-            const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
-            const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
-
-            vector<cv::KeyPoint> vToDistributeKeys;
-            vToDistributeKeys.reserve(nfeatures*10);
+            vMinBorderX[level] = EDGE_THRESHOLD-3;
+            vMaxBorderX[level] = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
+            vMaxBorderY[level] = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
 
-            const float width = (maxBorderX-minBorderX);
-            const float height = (maxBorderY-minBorderY);
+            const float width = (vMaxBorderX[level]-vMinBorderX[level]);
+            const float height = (vMaxBorderY[level]-vMinBorderX[level]);
 
             const int nCols = width/W;
             const int nRows = height/W;
-            const int wCell = ceil(width/nCols);
-            const int hCell = ceil(height/nRows);
+            vCols[level] = nCols;
+            vCellW[level] = ceil(width/nCols);
+            vCellH[level] = ceil(height/nRows);
 
+            vFirstRowTask[level] = vRowTasks.size();
             for(int i=0; i<nRows; i++)
-            {
-                const float iniY =minBorderY+i*hCell;
-                float maxY = iniY+hCell+6;
+                vRowTasks.push_back(make_pair(level,i));
+        }
+        vFirstRowTask[nlevels] = vRowTasks.size();
 
-                if(iniY>=maxBorderY-3)
-                    continue;
-                if(maxY>maxBorderY)
-                    maxY = maxBorderY;
+        vector<vector<cv::KeyPoint> > vRowKeys(vRowTasks.size());
 
-                for(int j=0; j<nCols; j++)
-                {
-                    const float iniX =minBorderX+j*wCell;
-                    float maxX = iniX+wCell+6;
-                    if(iniX>=maxBorderX-6)
-                        continue;
-                    if(maxX>maxBorderX)
-                        maxX = maxBorderX;
+        ThreadPool::ParallelFor(mpThreadPool, vRowTasks.size(), [&](int t)
+        {
+            const int level = vRowTasks[t].first;
+            const int i = vRowTasks[t].second;
 
-                    vector<cv::KeyPoint> vKeysCell;
+            const int minBorderX = vMinBorderX[level];
+            const int minBorderY = minBorderX;
+            const int maxBorderX = vMaxBorderX[level];
+            const int maxBorderY = vMaxBorderY[level];
+            const int wCell = vCellW[level];
+            const int hCell = vCellH[level];
 
-                    FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                         vKeysCell,iniThFAST,true);
+            const float iniY =minBorderY+i*hCell;
+            float maxY = iniY+hCell+6;
 
-                    /*if(bRight && j <= 13){
-                        FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                             vKeysCell,10,true);
-                    }
-                    else if(!bRight && j >= 16){
-                        FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                             vKeysCell,10,true);
-                    }
-                    else{
-                        FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                             vKeysCell,iniThFAST,true);
-                    }*/
+            if(iniY>=maxBorderY-3)
+                return;
+            if(maxY>maxBorderY)
+                maxY = maxBorderY;
 
+            vector<cv::KeyPoint> &vKeysRow = vRowKeys[t];
 
-                    if(vKeysCell.empty())
-                    {
-                        FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                             vKeysCell,minThFAST,true);
-                        /*if(bRight && j <= 13){
-                            FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                                 vKeysCell,5,true);
-                        }
-                        else if(!bRight && j >= 16){
-                            FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                                 vKeysCell,5,true);
-                        }
-                        else{
-                            FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                                 vKeysCell,minThFAST,true);
-                        }*/
-                    }
+            for(int j=0; j<vCols[level]; j++)
+            {
+                const float iniX =minBorderX+j*wCell;
+                float maxX = iniX+wCell+6;
+                if(iniX>=maxBorderX-6)
+                    continue;
+                if(maxX>maxBorderX)
+                    maxX = maxBorderX;
+
+                vector<cv::KeyPoint> vKeysCell;
+
+                FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
+                     vKeysCell,iniThFAST,true);
 
-                    if(!vKeysCell.empty())
+                if(vKeysCell.empty())
+                {
+                    FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
+                         vKeysCell,minThFAST,true);
+                }
+
+                if(!vKeysCell.empty())
+                {
+                    for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
                     {
-                        for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
-                        {
-                            (*vit).pt.x+=j*wCell;
-                            (*vit).pt.y+=i*hCell;
-                            vToDistributeKeys.push_back(*vit);
-                        }
+                        (*vit).pt.x+=j*wCell;
+                        (*vit).pt.y+=i*hCell;
+                        vKeysRow.push_back(*vit);
                     }
-
                 }
             }
+        });
+
+        ThreadPool::ParallelFor(mpThreadPool, nlevels, [&](int level)
+        {
+            const int minBorderX = vMinBorderX[level];
+            const int minBorderY = minBorderX;
+            const int maxBorderX = vMaxBorderX[level];
+            const int maxBorderY = vMaxBorderY[level];
+
+            // Rows are gathered in order, so the result does not depend on the scheduling
+            vector<cv::KeyPoint> vToDistributeKeys;
+            vToDistributeKeys.reserve(nfeatures*10);
+            for(int t=vFirstRowTask[level]; t<vFirstRowTask[level+1]; t++)
+                vToDistributeKeys.insert(vToDistributeKeys.end(),vRowKeys[t].begin(),vRowKeys[t].end());
 
             vector<KeyPoint> & keypoints = allKeypoints[level];
             keypoints.reserve(nfeatures);
@@ -888,11 +900,10 @@ namespace ORB_SLAM3
                 keypoints[i].octave=level;
                 keypoints[i].size = scaledPatchSize;
             }
-        }
 
-        // compute orientations
-        for (int level = 0; level < nlevels; ++level)
+            // compute orientations
             computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
+        });
     }
 
     void ORBextractor::ComputeKeyPointsOld(std::vector<std::vector<KeyPoint> > &allKeypoints)
@@ -1117,25 +1128,37 @@ namespace ORB_SLAM3
         //_keypoints.reserve(nkeypoints);
         _keypoints = vector<cv::KeyPoint>(nkeypoints);
 
-        int offset = 0;
-        //Modified for speeding up stereo fisheye matching
-        int monoIndex = 0, stereoIndex = nkeypoints-1;
-        for (int level = 0; level < nlevels; ++level)
+        // Blur and describe every level, levels being independent of each other
+        vector<Mat> vDescriptorsPerLevel(nlevels);
+        ThreadPool::ParallelFor(mpThreadPool, nlevels, [&](int level)
         {
             vector<KeyPoint>& keypoints = allKeypoints[level];
             int nkeypointsLevel = (int)keypoints.size();
 
             if(nkeypointsLevel==0)
-                continue;
+                return;
 
             // preprocess the resized image
             Mat workingMat = mvImagePyramid[level].clone();
             GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
 
             // Compute the descriptors
-            //Mat desc = descriptors.rowRange(offset, offset + nkeypointsLevel);
-            Mat desc = cv::Mat(nkeypointsLevel, 32, CV_8U);
-            computeDescriptors(workingMat, keypoints, desc, pattern);
+            vDescriptorsPerLevel[level] = cv::Mat(nkeypointsLevel, 32, CV_8U);
+            computeDescriptors(workingMat, keypoints, vDescriptorsPerLevel[level], pattern);
+        });
+
+        int offset = 0;
+        //Modified for speeding up stereo fisheye matching
+        int monoIndex = 0, stereoIndex = nkeypoints-1;
+        for (int level = 0; level < nlevels; ++level)
+        {
+            vector<KeyPoint>& keypoints = allKeypoints[level];
+            int nkeypointsLevel = (int)keypoints.size();
+
+            if(nkeypointsLevel==0)
+                continue;
+
+            const Mat &desc = vDescriptorsPerLevel[level];
 
             offset += nkeypointsLevel;
 
@@ -1169,28 +1192,37 @@ namespace ORB_SLAM3
 
     void ORBextractor::ComputePyramid(cv::Mat image)
     {
+        vector<Mat> vTemp(nlevels);
         for (int level = 0; level < nlevels; ++level)
         {
             float scale = mvInvScaleFactor[level];
             Size sz(cvRound((float)image.cols*scale), cvRound((float)image.rows*scale));
             Size wholeSize(sz.width + EDGE_THRESHOLD*2, sz.height + EDGE_THRESHOLD*2);
-            Mat temp(wholeSize, image.type()), masktemp;
-            mvImagePyramid[level] = temp(Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
+            vTemp[level] = Mat(wholeSize, image.type());
+            mvImagePyramid[level] = vTemp[level](Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
+
+            // Compute the resized image. The first level is resized from the input image, which is
+            // the same content as level 0, so that it does not wait for the border of level 0
+            if( level == 1 )
+                resize(image, mvImagePyramid[level], sz, 0, 0, INTER_LINEAR);
+            else if( level > 1 )
+                resize(mvImagePyramid[level-1], mvImagePyramid[level], sz, 0, 0, INTER_LINEAR);
+        }
 
-            // Compute the resized image
+        // Borders only depend on their own level
+        ThreadPool::ParallelFor(mpThreadPool, nlevels, [&](int level)
+        {
             if( level != 0 )
             {
-                resize(mvImagePyramid[level-1], mvImagePyramid[level], sz, 0, 0, INTER_LINEAR);
-
-                copyMakeBorder(mvImagePyramid[level], temp, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
+                copyMakeBorder(mvImagePyramid[level], vTemp[level], EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
                                BORDER_REFLECT_101+BORDER_ISOLATED);
             }
             else
             {
-                copyMakeBorder(image, temp, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
+                copyMakeBorder(image, vTemp[level], EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
                                BORDER_REFLECT_101);
             }
-        }
+        });
 
     }
 
@@ -18,6 +18,7 @@
 
 
 #include "ORBmatcher.h"
+#include "HammingDistance.h"
 
 #include<limits.h>
 
@@ -25,8 +26,6 @@
 
 #include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
 
-#include<stdint-gcc.h>
-
 using namespace std;
 
 namespace ORB_SLAM3
@@ -43,6 +42,8 @@ namespace ORB_SLAM3
     int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const float th, const bool bFarPoints, const float thFarPoints)
     {
         int nmatches=0, left = 0, right = 0;
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
 
         const bool bFactor = th!=1.0;
 
@@ -80,7 +81,8 @@ namespace ORB_SLAM3
                     int bestLevel2 = -1;
                     int bestIdx =-1 ;
 
-                    // Get best and second matches with near keypoints
+                    // Keypoints that can still be matched, then their distances in one batch
+                    vCandidates.clear();
                     for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
                     {
                         const size_t idx = *vit;
@@ -96,9 +98,16 @@ namespace ORB_SLAM3
                                 continue;
                         }
 
-                        const cv::Mat &d = F.mDescriptors.row(idx);
+                        vCandidates.push_back(idx);
+                    }
 
-                        const int dist = DescriptorDistance(MPdescriptor,d);
+                    HammingDistance::Compute(MPdescriptor,F.mDescriptors,vCandidates,vDistances);
+
+                    // Get best and second matches with near keypoints
+                    for(size_t iv=0; iv<vCandidates.size(); iv++)
+                    {
+                        const size_t idx = vCandidates[iv];
+                        const int dist = vDistances[iv];
 
                         if(dist<bestDist)
                         {
@@ -160,7 +169,8 @@ namespace ORB_SLAM3
                     int bestLevel2 = -1;
                     int bestIdx =-1 ;
 
-                    // Get best and second matches with near keypoints
+                    // Keypoints that can still be matched, then their distances in one batch
+                    vCandidates.clear();
                     for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
                     {
                         const size_t idx = *vit;
@@ -169,10 +179,16 @@ namespace ORB_SLAM3
                             if(F.mvpMapPoints[idx + F.Nleft]->Observations()>0)
                                 continue;
 
+                        vCandidates.push_back(idx);
+                    }
 
-                        const cv::Mat &d = F.mDescriptors.row(idx + F.Nleft);
+                    HammingDistance::Compute(MPdescriptor,F.mDescriptors.rowRange(F.Nleft,F.N),vCandidates,vDistances);
 
-                        const int dist = DescriptorDistance(MPdescriptor,d);
+                    // Get best and second matches with near keypoints
+                    for(size_t iv=0; iv<vCandidates.size(); iv++)
+                    {
+                        const size_t idx = vCandidates[iv];
+                        const int dist = vDistances[iv];
 
                         if(dist<bestDist)
                         {
@@ -229,6 +245,8 @@ namespace ORB_SLAM3
         const DBoW2::FeatureVector &vFeatVecKF = pKF->mFeatVec;
 
         int nmatches=0;
+        vector<unsigned int> vCandidates;
+        vector<int> vDistances;
 
         vector<int> rotHist[HISTO_LENGTH];
         for(int i=0;i<HISTO_LENGTH;i++)
@@ -245,8 +263,8 @@ namespace ORB_SLAM3
         {
             if(KFit->first == Fit->first)
             {
-                const vector<unsigned int> vIndicesKF = KFit->second;
-                const vector<unsigned int> vIndicesF = Fit->second;
+                const DBoW2::FeatureIndices &vIndicesKF = KFit->second;
+                const DBoW2::FeatureIndices &vIndicesF = Fit->second;
 
                 for(size_t iKF=0; iKF<vIndicesKF.size(); iKF++)
                 {
@@ -270,17 +288,19 @@ namespace ORB_SLAM3
                     int bestIdxFR =-1 ;
                     int bestDist2R=256;
 
+                    // Keypoints of the frame not matched yet, then their distances in one batch
+                    vCandidates.clear();
                     for(size_t iF=0; iF<vIndicesF.size(); iF++)
-                    {
-                        if(F.Nleft == -1){
-                            const unsigned int realIdxF = vIndicesF[iF];
-
-                            if(vpMapPointMatches[realIdxF])
-                                continue;
+                        if(!vpMapPointMatches[vIndicesF[iF]])
+                            vCandidates.push_back(vIndicesF[iF]);
 
-                            const cv::Mat &dF = F.mDescriptors.row(realIdxF);
+                    HammingDistance::Compute(dKF,F.mDescriptors,vCandidates,vDistances);
 
-                            const int dist =  DescriptorDistance(dKF,dF);
+                    for(size_t iF=0; iF<vCandidates.size(); iF++)
+                    {
+                        if(F.Nleft == -1){
+                            const unsigned int realIdxF = vCandidates[iF];
+                            const int dist = vDistances[iF];
 
                             if(dist<bestDist1)
                             {
@@ -294,14 +314,8 @@ namespace ORB_SLAM3
                             }
                         }
                         else{
-                            const unsigned int realIdxF = vIndicesF[iF];
-
-                            if(vpMapPointMatches[realIdxF])
-                                continue;
-
-                            const cv::Mat &dF = F.mDescriptors.row(realIdxF);
-
-                            const int dist =  DescriptorDistance(dKF,dF);
+                            const unsigned int realIdxF = vCandidates[iF];
+                            const int dist = vDistances[iF];
 
                             if(realIdxF < F.Nleft && dist<bestDist1){
                                 bestDist2=bestDist1;
@@ -427,6 +441,9 @@ namespace ORB_SLAM3
     int ORBmatcher::SearchByProjection(KeyFrame* pKF, Sophus::Sim3f &Scw, const vector<MapPoint*> &vpPoints,
                                        vector<MapPoint*> &vpMatched, int th, float ratioHamming)
     {
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         // Get Calibration Parameters for later projection
         const float &fx = pKF->fx;
         const float &fy = pKF->fy;
@@ -498,9 +515,10 @@ namespace ORB_SLAM3
 
             int bestDist = 256;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+            vCandidates.clear();
+            for(size_t iv=0; iv<vIndices.size(); iv++)
             {
-                const size_t idx = *vit;
+                const size_t idx = vIndices[iv];
                 if(vpMatched[idx])
                     continue;
 
@@ -509,9 +527,15 @@ namespace ORB_SLAM3
                 if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
 
-                const int dist = DescriptorDistance(dMP,dKF);
+            HammingDistance::Compute(dMP,pKF->mDescriptors,vCandidates,vDistances);
+
+            for(size_t iv=0; iv<vCandidates.size(); iv++)
+            {
+                const size_t idx = vCandidates[iv];
+                const int dist = vDistances[iv];
 
                 if(dist<bestDist)
                 {
@@ -534,6 +558,9 @@ namespace ORB_SLAM3
     int ORBmatcher::SearchByProjection(KeyFrame* pKF, Sophus::Sim3<float> &Scw, const std::vector<MapPoint*> &vpPoints, const std::vector<KeyFrame*> &vpPointsKFs,
                                        std::vector<MapPoint*> &vpMatched, std::vector<KeyFrame*> &vpMatchedKF, int th, float ratioHamming)
     {
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         // Get Calibration Parameters for later projection
         const float &fx = pKF->fx;
         const float &fy = pKF->fy;
@@ -611,9 +638,10 @@ namespace ORB_SLAM3
 
             int bestDist = 256;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+            vCandidates.clear();
+            for(size_t iv=0; iv<vIndices.size(); iv++)
             {
-                const size_t idx = *vit;
+                const size_t idx = vIndices[iv];
                 if(vpMatched[idx])
                     continue;
 
@@ -622,9 +650,15 @@ namespace ORB_SLAM3
                 if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
 
-                const int dist = DescriptorDistance(dMP,dKF);
+            HammingDistance::Compute(dMP,pKF->mDescriptors,vCandidates,vDistances);
+
+            for(size_t iv=0; iv<vCandidates.size(); iv++)
+            {
+                const size_t idx = vCandidates[iv];
+                const int dist = vDistances[iv];
 
                 if(dist<bestDist)
                 {
@@ -648,6 +682,7 @@ namespace ORB_SLAM3
     int ORBmatcher::SearchForInitialization(Frame &F1, Frame &F2, vector<cv::Point2f> &vbPrevMatched, vector<int> &vnMatches12, int windowSize)
     {
         int nmatches=0;
+        vector<int> vDistances;
         vnMatches12 = vector<int>(F1.mvKeysUn.size(),-1);
 
         vector<int> rotHist[HISTO_LENGTH];
@@ -676,13 +711,13 @@ namespace ORB_SLAM3
             int bestDist2 = INT_MAX;
             int bestIdx2 = -1;
 
-            for(vector<size_t>::iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
-            {
-                size_t i2 = *vit;
+            HammingDistance::Compute(d1,F2.mDescriptors,vIndices2,vDistances);
 
-                cv::Mat d2 = F2.mDescriptors.row(i2);
+            for(size_t iv=0; iv<vIndices2.size(); iv++)
+            {
+                size_t i2 = vIndices2[iv];
 
-                int dist = DescriptorDistance(d1,d2);
+                int dist = vDistances[iv];
 
                 if(vMatchedDistance[i2]<=dist)
                     continue;
@@ -764,6 +799,9 @@ namespace ORB_SLAM3
 
     int ORBmatcher::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &vpMatches12)
     {
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         const vector<cv::KeyPoint> &vKeysUn1 = pKF1->mvKeysUn;
         const DBoW2::FeatureVector &vFeatVec1 = pKF1->mFeatVec;
         const vector<MapPoint*> vpMapPoints1 = pKF1->GetMapPointMatches();
@@ -813,6 +851,7 @@ namespace ORB_SLAM3
                     int bestIdx2 =-1 ;
                     int bestDist2=256;
 
+                    vCandidates.clear();
                     for(size_t i2=0, iend2=f2it->second.size(); i2<iend2; i2++)
                     {
                         const size_t idx2 = f2it->second[i2];
@@ -829,9 +868,15 @@ namespace ORB_SLAM3
                         if(pMP2->isBad())
                             continue;
 
-                        const cv::Mat &d2 = Descriptors2.row(idx2);
+                        vCandidates.push_back(idx2);
+                    }
+
+                    HammingDistance::Compute(d1,Descriptors2,vCandidates,vDistances);
 
-                        int dist = DescriptorDistance(d1,d2);
+                    for(size_t i2=0; i2<vCandidates.size(); i2++)
+                    {
+                        const size_t idx2 = vCandidates[i2];
+                        int dist = vDistances[i2];
 
                         if(dist<bestDist1)
                         {
@@ -907,6 +952,9 @@ namespace ORB_SLAM3
     int ORBmatcher::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2,
                                            vector<pair<size_t, size_t> > &vMatchedPairs, const bool bOnlyStereo, const bool bCoarse)
     {
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         const DBoW2::FeatureVector &vFeatVec1 = pKF1->mFeatVec;
         const DBoW2::FeatureVector &vFeatVec2 = pKF2->mFeatVec;
 
@@ -994,6 +1042,7 @@ namespace ORB_SLAM3
                     int bestDist = TH_LOW;
                     int bestIdx2 = -1;
 
+                    vCandidates.clear();
                     for(size_t i2=0, iend2=f2it->second.size(); i2<iend2; i2++)
                     {
                         size_t idx2 = f2it->second[i2];
@@ -1010,9 +1059,16 @@ namespace ORB_SLAM3
                             if(!bStereo2)
                                 continue;
 
-                        const cv::Mat &d2 = pKF2->mDescriptors.row(idx2);
+                        vCandidates.push_back(idx2);
+                    }
 
-                        const int dist = DescriptorDistance(d1,d2);
+                    HammingDistance::Compute(d1,pKF2->mDescriptors,vCandidates,vDistances);
+
+                    for(size_t i2=0; i2<vCandidates.size(); i2++)
+                    {
+                        size_t idx2 = vCandidates[i2];
+                        const bool bStereo2 = (!pKF2->mpCamera2 &&  pKF2->mvuRight[idx2]>=0);
+                        const int dist = vDistances[i2];
 
                         if(dist>TH_LOW || dist>bestDist)
                             continue;
@@ -1147,6 +1203,11 @@ namespace ORB_SLAM3
 
     int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const float th, const bool bRight)
     {
+        // Descriptors of the camera the candidates are searched in
+        const cv::Mat descriptorsKF = bRight ? pKF->mDescriptors.rowRange(pKF->NLeft,pKF->N) : pKF->mDescriptors;
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         GeometricCamera* pCamera;
         Sophus::SE3f Tcw;
         Eigen::Vector3f Ow;
@@ -1257,9 +1318,10 @@ namespace ORB_SLAM3
 
             int bestDist = 256;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+            vCandidates.clear();
+            for(size_t iv=0; iv<vIndices.size(); iv++)
             {
-                size_t idx = *vit;
+                size_t idx = vIndices[iv];
                 const cv::KeyPoint &kp = (pKF -> NLeft == -1) ? pKF->mvKeysUn[idx]
                                                               : (!bRight) ? pKF -> mvKeys[idx]
                                                                           : pKF -> mvKeysRight[idx];
@@ -1295,11 +1357,17 @@ namespace ORB_SLAM3
                         continue;
                 }
 
-                if(bRight) idx += pKF->NLeft;
+                vCandidates.push_back(idx);
+            }
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+            HammingDistance::Compute(dMP,descriptorsKF,vCandidates,vDistances);
+
+            for(size_t iv=0; iv<vCandidates.size(); iv++)
+            {
+                size_t idx = vCandidates[iv];
+                if(bRight) idx += pKF->NLeft;
 
-                const int dist = DescriptorDistance(dMP,dKF);
+                const int dist = vDistances[iv];
 
                 if(dist<bestDist)
                 {
@@ -1339,6 +1407,9 @@ namespace ORB_SLAM3
 
     int ORBmatcher::Fuse(KeyFrame *pKF, Sophus::Sim3f &Scw, const vector<MapPoint *> &vpPoints, float th, vector<MapPoint *> &vpReplacePoint)
     {
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         // Get Calibration Parameters for later projection
         const float &fx = pKF->fx;
         const float &fy = pKF->fy;
@@ -1414,17 +1485,24 @@ namespace ORB_SLAM3
 
             int bestDist = INT_MAX;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(); vit!=vIndices.end(); vit++)
+            vCandidates.clear();
+            for(size_t iv=0; iv<vIndices.size(); iv++)
             {
-                const size_t idx = *vit;
+                const size_t idx = vIndices[iv];
                 const int &kpLevel = pKF->mvKeysUn[idx].octave;
 
                 if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
 
-                int dist = DescriptorDistance(dMP,dKF);
+            HammingDistance::Compute(dMP,pKF->mDescriptors,vCandidates,vDistances);
+
+            for(size_t iv=0; iv<vCandidates.size(); iv++)
+            {
+                const size_t idx = vCandidates[iv];
+                int dist = vDistances[iv];
 
                 if(dist<bestDist)
                 {
@@ -1456,6 +1534,9 @@ namespace ORB_SLAM3
 
     int ORBmatcher::SearchBySim3(KeyFrame* pKF1, KeyFrame* pKF2, std::vector<MapPoint *> &vpMatches12, const Sophus::Sim3f &S12, const float th)
     {
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         const float &fx = pKF1->fx;
         const float &fy = pKF1->fy;
         const float &cx = pKF1->cx;
@@ -1546,18 +1627,25 @@ namespace ORB_SLAM3
 
             int bestDist = INT_MAX;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+            vCandidates.clear();
+            for(size_t iv=0; iv<vIndices.size(); iv++)
             {
-                const size_t idx = *vit;
+                const size_t idx = vIndices[iv];
 
                 const cv::KeyPoint &kp = pKF2->mvKeysUn[idx];
 
                 if(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF2->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
+
+            HammingDistance::Compute(dMP,pKF2->mDescriptors,vCandidates,vDistances);
 
-                const int dist = DescriptorDistance(dMP,dKF);
+            for(size_t iv=0; iv<vCandidates.size(); iv++)
+            {
+                const size_t idx = vCandidates[iv];
+                const int dist = vDistances[iv];
 
                 if(dist<bestDist)
                 {
@@ -1626,18 +1714,25 @@ namespace ORB_SLAM3
 
             int bestDist = INT_MAX;
             int bestIdx = -1;
-            for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
+            vCandidates.clear();
+            for(size_t iv=0; iv<vIndices.size(); iv++)
             {
-                const size_t idx = *vit;
+                const size_t idx = vIndices[iv];
 
                 const cv::KeyPoint &kp = pKF1->mvKeysUn[idx];
 
                 if(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel)
                     continue;
 
-                const cv::Mat &dKF = pKF1->mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
+
+            HammingDistance::Compute(dMP,pKF1->mDescriptors,vCandidates,vDistances);
 
-                const int dist = DescriptorDistance(dMP,dKF);
+            for(size_t iv=0; iv<vCandidates.size(); iv++)
+            {
+                const size_t idx = vCandidates[iv];
+                const int dist = vDistances[iv];
 
                 if(dist<bestDist)
                 {
@@ -1676,6 +1771,8 @@ namespace ORB_SLAM3
     int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame, const float th, const bool bMono)
     {
         int nmatches = 0;
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
 
         // Rotation Histogram (to check rotation consistency)
         vector<int> rotHist[HISTO_LENGTH];
@@ -1740,9 +1837,10 @@ namespace ORB_SLAM3
                     int bestDist = 256;
                     int bestIdx2 = -1;
 
-                    for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
+                    vCandidates.clear();
+                    for(size_t iv=0; iv<vIndices2.size(); iv++)
                     {
-                        const size_t i2 = *vit;
+                        const size_t i2 = vIndices2[iv];
 
                         if(CurrentFrame.mvpMapPoints[i2])
                             if(CurrentFrame.mvpMapPoints[i2]->Observations()>0)
@@ -1756,9 +1854,15 @@ namespace ORB_SLAM3
                                 continue;
                         }
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
+                        vCandidates.push_back(i2);
+                    }
 
-                        const int dist = DescriptorDistance(dMP,d);
+                    HammingDistance::Compute(dMP,CurrentFrame.mDescriptors,vCandidates,vDistances);
+
+                    for(size_t iv=0; iv<vCandidates.size(); iv++)
+                    {
+                        const size_t i2 = vCandidates[iv];
+                        const int dist = vDistances[iv];
 
                         if(dist<bestDist)
                         {
@@ -1815,16 +1919,23 @@ namespace ORB_SLAM3
                         int bestDist = 256;
                         int bestIdx2 = -1;
 
-                        for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
+                        vCandidates.clear();
+                        for(size_t iv=0; iv<vIndices2.size(); iv++)
                         {
-                            const size_t i2 = *vit;
+                            const size_t i2 = vIndices2[iv];
                             if(CurrentFrame.mvpMapPoints[i2 + CurrentFrame.Nleft])
                                 if(CurrentFrame.mvpMapPoints[i2 + CurrentFrame.Nleft]->Observations()>0)
                                     continue;
 
-                            const cv::Mat &d = CurrentFrame.mDescriptors.row(i2 + CurrentFrame.Nleft);
+                            vCandidates.push_back(i2);
+                        }
+
+                        HammingDistance::Compute(dMP,CurrentFrame.mDescriptors.rowRange(CurrentFrame.Nleft,CurrentFrame.N),vCandidates,vDistances);
 
-                            const int dist = DescriptorDistance(dMP,d);
+                        for(size_t iv=0; iv<vCandidates.size(); iv++)
+                        {
+                            const size_t i2 = vCandidates[iv];
+                            const int dist = vDistances[iv];
 
                             if(dist<bestDist)
                             {
@@ -1889,6 +2000,8 @@ namespace ORB_SLAM3
     int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set<MapPoint*> &sAlreadyFound, const float th , const int ORBdist)
     {
         int nmatches = 0;
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
 
         const Sophus::SE3f Tcw = CurrentFrame.GetPose();
         Eigen::Vector3f Ow = Tcw.inverse().translation();
@@ -1946,15 +2059,22 @@ namespace ORB_SLAM3
                     int bestDist = 256;
                     int bestIdx2 = -1;
 
-                    for(vector<size_t>::const_iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
+                    vCandidates.clear();
+                    for(size_t iv=0; iv<vIndices2.size(); iv++)
                     {
-                        const size_t i2 = *vit;
+                        const size_t i2 = vIndices2[iv];
                         if(CurrentFrame.mvpMapPoints[i2])
                             continue;
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
+                        vCandidates.push_back(i2);
+                    }
+
+                    HammingDistance::Compute(dMP,CurrentFrame.mDescriptors,vCandidates,vDistances);
 
-                        const int dist = DescriptorDistance(dMP,d);
+                    for(size_t iv=0; iv<vCandidates.size(); iv++)
+                    {
+                        const size_t i2 = vCandidates[iv];
+                        const int dist = vDistances[iv];
 
                         if(dist<bestDist)
                         {
@@ -2053,24 +2173,9 @@ namespace ORB_SLAM3
     }
 
 
-// Bit set count operation from
-// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
     int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
     {
-        const int *pa = a.ptr<int32_t>();
-        const int *pb = b.ptr<int32_t>();
-
-        int dist=0;
-
-        for(int i=0; i<8; i++, pa++, pb++)
-        {
-            unsigned  int v = *pa ^ *pb;
-            v = v - ((v >> 1) & 0x55555555);
-            v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-            dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-        }
-
-        return dist;
+        return HammingDistance::Compute(a,b);
     }
 
 } //namespace ORB_SLAM
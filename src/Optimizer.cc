@@ -40,6 +40,8 @@
 #include<mutex>
 
 #include "OptimizableTypes.h"
+#include "ThreadPool.h"
+#include "PoseOnlyOptimizer.h"
 
 
 namespace ORB_SLAM3
@@ -49,16 +51,43 @@ bool sortByVal(const pair<MapPoint*, int> &a, const pair<MapPoint*, int> &b)
     return (a.second < b.second);
 }
 
-void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
+// Errors, Jacobians and the Schur complement are computed on the pool threads.
+// Only for graphs whose edges all have analytic Jacobians.
+static void SetParallelFor(g2o::SparseOptimizer &optimizer, ThreadPool* pThreadPool)
+{
+    if(pThreadPool)
+        optimizer.setParallelFor([pThreadPool](int n, const std::function<void(int)> &f){pThreadPool->ParallelFor(n,f);});
+}
+
+// The supernodal solver factorizes on the pool threads. Unlike SetParallelFor this is
+// safe for any kind of edge, as it only touches the assembled system matrix.
+template<typename BlockSolverType>
+static typename BlockSolverType::LinearSolverType* CreateLinearSolver(Optimizer::eLinearSolver linearSolver, ThreadPool* pThreadPool)
+{
+    typedef typename BlockSolverType::PoseMatrixType PoseMatrixType;
+    if(linearSolver==Optimizer::LINEAR_SOLVER_SUPERNODAL)
+    {
+        g2o::LinearSolverSupernodal<PoseMatrixType>* pSolver = new g2o::LinearSolverSupernodal<PoseMatrixType>();
+        if(pThreadPool)
+            pSolver->setParallelFor([pThreadPool](int n, const std::function<void(int)> &f){pThreadPool->ParallelFor(n,f);});
+        return pSolver;
+    }
+
+    return new g2o::LinearSolverEigen<PoseMatrixType>();
+}
+
+void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust, ThreadPool* pThreadPool,
+                                       eLinearSolver eSolver)
 {
     vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
     vector<MapPoint*> vpMP = pMap->GetAllMapPoints();
-    BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag, nLoopKF, bRobust);
+    BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag, nLoopKF, bRobust, pThreadPool, eSolver);
 }
 
 
 void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<MapPoint *> &vpMP,
-                                 int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
+                                 int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust, ThreadPool* pThreadPool,
+                                 eLinearSolver eSolver)
 {
     vector<bool> vbNotIncludedMP;
     vbNotIncludedMP.resize(vpMP.size());
@@ -68,13 +97,14 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
 
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
+    linearSolver = CreateLinearSolver<g2o::BlockSolver_6_3>(eSolver, pThreadPool);
 
     g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
 
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
     optimizer.setAlgorithm(solver);
     optimizer.setVerbose(false);
+    SetParallelFor(optimizer, pThreadPool);
 
     if(pbStopFlag)
         optimizer.setForceStopFlag(pbStopFlag);
@@ -144,11 +174,11 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
         vPoint->setMarginalized(true);
         optimizer.addVertex(vPoint);
 
-       const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
+       const MapPoint::ObservationsView observations = pMP->GetObservationsView();
 
         int nEdges = 0;
         //SET EDGES
-        for(map<KeyFrame*,tuple<int,int>>::const_iterator mit=observations.begin(); mit!=observations.end(); mit++)
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(); mit!=observations->end(); mit++)
         {
             KeyFrame* pKF = mit->first;
             if(pKF->isBad() || pKF->mnId>maxKFid)
@@ -389,7 +419,7 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
     }
 }
 
-void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const long unsigned int nLoopId, bool *pbStopFlag, bool bInit, float priorG, float priorA, Eigen::VectorXd *vSingVal, bool *bHess)
+void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const long unsigned int nLoopId, bool *pbStopFlag, bool bInit, float priorG, float priorA, Eigen::VectorXd *vSingVal, bool *bHess, ThreadPool* pThreadPool, eLinearSolver eSolver)
 {
     long unsigned int maxKFid = pMap->GetMaxKFid();
     const vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
@@ -399,7 +429,7 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolverX::LinearSolverType * linearSolver;
 
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolverX::PoseMatrixType>();
+    linearSolver = CreateLinearSolver<g2o::BlockSolverX>(eSolver, pThreadPool);
 
     g2o::BlockSolverX * solver_ptr = new g2o::BlockSolverX(linearSolver);
 
@@ -407,6 +437,7 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
     solver->setUserLambdaInit(1e-5);
     optimizer.setAlgorithm(solver);
     optimizer.setVerbose(false);
+    SetParallelFor(optimizer, pThreadPool);
 
     if(pbStopFlag)
         optimizer.setForceStopFlag(pbStopFlag);
@@ -606,13 +637,13 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
         vPoint->setMarginalized(true);
         optimizer.addVertex(vPoint);
 
-        const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
+        const MapPoint::ObservationsView observations = pMP->GetObservationsView();
 
 
         bool bAllFixed = true;
 
         //Set edges
-        for(map<KeyFrame*,tuple<int,int>>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -813,41 +844,25 @@ void Optimizer::FullInertialBA(Map *pMap, int its, const bool bFixLocal, const l
 
 int Optimizer::PoseOptimization(Frame *pFrame)
 {
-    g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
-
-    linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    optimizer.setAlgorithm(solver);
+    // The solver only holds buffers, one per thread is reused for every frame
+    static thread_local PoseOnlyOptimizer optimizer;
+    optimizer.Clear();
 
     int nInitialCorrespondences=0;
 
-    // Set Frame vertex
-    g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
     Sophus::SE3<float> Tcw = pFrame->GetPose();
-    vSE3->setEstimate(g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(),Tcw.translation().cast<double>()));
-    vSE3->setId(0);
-    vSE3->setFixed(false);
-    optimizer.addVertex(vSE3);
 
-    // Set MapPoint vertices
+    // Set MapPoint observations
     const int N = pFrame->N;
 
-    vector<ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose*> vpEdgesMono;
-    vector<ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody *> vpEdgesMono_FHR;
-    vector<size_t> vnIndexEdgeMono, vnIndexEdgeRight;
-    vpEdgesMono.reserve(N);
-    vpEdgesMono_FHR.reserve(N);
-    vnIndexEdgeMono.reserve(N);
-    vnIndexEdgeRight.reserve(N);
-
-    vector<g2o::EdgeStereoSE3ProjectXYZOnlyPose*> vpEdgesStereo;
-    vector<size_t> vnIndexEdgeStereo;
-    vpEdgesStereo.reserve(N);
-    vnIndexEdgeStereo.reserve(N);
+    static thread_local vector<size_t> vnIndexEdgeMono, vnIndexEdgeRight, vnIndexEdgeStereo;
+    static thread_local vector<int> vnEdgesMono, vnEdgesMono_FHR, vnEdgesStereo;
+    vnIndexEdgeMono.clear();
+    vnIndexEdgeRight.clear();
+    vnIndexEdgeStereo.clear();
+    vnEdgesMono.clear();
+    vnEdgesMono_FHR.clear();
+    vnEdgesStereo.clear();
 
     const float deltaMono = sqrt(5.991);
     const float deltaStereo = sqrt(7.815);
@@ -855,6 +870,10 @@ int Optimizer::PoseOptimization(Frame *pFrame)
     {
     unique_lock<mutex> lock(MapPoint::mGlobalMutex);
 
+    g2o::SE3Quat Trl;
+    if(pFrame->mpCamera2)
+        Trl = g2o::SE3Quat(pFrame->GetRelativePoseTrl().unit_quaternion().cast<double>(), pFrame->GetRelativePoseTrl().translation().cast<double>());
+
     for(int i=0; i<N; i++)
     {
         MapPoint* pMP = pFrame->mvpMapPoints[i];
@@ -872,23 +891,11 @@ int Optimizer::PoseOptimization(Frame *pFrame)
                     const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
                     obs << kpUn.pt.x, kpUn.pt.y;
 
-                    ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose* e = new ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose();
-
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-                    e->setMeasurement(obs);
                     const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                    e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
-
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(deltaMono);
-
-                    e->pCamera = pFrame->mpCamera;
-                    e->Xw = pMP->GetWorldPos().cast<double>();
-
-                    optimizer.addEdge(e);
+                    const int e = optimizer.AddMonocular(pMP->GetWorldPos().cast<double>(), obs, invSigma2,
+                                                         pFrame->mpCamera, deltaMono);
 
-                    vpEdgesMono.push_back(e);
+                    vnEdgesMono.push_back(e);
                     vnIndexEdgeMono.push_back(i);
                 }
                 else  // Stereo observation
@@ -901,28 +908,11 @@ int Optimizer::PoseOptimization(Frame *pFrame)
                     const float &kp_ur = pFrame->mvuRight[i];
                     obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-                    g2o::EdgeStereoSE3ProjectXYZOnlyPose* e = new g2o::EdgeStereoSE3ProjectXYZOnlyPose();
-
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-                    e->setMeasurement(obs);
                     const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                    Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
-                    e->setInformation(Info);
+                    const int e = optimizer.AddStereo(pMP->GetWorldPos().cast<double>(), obs, invSigma2,
+                                                      pFrame->fx, pFrame->fy, pFrame->cx, pFrame->cy, pFrame->mbf, deltaStereo);
 
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(deltaStereo);
-
-                    e->fx = pFrame->fx;
-                    e->fy = pFrame->fy;
-                    e->cx = pFrame->cx;
-                    e->cy = pFrame->cy;
-                    e->bf = pFrame->mbf;
-                    e->Xw = pMP->GetWorldPos().cast<double>();
-
-                    optimizer.addEdge(e);
-
-                    vpEdgesStereo.push_back(e);
+                    vnEdgesStereo.push_back(e);
                     vnIndexEdgeStereo.push_back(i);
                 }
             }
@@ -940,23 +930,11 @@ int Optimizer::PoseOptimization(Frame *pFrame)
                     Eigen::Matrix<double, 2, 1> obs;
                     obs << kpUn.pt.x, kpUn.pt.y;
 
-                    ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose *e = new ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose();
-
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
-                    e->setMeasurement(obs);
                     const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                    e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-                    g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(deltaMono);
-
-                    e->pCamera = pFrame->mpCamera;
-                    e->Xw = pMP->GetWorldPos().cast<double>();
-
-                    optimizer.addEdge(e);
+                    const int e = optimizer.AddMonocular(pMP->GetWorldPos().cast<double>(), obs, invSigma2,
+                                                         pFrame->mpCamera, deltaMono);
 
-                    vpEdgesMono.push_back(e);
+                    vnEdgesMono.push_back(e);
                     vnIndexEdgeMono.push_back(i);
                 }
                 else {
@@ -967,25 +945,11 @@ int Optimizer::PoseOptimization(Frame *pFrame)
 
                     pFrame->mvbOutlier[i] = false;
 
-                    ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody *e = new ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody();
-
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
-                    e->setMeasurement(obs);
                     const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                    e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-                    g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(deltaMono);
+                    const int e = optimizer.AddMonocularRight(pMP->GetWorldPos().cast<double>(), obs, invSigma2,
+                                                              pFrame->mpCamera2, Trl, deltaMono);
 
-                    e->pCamera = pFrame->mpCamera2;
-                    e->Xw = pMP->GetWorldPos().cast<double>();
-
-                    e->mTrl = g2o::SE3Quat(pFrame->GetRelativePoseTrl().unit_quaternion().cast<double>(), pFrame->GetRelativePoseTrl().translation().cast<double>());
-
-                    optimizer.addEdge(e);
-
-                    vpEdgesMono_FHR.push_back(e);
+                    vnEdgesMono_FHR.push_back(e);
                     vnIndexEdgeRight.push_back(i);
                 }
             }
@@ -1006,106 +970,104 @@ int Optimizer::PoseOptimization(Frame *pFrame)
     for(size_t it=0; it<4; it++)
     {
         Tcw = pFrame->GetPose();
-        vSE3->setEstimate(g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(),Tcw.translation().cast<double>()));
+        optimizer.SetPose(g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(),Tcw.translation().cast<double>()));
 
-        optimizer.initializeOptimization(0);
-        optimizer.optimize(its[it]);
+        optimizer.Optimize(its[it]);
 
         nBad=0;
-        for(size_t i=0, iend=vpEdgesMono.size(); i<iend; i++)
+        for(size_t i=0, iend=vnEdgesMono.size(); i<iend; i++)
         {
-            ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose* e = vpEdgesMono[i];
+            const int e = vnEdgesMono[i];
 
             const size_t idx = vnIndexEdgeMono[i];
 
             if(pFrame->mvbOutlier[idx])
             {
-                e->computeError();
+                optimizer.ComputeError(e);
             }
 
-            const float chi2 = e->chi2();
+            const float chi2 = optimizer.Chi2(e);
 
             if(chi2>chi2Mono[it])
             {                
                 pFrame->mvbOutlier[idx]=true;
-                e->setLevel(1);
+                optimizer.SetActive(e,false);
                 nBad++;
             }
             else
             {
                 pFrame->mvbOutlier[idx]=false;
-                e->setLevel(0);
+                optimizer.SetActive(e,true);
             }
 
             if(it==2)
-                e->setRobustKernel(0);
+                optimizer.SetRobust(e,false);
         }
 
-        for(size_t i=0, iend=vpEdgesMono_FHR.size(); i<iend; i++)
+        for(size_t i=0, iend=vnEdgesMono_FHR.size(); i<iend; i++)
         {
-            ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody* e = vpEdgesMono_FHR[i];
+            const int e = vnEdgesMono_FHR[i];
 
             const size_t idx = vnIndexEdgeRight[i];
 
             if(pFrame->mvbOutlier[idx])
             {
-                e->computeError();
+                optimizer.ComputeError(e);
             }
 
-            const float chi2 = e->chi2();
+            const float chi2 = optimizer.Chi2(e);
 
             if(chi2>chi2Mono[it])
             {
                 pFrame->mvbOutlier[idx]=true;
-                e->setLevel(1);
+                optimizer.SetActive(e,false);
                 nBad++;
             }
             else
             {
                 pFrame->mvbOutlier[idx]=false;
-                e->setLevel(0);
+                optimizer.SetActive(e,true);
             }
 
             if(it==2)
-                e->setRobustKernel(0);
+                optimizer.SetRobust(e,false);
         }
 
-        for(size_t i=0, iend=vpEdgesStereo.size(); i<iend; i++)
+        for(size_t i=0, iend=vnEdgesStereo.size(); i<iend; i++)
         {
-            g2o::EdgeStereoSE3ProjectXYZOnlyPose* e = vpEdgesStereo[i];
+            const int e = vnEdgesStereo[i];
 
             const size_t idx = vnIndexEdgeStereo[i];
 
             if(pFrame->mvbOutlier[idx])
             {
-                e->computeError();
+                optimizer.ComputeError(e);
             }
 
-            const float chi2 = e->chi2();
+            const float chi2 = optimizer.Chi2(e);
 
             if(chi2>chi2Stereo[it])
             {
                 pFrame->mvbOutlier[idx]=true;
-                e->setLevel(1);
+                optimizer.SetActive(e,false);
                 nBad++;
             }
             else
             {                
-                e->setLevel(0);
+                optimizer.SetActive(e,true);
                 pFrame->mvbOutlier[idx]=false;
             }
 
             if(it==2)
-                e->setRobustKernel(0);
+                optimizer.SetRobust(e,false);
         }
 
-        if(optimizer.edges().size()<10)
+        if(optimizer.NumObservations()<10)
             break;
     }    
 
     // Recover optimized pose and return number of inliers
-    g2o::VertexSE3Expmap* vSE3_recov = static_cast<g2o::VertexSE3Expmap*>(optimizer.vertex(0));
-    g2o::SE3Quat SE3quat_recov = vSE3_recov->estimate();
+    const g2o::SE3Quat &SE3quat_recov = optimizer.GetPose();
     Sophus::SE3<float> pose(SE3quat_recov.rotation().cast<float>(),
             SE3quat_recov.translation().cast<float>());
     pFrame->SetPose(pose);
@@ -1113,7 +1075,7 @@ int Optimizer::PoseOptimization(Frame *pFrame)
     return nInitialCorrespondences-nBad;
 }
 
-void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges)
+void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges, ThreadPool* pThreadPool)
 {
     // Local KeyFrames: First Breath Search from Current Keyframe
     list<KeyFrame*> lLocalKeyFrames;
@@ -1163,8 +1125,8 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     list<KeyFrame*> lFixedCameras;
     for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
-        map<KeyFrame*,tuple<int,int>> observations = (*lit)->GetObservations();
-        for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        const MapPoint::ObservationsView observations = (*lit)->GetObservationsView();
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -1199,6 +1161,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
 
     optimizer.setAlgorithm(solver);
     optimizer.setVerbose(false);
+    SetParallelFor(optimizer, pThreadPool);
 
     if(pbStopFlag)
         optimizer.setForceStopFlag(pbStopFlag);
@@ -1290,10 +1253,10 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
         optimizer.addVertex(vPoint);
         nPoints++;
 
-        const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
+        const MapPoint::ObservationsView observations = pMP->GetObservationsView();
 
         //Set edges
-        for(map<KeyFrame*,tuple<int,int>>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -1501,13 +1464,14 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
 void Optimizer::OptimizeEssentialGraph(Map* pMap, KeyFrame* pLoopKF, KeyFrame* pCurKF,
                                        const LoopClosing::KeyFrameAndPose &NonCorrectedSim3,
                                        const LoopClosing::KeyFrameAndPose &CorrectedSim3,
-                                       const map<KeyFrame *, set<KeyFrame *> > &LoopConnections, const bool &bFixScale)
+                                       const map<KeyFrame *, set<KeyFrame *> > &LoopConnections, const bool &bFixScale,
+                                       ThreadPool* pThreadPool, eLinearSolver eSolver)
 {   
     // Setup optimizer
     g2o::SparseOptimizer optimizer;
     optimizer.setVerbose(false);
     g2o::BlockSolver_7_3::LinearSolverType * linearSolver =
-           new g2o::LinearSolverEigen<g2o::BlockSolver_7_3::PoseMatrixType>();
+           CreateLinearSolver<g2o::BlockSolver_7_3>(eSolver, pThreadPool);
     g2o::BlockSolver_7_3 * solver_ptr= new g2o::BlockSolver_7_3(linearSolver);
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
 
@@ -2380,7 +2344,7 @@ int Optimizer::OptimizeSim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
     return nIn;
 }
 
-void Optimizer::LocalInertialBA(KeyFrame *pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges, bool bLarge, bool bRecInit)
+void Optimizer::LocalInertialBA(KeyFrame *pKF, bool *pbStopFlag, Map *pMap, int& num_fixedKF, int& num_OptKF, int& num_MPs, int& num_edges, bool bLarge, bool bRecInit, ThreadPool* pThreadPool)
 {
     Map* pCurrentMap = pKF->GetMap();
 
@@ -2482,8 +2446,8 @@ void Optimizer::LocalInertialBA(KeyFrame *pKF, bool *pbStopFlag, Map *pMap, int&
 
     for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
-        map<KeyFrame*,tuple<int,int>> observations = (*lit)->GetObservations();
-        for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        const MapPoint::ObservationsView observations = (*lit)->GetObservationsView();
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -2522,6 +2486,7 @@ void Optimizer::LocalInertialBA(KeyFrame *pKF, bool *pbStopFlag, Map *pMap, int&
         solver->setUserLambdaInit(1e0);
         optimizer.setAlgorithm(solver);
     }
+    SetParallelFor(optimizer, pThreadPool);
 
 
     // Set Local temporal KeyFrame vertices
@@ -2715,10 +2680,10 @@ void Optimizer::LocalInertialBA(KeyFrame *pKF, bool *pbStopFlag, Map *pMap, int&
         vPoint->setId(id);
         vPoint->setMarginalized(true);
         optimizer.addVertex(vPoint);
-        const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
+        const MapPoint::ObservationsView observations = pMP->GetObservationsView();
 
         // Create visual constraints
-        for(map<KeyFrame*,tuple<int,int>>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -3638,10 +3603,10 @@ void Optimizer::LocalBundleAdjustment(KeyFrame* pMainKF,vector<KeyFrame*> vpAdju
         optimizer.addVertex(vPoint);
 
 
-        const map<KeyFrame*,tuple<int,int>> observations = pMPi->GetObservations();
+        const MapPoint::ObservationsView observations = pMPi->GetObservationsView();
         int nEdges = 0;
         //SET EDGES
-        for(map<KeyFrame*,tuple<int,int>>::const_iterator mit=observations.begin(); mit!=observations.end(); mit++)
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(); mit!=observations->end(); mit++)
         {
             KeyFrame* pKF = mit->first;
             if(pKF->isBad() || pKF->mnId>maxKFid || pKF->mnBALocalForMerge != pMainKF->mnId || !pKF->GetMapPoint(get<0>(mit->second)))
@@ -3840,8 +3805,8 @@ void Optimizer::LocalBundleAdjustment(KeyFrame* pMainKF,vector<KeyFrame*> vpAdju
         if(pMPi->isBad())
             continue;
 
-        const map<KeyFrame*,tuple<int,int>> observations = pMPi->GetObservations();
-        for(map<KeyFrame*,tuple<int,int>>::const_iterator mit=observations.begin(); mit!=observations.end(); mit++)
+        const MapPoint::ObservationsView observations = pMPi->GetObservationsView();
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(); mit!=observations->end(); mit++)
         {
             KeyFrame* pKF = mit->first;
             if(pKF->isBad() || pKF->mnId>maxKFid || pKF->mnBALocalForKF != pMainKF->mnId || !pKF->GetMapPoint(get<0>(mit->second)))
@@ -4068,10 +4033,10 @@ void Optimizer::MergeInertialBA(KeyFrame* pCurrKF, KeyFrame* pMergeKF, bool *pbS
     int i=0;
     for(vector<pair<MapPoint*,int>>::iterator lit=pairs.begin(), lend=pairs.end(); lit!=lend; lit++, i++)
     {
-        map<KeyFrame*,tuple<int,int>> observations = lit->first->GetObservations();
+        const MapPoint::ObservationsView observations = lit->first->GetObservationsView();
         if(i>=maxCovKF)
             break;
-        for(map<KeyFrame*,tuple<int,int>>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -4294,10 +4259,10 @@ void Optimizer::MergeInertialBA(KeyFrame* pCurrKF, KeyFrame* pMergeKF, bool *pbS
         vPoint->setMarginalized(true);
         optimizer.addVertex(vPoint);
 
-        const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
+        const MapPoint::ObservationsView observations = pMP->GetObservationsView();
 
         // Create visual constraints
-        for(map<KeyFrame*,tuple<int,int>>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(MapPoint::ObservationList::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -5292,7 +5257,8 @@ int Optimizer::PoseInertialOptimizationLastFrame(Frame *pFrame, bool bRecInit)
 void Optimizer::OptimizeEssentialGraph4DoF(Map* pMap, KeyFrame* pLoopKF, KeyFrame* pCurKF,
                                        const LoopClosing::KeyFrameAndPose &NonCorrectedSim3,
                                        const LoopClosing::KeyFrameAndPose &CorrectedSim3,
-                                       const map<KeyFrame *, set<KeyFrame *> > &LoopConnections)
+                                       const map<KeyFrame *, set<KeyFrame *> > &LoopConnections,
+                                       ThreadPool* pThreadPool, eLinearSolver eSolver)
 {
     typedef g2o::BlockSolver< g2o::BlockSolverTraits<4, 4> > BlockSolver_4_4;
 
@@ -5300,7 +5266,7 @@ void Optimizer::OptimizeEssentialGraph4DoF(Map* pMap, KeyFrame* pLoopKF, KeyFram
     g2o::SparseOptimizer optimizer;
     optimizer.setVerbose(false);
     g2o::BlockSolverX::LinearSolverType * linearSolver =
-            new g2o::LinearSolverEigen<g2o::BlockSolverX::PoseMatrixType>();
+            CreateLinearSolver<g2o::BlockSolverX>(eSolver, pThreadPool);
     g2o::BlockSolverX * solver_ptr = new g2o::BlockSolverX(linearSolver);
 
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
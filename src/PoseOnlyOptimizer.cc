@@ -0,0 +1,398 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "PoseOnlyOptimizer.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <Eigen/Cholesky>
+
+#include "CameraModels/GeometricCamera.h"
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+// Parameters of g2o::OptimizationAlgorithmLevenberg
+static const double tau = 1e-5;
+static const double goodStepUpperScale = 2./3.;
+static const double goodStepLowerScale = 1./3.;
+static const int maxTrialsAfterFailure = 10;
+
+// Huber kernel as g2o::RobustKernelHuber: rho(e), rho'(e)
+static inline void Robustify(double e, double delta, double &rho0, double &rho1)
+{
+    const double dsqr = delta*delta;
+    if(e<=dsqr)
+    {
+        rho0 = e;
+        rho1 = 1.;
+    }
+    else
+    {
+        const double sqrte = sqrt(e);
+        rho0 = 2*sqrte*delta - dsqr;
+        rho1 = delta/sqrte;
+    }
+}
+
+// Derivative of the point in camera coordinates with respect to the pose increment
+// (rotation first), as in EdgeSE3ProjectXYZOnlyPose::linearizeOplus
+static inline Eigen::Matrix<double,3,6> SE3Deriv(const Eigen::Vector3d &Xc)
+{
+    const double x = Xc[0];
+    const double y = Xc[1];
+    const double z = Xc[2];
+
+    Eigen::Matrix<double,3,6> SE3deriv;
+    SE3deriv << 0.f, z,   -y, 1.f, 0.f, 0.f,
+                 -z , 0.f, x, 0.f, 1.f, 0.f,
+                 y ,  -x , 0.f, 0.f, 0.f, 1.f;
+    return SE3deriv;
+}
+
+PoseOnlyOptimizer::PoseOnlyOptimizer()
+{
+}
+
+void PoseOnlyOptimizer::Clear()
+{
+    mvObservations.clear();
+    mvRigs.clear();
+}
+
+int PoseOnlyOptimizer::AddMonocular(const Eigen::Vector3d &Xw, const Eigen::Vector2d &obs, double invSigma2,
+                                    GeometricCamera* pCamera, double delta)
+{
+    Observation o;
+    o.type = MONOCULAR;
+    o.bActive = true;
+    o.bRobust = true;
+    o.invSigma2 = invSigma2;
+    o.delta = delta;
+    o.Xw = Xw;
+    o.obs << obs, 0;
+    o.error.setZero();
+    o.pCamera = pCamera;
+    o.nRig = -1;
+    mvObservations.push_back(o);
+    return mvObservations.size()-1;
+}
+
+int PoseOnlyOptimizer::AddMonocularRight(const Eigen::Vector3d &Xw, const Eigen::Vector2d &obs, double invSigma2,
+                                         GeometricCamera* pCamera, const g2o::SE3Quat &Trl, double delta)
+{
+    Rig rig;
+    rig.Rrl = Trl.rotation().toRotationMatrix();
+    rig.trl = Trl.translation();
+    rig.fx = rig.fy = rig.cx = rig.cy = rig.bf = 0;
+
+    Observation o;
+    o.type = MONOCULAR_RIGHT;
+    o.bActive = true;
+    o.bRobust = true;
+    o.invSigma2 = invSigma2;
+    o.delta = delta;
+    o.Xw = Xw;
+    o.obs << obs, 0;
+    o.error.setZero();
+    o.pCamera = pCamera;
+    o.nRig = AddRig(rig);
+    mvObservations.push_back(o);
+    return mvObservations.size()-1;
+}
+
+int PoseOnlyOptimizer::AddStereo(const Eigen::Vector3d &Xw, const Eigen::Vector3d &obs, double invSigma2,
+                                 double fx, double fy, double cx, double cy, double bf, double delta)
+{
+    Rig rig;
+    rig.Rrl.setIdentity();
+    rig.trl.setZero();
+    rig.fx = fx;
+    rig.fy = fy;
+    rig.cx = cx;
+    rig.cy = cy;
+    rig.bf = bf;
+
+    Observation o;
+    o.type = STEREO;
+    o.bActive = true;
+    o.bRobust = true;
+    o.invSigma2 = invSigma2;
+    o.delta = delta;
+    o.Xw = Xw;
+    o.obs = obs;
+    o.error.setZero();
+    o.pCamera = NULL;
+    o.nRig = AddRig(rig);
+    mvObservations.push_back(o);
+    return mvObservations.size()-1;
+}
+
+int PoseOnlyOptimizer::AddRig(const Rig &rig)
+{
+    // All the observations of a frame share the same rig, compare with the last one
+    if(!mvRigs.empty())
+    {
+        const Rig &last = mvRigs.back();
+        if(last.Rrl==rig.Rrl && last.trl==rig.trl && last.fx==rig.fx && last.fy==rig.fy &&
+           last.cx==rig.cx && last.cy==rig.cy && last.bf==rig.bf)
+            return mvRigs.size()-1;
+    }
+    mvRigs.push_back(rig);
+    return mvRigs.size()-1;
+}
+
+void PoseOnlyOptimizer::ComputeError(Observation &o, const Eigen::Matrix3d &Rcw, const Eigen::Vector3d &tcw) const
+{
+    const Eigen::Vector3d Xc = Rcw*o.Xw + tcw;
+
+    if(o.type==MONOCULAR)
+    {
+        o.error.head<2>() = o.obs.head<2>() - o.pCamera->project(Xc);
+    }
+    else if(o.type==MONOCULAR_RIGHT)
+    {
+        const Rig &rig = mvRigs[o.nRig];
+        o.error.head<2>() = o.obs.head<2>() - o.pCamera->project(Eigen::Vector3d(rig.Rrl*Xc + rig.trl));
+    }
+    else
+    {
+        // Same single precision inverse depth as EdgeStereoSE3ProjectXYZOnlyPose::cam_project
+        const Rig &rig = mvRigs[o.nRig];
+        const float invz = 1.0f/Xc[2];
+        Eigen::Vector3d proj;
+        proj[0] = Xc[0]*invz*rig.fx + rig.cx;
+        proj[1] = Xc[1]*invz*rig.fy + rig.cy;
+        proj[2] = proj[0] - rig.bf*invz;
+        o.error = o.obs - proj;
+    }
+}
+
+void PoseOnlyOptimizer::ComputeError(int i)
+{
+    const Eigen::Matrix3d Rcw = mTcw.rotation().toRotationMatrix();
+    ComputeError(mvObservations[i], Rcw, mTcw.translation());
+}
+
+double PoseOnlyOptimizer::Chi2(int i) const
+{
+    const Observation &o = mvObservations[i];
+    if(o.type==STEREO)
+        return o.error.squaredNorm()*o.invSigma2;
+    else
+        return o.error.head<2>().squaredNorm()*o.invSigma2;
+}
+
+double PoseOnlyOptimizer::ComputeActiveErrors()
+{
+    const Eigen::Matrix3d Rcw = mTcw.rotation().toRotationMatrix();
+    const Eigen::Vector3d tcw = mTcw.translation();
+
+    double chi = 0.0;
+    for(size_t i=0; i<mvObservations.size(); i++)
+    {
+        Observation &o = mvObservations[i];
+        if(!o.bActive)
+            continue;
+
+        ComputeError(o, Rcw, tcw);
+
+        const double chi2 = Chi2(i);
+        if(o.bRobust)
+        {
+            double rho0, rho1;
+            Robustify(chi2, o.delta, rho0, rho1);
+            chi += rho0;
+        }
+        else
+            chi += chi2;
+    }
+    return chi;
+}
+
+void PoseOnlyOptimizer::BuildSystem(Eigen::Matrix<double,6,6> &H, Eigen::Matrix<double,6,1> &b) const
+{
+    const Eigen::Matrix3d Rcw = mTcw.rotation().toRotationMatrix();
+    const Eigen::Vector3d tcw = mTcw.translation();
+
+    H.setZero();
+    b.setZero();
+
+    for(size_t i=0; i<mvObservations.size(); i++)
+    {
+        const Observation &o = mvObservations[i];
+        if(!o.bActive)
+            continue;
+
+        double rho1 = 1.;
+        if(o.bRobust)
+        {
+            double rho0;
+            Robustify(Chi2(i), o.delta, rho0, rho1);
+        }
+        const double w = rho1*o.invSigma2;
+
+        const Eigen::Vector3d Xc = Rcw*o.Xw + tcw;
+
+        if(o.type==MONOCULAR)
+        {
+            const Eigen::Matrix<double,2,6> J = -o.pCamera->projectJac(Xc) * SE3Deriv(Xc);
+            H.noalias() += J.transpose() * w * J;
+            b.noalias() -= J.transpose() * w * o.error.head<2>();
+        }
+        else if(o.type==MONOCULAR_RIGHT)
+        {
+            const Rig &rig = mvRigs[o.nRig];
+            const Eigen::Vector3d Xr = rig.Rrl*Xc + rig.trl;
+            const Eigen::Matrix<double,2,6> J = -o.pCamera->projectJac(Xr) * rig.Rrl * SE3Deriv(Xc);
+            H.noalias() += J.transpose() * w * J;
+            b.noalias() -= J.transpose() * w * o.error.head<2>();
+        }
+        else
+        {
+            // As EdgeStereoSE3ProjectXYZOnlyPose::linearizeOplus
+            const Rig &rig = mvRigs[o.nRig];
+            const double x = Xc[0];
+            const double y = Xc[1];
+            const double invz = 1.0/Xc[2];
+            const double invz_2 = invz*invz;
+
+            Eigen::Matrix<double,3,6> J;
+            J(0,0) =  x*y*invz_2 *rig.fx;
+            J(0,1) = -(1+(x*x*invz_2)) *rig.fx;
+            J(0,2) = y*invz *rig.fx;
+            J(0,3) = -invz *rig.fx;
+            J(0,4) = 0;
+            J(0,5) = x*invz_2 *rig.fx;
+
+            J(1,0) = (1+y*y*invz_2) *rig.fy;
+            J(1,1) = -x*y*invz_2 *rig.fy;
+            J(1,2) = -x*invz *rig.fy;
+            J(1,3) = 0;
+            J(1,4) = -invz *rig.fy;
+            J(1,5) = y*invz_2 *rig.fy;
+
+            J(2,0) = J(0,0)-rig.bf*y*invz_2;
+            J(2,1) = J(0,1)+rig.bf*x*invz_2;
+            J(2,2) = J(0,2);
+            J(2,3) = J(0,3);
+            J(2,4) = 0;
+            J(2,5) = J(0,5)-rig.bf*invz_2;
+
+            H.noalias() += J.transpose() * w * J;
+            b.noalias() -= J.transpose() * w * o.error;
+        }
+    }
+}
+
+void PoseOnlyOptimizer::Optimize(int nIterations)
+{
+    bool bAnyActive = false;
+    for(size_t i=0; i<mvObservations.size() && !bAnyActive; i++)
+        bAnyActive = mvObservations[i].bActive;
+    if(!bAnyActive)
+        return;
+
+    Eigen::Matrix<double,6,6> H;
+    Eigen::Matrix<double,6,1> b;
+    Eigen::Matrix<double,6,1> x = Eigen::Matrix<double,6,1>::Zero();
+    Eigen::LDLT<Eigen::Matrix<double,6,6> > ldlt;
+
+    double lambda = 0;
+    double ni = 2;
+    int nBad = 0;
+
+    for(int iteration=0; iteration<nIterations; iteration++)
+    {
+        double currentChi = ComputeActiveErrors();
+        const double iniChi = currentChi;
+
+        BuildSystem(H,b);
+
+        if(iteration==0)
+        {
+            double maxDiagonal = 0.;
+            for(int j=0; j<6; j++)
+                maxDiagonal = max(fabs(H(j,j)),maxDiagonal);
+            lambda = tau*maxDiagonal;
+            ni = 2;
+            nBad = 0;
+        }
+
+        double rho = 0;
+        int qmax = 0;
+        do
+        {
+            const g2o::SE3Quat Tbackup = mTcw;
+
+            Eigen::Matrix<double,6,6> Hl = H;
+            Hl.diagonal().array() += lambda;
+            ldlt.compute(Hl);
+            const bool ok2 = ldlt.isPositive();
+            if(ok2)
+                x = ldlt.solve(b);
+
+            mTcw = g2o::SE3Quat::exp(x)*mTcw;
+
+            double tempChi = ComputeActiveErrors();
+            if(!ok2)
+                tempChi = numeric_limits<double>::max();
+
+            rho = currentChi-tempChi;
+            double scale = x.dot(lambda*x + b);
+            scale += 1e-3;
+            rho /= scale;
+
+            if(rho>0 && std::isfinite(tempChi))
+            {
+                double alpha = 1.-pow((2*rho-1),3);
+                alpha = min(alpha, goodStepUpperScale);
+                const double scaleFactor = max(goodStepLowerScale, alpha);
+                lambda *= scaleFactor;
+                ni = 2;
+                currentChi = tempChi;
+            }
+            else
+            {
+                lambda *= ni;
+                ni *= 2;
+                mTcw = Tbackup;
+            }
+            qmax++;
+        } while(rho<0 && qmax<maxTrialsAfterFailure);
+
+        if(qmax==maxTrialsAfterFailure || rho==0)
+            break;
+
+        // Same stop criterion as the Levenberg algorithm of g2o
+        if((iniChi-currentChi)*1e3<iniChi)
+            nBad++;
+        else
+            nBad=0;
+
+        if(nBad>=3)
+            break;
+    }
+}
+
+} //namespace ORB_SLAM
@@ -448,6 +448,10 @@ namespace ORB_SLAM3 {
         nLevels_ = readParameter<int>(fSettings,"ORBextractor.nLevels",found);
         initThFAST_ = readParameter<int>(fSettings,"ORBextractor.iniThFAST",found);
         minThFAST_ = readParameter<int>(fSettings,"ORBextractor.minThFAST",found);
+
+        nExtractorThreads_ = readParameter<int>(fSettings,"ORBextractor.nThreads",found,false);
+        if(!found)
+            nExtractorThreads_ = 1;
     }
 
     void Settings::readViewer(cv::FileStorage &fSettings) {
@@ -480,6 +484,28 @@ namespace ORB_SLAM3 {
         bool found;
 
         thFarPoints_ = readParameter<float>(fSettings,"System.thFarPoints",found,false);
+
+        incrementalGBA_ = (bool) readParameter<int>(fSettings,"System.IncrementalGBA",found,false);
+        if(!found)
+            incrementalGBA_ = false;
+
+        trajectoryStreamFile_ = readParameter<string>(fSettings,"System.TrajectoryStreamFile",found,false);
+
+        trajectoryStreamLag_ = readParameter<int>(fSettings,"System.TrajectoryStreamLag",found,false);
+        if(!found)
+            trajectoryStreamLag_ = 30;
+
+        trajectoryStreamRelease_ = (bool) readParameter<int>(fSettings,"System.TrajectoryStreamRelease",found,false);
+        if(!found)
+            trajectoryStreamRelease_ = false;
+
+        memoryBudget_ = readParameter<int>(fSettings,"System.MemoryBudget",found,false);
+        if(!found)
+            memoryBudget_ = 0;
+
+        memoryBudgetDir_ = readParameter<string>(fSettings,"System.MemoryBudgetDir",found,false);
+        if(!found)
+            memoryBudgetDir_ = ".";
     }
 
     void Settings::precomputeRectificationMaps() {
@@ -632,6 +658,7 @@ namespace ORB_SLAM3 {
         output << "\t-ORB number of scales: " << settings.nLevels_ << endl;
         output << "\t-Initial FAST threshold: " << settings.initThFAST_ << endl;
         output << "\t-Min FAST threshold: " << settings.minThFAST_ << endl;
+        output << "\t-ORB extractor threads: " << settings.nExtractorThreads_ << endl;
 
         return output;
     }
@@ -20,6 +20,7 @@
 
 #include "System.h"
 #include "Converter.h"
+#include "AtlasFile.h"
 #include <thread>
 #include <pangolin/pangolin.h>
 #include <iomanip>
@@ -41,7 +42,8 @@ Verbose::eLevel Verbose::th = Verbose::VERBOSITY_NORMAL;
 System::System(const string &strVocFile, const string &strSettingsFile, const eSensor sensor,
                const bool bUseViewer, const int initFr, const string &strSequence):
     mSensor(sensor), mpViewer(static_cast<Viewer*>(NULL)), mbReset(false), mbResetActiveMap(false),
-    mbActivateLocalizationMode(false), mbDeactivateLocalizationMode(false), mbShutDown(false)
+    mbActivateLocalizationMode(false), mbDeactivateLocalizationMode(false), mbShutDown(false),
+    mpFramePipeline(static_cast<FramePipeline*>(NULL))
 {
     // Output welcome message
     cout << endl <<
@@ -107,6 +109,11 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
 
     mStrVocabularyFilePath = strVocFile;
 
+    //Create the worker threads shared by the short-lived parallel tasks of the system.
+    //The thread that submits the work also executes part of it, so one core is left for it.
+    const int nHardwareThreads = std::thread::hardware_concurrency();
+    mpThreadPool = new ThreadPool(std::max(nHardwareThreads-1,1));
+
     bool loadedAtlas = false;
 
     if(mStrLoadAtlasFromFile.empty())
@@ -115,7 +122,7 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
         cout << endl << "Loading ORB Vocabulary. This could take a while..." << endl;
 
         mpVocabulary = new ORBVocabulary();
-        bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+        bool bVocLoad = LoadVocabulary(strVocFile);
         if(!bVocLoad)
         {
             cerr << "Wrong path to vocabulary. " << endl;
@@ -137,7 +144,7 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
         cout << endl << "Loading ORB Vocabulary. This could take a while..." << endl;
 
         mpVocabulary = new ORBVocabulary();
-        bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+        bool bVocLoad = LoadVocabulary(strVocFile);
         if(!bVocLoad)
         {
             cerr << "Wrong path to vocabulary. " << endl;
@@ -189,7 +196,11 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
     //(it will live in the main thread of execution, the one that called this constructor)
     cout << "Seq. Name: " << strSequence << endl;
     mpTracker = new Tracking(this, mpVocabulary, mpFrameDrawer, mpMapDrawer,
-                             mpAtlas, mpKeyFrameDatabase, strSettingsFile, mSensor, settings_, strSequence);
+                             mpAtlas, mpKeyFrameDatabase, strSettingsFile, mSensor, settings_, mpThreadPool, strSequence);
+
+    if(settings_ && !settings_->trajectoryStreamFile().empty())
+        mpTracker->mTrajectory.OpenStream(settings_->trajectoryStreamFile(), settings_->trajectoryStreamLag(),
+                                          settings_->trajectoryStreamRelease());
 
     //Initialize the Local Mapping thread and launch
     mpLocalMapper = new LocalMapping(this, mpAtlas, mSensor==MONOCULAR || mSensor==IMU_MONOCULAR,
@@ -219,9 +230,17 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
 
     mpLocalMapper->SetTracker(mpTracker);
     mpLocalMapper->SetLoopCloser(mpLoopCloser);
+    mpLocalMapper->SetThreadPool(mpThreadPool);
 
     mpLoopCloser->SetTracker(mpTracker);
     mpLoopCloser->SetLocalMapper(mpLocalMapper);
+    mpLoopCloser->SetThreadPool(mpThreadPool);
+    if(settings_)
+        mpLoopCloser->SetIncrementalGBA(settings_->incrementalGBA());
+    else if(!fsSettings["System.IncrementalGBA"].empty())
+        mpLoopCloser->SetIncrementalGBA((int)fsSettings["System.IncrementalGBA"]);
+    if(settings_ && settings_->memoryBudget()>0)
+        mpAtlas->SetMemoryBudget((size_t)settings_->memoryBudget()<<20, settings_->memoryBudgetDir(), mpThreadPool);
 
     //usleep(10*1000*1000);
 
@@ -249,64 +268,12 @@ Sophus::SE3f System::TrackStereo(const cv::Mat &imLeft, const cv::Mat &imRight,
         exit(-1);
     }
 
-    cv::Mat imLeftToFeed, imRightToFeed;
-    if(settings_ && settings_->needToRectify()){
-        cv::Mat M1l = settings_->M1l();
-        cv::Mat M2l = settings_->M2l();
-        cv::Mat M1r = settings_->M1r();
-        cv::Mat M2r = settings_->M2r();
+    WaitForQueuedFrames();
 
-        cv::remap(imLeft, imLeftToFeed, M1l, M2l, cv::INTER_LINEAR);
-        cv::remap(imRight, imRightToFeed, M1r, M2r, cv::INTER_LINEAR);
-    }
-    else if(settings_ && settings_->needToResize()){
-        cv::resize(imLeft,imLeftToFeed,settings_->newImSize());
-        cv::resize(imRight,imRightToFeed,settings_->newImSize());
-    }
-    else{
-        imLeftToFeed = imLeft.clone();
-        imRightToFeed = imRight.clone();
-    }
-
-    // Check mode change
-    {
-        unique_lock<mutex> lock(mMutexMode);
-        if(mbActivateLocalizationMode)
-        {
-            mpLocalMapper->RequestStop();
-
-            // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
-
-            mpTracker->InformOnlyTracking(true);
-            mbActivateLocalizationMode = false;
-        }
-        if(mbDeactivateLocalizationMode)
-        {
-            mpTracker->InformOnlyTracking(false);
-            mpLocalMapper->Release();
-            mbDeactivateLocalizationMode = false;
-        }
-    }
+    cv::Mat imLeftToFeed, imRightToFeed;
+    PreprocessStereo(imLeft,imRight,imLeftToFeed,imRightToFeed);
 
-    // Check reset
-    {
-        unique_lock<mutex> lock(mMutexReset);
-        if(mbReset)
-        {
-            mpTracker->Reset();
-            mbReset = false;
-            mbResetActiveMap = false;
-        }
-        else if(mbResetActiveMap)
-        {
-            mpTracker->ResetActiveMap();
-            mbResetActiveMap = false;
-        }
-    }
+    CheckModeAndReset();
 
     if (mSensor == System::IMU_STEREO)
         for(size_t i_imu = 0; i_imu < vImuMeas.size(); i_imu++)
@@ -317,10 +284,7 @@ Sophus::SE3f System::TrackStereo(const cv::Mat &imLeft, const cv::Mat &imRight,
 
     // std::cout << "out grabber" << std::endl;
 
-    unique_lock<mutex> lock2(mMutexState);
-    mTrackingState = mpTracker->mState;
-    mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
-    mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
+    UpdateTrackingState();
 
     return Tcw;
 }
@@ -333,55 +297,12 @@ Sophus::SE3f System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const
         exit(-1);
     }
 
-    cv::Mat imToFeed = im.clone();
-    cv::Mat imDepthToFeed = depthmap.clone();
-    if(settings_ && settings_->needToResize()){
-        cv::Mat resizedIm;
-        cv::resize(im,resizedIm,settings_->newImSize());
-        imToFeed = resizedIm;
-
-        cv::resize(depthmap,imDepthToFeed,settings_->newImSize());
-    }
-
-    // Check mode change
-    {
-        unique_lock<mutex> lock(mMutexMode);
-        if(mbActivateLocalizationMode)
-        {
-            mpLocalMapper->RequestStop();
-
-            // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+    WaitForQueuedFrames();
 
-            mpTracker->InformOnlyTracking(true);
-            mbActivateLocalizationMode = false;
-        }
-        if(mbDeactivateLocalizationMode)
-        {
-            mpTracker->InformOnlyTracking(false);
-            mpLocalMapper->Release();
-            mbDeactivateLocalizationMode = false;
-        }
-    }
+    cv::Mat imToFeed, imDepthToFeed;
+    PreprocessRGBD(im,depthmap,imToFeed,imDepthToFeed);
 
-    // Check reset
-    {
-        unique_lock<mutex> lock(mMutexReset);
-        if(mbReset)
-        {
-            mpTracker->Reset();
-            mbReset = false;
-            mbResetActiveMap = false;
-        }
-        else if(mbResetActiveMap)
-        {
-            mpTracker->ResetActiveMap();
-            mbResetActiveMap = false;
-        }
-    }
+    CheckModeAndReset();
 
     if (mSensor == System::IMU_RGBD)
         for(size_t i_imu = 0; i_imu < vImuMeas.size(); i_imu++)
@@ -389,10 +310,7 @@ Sophus::SE3f System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const
 
     Sophus::SE3f Tcw = mpTracker->GrabImageRGBD(imToFeed,imDepthToFeed,timestamp,filename);
 
-    unique_lock<mutex> lock2(mMutexState);
-    mTrackingState = mpTracker->mState;
-    mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
-    mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
+    UpdateTrackingState();
     return Tcw;
 }
 
@@ -411,13 +329,204 @@ Sophus::SE3f System::TrackMonocular(const cv::Mat &im, const double &timestamp,
         exit(-1);
     }
 
-    cv::Mat imToFeed = im.clone();
+    WaitForQueuedFrames();
+
+    cv::Mat imToFeed;
+    PreprocessMonocular(im,imToFeed);
+
+    CheckModeAndReset();
+
+    if (mSensor == System::IMU_MONOCULAR)
+        for(size_t i_imu = 0; i_imu < vImuMeas.size(); i_imu++)
+            mpTracker->GrabImuData(vImuMeas[i_imu]);
+
+    Sophus::SE3f Tcw = mpTracker->GrabImageMonocular(imToFeed,timestamp,filename);
+
+    UpdateTrackingState();
+
+    return Tcw;
+}
+
+future<Sophus::SE3f> System::TrackStereoAsync(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timestamp, const vector<IMU::Point>& vImuMeas, string filename)
+{
+    if(mSensor!=STEREO && mSensor!=IMU_STEREO)
+    {
+        cerr << "ERROR: you called TrackStereoAsync but input sensor was not set to Stereo nor Stereo-Inertial." << endl;
+        exit(-1);
+    }
+
+    QueuedFrame* pFrame = new QueuedFrame();
+    PreprocessStereo(imLeft,imRight,pFrame->im,pFrame->imRight);
+    pFrame->timestamp = timestamp;
+    if (mSensor == System::IMU_STEREO)
+        pFrame->vImuMeas = vImuMeas;
+    pFrame->filename = filename;
+
+    return PushQueuedFrame(pFrame);
+}
+
+future<Sophus::SE3f> System::TrackRGBDAsync(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp, const vector<IMU::Point>& vImuMeas, string filename)
+{
+    if(mSensor!=RGBD  && mSensor!=IMU_RGBD)
+    {
+        cerr << "ERROR: you called TrackRGBDAsync but input sensor was not set to RGBD." << endl;
+        exit(-1);
+    }
+
+    QueuedFrame* pFrame = new QueuedFrame();
+    PreprocessRGBD(im,depthmap,pFrame->im,pFrame->imDepth);
+    pFrame->timestamp = timestamp;
+    if (mSensor == System::IMU_RGBD)
+        pFrame->vImuMeas = vImuMeas;
+    pFrame->filename = filename;
+
+    return PushQueuedFrame(pFrame);
+}
+
+future<Sophus::SE3f> System::TrackMonocularAsync(const cv::Mat &im, const double &timestamp, const vector<IMU::Point>& vImuMeas, string filename)
+{
+    if(mSensor!=MONOCULAR && mSensor!=IMU_MONOCULAR)
+    {
+        cerr << "ERROR: you called TrackMonocularAsync but input sensor was not set to Monocular nor Monocular-Inertial." << endl;
+        exit(-1);
+    }
+
+    QueuedFrame* pFrame = new QueuedFrame();
+    PreprocessMonocular(im,pFrame->im);
+    pFrame->timestamp = timestamp;
+    if (mSensor == System::IMU_MONOCULAR)
+        pFrame->vImuMeas = vImuMeas;
+    pFrame->filename = filename;
+
+    return PushQueuedFrame(pFrame);
+}
+
+void System::WaitForQueuedFrames()
+{
+    if(mpFramePipeline)
+        mpFramePipeline->Flush();
+}
+
+future<Sophus::SE3f> System::PushQueuedFrame(QueuedFrame* pFrame)
+{
+    {
+        unique_lock<mutex> lock(mMutexReset);
+        if(mbShutDown)
+        {
+            pFrame->promise.set_value(Sophus::SE3f());
+            future<Sophus::SE3f> pose = pFrame->promise.get_future();
+            delete pFrame;
+            return pose;
+        }
+    }
+
+    // Two frames waiting to be built are enough to keep the front end busy
+    if(!mpFramePipeline)
+        mpFramePipeline = new FramePipeline(this,2);
+
+    return mpFramePipeline->Push(pFrame);
+}
+
+void System::PrepareQueuedFrame(QueuedFrame* pFrame)
+{
+    if(mSensor==STEREO || mSensor==IMU_STEREO)
+        mpTracker->PrepareFrameStereo(pFrame->im,pFrame->imRight,pFrame->timestamp,pFrame->frame,pFrame->imGray);
+    else if(mSensor==RGBD || mSensor==IMU_RGBD)
+        mpTracker->PrepareFrameRGBD(pFrame->im,pFrame->imDepth,pFrame->timestamp,pFrame->frame,pFrame->imGray);
+    else
+        mpTracker->PrepareFrameMonocular(pFrame->im,pFrame->timestamp,pFrame->bIniExtractor,pFrame->frame,pFrame->imGray);
+
+    pFrame->bPrepared = true;
+}
+
+void System::UpdateQueuedFrame(QueuedFrame* pFrame)
+{
+    if(mSensor==MONOCULAR || mSensor==IMU_MONOCULAR)
+    {
+        const bool bIniExtractor = mpTracker->UseIniExtractor();
+        if(pFrame->bPrepared && pFrame->bIniExtractor==bIniExtractor)
+            return;
+
+        // No frame was built after this one, so it can take its id again
+        if(pFrame->bPrepared)
+            Frame::nNextId = pFrame->frame.mnId;
+        pFrame->bIniExtractor = bIniExtractor;
+    }
+    else if(pFrame->bPrepared)
+        return;
+
+    PrepareQueuedFrame(pFrame);
+}
+
+Sophus::SE3f System::TrackQueuedFrame(QueuedFrame* pFrame)
+{
+    UpdateQueuedFrame(pFrame);
+
+    for(size_t i_imu = 0; i_imu < pFrame->vImuMeas.size(); i_imu++)
+        mpTracker->GrabImuData(pFrame->vImuMeas[i_imu]);
+
+    Sophus::SE3f Tcw = mpTracker->TrackPreparedFrame(pFrame->frame,pFrame->imGray,pFrame->imRight,pFrame->filename);
+
+    UpdateTrackingState();
+
+    return Tcw;
+}
+
+void System::PreprocessStereo(const cv::Mat &imLeft, const cv::Mat &imRight, cv::Mat &imLeftToFeed, cv::Mat &imRightToFeed)
+{
+    if(settings_ && settings_->needToRectify()){
+        cv::Mat M1l = settings_->M1l();
+        cv::Mat M2l = settings_->M2l();
+        cv::Mat M1r = settings_->M1r();
+        cv::Mat M2r = settings_->M2r();
+
+        cv::remap(imLeft, imLeftToFeed, M1l, M2l, cv::INTER_LINEAR);
+        cv::remap(imRight, imRightToFeed, M1r, M2r, cv::INTER_LINEAR);
+    }
+    else if(settings_ && settings_->needToResize()){
+        cv::resize(imLeft,imLeftToFeed,settings_->newImSize());
+        cv::resize(imRight,imRightToFeed,settings_->newImSize());
+    }
+    else{
+        imLeftToFeed = imLeft.clone();
+        imRightToFeed = imRight.clone();
+    }
+}
+
+void System::PreprocessRGBD(const cv::Mat &im, const cv::Mat &depthmap, cv::Mat &imToFeed, cv::Mat &imDepthToFeed)
+{
     if(settings_ && settings_->needToResize()){
-        cv::Mat resizedIm;
-        cv::resize(im,resizedIm,settings_->newImSize());
-        imToFeed = resizedIm;
+        cv::resize(im,imToFeed,settings_->newImSize());
+        cv::resize(depthmap,imDepthToFeed,settings_->newImSize());
+    }
+    else{
+        imToFeed = im.clone();
+        imDepthToFeed = depthmap.clone();
     }
+}
+
+void System::PreprocessMonocular(const cv::Mat &im, cv::Mat &imToFeed)
+{
+    if(settings_ && settings_->needToResize())
+        cv::resize(im,imToFeed,settings_->newImSize());
+    else
+        imToFeed = im.clone();
+}
+
+bool System::ModeOrResetRequested()
+{
+    {
+        unique_lock<mutex> lock(mMutexMode);
+        if(mbActivateLocalizationMode || mbDeactivateLocalizationMode)
+            return true;
+    }
+
+    unique_lock<mutex> lock(mMutexReset);
+    return mbReset || mbResetActiveMap;
+}
 
+void System::CheckModeAndReset()
+{
     // Check mode change
     {
         unique_lock<mutex> lock(mMutexMode);
@@ -426,10 +535,7 @@ Sophus::SE3f System::TrackMonocular(const cv::Mat &im, const double &timestamp,
             mpLocalMapper->RequestStop();
 
             // Wait until Local Mapping has effectively stopped
-            while(!mpLocalMapper->isStopped())
-            {
-                usleep(1000);
-            }
+            mpLocalMapper->WaitUntilStopped();
 
             mpTracker->InformOnlyTracking(true);
             mbActivateLocalizationMode = false;
@@ -453,24 +559,20 @@ Sophus::SE3f System::TrackMonocular(const cv::Mat &im, const double &timestamp,
         }
         else if(mbResetActiveMap)
         {
-            cout << "SYSTEM-> Reseting active map in monocular case" << endl;
+            if(mSensor==MONOCULAR || mSensor==IMU_MONOCULAR)
+                cout << "SYSTEM-> Reseting active map in monocular case" << endl;
             mpTracker->ResetActiveMap();
             mbResetActiveMap = false;
         }
     }
+}
 
-    if (mSensor == System::IMU_MONOCULAR)
-        for(size_t i_imu = 0; i_imu < vImuMeas.size(); i_imu++)
-            mpTracker->GrabImuData(vImuMeas[i_imu]);
-
-    Sophus::SE3f Tcw = mpTracker->GrabImageMonocular(imToFeed,timestamp,filename);
-
-    unique_lock<mutex> lock2(mMutexState);
+void System::UpdateTrackingState()
+{
+    unique_lock<mutex> lock(mMutexState);
     mTrackingState = mpTracker->mState;
     mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
     mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
-
-    return Tcw;
 }
 
 
@@ -514,6 +616,13 @@ void System::ResetActiveMap()
 
 void System::Shutdown()
 {
+    // Track the frames still queued
+    if(mpFramePipeline)
+    {
+        delete mpFramePipeline;
+        mpFramePipeline = static_cast<FramePipeline*>(NULL);
+    }
+
     {
         unique_lock<mutex> lock(mMutexReset);
         mbShutDown = true;
@@ -545,6 +654,11 @@ void System::Shutdown()
         /*usleep(5000);
     }*/
 
+    {
+        unique_lock<mutex> lock(mpTracker->mTrajectory.mMutexTrajectory);
+        mpTracker->mTrajectory.CloseStream();
+    }
+
     if(!mStrSaveAtlasToFile.empty())
     {
         Verbose::PrintMess("Atlas saving to file " + mStrSaveAtlasToFile, Verbose::VERBOSITY_NORMAL);
@@ -590,18 +704,17 @@ void System::SaveTrajectoryTUM(const string &filename)
     // We need to get first the keyframe pose and then concatenate the relative transformation.
     // Frames not localized (tracking failure) are not saved.
 
-    // For each frame we have a reference keyframe (lRit), the timestamp (lT) and a flag
-    // which is true when tracking failed (lbL).
-    list<ORB_SLAM3::KeyFrame*>::iterator lRit = mpTracker->mlpReferences.begin();
-    list<double>::iterator lT = mpTracker->mlFrameTimes.begin();
-    list<bool>::iterator lbL = mpTracker->mlbLost.begin();
-    for(list<Sophus::SE3f>::iterator lit=mpTracker->mlRelativeFramePoses.begin(),
-        lend=mpTracker->mlRelativeFramePoses.end();lit!=lend;lit++, lRit++, lT++, lbL++)
+    // For each frame we have a reference keyframe, the timestamp and a flag
+    // which is true when tracking failed.
+    FrameTrajectory &trajectory = mpTracker->mTrajectory;
+    unique_lock<mutex> lockTrajectory(trajectory.mMutexTrajectory);
+    for(size_t i=trajectory.Begin(); i<trajectory.size(); i++)
     {
-        if(*lbL)
+        const FramePose &pose = trajectory[i];
+        if(pose.bLost)
             continue;
 
-        KeyFrame* pKF = *lRit;
+        KeyFrame* pKF = pose.pReferenceKF;
 
         Sophus::SE3f Trw;
 
@@ -614,13 +727,13 @@ void System::SaveTrajectoryTUM(const string &filename)
 
         Trw = Trw * pKF->GetPose() * Two;
 
-        Sophus::SE3f Tcw = (*lit) * Trw;
+        Sophus::SE3f Tcw = pose.Tcr * Trw;
         Sophus::SE3f Twc = Tcw.inverse();
 
         Eigen::Vector3f twc = Twc.translation();
         Eigen::Quaternionf q = Twc.unit_quaternion();
 
-        f << setprecision(6) << *lT << " " <<  setprecision(9) << twc(0) << " " << twc(1) << " " << twc(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
+        f << setprecision(6) << pose.timestamp << " " <<  setprecision(9) << twc(0) << " " << twc(1) << " " << twc(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
     }
     f.close();
     // cout << endl << "trajectory saved!" << endl;
@@ -703,11 +816,10 @@ void System::SaveTrajectoryEuRoC(const string &filename)
     // We need to get first the keyframe pose and then concatenate the relative transformation.
     // Frames not localized (tracking failure) are not saved.
 
-    // For each frame we have a reference keyframe (lRit), the timestamp (lT) and a flag
-    // which is true when tracking failed (lbL).
-    list<ORB_SLAM3::KeyFrame*>::iterator lRit = mpTracker->mlpReferences.begin();
-    list<double>::iterator lT = mpTracker->mlFrameTimes.begin();
-    list<bool>::iterator lbL = mpTracker->mlbLost.begin();
+    // For each frame we have a reference keyframe, the timestamp and a flag
+    // which is true when tracking failed.
+    FrameTrajectory &trajectory = mpTracker->mTrajectory;
+    unique_lock<mutex> lockTrajectory(trajectory.mMutexTrajectory);
 
     //cout << "size mlpReferences: " << mpTracker->mlpReferences.size() << endl;
     //cout << "size mlRelativeFramePoses: " << mpTracker->mlRelativeFramePoses.size() << endl;
@@ -715,15 +827,15 @@ void System::SaveTrajectoryEuRoC(const string &filename)
     //cout << "size mpTracker->mlbLost: " << mpTracker->mlbLost.size() << endl;
 
 
-    for(auto lit=mpTracker->mlRelativeFramePoses.begin(),
-        lend=mpTracker->mlRelativeFramePoses.end();lit!=lend;lit++, lRit++, lT++, lbL++)
+    for(size_t i=trajectory.Begin(); i<trajectory.size(); i++)
     {
+        const FramePose &pose = trajectory[i];
         //cout << "1" << endl;
-        if(*lbL)
+        if(pose.bLost)
             continue;
 
 
-        KeyFrame* pKF = *lRit;
+        KeyFrame* pKF = pose.pReferenceKF;
         //cout << "KF: " << pKF->mnId << endl;
 
         Sophus::SE3f Trw;
@@ -756,17 +868,17 @@ void System::SaveTrajectoryEuRoC(const string &filename)
 
         if (mSensor == IMU_MONOCULAR || mSensor == IMU_STEREO || mSensor==IMU_RGBD)
         {
-            Sophus::SE3f Twb = (pKF->mImuCalib.mTbc * (*lit) * Trw).inverse();
+            Sophus::SE3f Twb = (pKF->mImuCalib.mTbc * pose.Tcr * Trw).inverse();
             Eigen::Quaternionf q = Twb.unit_quaternion();
             Eigen::Vector3f twb = Twb.translation();
-            f << setprecision(6) << 1e9*(*lT) << " " <<  setprecision(9) << twb(0) << " " << twb(1) << " " << twb(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
+            f << setprecision(6) << 1e9*pose.timestamp << " " <<  setprecision(9) << twb(0) << " " << twb(1) << " " << twb(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
         }
         else
         {
-            Sophus::SE3f Twc = ((*lit)*Trw).inverse();
+            Sophus::SE3f Twc = (pose.Tcr*Trw).inverse();
             Eigen::Quaternionf q = Twc.unit_quaternion();
             Eigen::Vector3f twc = Twc.translation();
-            f << setprecision(6) << 1e9*(*lT) << " " <<  setprecision(9) << twc(0) << " " << twc(1) << " " << twc(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
+            f << setprecision(6) << 1e9*pose.timestamp << " " <<  setprecision(9) << twc(0) << " " << twc(1) << " " << twc(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
         }
 
         // cout << "5" << endl;
@@ -808,11 +920,10 @@ void System::SaveTrajectoryEuRoC(const string &filename, Map* pMap)
     // We need to get first the keyframe pose and then concatenate the relative transformation.
     // Frames not localized (tracking failure) are not saved.
 
-    // For each frame we have a reference keyframe (lRit), the timestamp (lT) and a flag
-    // which is true when tracking failed (lbL).
-    list<ORB_SLAM3::KeyFrame*>::iterator lRit = mpTracker->mlpReferences.begin();
-    list<double>::iterator lT = mpTracker->mlFrameTimes.begin();
-    list<bool>::iterator lbL = mpTracker->mlbLost.begin();
+    // For each frame we have a reference keyframe, the timestamp and a flag
+    // which is true when tracking failed.
+    FrameTrajectory &trajectory = mpTracker->mTrajectory;
+    unique_lock<mutex> lockTrajectory(trajectory.mMutexTrajectory);
 
     //cout << "size mlpReferences: " << mpTracker->mlpReferences.size() << endl;
     //cout << "size mlRelativeFramePoses: " << mpTracker->mlRelativeFramePoses.size() << endl;
@@ -820,15 +931,15 @@ void System::SaveTrajectoryEuRoC(const string &filename, Map* pMap)
     //cout << "size mpTracker->mlbLost: " << mpTracker->mlbLost.size() << endl;
 
 
-    for(auto lit=mpTracker->mlRelativeFramePoses.begin(),
-        lend=mpTracker->mlRelativeFramePoses.end();lit!=lend;lit++, lRit++, lT++, lbL++)
+    for(size_t i=trajectory.Begin(); i<trajectory.size(); i++)
     {
+        const FramePose &pose = trajectory[i];
         //cout << "1" << endl;
-        if(*lbL)
+        if(pose.bLost)
             continue;
 
 
-        KeyFrame* pKF = *lRit;
+        KeyFrame* pKF = pose.pReferenceKF;
         //cout << "KF: " << pKF->mnId << endl;
 
         Sophus::SE3f Trw;
@@ -861,17 +972,17 @@ void System::SaveTrajectoryEuRoC(const string &filename, Map* pMap)
 
         if (mSensor == IMU_MONOCULAR || mSensor == IMU_STEREO || mSensor==IMU_RGBD)
         {
-            Sophus::SE3f Twb = (pKF->mImuCalib.mTbc * (*lit) * Trw).inverse();
+            Sophus::SE3f Twb = (pKF->mImuCalib.mTbc * pose.Tcr * Trw).inverse();
             Eigen::Quaternionf q = Twb.unit_quaternion();
             Eigen::Vector3f twb = Twb.translation();
-            f << setprecision(6) << 1e9*(*lT) << " " <<  setprecision(9) << twb(0) << " " << twb(1) << " " << twb(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
+            f << setprecision(6) << 1e9*pose.timestamp << " " <<  setprecision(9) << twb(0) << " " << twb(1) << " " << twb(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
         }
         else
         {
-            Sophus::SE3f Twc = ((*lit)*Trw).inverse();
+            Sophus::SE3f Twc = (pose.Tcr*Trw).inverse();
             Eigen::Quaternionf q = Twc.unit_quaternion();
             Eigen::Vector3f twc = Twc.translation();
-            f << setprecision(6) << 1e9*(*lT) << " " <<  setprecision(9) << twc(0) << " " << twc(1) << " " << twc(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
+            f << setprecision(6) << 1e9*pose.timestamp << " " <<  setprecision(9) << twc(0) << " " << twc(1) << " " << twc(2) << " " << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << endl;
         }
 
         // cout << "5" << endl;
@@ -1227,14 +1338,14 @@ void System::SaveTrajectoryKITTI(const string &filename)
     // We need to get first the keyframe pose and then concatenate the relative transformation.
     // Frames not localized (tracking failure) are not saved.
 
-    // For each frame we have a reference keyframe (lRit), the timestamp (lT) and a flag
-    // which is true when tracking failed (lbL).
-    list<ORB_SLAM3::KeyFrame*>::iterator lRit = mpTracker->mlpReferences.begin();
-    list<double>::iterator lT = mpTracker->mlFrameTimes.begin();
-    for(list<Sophus::SE3f>::iterator lit=mpTracker->mlRelativeFramePoses.begin(),
-        lend=mpTracker->mlRelativeFramePoses.end();lit!=lend;lit++, lRit++, lT++)
+    // For each frame we have a reference keyframe, the timestamp and a flag
+    // which is true when tracking failed.
+    FrameTrajectory &trajectory = mpTracker->mTrajectory;
+    unique_lock<mutex> lockTrajectory(trajectory.mMutexTrajectory);
+    for(size_t i=trajectory.Begin(); i<trajectory.size(); i++)
     {
-        ORB_SLAM3::KeyFrame* pKF = *lRit;
+        const FramePose &pose = trajectory[i];
+        ORB_SLAM3::KeyFrame* pKF = pose.pReferenceKF;
 
         Sophus::SE3f Trw;
 
@@ -1249,7 +1360,7 @@ void System::SaveTrajectoryKITTI(const string &filename)
 
         Trw = Trw * pKF->GetPose() * Tow;
 
-        Sophus::SE3f Tcw = (*lit) * Trw;
+        Sophus::SE3f Tcw = pose.Tcr * Trw;
         Sophus::SE3f Twc = Tcw.inverse();
         Eigen::Matrix3f Rwc = Twc.rotationMatrix();
         Eigen::Vector3f twc = Twc.translation();
@@ -1366,6 +1477,8 @@ bool System::isFinished()
 
 void System::ChangeDataset()
 {
+    WaitForQueuedFrames();
+
     if(mpAtlas->GetCurrentMap()->KeyFramesInMap() < 12)
     {
         mpTracker->ResetActiveMap();
@@ -1412,7 +1525,7 @@ void System::SaveAtlas(int type){
         pathSaveFileName = pathSaveFileName.append(mStrSaveAtlasToFile);
         pathSaveFileName = pathSaveFileName.append(".osa");
 
-        string strVocabularyChecksum = CalculateCheckSum(mStrVocabularyFilePath,TEXT_FILE);
+        string strVocabularyChecksum = GetVocabularyChecksum();
         std::size_t found = mStrVocabularyFilePath.find_last_of("/\\");
         string strVocabularyName = mStrVocabularyFilePath.substr(found+1);
 
@@ -1431,13 +1544,8 @@ void System::SaveAtlas(int type){
         else if(type == BINARY_FILE) // File binary
         {
             cout << "Starting to write the save binary file" << endl;
-            std::remove(pathSaveFileName.c_str());
-            std::ofstream ofs(pathSaveFileName, std::ios::binary);
-            boost::archive::binary_oarchive oa(ofs);
-            oa << strVocabularyName;
-            oa << strVocabularyChecksum;
-            oa << mpAtlas;
-            cout << "End to write save binary file" << endl;
+            if(AtlasFile::Save(pathSaveFileName, mpAtlas, strVocabularyName, strVocabularyChecksum, mpThreadPool))
+                cout << "End to write save binary file" << endl;
         }
     }
 }
@@ -1476,10 +1584,22 @@ bool System::LoadAtlas(int type)
             cout << "Load file not found" << endl;
             return false;
         }
-        boost::archive::binary_iarchive ia(ifs);
-        ia >> strFileVoc;
-        ia >> strVocChecksum;
-        ia >> mpAtlas;
+
+        if(AtlasFile::IsAtlasFile(pathLoadFileName))
+        {
+            ifs.close();
+            mpAtlas = new Atlas();
+            if(!AtlasFile::Load(pathLoadFileName, mpAtlas, strFileVoc, strVocChecksum, mpThreadPool))
+                return false;
+        }
+        else
+        {
+            // Sessions saved before the atlas file format are boost archives
+            boost::archive::binary_iarchive ia(ifs);
+            ia >> strFileVoc;
+            ia >> strVocChecksum;
+            ia >> mpAtlas;
+        }
         cout << "End to load the save binary file" << endl;
         isRead = true;
     }
@@ -1487,7 +1607,7 @@ bool System::LoadAtlas(int type)
     if(isRead)
     {
         //Check if the vocabulary is the same
-        string strInputVocabularyChecksum = CalculateCheckSum(mStrVocabularyFilePath,TEXT_FILE);
+        string strInputVocabularyChecksum = GetVocabularyChecksum();
 
         if(strInputVocabularyChecksum.compare(strVocChecksum) != 0)
         {
@@ -1505,6 +1625,27 @@ bool System::LoadAtlas(int type)
     return false;
 }
 
+bool System::LoadVocabulary(const string &strVocFile)
+{
+    // Binary vocabularies (see tools/bin_vocabulary) are mapped in place, text ones are parsed
+    const string strExt = ".bin";
+    if(strVocFile.size() > strExt.size() &&
+       strVocFile.compare(strVocFile.size()-strExt.size(), strExt.size(), strExt) == 0)
+        return mpVocabulary->loadFromBinaryFile(strVocFile);
+
+    return mpVocabulary->loadFromTextFile(strVocFile);
+}
+
+string System::GetVocabularyChecksum()
+{
+    // A converted vocabulary stores the checksum of its text file, so saved atlases stay compatible
+    const string strChecksum = mpVocabulary->getBinaryChecksum();
+    if(!strChecksum.empty())
+        return strChecksum;
+
+    return CalculateCheckSum(mStrVocabularyFilePath,TEXT_FILE);
+}
+
 string System::CalculateCheckSum(string filename, int type)
 {
     string checksum = "";
@@ -0,0 +1,151 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+namespace
+{
+
+// Shared state of one ParallelFor call. Indices are claimed dynamically, so
+// threads that finish early keep taking work from the slower ones.
+struct ParallelJob
+{
+    ParallelJob(int n, const function<void(int)> &f): n(n), f(f), next(0), remaining(n) {}
+
+    void Run()
+    {
+        while(true)
+        {
+            const int i = next++;
+            if(i>=n)
+                break;
+
+            f(i);
+
+            if(--remaining==0)
+            {
+                unique_lock<mutex> lock(mMutex);
+                cv.notify_all();
+            }
+        }
+    }
+
+    void Wait()
+    {
+        unique_lock<mutex> lock(mMutex);
+        cv.wait(lock, [this]{return remaining==0;});
+    }
+
+    const int n;
+    const function<void(int)> &f;
+    atomic<int> next;
+    atomic<int> remaining;
+    mutex mMutex;
+    condition_variable cv;
+};
+
+} // namespace
+
+ThreadPool::ThreadPool(int nThreads): mbFinish(false)
+{
+    for(int i=0; i<nThreads; i++)
+        mvWorkers.push_back(thread(&ThreadPool::Run, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        unique_lock<mutex> lock(mMutexTasks);
+        mbFinish = true;
+    }
+    mcvTasks.notify_all();
+
+    for(size_t i=0; i<mvWorkers.size(); i++)
+        mvWorkers[i].join();
+}
+
+void ThreadPool::Run()
+{
+    while(true)
+    {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(mMutexTasks);
+            mcvTasks.wait(lock, [this]{return mbFinish || !mlTasks.empty();});
+
+            if(mlTasks.empty())
+                return;
+
+            task = std::move(mlTasks.front());
+            mlTasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+void ThreadPool::ParallelFor(int n, const function<void(int)> &f)
+{
+    if(n<=0)
+        return;
+
+    if(n==1 || mvWorkers.empty())
+    {
+        for(int i=0; i<n; i++)
+            f(i);
+        return;
+    }
+
+    shared_ptr<ParallelJob> pJob = make_shared<ParallelJob>(n, f);
+
+    // Helpers that start after all indices are claimed return without touching f
+    const int nHelpers = min(n-1, (int)mvWorkers.size());
+    {
+        unique_lock<mutex> lock(mMutexTasks);
+        for(int i=0; i<nHelpers; i++)
+            mlTasks.push_back([pJob]{pJob->Run();});
+    }
+    if(nHelpers==1)
+        mcvTasks.notify_one();
+    else
+        mcvTasks.notify_all();
+
+    pJob->Run();
+    pJob->Wait();
+}
+
+void ThreadPool::ParallelFor(ThreadPool* pPool, int n, const function<void(int)> &f)
+{
+    if(pPool)
+        pPool->ParallelFor(n, f);
+    else
+        for(int i=0; i<n; i++)
+            f(i);
+}
+
+} //namespace ORB_SLAM
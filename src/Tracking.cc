@@ -32,6 +32,7 @@
 #include <iostream>
 
 #include <mutex>
+#include <atomic>
 #include <chrono>
 
 
@@ -41,12 +42,13 @@ namespace ORB_SLAM3
 {
 
 
-Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer, MapDrawer *pMapDrawer, Atlas *pAtlas, KeyFrameDatabase* pKFDB, const string &strSettingPath, const int sensor, Settings* settings, const string &_nameSeq):
+Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer, MapDrawer *pMapDrawer, Atlas *pAtlas, KeyFrameDatabase* pKFDB, const string &strSettingPath, const int sensor, Settings* settings, ThreadPool* pThreadPool, const string &_nameSeq):
     mState(NO_IMAGES_YET), mSensor(sensor), mTrackedFr(0), mbStep(false),
     mbOnlyTracking(false), mbMapUpdated(false), mbVO(false), mpORBVocabulary(pVoc), mpKeyFrameDB(pKFDB),
     mbReadyToInitializate(false), mpSystem(pSys), mpViewer(NULL), bStepByStep(false),
     mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer), mpAtlas(pAtlas), mnLastRelocFrameId(0), time_recently_lost(5.0),
-    mnInitialFrameId(0), mbCreatedMap(false), mnFirstFrameId(0), mpCamera2(nullptr), mpLastKeyFrame(static_cast<KeyFrame*>(NULL))
+    mnInitialFrameId(0), mbCreatedMap(false), mnFirstFrameId(0), mpCamera2(nullptr), mpLastKeyFrame(static_cast<KeyFrame*>(NULL)),
+    mpThreadPool(pThreadPool)
 {
     // Load camera parameters from settings file
     if(settings){
@@ -530,6 +532,9 @@ Tracking::~Tracking()
 {
     //f_track_stats.close();
 
+    for(size_t i=0; i<mvpRelocSolvers.size(); i++)
+        delete mvpRelocSolvers[i];
+
 }
 
 void Tracking::newParameterLoader(Settings *settings) {
@@ -600,6 +605,8 @@ void Tracking::newParameterLoader(Settings *settings) {
     if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
         mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
 
+    SetExtractorThreadPool(settings->nExtractorThreads());
+
     //IMU parameters
     Sophus::SE3f Tbc = settings->Tbc();
     mInsertKFsLost = settings->insertKFsWhenLost();
@@ -1288,16 +1295,39 @@ bool Tracking::ParseORBParamFile(cv::FileStorage &fSettings)
     if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
         mpIniORBextractor = new ORBextractor(5*nFeatures,fScaleFactor,nLevels,fIniThFAST,fMinThFAST);
 
+    int nExtractorThreads = 1;
+    node = fSettings["ORBextractor.nThreads"];
+    if(!node.empty() && node.isInt())
+        nExtractorThreads = node.operator int();
+
+    SetExtractorThreadPool(nExtractorThreads);
+
     cout << endl << "ORB Extractor Parameters: " << endl;
     cout << "- Number of Features: " << nFeatures << endl;
     cout << "- Scale Levels: " << nLevels << endl;
     cout << "- Scale Factor: " << fScaleFactor << endl;
     cout << "- Initial Fast Threshold: " << fIniThFAST << endl;
     cout << "- Minimum Fast Threshold: " << fMinThFAST << endl;
+    cout << "- Extraction Threads: " << nExtractorThreads << endl;
 
     return true;
 }
 
+void Tracking::SetExtractorThreadPool(const int nThreads)
+{
+    // Intra-frame parallel extraction runs on the pool owned by System
+    if(nThreads<=1 || !mpThreadPool)
+        return;
+
+    mpORBextractorLeft->SetThreadPool(mpThreadPool);
+
+    if(mSensor==System::STEREO || mSensor==System::IMU_STEREO)
+        mpORBextractorRight->SetThreadPool(mpThreadPool);
+
+    if(mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR)
+        mpIniORBextractor->SetThreadPool(mpThreadPool);
+}
+
 bool Tracking::ParseIMUParamFile(cv::FileStorage &fSettings)
 {
     bool b_miss_params = false;
@@ -1451,164 +1481,137 @@ bool Tracking::GetStepByStep()
 
 
 
-Sophus::SE3f Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp, string filename)
+void Tracking::ConvertToGray(cv::Mat &im)
 {
-    //cout << "GrabImageStereo" << endl;
-
-    mImGray = imRectLeft;
-    cv::Mat imGrayRight = imRectRight;
-    mImRight = imRectRight;
-
-    if(mImGray.channels()==3)
+    if(im.channels()==3)
     {
-        //cout << "Image with 3 channels" << endl;
         if(mbRGB)
-        {
-            cvtColor(mImGray,mImGray,cv::COLOR_RGB2GRAY);
-            cvtColor(imGrayRight,imGrayRight,cv::COLOR_RGB2GRAY);
-        }
+            cvtColor(im,im,cv::COLOR_RGB2GRAY);
         else
-        {
-            cvtColor(mImGray,mImGray,cv::COLOR_BGR2GRAY);
-            cvtColor(imGrayRight,imGrayRight,cv::COLOR_BGR2GRAY);
-        }
+            cvtColor(im,im,cv::COLOR_BGR2GRAY);
     }
-    else if(mImGray.channels()==4)
+    else if(im.channels()==4)
     {
-        //cout << "Image with 4 channels" << endl;
         if(mbRGB)
-        {
-            cvtColor(mImGray,mImGray,cv::COLOR_RGBA2GRAY);
-            cvtColor(imGrayRight,imGrayRight,cv::COLOR_RGBA2GRAY);
-        }
+            cvtColor(im,im,cv::COLOR_RGBA2GRAY);
         else
-        {
-            cvtColor(mImGray,mImGray,cv::COLOR_BGRA2GRAY);
-            cvtColor(imGrayRight,imGrayRight,cv::COLOR_BGRA2GRAY);
-        }
+            cvtColor(im,im,cv::COLOR_BGRA2GRAY);
     }
+}
 
-    //cout << "Incoming frame creation" << endl;
+Sophus::SE3f Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp, string filename)
+{
+    PrepareFrameStereo(imRectLeft,imRectRight,timestamp,mCurrentFrame,mImGray);
+    mImRight = imRectRight;
 
-    if (mSensor == System::STEREO && !mpCamera2)
-        mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera);
-    else if(mSensor == System::STEREO && mpCamera2)
-        mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,mpCamera2,mTlr);
-    else if(mSensor == System::IMU_STEREO && !mpCamera2)
-        mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,&mLastFrame,*mpImuCalib);
-    else if(mSensor == System::IMU_STEREO && mpCamera2)
-        mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,mpCamera2,mTlr,&mLastFrame,*mpImuCalib);
+    return TrackCurrentFrame(filename);
+}
 
-    //cout << "Incoming frame ended" << endl;
 
-    mCurrentFrame.mNameFile = filename;
-    mCurrentFrame.mnDataset = mnNumDataset;
+Sophus::SE3f Tracking::GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, string filename)
+{
+    PrepareFrameRGBD(imRGB,imD,timestamp,mCurrentFrame,mImGray);
 
-#ifdef REGISTER_TIMES
-    vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
-    vdStereoMatch_ms.push_back(mCurrentFrame.mTimeStereoMatch);
-#endif
+    return TrackCurrentFrame(filename);
+}
 
-    //cout << "Tracking start" << endl;
-    Track();
-    //cout << "Tracking end" << endl;
 
-    return mCurrentFrame.GetPose();
+Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp, string filename)
+{
+    PrepareFrameMonocular(im,timestamp,UseIniExtractor(),mCurrentFrame,mImGray);
+
+    return TrackCurrentFrame(filename);
 }
 
+void Tracking::PrepareFrameStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp, Frame &frame, cv::Mat &imGray)
+{
+    imGray = imRectLeft;
+    cv::Mat imGrayRight = imRectRight;
+    ConvertToGray(imGray);
+    ConvertToGray(imGrayRight);
 
-Sophus::SE3f Tracking::GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, string filename)
+    if (mSensor == System::STEREO && !mpCamera2)
+        frame = Frame(imGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,static_cast<Frame*>(NULL),IMU::Calib(),mpThreadPool);
+    else if(mSensor == System::STEREO && mpCamera2)
+        frame = Frame(imGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,mpCamera2,mTlr,static_cast<Frame*>(NULL),IMU::Calib(),mpThreadPool);
+    else if(mSensor == System::IMU_STEREO && !mpCamera2)
+        frame = Frame(imGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,static_cast<Frame*>(NULL),*mpImuCalib,mpThreadPool);
+    else if(mSensor == System::IMU_STEREO && mpCamera2)
+        frame = Frame(imGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,mpCamera2,mTlr,static_cast<Frame*>(NULL),*mpImuCalib,mpThreadPool);
+}
+
+void Tracking::PrepareFrameRGBD(const cv::Mat &imRGB, const cv::Mat &imD, const double &timestamp, Frame &frame, cv::Mat &imGray)
 {
-    mImGray = imRGB;
+    imGray = imRGB;
     cv::Mat imDepth = imD;
-
-    if(mImGray.channels()==3)
-    {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,cv::COLOR_RGB2GRAY);
-        else
-            cvtColor(mImGray,mImGray,cv::COLOR_BGR2GRAY);
-    }
-    else if(mImGray.channels()==4)
-    {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,cv::COLOR_RGBA2GRAY);
-        else
-            cvtColor(mImGray,mImGray,cv::COLOR_BGRA2GRAY);
-    }
+    ConvertToGray(imGray);
 
     if((fabs(mDepthMapFactor-1.0f)>1e-5) || imDepth.type()!=CV_32F)
         imDepth.convertTo(imDepth,CV_32F,mDepthMapFactor);
 
     if (mSensor == System::RGBD)
-        mCurrentFrame = Frame(mImGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera);
+        frame = Frame(imGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera);
     else if(mSensor == System::IMU_RGBD)
-        mCurrentFrame = Frame(mImGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,&mLastFrame,*mpImuCalib);
-
-
-
+        frame = Frame(imGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,mpCamera,static_cast<Frame*>(NULL),*mpImuCalib);
+}
 
+void Tracking::PrepareFrameMonocular(const cv::Mat &im, const double &timestamp, bool bIniExtractor, Frame &frame, cv::Mat &imGray)
+{
+    imGray = im;
+    ConvertToGray(imGray);
 
+    ORBextractor* pExtractor = bIniExtractor ? mpIniORBextractor : mpORBextractorLeft;
 
-    mCurrentFrame.mNameFile = filename;
-    mCurrentFrame.mnDataset = mnNumDataset;
+    if (mSensor == System::MONOCULAR)
+        frame = Frame(imGray,timestamp,pExtractor,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth);
+    else if(mSensor == System::IMU_MONOCULAR)
+        frame = Frame(imGray,timestamp,pExtractor,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth,static_cast<Frame*>(NULL),*mpImuCalib);
+}
 
-#ifdef REGISTER_TIMES
-    vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
-#endif
+bool Tracking::UseIniExtractor()
+{
+    if (mSensor == System::MONOCULAR)
+        return mState==NOT_INITIALIZED || mState==NO_IMAGES_YET || (lastID - initID) < mMaxFrames;
+    else if(mSensor == System::IMU_MONOCULAR)
+        return mState==NOT_INITIALIZED || mState==NO_IMAGES_YET;
+    return false;
+}
 
-    Track();
+Sophus::SE3f Tracking::TrackPreparedFrame(const Frame &frame, const cv::Mat &imGray, const cv::Mat &imRight, string filename)
+{
+    mCurrentFrame = frame;
+    mImGray = imGray;
+    mImRight = imRight;
 
-    return mCurrentFrame.GetPose();
+    return TrackCurrentFrame(filename);
 }
 
-
-Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp, string filename)
+Sophus::SE3f Tracking::TrackCurrentFrame(const string &filename)
 {
-    mImGray = im;
-    if(mImGray.channels()==3)
-    {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,cv::COLOR_RGB2GRAY);
-        else
-            cvtColor(mImGray,mImGray,cv::COLOR_BGR2GRAY);
-    }
-    else if(mImGray.channels()==4)
-    {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,cv::COLOR_RGBA2GRAY);
-        else
-            cvtColor(mImGray,mImGray,cv::COLOR_BGRA2GRAY);
-    }
-
-    if (mSensor == System::MONOCULAR)
+    // Link to the last frame, as the inertial Frame constructors do. The stereo fisheye one does not
+    // take the velocity.
+    if(mSensor == System::IMU_MONOCULAR || mSensor == System::IMU_STEREO || mSensor == System::IMU_RGBD)
     {
-        if(mState==NOT_INITIALIZED || mState==NO_IMAGES_YET ||(lastID - initID) < mMaxFrames)
-            mCurrentFrame = Frame(mImGray,timestamp,mpIniORBextractor,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth);
-        else
-            mCurrentFrame = Frame(mImGray,timestamp,mpORBextractorLeft,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth);
-    }
-    else if(mSensor == System::IMU_MONOCULAR)
-    {
-        if(mState==NOT_INITIALIZED || mState==NO_IMAGES_YET)
-        {
-            mCurrentFrame = Frame(mImGray,timestamp,mpIniORBextractor,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth,&mLastFrame,*mpImuCalib);
-        }
-        else
-            mCurrentFrame = Frame(mImGray,timestamp,mpORBextractorLeft,mpORBVocabulary,mpCamera,mDistCoef,mbf,mThDepth,&mLastFrame,*mpImuCalib);
+        mCurrentFrame.mpPrevFrame = &mLastFrame;
+        if(mLastFrame.HasVelocity() && !(mSensor == System::IMU_STEREO && mpCamera2))
+            mCurrentFrame.SetVelocity(mLastFrame.GetVelocity());
     }
 
-    if (mState==NO_IMAGES_YET)
-        t0=timestamp;
+    const bool bMonocular = mSensor == System::MONOCULAR || mSensor == System::IMU_MONOCULAR;
+    if (bMonocular && mState==NO_IMAGES_YET)
+        t0=mCurrentFrame.mTimeStamp;
 
     mCurrentFrame.mNameFile = filename;
     mCurrentFrame.mnDataset = mnNumDataset;
 
 #ifdef REGISTER_TIMES
     vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
+    if(mSensor == System::STEREO || mSensor == System::IMU_STEREO)
+        vdStereoMatch_ms.push_back(mCurrentFrame.mTimeStereoMatch);
 #endif
 
-    lastID = mCurrentFrame.mnId;
+    if(bMonocular)
+        lastID = mCurrentFrame.mnId;
     Track();
 
     return mCurrentFrame.GetPose();
@@ -1674,7 +1677,7 @@ void Tracking::PreintegrateIMU()
             usleep(500);
     }
 
-    const int n = mvImuFromLastFrame.size()-1;
+    const int n = (int)mvImuFromLastFrame.size()-1;
     if(n==0){
         cout << "Empty IMU measurements vector!!!\n";
         return;
@@ -1682,6 +1685,11 @@ void Tracking::PreintegrateIMU()
 
     IMU::Preintegrated* pImuPreintegratedFromLastFrame = new IMU::Preintegrated(mLastFrame.mImuBias,mCurrentFrame.mImuCalib);
 
+    // Steps between the two frames, integrated in one batch into both preintegrations.
+    // n is -1 if every queued measurement was older than the last frame, then none is integrated.
+    std::vector<IMU::Preintegrated::integrable> vSteps;
+    vSteps.reserve(std::max(n,0));
+
     for(int i=0; i<n; i++)
     {
         float tstep;
@@ -1719,12 +1727,14 @@ void Tracking::PreintegrateIMU()
             tstep = mCurrentFrame.mTimeStamp-mCurrentFrame.mpPrevFrame->mTimeStamp;
         }
 
-        if (!mpImuPreintegratedFromLastKF)
-            cout << "mpImuPreintegratedFromLastKF does not exist" << endl;
-        mpImuPreintegratedFromLastKF->IntegrateNewMeasurement(acc,angVel,tstep);
-        pImuPreintegratedFromLastFrame->IntegrateNewMeasurement(acc,angVel,tstep);
+        vSteps.push_back(IMU::Preintegrated::integrable(acc,angVel,tstep));
     }
 
+    if (!mpImuPreintegratedFromLastKF)
+        cout << "mpImuPreintegratedFromLastKF does not exist" << endl;
+    mpImuPreintegratedFromLastKF->IntegrateNewMeasurements(vSteps.data(),vSteps.size());
+    pImuPreintegratedFromLastFrame->IntegrateNewMeasurements(vSteps.data(),vSteps.size());
+
     mCurrentFrame.mpImuPreintegratedFrame = pImuPreintegratedFromLastFrame;
     mCurrentFrame.mpImuPreintegrated = mpImuPreintegratedFromLastKF;
     mCurrentFrame.mpLastKeyFrame = mpLastKeyFrame;
@@ -2300,22 +2310,19 @@ void Tracking::Track()
     if(mState==OK || mState==RECENTLY_LOST)
     {
         // Store frame pose information to retrieve the complete camera trajectory afterwards.
+        unique_lock<mutex> lock(mTrajectory.mMutexTrajectory);
         if(mCurrentFrame.isSet())
         {
             Sophus::SE3f Tcr_ = mCurrentFrame.GetPose() * mCurrentFrame.mpReferenceKF->GetPoseInverse();
-            mlRelativeFramePoses.push_back(Tcr_);
-            mlpReferences.push_back(mCurrentFrame.mpReferenceKF);
-            mlFrameTimes.push_back(mCurrentFrame.mTimeStamp);
-            mlbLost.push_back(mState==LOST);
+            mTrajectory.PushBack(Tcr_, mCurrentFrame.mpReferenceKF, mCurrentFrame.mTimeStamp, mState==LOST);
         }
         else
         {
             // This can happen if tracking is lost
-            mlRelativeFramePoses.push_back(mlRelativeFramePoses.back());
-            mlpReferences.push_back(mlpReferences.back());
-            mlFrameTimes.push_back(mlFrameTimes.back());
-            mlbLost.push_back(mState==LOST);
+            const FramePose last = mTrajectory.back();
+            mTrajectory.PushBack(last.Tcr, last.pReferenceKF, last.timestamp, mState==LOST);
         }
+        mTrajectory.Stream();
 
     }
 
@@ -2323,10 +2330,7 @@ void Tracking::Track()
     if (Stop()) {
 
         // Safe area to stop
-        while(isStopped())
-        {
-            usleep(3000);
-        }
+        mStopChanged.WaitUntil([&]{return !isStopped();});
     }
 #endif
 }
@@ -2501,7 +2505,7 @@ void Tracking::MonocularInitialization()
         Sophus::SE3f Tcw;
         vector<bool> vbTriangulated; // Triangulated Correspondences (mvIniMatches)
 
-        if(mpCamera->ReconstructWithTwoViews(mInitialFrame.mvKeysUn,mCurrentFrame.mvKeysUn,mvIniMatches,Tcw,mvIniP3D,vbTriangulated))
+        if(mpCamera->ReconstructWithTwoViews(mInitialFrame.mvKeysUn,mCurrentFrame.mvKeysUn,mvIniMatches,Tcw,mvIniP3D,vbTriangulated,mpThreadPool))
         {
             for(size_t i=0, iend=mvIniMatches.size(); i<iend;i++)
             {
@@ -2533,8 +2537,8 @@ void Tracking::CreateInitialMapMonocular()
         pKFini->mpImuPreintegrated = (IMU::Preintegrated*)(NULL);
 
 
-    pKFini->ComputeBoW();
-    pKFcur->ComputeBoW();
+    pKFini->ComputeBoW(mpThreadPool);
+    pKFcur->ComputeBoW(mpThreadPool);
 
     // Insert KFs in the map
     mpAtlas->AddKeyFrame(pKFini);
@@ -2577,7 +2581,7 @@ void Tracking::CreateInitialMapMonocular()
 
     // Bundle Adjustment
     Verbose::PrintMess("New Map created with " + to_string(mpAtlas->MapPointsInMap()) + " points", Verbose::VERBOSITY_QUIET);
-    Optimizer::GlobalBundleAdjustemnt(mpAtlas->GetCurrentMap(),20);
+    Optimizer::GlobalBundleAdjustemnt(mpAtlas->GetCurrentMap(),20,NULL,0,true,mpThreadPool);
 
     float medianDepth = pKFini->ComputeSceneMedianDepth(2);
     float invMedianDepth;
@@ -2720,7 +2724,7 @@ void Tracking::CheckReplacedInLastFrame()
 bool Tracking::TrackReferenceKeyFrame()
 {
     // Compute Bag of Words vector
-    mCurrentFrame.ComputeBoW();
+    mCurrentFrame.ComputeBoW(mpThreadPool);
 
     // We perform first an ORB matching with the reference keyframe
     // If enough matches are found we setup a PnP solver
@@ -2782,7 +2786,11 @@ void Tracking::UpdateLastFrame()
 {
     // Update pose according to reference keyframe
     KeyFrame* pRef = mLastFrame.mpReferenceKF;
-    Sophus::SE3f Tlr = mlRelativeFramePoses.back();
+    Sophus::SE3f Tlr;
+    {
+        unique_lock<mutex> lock(mTrajectory.mMutexTrajectory);
+        Tlr = mTrajectory.back().Tcr;
+    }
     mLastFrame.SetPose(Tlr * pRef->GetPose());
 
     if(mnLastKeyFrameId==mLastFrame.mnId || mSensor==System::MONOCULAR || mSensor==System::IMU_MONOCULAR || !mbOnlyTracking)
@@ -3467,8 +3475,8 @@ void Tracking::UpdateLocalKeyFrames()
             {
                 if(!pMP->isBad())
                 {
-                    const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
-                    for(map<KeyFrame*,tuple<int,int>>::const_iterator it=observations.begin(), itend=observations.end(); it!=itend; it++)
+                    const MapPoint::ObservationsView observations = pMP->GetObservationsView();
+                    for(MapPoint::ObservationList::const_iterator it=observations->begin(), itend=observations->end(); it!=itend; it++)
                         keyframeCounter[it->first]++;
                 }
                 else
@@ -3490,8 +3498,8 @@ void Tracking::UpdateLocalKeyFrames()
                     continue;
                 if(!pMP->isBad())
                 {
-                    const map<KeyFrame*,tuple<int,int>> observations = pMP->GetObservations();
-                    for(map<KeyFrame*,tuple<int,int>>::const_iterator it=observations.begin(), itend=observations.end(); it!=itend; it++)
+                    const MapPoint::ObservationsView observations = pMP->GetObservationsView();
+                    for(MapPoint::ObservationList::const_iterator it=observations->begin(), itend=observations->end(); it!=itend; it++)
                         keyframeCounter[it->first]++;
                 }
                 else
@@ -3581,6 +3589,26 @@ void Tracking::UpdateLocalKeyFrames()
         }
     }
 
+    // Just after a relocalization the few matched points may not reach all the keyframes that see
+    // the area in view, the keyframes around the camera are added as well
+    if(mCurrentFrame.mnId<mnLastRelocFrameId+2 && pKFmax && mvpLocalKeyFrames.size()<80)
+    {
+        const float radius = pKFmax->ComputeSceneMedianDepth(2);
+        if(radius>0)
+        {
+            const vector<KeyFrame*> vpNearKFs = mpAtlas->GetCurrentMap()->GetKeyFramesInRadius(mCurrentFrame.GetCameraCenter(),radius);
+            for(size_t i=0; i<vpNearKFs.size() && mvpLocalKeyFrames.size()<80; i++)
+            {
+                KeyFrame* pNearKF = vpNearKFs[i];
+                if(!pNearKF->isBad() && pNearKF->mnTrackReferenceForFrame!=mCurrentFrame.mnId)
+                {
+                    mvpLocalKeyFrames.push_back(pNearKF);
+                    pNearKF->mnTrackReferenceForFrame=mCurrentFrame.mnId;
+                }
+            }
+        }
+    }
+
     // Add 10 last temporal KFs (mainly for IMU)
     if((mSensor == System::IMU_MONOCULAR || mSensor == System::IMU_STEREO || mSensor == System::IMU_RGBD) &&mvpLocalKeyFrames.size()<80)
     {
@@ -3610,7 +3638,7 @@ bool Tracking::Relocalization()
 {
     Verbose::PrintMess("Starting relocalization", Verbose::VERBOSITY_NORMAL);
     // Compute Bag of Words Vector
-    mCurrentFrame.ComputeBoW();
+    mCurrentFrame.ComputeBoW(mpThreadPool);
 
     // Relocalization is performed when tracking is lost
     // Track Lost: Query KeyFrame Database for keyframe candidates for relocalisation
@@ -3623,146 +3651,159 @@ bool Tracking::Relocalization()
 
     const int nKFs = vpCandidateKFs.size();
 
-    // We perform first an ORB matching with each candidate
-    // If enough matches are found we setup a PnP solver
-    ORBmatcher matcher(0.75,true);
-
-    vector<MLPnPsolver*> vpMLPnPsolvers;
-    vpMLPnPsolvers.resize(nKFs);
+    // Solvers are kept between relocalizations and set up again for each candidate
+    while((int)mvpRelocSolvers.size()<nKFs)
+        mvpRelocSolvers.push_back(new MLPnPsolver());
 
     vector<vector<MapPoint*> > vvpMapPointMatches;
     vvpMapPointMatches.resize(nKFs);
 
-    vector<bool> vbDiscarded;
-    vbDiscarded.resize(nKFs);
-
-    int nCandidates=0;
+    // Written concurrently, so not vector<bool>
+    vector<char> vbDiscarded;
+    vbDiscarded.resize(nKFs,false);
 
-    for(int i=0; i<nKFs; i++)
+    // We perform first an ORB matching with each candidate
+    // If enough matches are found we setup a PnP solver
+    ThreadPool::ParallelFor(mpThreadPool, nKFs, [&](int i)
     {
         KeyFrame* pKF = vpCandidateKFs[i];
         if(pKF->isBad())
+        {
             vbDiscarded[i] = true;
-        else
+            return;
+        }
+
+        ORBmatcher matcher(0.75,true);
+        int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i]);
+        if(nmatches<15)
         {
-            int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i]);
-            if(nmatches<15)
-            {
-                vbDiscarded[i] = true;
-                continue;
-            }
-            else
-            {
-                MLPnPsolver* pSolver = new MLPnPsolver(mCurrentFrame,vvpMapPointMatches[i]);
-                pSolver->SetRansacParameters(0.99,10,300,6,0.5,5.991);  //This solver needs at least 6 points
-                vpMLPnPsolvers[i] = pSolver;
-                nCandidates++;
-            }
+            vbDiscarded[i] = true;
+            return;
         }
-    }
 
-    // Alternatively perform some iterations of P4P RANSAC
-    // Until we found a camera pose supported by enough inliers
-    bool bMatch = false;
-    ORBmatcher matcher2(0.9,true);
+        MLPnPsolver* pSolver = mvpRelocSolvers[i];
+        pSolver->Init(mCurrentFrame,vvpMapPointMatches[i],pKF->mnId);
+        pSolver->SetRansacParameters(0.99,10,300,6,0.5,5.991);  //This solver needs at least 6 points
+    });
+
+    vector<int> vCandidates;
+    for(int i=0; i<nKFs; i++)
+        if(!vbDiscarded[i])
+            vCandidates.push_back(i);
+
+    // Each candidate alternates 5 P4P RANSAC iterations with pose optimization on its own copy
+    // of the frame, until it finds a pose supported by enough inliers or runs out of iterations.
+    // The first candidate (in database order) that succeeds wins: candidates after it stop
+    // as soon as it is found, the ones before it still get their chance.
+    std::atomic<int> nWinner(nKFs);
+    vector<Frame*> vpCandidateFrames(nKFs,static_cast<Frame*>(NULL));
 
-    while(nCandidates>0 && !bMatch)
+    ThreadPool::ParallelFor(mpThreadPool, vCandidates.size(), [&](int c)
     {
-        for(int i=0; i<nKFs; i++)
-        {
-            if(vbDiscarded[i])
-                continue;
+        const int i = vCandidates[c];
+        MLPnPsolver* pSolver = mvpRelocSolvers[i];
+        Frame* pF = new Frame(mCurrentFrame);
+        vpCandidateFrames[i] = pF;
+
+        ORBmatcher matcher2(0.9,true);
+        bool bNoMore = false;
 
+        while(!bNoMore && i<nWinner)
+        {
             // Perform 5 Ransac Iterations
             vector<bool> vbInliers;
             int nInliers;
-            bool bNoMore;
 
-            MLPnPsolver* pSolver = vpMLPnPsolvers[i];
             Eigen::Matrix4f eigTcw;
             bool bTcw = pSolver->iterate(5,bNoMore,vbInliers,nInliers, eigTcw);
 
-            // If Ransac reachs max. iterations discard keyframe
-            if(bNoMore)
-            {
-                vbDiscarded[i]=true;
-                nCandidates--;
-            }
-
             // If a Camera Pose is computed, optimize
-            if(bTcw)
-            {
-                Sophus::SE3f Tcw(eigTcw);
-                mCurrentFrame.SetPose(Tcw);
-                // Tcw.copyTo(mCurrentFrame.mTcw);
+            if(!bTcw)
+                continue;
 
-                set<MapPoint*> sFound;
+            Sophus::SE3f Tcw(eigTcw);
+            pF->SetPose(Tcw);
 
-                const int np = vbInliers.size();
+            set<MapPoint*> sFound;
 
-                for(int j=0; j<np; j++)
+            const int np = vbInliers.size();
+
+            for(int j=0; j<np; j++)
+            {
+                if(vbInliers[j])
                 {
-                    if(vbInliers[j])
-                    {
-                        mCurrentFrame.mvpMapPoints[j]=vvpMapPointMatches[i][j];
-                        sFound.insert(vvpMapPointMatches[i][j]);
-                    }
-                    else
-                        mCurrentFrame.mvpMapPoints[j]=NULL;
+                    pF->mvpMapPoints[j]=vvpMapPointMatches[i][j];
+                    sFound.insert(vvpMapPointMatches[i][j]);
                 }
+                else
+                    pF->mvpMapPoints[j]=NULL;
+            }
 
-                int nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+            int nGood = Optimizer::PoseOptimization(pF);
 
-                if(nGood<10)
-                    continue;
+            if(nGood<10)
+                continue;
+
+            for(int io =0; io<pF->N; io++)
+                if(pF->mvbOutlier[io])
+                    pF->mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
 
-                for(int io =0; io<mCurrentFrame.N; io++)
-                    if(mCurrentFrame.mvbOutlier[io])
-                        mCurrentFrame.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
+            // If few inliers, search by projection in a coarse window and optimize again
+            if(nGood<50)
+            {
+                int nadditional =matcher2.SearchByProjection(*pF,vpCandidateKFs[i],sFound,10,100);
 
-                // If few inliers, search by projection in a coarse window and optimize again
-                if(nGood<50)
+                if(nadditional+nGood>=50)
                 {
-                    int nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,10,100);
+                    nGood = Optimizer::PoseOptimization(pF);
 
-                    if(nadditional+nGood>=50)
+                    // If many inliers but still not enough, search by projection again in a narrower window
+                    // the camera has been already optimized with many points
+                    if(nGood>30 && nGood<50)
                     {
-                        nGood = Optimizer::PoseOptimization(&mCurrentFrame);
-
-                        // If many inliers but still not enough, search by projection again in a narrower window
-                        // the camera has been already optimized with many points
-                        if(nGood>30 && nGood<50)
+                        sFound.clear();
+                        for(int ip =0; ip<pF->N; ip++)
+                            if(pF->mvpMapPoints[ip])
+                                sFound.insert(pF->mvpMapPoints[ip]);
+                        nadditional =matcher2.SearchByProjection(*pF,vpCandidateKFs[i],sFound,3,64);
+
+                        // Final optimization
+                        if(nGood+nadditional>=50)
                         {
-                            sFound.clear();
-                            for(int ip =0; ip<mCurrentFrame.N; ip++)
-                                if(mCurrentFrame.mvpMapPoints[ip])
-                                    sFound.insert(mCurrentFrame.mvpMapPoints[ip]);
-                            nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,3,64);
-
-                            // Final optimization
-                            if(nGood+nadditional>=50)
-                            {
-                                nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+                            nGood = Optimizer::PoseOptimization(pF);
 
-                                for(int io =0; io<mCurrentFrame.N; io++)
-                                    if(mCurrentFrame.mvbOutlier[io])
-                                        mCurrentFrame.mvpMapPoints[io]=NULL;
-                            }
+                            for(int io =0; io<pF->N; io++)
+                                if(pF->mvbOutlier[io])
+                                    pF->mvpMapPoints[io]=NULL;
                         }
                     }
                 }
+            }
 
-
-                // If the pose is supported by enough inliers stop ransacs and continue
-                if(nGood>=50)
-                {
-                    bMatch = true;
-                    break;
-                }
+            // If the pose is supported by enough inliers stop ransacs and continue
+            if(nGood>=50)
+            {
+                int nPrev = nWinner;
+                while(i<nPrev && !nWinner.compare_exchange_weak(nPrev,i));
+                break;
             }
         }
+    });
+
+    const int nBest = nWinner;
+    const bool bMatch = nBest<nKFs;
+
+    if(bMatch)
+    {
+        const Frame* pF = vpCandidateFrames[nBest];
+        mCurrentFrame.SetPose(pF->GetPose());
+        mCurrentFrame.mvpMapPoints = pF->mvpMapPoints;
+        mCurrentFrame.mvbOutlier = pF->mvbOutlier;
     }
 
+    for(int i=0; i<nKFs; i++)
+        delete vpCandidateFrames[i];
+
     if(!bMatch)
     {
         return false;
@@ -3806,6 +3847,12 @@ void Tracking::Reset(bool bLocMap)
     mpKeyFrameDB->clear();
     Verbose::PrintMess("done", Verbose::VERBOSITY_NORMAL);
 
+    // Write the streamed trajectory while its keyframes exist
+    {
+        unique_lock<mutex> lock(mTrajectory.mMutexTrajectory);
+        mTrajectory.FlushStream();
+    }
+
     // Clear Map (this erase MapPoints and KeyFrames)
     mpAtlas->clearAtlas();
     mpAtlas->CreateNewMap();
@@ -3820,10 +3867,10 @@ void Tracking::Reset(bool bLocMap)
     mbReadyToInitializate = false;
     mbSetInit=false;
 
-    mlRelativeFramePoses.clear();
-    mlpReferences.clear();
-    mlFrameTimes.clear();
-    mlbLost.clear();
+    {
+        unique_lock<mutex> lock(mTrajectory.mMutexTrajectory);
+        mTrajectory.Clear();
+    }
     mCurrentFrame = Frame();
     mnLastRelocFrameId = 0;
     mLastFrame = Frame();
@@ -3866,6 +3913,12 @@ void Tracking::ResetActiveMap(bool bLocMap)
     mpKeyFrameDB->clearMap(pMap); // Only clear the active map references
     Verbose::PrintMess("done", Verbose::VERBOSITY_NORMAL);
 
+    // Write the streamed trajectory while its keyframes exist
+    {
+        unique_lock<mutex> lock(mTrajectory.mMutexTrajectory);
+        mTrajectory.FlushStream();
+    }
+
     // Clear Map (this erase MapPoints and KeyFrames)
     mpAtlas->clearMap();
 
@@ -3878,8 +3931,6 @@ void Tracking::ResetActiveMap(bool bLocMap)
 
     mbReadyToInitializate = false;
 
-    list<bool> lbLost;
-    // lbLost.reserve(mlbLost.size());
     unsigned int index = mnFirstFrameId;
     cout << "mnFirstFrameId = " << mnFirstFrameId << endl;
     for(Map* pMap : mpAtlas->GetAllMaps())
@@ -3895,22 +3946,22 @@ void Tracking::ResetActiveMap(bool bLocMap)
     int num_lost = 0;
     cout << "mnInitialFrameId = " << mnInitialFrameId << endl;
 
-    for(list<bool>::iterator ilbL = mlbLost.begin(); ilbL != mlbLost.end(); ilbL++)
     {
-        if(index < mnInitialFrameId)
-            lbLost.push_back(*ilbL);
-        else
+        unique_lock<mutex> lock(mTrajectory.mMutexTrajectory);
+        index += mTrajectory.Begin();
+        for(size_t i=mTrajectory.Begin(); i<mTrajectory.size(); i++)
         {
-            lbLost.push_back(true);
-            num_lost += 1;
-        }
+            if(index >= mnInitialFrameId)
+            {
+                mTrajectory[i].bLost = true;
+                num_lost += 1;
+            }
 
-        index++;
+            index++;
+        }
     }
     cout << num_lost << " Frames set to lost" << endl;
 
-    mlbLost = lbLost;
-
     mnInitialFrameId = mCurrentFrame.mnId;
     mnLastRelocFrameId = mCurrentFrame.mnId;
 
@@ -3981,23 +4032,25 @@ void Tracking::UpdateFrameIMU(const float s, const IMU::Bias &b, KeyFrame* pCurr
 {
     Map * pMap = pCurrentKeyFrame->GetMap();
     unsigned int index = mnFirstFrameId;
-    list<ORB_SLAM3::KeyFrame*>::iterator lRit = mlpReferences.begin();
-    list<bool>::iterator lbL = mlbLost.begin();
-    for(auto lit=mlRelativeFramePoses.begin(),lend=mlRelativeFramePoses.end();lit!=lend;lit++, lRit++, lbL++)
     {
-        if(*lbL)
-            continue;
+        unique_lock<mutex> lock(mTrajectory.mMutexTrajectory);
+        for(size_t i=mTrajectory.Begin(); i<mTrajectory.size(); i++)
+        {
+            FramePose &pose = mTrajectory[i];
+            if(pose.bLost)
+                continue;
 
-        KeyFrame* pKF = *lRit;
+            KeyFrame* pKF = pose.pReferenceKF;
 
-        while(pKF->isBad())
-        {
-            pKF = pKF->GetParent();
-        }
+            while(pKF->isBad())
+            {
+                pKF = pKF->GetParent();
+            }
 
-        if(pKF->GetMap() == pMap)
-        {
-            (*lit).translation() *= s;
+            if(pKF->GetMap() == pMap)
+            {
+                pose.Tcr.translation() *= s;
+            }
         }
     }
 
@@ -4086,8 +4139,11 @@ float Tracking::GetImageScale()
 #ifdef REGISTER_LOOP
 void Tracking::RequestStop()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    mbStopRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        mbStopRequested = true;
+    }
+    mStopChanged.Notify();
 }
 
 bool Tracking::Stop()
@@ -4117,9 +4173,12 @@ bool Tracking::isStopped()
 
 void Tracking::Release()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    mbStopped = false;
-    mbStopRequested = false;
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        mbStopped = false;
+        mbStopRequested = false;
+    }
+    mStopChanged.Notify();
 }
 #endif
 
@@ -20,11 +20,10 @@
 
 #include "Converter.h"
 #include "GeometricTools.h"
+#include "ThreadPool.h"
 
 #include "Thirdparty/DBoW2/DUtils/Random.h"
 
-#include<thread>
-
 
 using namespace std;
 namespace ORB_SLAM3
@@ -39,7 +38,8 @@ namespace ORB_SLAM3
     }
 
     bool TwoViewReconstruction::Reconstruct(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const vector<int> &vMatches12,
-                                             Sophus::SE3f &T21, vector<cv::Point3f> &vP3D, vector<bool> &vbTriangulated)
+                                             Sophus::SE3f &T21, vector<cv::Point3f> &vP3D, vector<bool> &vbTriangulated,
+                                             ThreadPool* pThreadPool)
     {
         mvKeys1.clear();
         mvKeys2.clear();
@@ -97,17 +97,19 @@ namespace ORB_SLAM3
             }
         }
 
-        // Launch threads to compute in parallel a fundamental matrix and a homography
+        // Compute in parallel a fundamental matrix and a homography
         vector<bool> vbMatchesInliersH, vbMatchesInliersF;
         float SH, SF;
         Eigen::Matrix3f H, F;
 
-        thread threadH(&TwoViewReconstruction::FindHomography,this,ref(vbMatchesInliersH), ref(SH), ref(H));
-        thread threadF(&TwoViewReconstruction::FindFundamental,this,ref(vbMatchesInliersF), ref(SF), ref(F));
-
-        // Wait until both threads have finished
-        threadH.join();
-        threadF.join();
+        // Returns when both models have been computed
+        ThreadPool::ParallelFor(pThreadPool, 2, [&](int i)
+        {
+            if(i==0)
+                FindHomography(vbMatchesInliersH, SH, H);
+            else
+                FindFundamental(vbMatchesInliersF, SF, F);
+        });
 
         // Compute ratio of scores
         if(SH+SF == 0.f) return false;
@@ -0,0 +1,112 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include<iostream>
+#include<fstream>
+#include<cstdio>
+#include<chrono>
+
+#include<openssl/md5.h>
+
+#include"ORBVocabulary.h"
+
+using namespace std;
+
+// Same MD5 as System::CalculateCheckSum on the text file, so that atlases
+// saved with the text vocabulary can be loaded with the binary one
+string TextFileChecksum(const string &filename)
+{
+    string checksum = "";
+
+    ifstream f(filename.c_str(), std::ios::in);
+    if(!f.is_open())
+        return checksum;
+
+    unsigned char c[MD5_DIGEST_LENGTH];
+    MD5_CTX md5Context;
+    char buffer[1024];
+
+    MD5_Init(&md5Context);
+    while(int count = f.readsome(buffer, sizeof(buffer)))
+        MD5_Update(&md5Context, buffer, count);
+    f.close();
+
+    MD5_Final(c, &md5Context);
+
+    for(int i = 0; i < MD5_DIGEST_LENGTH; i++)
+    {
+        char aux[10];
+        sprintf(aux,"%02x", c[i]);
+        checksum = checksum + aux;
+    }
+
+    return checksum;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc != 3)
+    {
+        cerr << endl << "Usage: ./bin_vocabulary path_to_text_vocabulary path_to_binary_vocabulary" << endl;
+        return 1;
+    }
+
+    const string strTextFile = argv[1];
+    const string strBinFile = argv[2];
+
+    ORB_SLAM3::ORBVocabulary voc;
+
+    cout << "Loading text vocabulary " << strTextFile << endl;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    if(!voc.loadFromTextFile(strTextFile))
+    {
+        cerr << "Failed to load " << strTextFile << endl;
+        return 1;
+    }
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    if(!voc.saveToBinaryFile(strBinFile, TextFileChecksum(strTextFile)))
+    {
+        cerr << "Failed to write " << strBinFile << endl;
+        return 1;
+    }
+
+    // Check that the new file loads and gives the same words
+    ORB_SLAM3::ORBVocabulary vocBin;
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    if(!vocBin.loadFromBinaryFile(strBinFile))
+    {
+        cerr << "Failed to load back " << strBinFile << endl;
+        return 1;
+    }
+    std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+
+    if(vocBin.size() != voc.size())
+    {
+        cerr << "Binary vocabulary has " << vocBin.size() << " words instead of " << voc.size() << endl;
+        return 1;
+    }
+
+    const double tText = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(t1 - t0).count();
+    const double tBin = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(t3 - t2).count();
+
+    cout << voc.size() << " words written to " << strBinFile << endl;
+    cout << "Load time: text " << tText << " ms, binary " << tBin << " ms" << endl;
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include<iostream>
+#include<vector>
+#include<string>
+#include<chrono>
+#include<cstdlib>
+
+#include<opencv2/core/core.hpp>
+
+#include"HammingDistance.h"
+
+using namespace std;
+using namespace ORB_SLAM3;
+
+// Reference distance, one bit at a time
+int ReferenceDistance(const uint8_t* a, const uint8_t* b)
+{
+    int dist=0;
+    for(int i=0; i<32; i++)
+    {
+        const uint8_t v = a[i]^b[i];
+        for(int j=0; j<8; j++)
+            dist += (v>>j) & 1;
+    }
+    return dist;
+}
+
+// Checks every entry point of the selected kernel against the reference and returns the mismatches
+// descriptors may have any row step, contiguous holds the same rows packed in 32 bytes
+int Check(const cv::Mat &descriptors, const cv::Mat &contiguous, const vector<unsigned int> &vIndices,
+          const vector<size_t> &vIndicesSizeT)
+{
+    const int N = descriptors.rows;
+    int nErrors = 0;
+    vector<int> vDist, vDistSizeT, vDistContiguous(N);
+
+    for(int q=0; q<N; q++)
+    {
+        const uint8_t* pQuery = descriptors.ptr<uint8_t>(q);
+        const cv::Mat query = descriptors.row(q);
+
+        HammingDistance::Compute(query, descriptors, vIndices, vDist);
+        HammingDistance::Compute(query, descriptors, vIndicesSizeT, vDistSizeT);
+        HammingDistance::Compute(pQuery, contiguous.ptr<uint8_t>(), N, vDistContiguous.data());
+
+        for(size_t i=0; i<vIndices.size(); i++)
+        {
+            const int ref = ReferenceDistance(pQuery, descriptors.ptr<uint8_t>(vIndices[i]));
+            if(vDist[i]!=ref || vDistSizeT[i]!=ref)
+                nErrors++;
+        }
+
+        for(int i=0; i<N; i++)
+        {
+            const int ref = ReferenceDistance(pQuery, descriptors.ptr<uint8_t>(i));
+            if(vDistContiguous[i]!=ref || HammingDistance::Compute(pQuery, descriptors.ptr<uint8_t>(i))!=ref)
+                nErrors++;
+        }
+    }
+
+    return nErrors;
+}
+
+// Nanoseconds per distance of f, which computes nDistances distances per call
+template<class F>
+double Time(F f, int nDistances, int nRepetitions)
+{
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for(int r=0; r<nRepetitions; r++)
+        f();
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    const double ns = std::chrono::duration_cast<std::chrono::duration<double,std::nano> >(t1-t0).count();
+    return ns/((double)nDistances*nRepetitions);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc > 3)
+    {
+        cerr << endl << "Usage: ./hamming_benchmark [num_descriptors] [repetitions]" << endl;
+        return 1;
+    }
+
+    const int N = argc > 1 ? atoi(argv[1]) : 2000;
+    const int nRepetitions = argc > 2 ? atoi(argv[2]) : 200;
+    if(N<=0 || nRepetitions<=0)
+    {
+        cerr << "The number of descriptors and repetitions must be positive" << endl;
+        return 1;
+    }
+
+    // Random descriptors, with a row step larger than 32 bytes as in a submatrix
+    cv::Mat storage(N, 48, CV_8U);
+    cv::randu(storage, cv::Scalar::all(0), cv::Scalar::all(256));
+    const cv::Mat descriptors = storage.colRange(0,32);
+
+    // Candidates as the matcher collects them: scattered rows, some repeated
+    vector<unsigned int> vIndices(N);
+    vector<size_t> vIndicesSizeT(N);
+    cv::RNG rng(0);
+    for(int i=0; i<N; i++)
+    {
+        vIndices[i] = rng.uniform(0,N);
+        vIndicesSizeT[i] = vIndices[i];
+    }
+
+    const cv::Mat contiguous = descriptors.clone();
+    const string strDefault = HammingDistance::KernelName();
+    cout << "Descriptors: " << N << ", repetitions: " << nRepetitions << ", selected kernel: " << strDefault << endl << endl;
+
+    const char* kernels[] = {"scalar", "popcnt", "avx2", "avx512"};
+    const uint8_t* pQuery = descriptors.ptr<uint8_t>(0);
+    const cv::Mat query = descriptors.row(0);
+    vector<int> vDist(N);
+    volatile int sink = 0;
+    int nFailed = 0;
+
+    // Reference first, the kernels are compared against it
+    const double tReference = Time([&](){
+        for(int i=0; i<N; i++)
+            vDist[i] = ReferenceDistance(pQuery, contiguous.ptr<uint8_t>(i));
+        sink += vDist[N-1];
+    }, N, nRepetitions);
+    cout << "reference  pair " << tReference << " ns" << endl;
+
+    for(int k=0; k<4; k++)
+    {
+        if(!HammingDistance::SelectKernel(kernels[k]))
+        {
+            cout << kernels[k] << " not supported by this CPU" << endl;
+            continue;
+        }
+
+        const int nErrors = Check(descriptors, contiguous, vIndices, vIndicesSizeT);
+        if(nErrors>0)
+            nFailed++;
+
+        const double tPair = Time([&](){
+            for(int i=0; i<N; i++)
+                vDist[i] = HammingDistance::Compute(pQuery, contiguous.ptr<uint8_t>(i));
+            sink += vDist[N-1];
+        }, N, nRepetitions);
+
+        const double tIndexed = Time([&](){
+            HammingDistance::Compute(query, descriptors, vIndices, vDist);
+            sink += vDist[N-1];
+        }, N, nRepetitions);
+
+        const double tContiguous = Time([&](){
+            HammingDistance::Compute(pQuery, contiguous.ptr<uint8_t>(), N, vDist.data());
+            sink += vDist[N-1];
+        }, N, nRepetitions);
+
+        cout << kernels[k] << "  pair " << tPair << " ns, indexed " << tIndexed << " ns, contiguous " << tContiguous
+             << " ns, " << (nErrors==0 ? "matches the reference" : "MISMATCHES") << " (" << nErrors << " errors)" << endl;
+    }
+
+    HammingDistance::SelectKernel(strDefault);
+
+    return nFailed==0 ? 0 : 1;
+}